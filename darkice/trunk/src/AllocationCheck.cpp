@@ -0,0 +1,487 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : AllocationCheck.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error need stdlib.h
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#error need unistd.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+#include <new>
+#include <atomic>
+#include <iostream>
+
+#include "Exception.h"
+#include "Ref.h"
+#include "Reporter.h"
+#include "AudioSource.h"
+#include "Sink.h"
+#include "BufferedSink.h"
+#include "FanOutSink.h"
+#include "MultiThreadedConnector.h"
+
+#ifdef HAVE_LAME_LIB
+#include "LameLibEncoder.h"
+#endif
+#ifdef HAVE_TWOLAME_LIB
+#include "TwoLameLibEncoder.h"
+#endif
+#ifdef HAVE_VORBIS_LIB
+#include "VorbisLibEncoder.h"
+#endif
+#ifdef HAVE_OPUS_LIB
+#include "OpusLibEncoder.h"
+#endif
+#ifdef HAVE_FLAC_LIB
+#include "FlacLibEncoder.h"
+#endif
+#ifdef HAVE_FAAC_LIB
+#include "FaacEncoder.h"
+#endif
+#ifdef HAVE_FDKAAC_LIB
+#include "aacPlusEncoder.h"
+#endif
+
+
+/* ===================================================  local data structures */
+
+/*------------------------------------------------------------------------------
+ *  A sine tone, read in chunks paced a little faster than real time.
+ *  It starts counting the heap calls once the encoders warmed up, and
+ *  stops counting at the end.
+ *----------------------------------------------------------------------------*/
+class ToneSource : public AudioSource
+{
+    private:
+
+        /**
+         *  The number of chunks read so far.
+         */
+        unsigned int    chunks;
+
+        /**
+         *  The number of samples read so far, for each channel.
+         */
+        unsigned long   samples;
+
+    public:
+
+        /**
+         *  Constructor, for 16 bit stereo at 44.1 kHz.
+         */
+        inline
+        ToneSource ( void )
+                    : AudioSource( 44100, 16, 2)
+        {
+            chunks  = 0;
+            samples = 0;
+        }
+
+        inline virtual bool
+        open ( void )
+        {
+            return true;
+        }
+
+        inline virtual bool
+        isOpen ( void ) const                       throw ()
+        {
+            return true;
+        }
+
+        inline virtual bool
+        canRead (   unsigned int    sec,
+                    unsigned int    usec )
+        {
+            return true;
+        }
+
+        virtual unsigned int
+        read (  void          * buf,
+                unsigned int    len );
+
+        inline virtual void
+        close ( void )
+        {
+        }
+};
+
+/*------------------------------------------------------------------------------
+ *  A sink taking anything, the end of the chain of each output
+ *----------------------------------------------------------------------------*/
+class NullSink : public Sink
+{
+    private:
+
+        /**
+         *  Tell if the sink is open.
+         */
+        bool    opened;
+
+    public:
+
+        /**
+         *  Default constructor.
+         */
+        inline
+        NullSink ( void )
+        {
+            opened = false;
+        }
+
+        inline virtual bool
+        open ( void )
+        {
+            opened = true;
+            return true;
+        }
+
+        inline virtual bool
+        isOpen ( void ) const                       throw ()
+        {
+            return opened;
+        }
+
+        inline virtual bool
+        canWrite (  unsigned int    sec,
+                    unsigned int    usec )
+        {
+            return true;
+        }
+
+        inline virtual unsigned int
+        write ( const void    * buf,
+                unsigned int    len )
+        {
+            return len;
+        }
+
+        inline virtual void
+        flush ( void )
+        {
+        }
+
+        inline virtual void
+        cut ( void )                                throw ()
+        {
+        }
+
+        inline virtual void
+        close ( void )
+        {
+            opened = false;
+        }
+};
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The size of the chunks read, as DarkIce reads by default
+ *----------------------------------------------------------------------------*/
+static const unsigned int   chunkSize    = 4096;
+
+/*------------------------------------------------------------------------------
+ *  The chunks read before counting, for the buffers to reach their size
+ *----------------------------------------------------------------------------*/
+static const unsigned int   warmUpChunks = 200;
+
+/*------------------------------------------------------------------------------
+ *  The chunks read while counting
+ *----------------------------------------------------------------------------*/
+static const unsigned int   countChunks  = 800;
+
+/*------------------------------------------------------------------------------
+ *  The microseconds to give the sinks to catch up, before starting and
+ *  stopping the count
+ *----------------------------------------------------------------------------*/
+static const unsigned int   settleTime   = 500000;
+
+/*------------------------------------------------------------------------------
+ *  The microseconds between the chunks read
+ *----------------------------------------------------------------------------*/
+static const unsigned int   chunkTime    = 2000;
+
+/*------------------------------------------------------------------------------
+ *  Tell if the heap calls are being counted
+ *----------------------------------------------------------------------------*/
+static std::atomic<bool>            counting( false);
+
+/*------------------------------------------------------------------------------
+ *  The heap calls made while counting, by any thread
+ *----------------------------------------------------------------------------*/
+static std::atomic<unsigned long>   heapCalls( 0);
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  The allocation functions of the program, counting the calls
+ *----------------------------------------------------------------------------*/
+static void *
+countedAlloc (  size_t      size )
+{
+    void  * ptr;
+
+    if ( counting.load( std::memory_order_relaxed) ) {
+        heapCalls.fetch_add( 1, std::memory_order_relaxed);
+    }
+    ptr = malloc( size ? size : 1);
+    if ( !ptr ) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *
+operator new ( size_t   size )
+{
+    return countedAlloc( size);
+}
+
+void *
+operator new[] ( size_t     size )
+{
+    return countedAlloc( size);
+}
+
+void *
+operator new ( size_t                   size,
+               const std::nothrow_t   & nt )            throw ()
+{
+    try {
+        return countedAlloc( size);
+    } catch ( std::bad_alloc    & e ) {
+        return 0;
+    }
+}
+
+void *
+operator new[] ( size_t                 size,
+                 const std::nothrow_t & nt )            throw ()
+{
+    try {
+        return countedAlloc( size);
+    } catch ( std::bad_alloc    & e ) {
+        return 0;
+    }
+}
+
+void
+operator delete ( void    * ptr )                       throw ()
+{
+    free( ptr);
+}
+
+void
+operator delete[] ( void  * ptr )                       throw ()
+{
+    free( ptr);
+}
+
+void
+operator delete ( void    * ptr,
+                  size_t    size )                      throw ()
+{
+    free( ptr);
+}
+
+void
+operator delete[] ( void  * ptr,
+                    size_t  size )                      throw ()
+{
+    free( ptr);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Read a chunk of the tone
+ *----------------------------------------------------------------------------*/
+unsigned int
+ToneSource :: read (    void          * buf,
+                        unsigned int    len )
+{
+    int16_t       * s = (int16_t *) buf;
+    unsigned int    n = len / 4;
+
+    if ( chunks == warmUpChunks ) {
+        usleep( settleTime);
+        counting.store( true);
+    } else if ( chunks == warmUpChunks + countChunks ) {
+        usleep( settleTime);
+        counting.store( false);
+        return 0;
+    }
+    ++chunks;
+
+    for ( unsigned int i = 0; i < n; ++i, ++samples ) {
+        int16_t     v = (int16_t) (8000.0 * sin( samples * 0.0627));
+
+        s[2 * i]     = v;
+        s[2 * i + 1] = (int16_t) -v;
+    }
+    usleep( chunkTime);
+
+    return n * 4;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Attach a sink to the connector
+ *----------------------------------------------------------------------------*/
+static void
+attach (    MultiThreadedConnector    * connector,
+            Sink                      * sink,
+            const char                * name )
+{
+    connector->attach( sink);
+    std::cout << "writing " << name << std::endl;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Create the chain of sinks of a stream output
+ *----------------------------------------------------------------------------*/
+static Sink *
+newOutput ( void )
+{
+    return new FanOutSink( new BufferedSink( new NullSink(), 64 * 1024));
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Encode a tone with all the encoders built in, through the connector,
+ *  and check that none of them calls the heap once warmed up
+ *----------------------------------------------------------------------------*/
+int
+main (  int         argc,
+        char      * argv[] )
+{
+    try {
+        Ref<ToneSource>                 source    = new ToneSource();
+        Ref<MultiThreadedConnector>     connector;
+        AudioSource                   * dsp       = source.get();
+
+        Reporter::setReportVerbosity( 0);
+        connector = new MultiThreadedConnector( dsp, true, 64 * 1024);
+
+        // a plain sink, taking the raw audio
+        attach( connector.get(), newOutput(), "raw audio");
+
+#ifdef HAVE_LAME_LIB
+        attach( connector.get(),
+                new LameLibEncoder( newOutput(), dsp, AudioEncoder::cbr,
+                                    128, 0.5, 44100, 2),
+                "mp3");
+#endif
+#ifdef HAVE_TWOLAME_LIB
+        attach( connector.get(),
+                new TwoLameLibEncoder( newOutput(), dsp, AudioEncoder::cbr,
+                                       128, 44100, 2),
+                "mp2");
+#endif
+#ifdef HAVE_VORBIS_LIB
+        attach( connector.get(),
+                new VorbisLibEncoder( newOutput(), dsp, AudioEncoder::vbr,
+                                      128, 0.4, 44100, 2),
+                "vorbis");
+        attach( connector.get(),
+                new VorbisLibEncoder( newOutput(), dsp, AudioEncoder::vbr,
+                                      64, 0.2, 22050, 2, 0, 2),
+                "vorbis, resampled, pipelined");
+#endif
+#ifdef HAVE_OPUS_LIB
+        attach( connector.get(),
+                new OpusLibEncoder( newOutput(), dsp, AudioEncoder::cbr,
+                                    96, 0.5, 48000, 2),
+                "opus");
+        attach( connector.get(),
+                new OpusLibEncoder( newOutput(), dsp, AudioEncoder::vbr,
+                                    64, 0.5, 48000, 2, 0, 2),
+                "opus, pipelined");
+#endif
+#ifdef HAVE_FLAC_LIB
+        attach( connector.get(),
+                new FlacLibEncoder( newOutput(), dsp, AudioEncoder::vbr,
+                                    0, 0.5, 44100, 2),
+                "flac");
+#endif
+#ifdef HAVE_FAAC_LIB
+        attach( connector.get(),
+                new FaacEncoder( newOutput(), dsp, AudioEncoder::cbr,
+                                 128, 0.5, 44100, 2),
+                "aac");
+#endif
+#ifdef HAVE_FDKAAC_LIB
+        attach( connector.get(),
+                new aacPlusEncoder( newOutput(), dsp, AudioEncoder::cbr,
+                                    64, 0.5, 44100, 2),
+                "aacp");
+#endif
+
+        if ( !connector->open() ) {
+            std::cerr << "couldn't open the connector" << std::endl;
+            return 1;
+        }
+        connector->transfer( 0, chunkSize, 1, 0);
+        connector->close();
+    } catch ( Exception   & e ) {
+        std::cerr << "allocation check failed: " << e << std::endl;
+        return 1;
+    }
+
+    std::cout << "heap calls in " << countChunks << " chunks once warmed up: "
+              << heapCalls.load() << std::endl;
+
+    return heapCalls.load() ? 1 : 0;
+}
+
@@ -43,6 +43,18 @@
 #include "config.h"
 #endif
 
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#else
+#error need errno.h
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
 #include "Util.h"
 #include "Exception.h"
 #include "AlsaDspSource.h"
@@ -78,12 +90,18 @@ AlsaDspSource :: isBigEndian ( void ) const                  throw ()
  *  Initialize the object
  *----------------------------------------------------------------------------*/
 void
-AlsaDspSource :: init (  const char      * name )
+AlsaDspSource :: init (  const char      * name,
+                         bool              mmapAccess )
 {
     pcmName       = Util::strDup( name);
     captureHandle = 0;
     bufferTime    = 1000000; // Do 1s buffering
+    periodSize    = 0;
     running       = false;
+    pollFds       = 0;
+    numPollFds    = 0;
+
+    this->mmapAccess = mmapAccess;
 }
 
 
@@ -123,6 +141,19 @@ AlsaDspSource :: open ( void )
         case 16:
             format = SND_PCM_FORMAT_S16;
             break;
+
+        case 24:
+            // packed into 3 bytes, in the byte order of the host
+#ifdef WORDS_BIGENDIAN
+            format = SND_PCM_FORMAT_S24_3BE;
+#else
+            format = SND_PCM_FORMAT_S24_3LE;
+#endif
+            break;
+
+        case 32:
+            format = SND_PCM_FORMAT_S32;
+            break;
             
         default:
             return false;
@@ -147,7 +178,9 @@ AlsaDspSource :: open ( void )
     }
 
     if (snd_pcm_hw_params_set_access(captureHandle, hwParams,
-                                     SND_PCM_ACCESS_RW_INTERLEAVED) < 0) {
+                                     mmapAccess
+                                   ? SND_PCM_ACCESS_MMAP_INTERLEAVED
+                                   : SND_PCM_ACCESS_RW_INTERLEAVED) < 0) {
         snd_pcm_hw_params_free(hwParams);
         close();
         throw Exception( __FILE__, __LINE__, "can't set access type");
@@ -195,6 +228,12 @@ AlsaDspSource :: open ( void )
         throw Exception( __FILE__, __LINE__, "can't set hardware parameters");
     }
 
+    // let the reads line up with the periods of the device
+    snd_pcm_uframes_t   frames;
+    if (snd_pcm_hw_params_get_period_size(hwParams, &frames, 0) == 0) {
+        periodSize = frames;
+    }
+
     snd_pcm_hw_params_free(hwParams);
 
     if (snd_pcm_prepare(captureHandle) < 0) {
@@ -205,10 +244,116 @@ AlsaDspSource :: open ( void )
 
     bytesPerFrame = getChannel() * getBitsPerSample() / 8;
 
+    if ( mmapAccess ) {
+        setupPolling();
+    }
+
     return true;
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Set up waking up on period boundaries
+ *----------------------------------------------------------------------------*/
+void
+AlsaDspSource :: setupPolling ( void )
+{
+    snd_pcm_sw_params_t   * swParams;
+    int                     count;
+
+    if (snd_pcm_sw_params_malloc(&swParams) < 0) {
+        close();
+        throw Exception( __FILE__, __LINE__, "can't alloc software "\
+                        "parameter structure");
+    }
+
+    // wake up once for each period captured
+    if (snd_pcm_sw_params_current(captureHandle, swParams) < 0
+     || snd_pcm_sw_params_set_avail_min(captureHandle, swParams,
+                                        periodSize) < 0
+     || snd_pcm_sw_params(captureHandle, swParams) < 0) {
+        snd_pcm_sw_params_free(swParams);
+        close();
+        throw Exception( __FILE__, __LINE__, "can't set software parameters");
+    }
+    snd_pcm_sw_params_free(swParams);
+
+    count = snd_pcm_poll_descriptors_count(captureHandle);
+    if (count <= 0) {
+        close();
+        throw Exception( __FILE__, __LINE__, "no descriptors to poll", count);
+    }
+    numPollFds = count;
+    pollFds    = new struct pollfd[numPollFds];
+    if (snd_pcm_poll_descriptors(captureHandle, pollFds, numPollFds) < 0) {
+        close();
+        throw Exception( __FILE__, __LINE__, "can't get descriptors to poll");
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wait until at least a period is captured
+ *----------------------------------------------------------------------------*/
+bool
+AlsaDspSource :: waitForPeriod ( int    msecs )
+{
+    snd_pcm_sframes_t   avail;
+    unsigned short      revents;
+    int                 ret;
+
+    for (;;) {
+        avail = snd_pcm_avail_update(captureHandle);
+        if (avail < 0) {
+            recover(avail);
+            continue;
+        }
+        if ((snd_pcm_uframes_t) avail >= periodSize) {
+            return true;
+        }
+
+        ret = poll(pollFds, numPollFds, msecs);
+        if (ret == 0) {
+            return false;
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw Exception( __FILE__, __LINE__, "poll error", errno);
+        }
+
+        snd_pcm_poll_descriptors_revents(captureHandle, pollFds, numPollFds,
+                                         &revents);
+        if (revents & POLLERR) {
+            recover(-EPIPE);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Recover from an overrun or a suspend of the device
+ *----------------------------------------------------------------------------*/
+void
+AlsaDspSource :: recover ( int  err )
+{
+    if (err == -EPIPE) {
+        reportEvent(1, "AlsaDspSource :: Buffer overrun!");
+        noteXrun();
+    }
+
+    if (snd_pcm_recover(captureHandle, err, 1) < 0) {
+        Exception e = Exception(__FILE__, __LINE__, snd_strerror(err));
+        close();
+        throw e;
+    }
+
+    // a recovered capture has to be started again
+    snd_pcm_start(captureHandle);
+}
+
+
 /*------------------------------------------------------------------------------
  *  Check whether read() would return anything
  *----------------------------------------------------------------------------*/
@@ -225,6 +370,11 @@ AlsaDspSource :: canRead ( unsigned int    sec,
         running = true;
     }
 
+    // when mmapped, the device wakes us up as each period is captured
+    if ( mmapAccess ) {
+        return waitForPeriod( sec * 1000 + usec / 1000);
+    }
+
     /*
      * FIXME How to check for available frames? It
      * seems like snd_pcm_wait stops working when
@@ -250,12 +400,17 @@ AlsaDspSource :: read (    void          * buf,
         return 0;
     }
 
+    if ( mmapAccess ) {
+        return readMmap( buf, len);
+    }
+
     do {
         ret = snd_pcm_readi(captureHandle, buf, len/bytesPerFrame);
 
         // Check for buffer overrun
         if (ret == -EPIPE) {
             reportEvent(1, "AlsaDspSource :: Buffer overrun!");
+            noteXrun();
             snd_pcm_prepare(captureHandle);
             ret = -EAGAIN;
         }
@@ -280,6 +435,71 @@ AlsaDspSource :: read (    void          * buf,
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Read from the memory mapped buffer of the device
+ *----------------------------------------------------------------------------*/
+unsigned int
+AlsaDspSource :: readMmap ( void          * buf,
+                            unsigned int    len )
+{
+    unsigned char             * out    = (unsigned char *) buf;
+    snd_pcm_uframes_t           frames = len / bytesPerFrame;
+    snd_pcm_uframes_t           done   = 0;
+
+    if ( !running ) {
+        snd_pcm_start(captureHandle);
+        running = true;
+    }
+
+    while ( done < frames ) {
+        const snd_pcm_channel_area_t  * areas;
+        snd_pcm_uframes_t               offset;
+        snd_pcm_uframes_t               n;
+        snd_pcm_sframes_t               avail;
+        snd_pcm_sframes_t               ret;
+
+        avail = snd_pcm_avail_update(captureHandle);
+        if (avail < 0) {
+            recover(avail);
+            continue;
+        }
+        if (avail == 0) {
+            // the rest comes with the next period
+            if ( !waitForPeriod( 1000) ) {
+                break;
+            }
+            continue;
+        }
+
+        n = frames - done < (snd_pcm_uframes_t) avail
+          ? frames - done : (snd_pcm_uframes_t) avail;
+        if ((ret = snd_pcm_mmap_begin(captureHandle, &areas, &offset, &n))
+                                                                        < 0) {
+            recover(ret);
+            continue;
+        }
+
+        // interleaved, so all the channels are in the first area. copied
+        // right into the frame to convert: the device buffer is reused
+        // long before the sinks are done with the frame
+        memcpy(out + done * bytesPerFrame,
+               (const unsigned char *) areas[0].addr
+                        + areas[0].first / 8
+                        + offset * areas[0].step / 8,
+               n * bytesPerFrame);
+
+        ret = snd_pcm_mmap_commit(captureHandle, offset, n);
+        if (ret < 0 || (snd_pcm_uframes_t) ret != n) {
+            recover(ret < 0 ? ret : -EPIPE);
+            continue;
+        }
+        done += n;
+    }
+
+    return done * bytesPerFrame;
+}
+
+
 /*------------------------------------------------------------------------------
  *  Close the audio source
  *----------------------------------------------------------------------------*/
@@ -291,9 +511,13 @@ AlsaDspSource :: close ( void )
     }
 
     snd_pcm_close(captureHandle);
+    delete[] pollFds;
 
     captureHandle  = 0;
+    pollFds        = 0;
+    numPollFds     = 0;
     running        = false;
+    periodSize     = 0;
 }
 
 #endif // HAVE_ALSA_LIB
@@ -55,6 +55,12 @@
 #error configure for ALSA 
 #endif
 
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#else
+#error need poll.h
+#endif
+
 
 /* ================================================================ constants */
 
@@ -100,6 +106,27 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
          */
         unsigned int bufferTime;
 
+        /**
+         *  Number of samples for each channel in a period of the device.
+         */
+        unsigned int periodSize;
+
+        /**
+         *  Capture through the memory mapped buffer of the device,
+         *  waking up on period boundaries, instead of snd_pcm_readi.
+         */
+        bool mmapAccess;
+
+        /**
+         *  The descriptors to poll for a captured period, when mmapped.
+         */
+        struct pollfd *pollFds;
+
+        /**
+         *  The number of descriptors in pollFds.
+         */
+        unsigned int numPollFds;
+
 
     protected:
 
@@ -118,10 +145,51 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
          *  Initialize the object
          *
          *  @param name the PCM to open.
+         *  @param mmapAccess capture through the memory mapped buffer.
+         *  @exception Exception
+         */
+        void
+        init (  const char    * name,
+                bool            mmapAccess );
+
+        /**
+         *  Set up waking up on period boundaries, for mmapped capture.
+         *
+         *  @exception Exception
+         */
+        void
+        setupPolling ( void );
+
+        /**
+         *  Wait until at least a period is captured, when mmapped.
+         *
+         *  @param msecs the maximum milliseconds to wait.
+         *  @return true if a period is ready, false on timeout.
          *  @exception Exception
          */
+        bool
+        waitForPeriod ( int     msecs );
+
+        /**
+         *  Recover from an overrun or a suspend of the device.
+         *
+         *  @param err the error returned by ALSA.
+         *  @exception Exception if the device can't recover.
+         */
         void
-        init (  const char    * name );
+        recover ( int   err );
+
+        /**
+         *  Read from the memory mapped buffer of the device.
+         *
+         *  @param buf the buffer to read into.
+         *  @param len the number of bytes to read into buf
+         *  @return the number of bytes read (may be less than len).
+         *  @exception Exception
+         */
+        unsigned int
+        readMmap (  void          * buf,
+                    unsigned int    len );
 
         /**
          *  De-iitialize the object
@@ -142,16 +210,19 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channel number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param mmapAccess capture through the memory mapped buffer of
+         *                    the device, instead of reading it.
          *  @exception Exception
          */
         inline
         AlsaDspSource (  const char    * name,
                          int             sampleRate    = 44100,
                          int             bitsPerSample = 16,
-                         int             channel       = 2 )
+                         int             channel       = 2,
+                         bool            mmapAccess    = false )
                     : AudioSource( sampleRate, bitsPerSample, channel)
         {
-            init( name);
+            init( name, mmapAccess);
         }
 
         /**
@@ -164,7 +235,7 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
         AlsaDspSource (  const AlsaDspSource &    ds )
                     : AudioSource( ds )
         {
-            init( ds.pcmName);
+            init( ds.pcmName, ds.mmapAccess);
         }
 
         /**
@@ -191,7 +262,7 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
             if ( this != &ds ) {
                 strip();
                 AudioSource::operator=( ds);
-                init( ds.pcmName);
+                init( ds.pcmName, ds.mmapAccess);
             }
             return *this;
         }
@@ -285,6 +356,18 @@ class AlsaDspSource : public AudioSource, public virtual Reporter
         setBufferTime( unsigned int time ) {
             bufferTime = time;
         }
+
+        /**
+         *  Get the number of samples the device delivers at once.
+         *
+         *  @return the number of samples for each channel in a period,
+         *          or 0 if not open.
+         */
+        inline virtual unsigned int
+        getPeriodSize ( void ) const     throw ()
+        {
+            return periodSize;
+        }
 };
 
 
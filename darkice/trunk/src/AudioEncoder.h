@@ -37,8 +37,13 @@
 /* ============================================================ include files */
 
 #include "Referable.h"
+#include "Ref.h"
 #include "Sink.h"
 #include "AudioSource.h"
+#include "AudioFrame.h"
+#include "Resampler.h"
+#include "ChannelMap.h"
+#include "ScratchBuffer.h"
 
 
 /* ================================================================ constants */
@@ -87,15 +92,32 @@ class AudioEncoder : public Sink, public virtual Referable
         unsigned int        inBitsPerSample;
 
         /**
-         *  Number of channels of the input.
+         *  Number of channels of the input, after mapping the channels
+         *  of the source.
          */
         unsigned int        inChannel;
 
+        /**
+         *  Number of channels of the source, before mapping them.
+         */
+        unsigned int        sourceChannel;
+
+        /**
+         *  The channels of the source to encode, or NULL to encode
+         *  all of them as they are.
+         */
+        Ref<ChannelMap>     channelMap;
+
         /**
          *  Is the input big endian or little endian?
          */
         bool                inBigEndian;
 
+        /**
+         *  Is the input 32 bit floats instead of integers?
+         */
+        bool                inFloat;
+
         /**
          *  The bitrate mode of the encoder
          */
@@ -121,6 +143,38 @@ class AudioEncoder : public Sink, public virtual Referable
          */
         unsigned int        outChannel;
 
+        /**
+         *  Frame used to convert raw audio written to the encoder.
+         */
+        AudioFrame        * inputFrame;
+
+        /**
+         *  Resampler used for frames that don't hold the audio at the
+         *  output sample rate already. Created when first needed.
+         */
+        Ref<Resampler>      resampler;
+
+        /**
+         *  Frame holding the output of the resampler.
+         */
+        AudioFrame        * resampledFrame;
+
+        /**
+         *  Frame holding the mapped channels of the source.
+         */
+        AudioFrame        * mappedFrame;
+
+        /**
+         *  Frame holding the mapped channels of the resampled source,
+         *  attached to mappedFrame, which owns it.
+         */
+        AudioFrame        * mappedResampled;
+
+        /**
+         *  Buffer to mix the mapped channels into.
+         */
+        ScratchBuffer<float>    mixBuffer;
+
         /**
          *  Initialize the object.
          *
@@ -129,10 +183,13 @@ class AudioEncoder : public Sink, public virtual Referable
          *  @param inBitsPerSample number of bits per sample of the input.
          *  @param inChannel number of channels  of the input.
          *  @param inBigEndian shows if the input is big or little endian.
+         *  @param inFloat shows if the input is 32 bit floats.
          *  @param outBitrateMode the bit rate mode of the output.
          *  @param outBitrate bit rate of the output.
          *  @param outSampleRate sample rate of the output.
          *  @param outChannel number of channels of the output.
+         *  @param channelMap the channels of the input to encode,
+         *                    or NULL for all of them.
          *  @exception Exception
          */
         inline void
@@ -141,22 +198,39 @@ class AudioEncoder : public Sink, public virtual Referable
                     unsigned int    inBitsPerSample,
                     unsigned int    inChannel,
                     bool            inBigEndian,
+                    bool            inFloat,
                     BitrateMode     outBitrateMode,
                     unsigned int    outBitrate,
                     double          outQuality,
                     unsigned int    outSampleRate,
-                    unsigned int    outChannel )
+                    unsigned int    outChannel,
+                    ChannelMap    * channelMap )
         {
+            if ( channelMap && channelMap->getInChannels() != inChannel ) {
+                throw Exception( __FILE__, __LINE__,
+                                 "channel map for another number of channels",
+                                 channelMap->getInChannels());
+            }
+
             this->sink             = sink;
             this->inSampleRate     = inSampleRate;
             this->inBitsPerSample  = inBitsPerSample;
-            this->inChannel        = inChannel;
+            this->sourceChannel    = inChannel;
+            this->inChannel        = channelMap ? channelMap->getOutChannels()
+                                                : inChannel;
+            this->channelMap       = channelMap;
             this->inBigEndian      = inBigEndian;
+            this->inFloat          = inFloat;
             this->outBitrateMode   = outBitrateMode;
             this->outBitrate       = outBitrate;
             this->outQuality       = outQuality;
             this->outSampleRate    = outSampleRate;
             this->outChannel       = outChannel;
+            this->inputFrame       = 0;
+            this->resampler        = 0;
+            this->resampledFrame   = 0;
+            this->mappedFrame      = 0;
+            this->mappedResampled  = 0;
 
             if ( outQuality < -0.1 || 1.0 < outQuality ) {
                 throw Exception( __FILE__, __LINE__, "invalid encoder quality");
@@ -171,6 +245,16 @@ class AudioEncoder : public Sink, public virtual Referable
         inline void
         strip ( void )
         {
+            // deletes mappedResampled as well
+            delete mappedFrame;
+            mappedFrame     = 0;
+            mappedResampled = 0;
+            channelMap      = 0;
+            delete resampledFrame;
+            resampledFrame = 0;
+            resampler      = 0;
+            delete inputFrame;
+            inputFrame     = 0;
         }
 
 
@@ -188,7 +272,7 @@ class AudioEncoder : public Sink, public virtual Referable
         }
 
         /**
-         *  Constructor.
+         *  Constructor, for integer input samples.
          *
          *  @param sink the sink to send encoded output to
          *  @param inSampleRate sample rate of the input.
@@ -221,11 +305,13 @@ class AudioEncoder : public Sink, public virtual Referable
                    inBitsPerSample,
                    inChannel,
                    inBigEndian,
+                   false,
                    outBitrateMode,
                    outBitrate,
                    outQuality,
                    outSampleRate ? outSampleRate : inSampleRate,
-                   outChannel    ? outChannel    : inChannel );
+                   outChannel    ? outChannel    : inChannel,
+                   0 );
         }
 
         /**
@@ -241,6 +327,8 @@ class AudioEncoder : public Sink, public virtual Referable
          *                       If 0, input sample rate is used.
          *  @param outChannel number of channels of the output.
          *                    If 0, input channel is used.
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them as they are.
          *  @exception Exception
          */
         inline
@@ -250,18 +338,24 @@ class AudioEncoder : public Sink, public virtual Referable
                         unsigned int            outBitrate,
                         double                  outQuality,
                         unsigned int            outSampleRate = 0,
-                        unsigned int            outChannel    = 0 )
+                        unsigned int            outChannel    = 0,
+                        ChannelMap            * channelMap    = 0 )
         {
+            unsigned int    channel = channelMap ? channelMap->getOutChannels()
+                                                 : as->getChannel();
+
             init( sink,
                   as->getSampleRate(),
                   as->getBitsPerSample(),
                   as->getChannel(),
                   as->isBigEndian(),
+                  as->isFloat(),
                   outBitrateMode,
                   outBitrate,
                   outQuality,
                   outSampleRate ? outSampleRate : as->getSampleRate(),
-                  outChannel    ? outChannel    : as->getChannel() );
+                  outChannel    ? outChannel    : channel,
+                  channelMap );
         }
 
         /**
@@ -275,13 +369,15 @@ class AudioEncoder : public Sink, public virtual Referable
             init ( encoder.sink.get(),
                    encoder.inSampleRate,
                    encoder.inBitsPerSample,
-                   encoder.inChannel,
+                   encoder.sourceChannel,
                    encoder.inBigEndian,
+                   encoder.inFloat,
                    encoder.outBitrateMode,
                    encoder.outBitrate,
                    encoder.outQuality,
                    encoder.outSampleRate,
-                   encoder.outChannel );
+                   encoder.outChannel,
+                   encoder.channelMap.get() );
         }
 
         /**
@@ -300,18 +396,168 @@ class AudioEncoder : public Sink, public virtual Referable
                 init ( encoder.sink.get(),
                        encoder.inSampleRate,
                        encoder.inBitsPerSample,
-                       encoder.inChannel,
+                       encoder.sourceChannel,
                        encoder.inBigEndian,
+                       encoder.inFloat,
                        encoder.outBitrateMode,
                        encoder.outBitrate,
                        encoder.outQuality,
                        encoder.outSampleRate,
-                       encoder.outChannel );
+                       encoder.outChannel,
+                       encoder.channelMap.get() );
             }
 
             return *this;
         }
 
+        /**
+         *  Convert raw audio, as read from the AudioSource, into a frame.
+         *  Encoders use this to implement write() based on writeFrame().
+         *
+         *  @param buf the raw audio.
+         *  @param len the number of bytes in buf.
+         *  @return a frame holding the converted audio, owned by the
+         *          encoder and valid until the next call.
+         *  @exception Exception
+         */
+        inline const AudioFrame *
+        toFrame (   const void    * buf,
+                    unsigned int    len )
+        {
+            if ( !inputFrame ) {
+                inputFrame = new AudioFrame( inSampleRate,
+                                             sourceChannel,
+                                             inBitsPerSample,
+                                             inFloat,
+                                             inBigEndian,
+                                             len );
+            }
+            inputFrame->setData( buf, len);
+            return mapChannels( inputFrame);
+        }
+
+        /**
+         *  Map the channels of a frame of the source, if the encoder
+         *  has a channel map. The resampled audio attached to the frame
+         *  for the output sample rate is mapped as well.
+         *
+         *  @param frame the audio as read from the source.
+         *  @return a frame with the channels to encode. valid until
+         *          the next call.
+         *  @exception Exception
+         */
+        inline const AudioFrame *
+        mapChannels (   const AudioFrame  * frame )
+        {
+            const AudioFrame  * resampled;
+
+            if ( !channelMap.get() ) {
+                return frame;
+            }
+
+            if ( !mappedFrame ) {
+                mappedFrame = newMappedFrame( frame);
+            }
+            mapFrame( frame, mappedFrame);
+
+            resampled = frame->getResampled( outSampleRate);
+            if ( resampled && resampled != frame ) {
+                if ( !mappedResampled ) {
+                    mappedResampled = newMappedFrame( resampled);
+                    mappedFrame->attach( mappedResampled);
+                }
+                mapFrame( resampled, mappedResampled);
+            }
+
+            return mappedFrame;
+        }
+
+        /**
+         *  Create a frame for the mapped channels of a frame. It keeps
+         *  the bits per sample of the frame, but at least 16.
+         *
+         *  @param frame the frame to map.
+         *  @return a new frame, with the mapped number of channels.
+         *  @exception Exception
+         */
+        inline AudioFrame *
+        newMappedFrame (    const AudioFrame  * frame )
+        {
+            unsigned int    bits = frame->getBitsPerSample() > 16
+                                 ? frame->getBitsPerSample() : 16;
+
+            return new AudioFrame( frame->getSampleRate(),
+                                   inChannel,
+                                   bits,
+                                   frame->isFloat(),
+#ifdef WORDS_BIGENDIAN
+                                   true,
+#else
+                                   false,
+#endif
+                                   frame->getSamples() * inChannel
+                                 * (bits / 8) );
+        }
+
+        /**
+         *  Fill a frame with the mapped channels of another one.
+         *
+         *  @param frame the frame to map.
+         *  @param mapped the frame to fill.
+         *  @exception Exception
+         */
+        inline void
+        mapFrame (  const AudioFrame  * frame,
+                    AudioFrame        * mapped )
+        {
+            float     * buf = mixBuffer.reserve( frame->getSamples()
+                                               * inChannel);
+
+            channelMap->apply( frame, buf);
+            mapped->setFloat( buf, frame->getSamples());
+        }
+
+        /**
+         *  Get a frame of input audio at the output sample rate.
+         *  If the frame has the audio at the output sample rate attached
+         *  already, that is used, otherwise the audio is resampled by
+         *  the encoder itself.
+         *
+         *  @param frame the audio to resample, in the input format
+         *               of the encoder.
+         *  @return a frame at the output sample rate, with the input
+         *          number of channels. valid until the next call.
+         *  @exception Exception
+         */
+        inline const AudioFrame *
+        resample (  const AudioFrame  * frame )
+        {
+            const AudioFrame  * resampled;
+
+            resampled = frame->getResampled( outSampleRate);
+            if ( resampled ) {
+                return resampled;
+            }
+
+            if ( !resampler.get() ) {
+                resampler      = new Resampler( inSampleRate,
+                                                outSampleRate,
+                                                inChannel );
+                resampledFrame = new AudioFrame( outSampleRate,
+                                                 inChannel,
+                                                 16,
+                                                 false,
+#ifdef WORDS_BIGENDIAN
+                                                 true,
+#else
+                                                 false,
+#endif
+                                                 frame->getSize() );
+            }
+            resampler->resample( frame, resampledFrame);
+            return resampledFrame;
+        }
+
 
     public:
 
@@ -337,6 +583,30 @@ class AudioEncoder : public Sink, public virtual Referable
             return sink;
         }
 
+        /**
+         *  Get the number of channels of the source, before mapping
+         *  its channels.
+         *
+         *  @return the number of channels of the source.
+         */
+        inline unsigned int
+        getSourceChannel ( void ) const     throw ()
+        {
+            return sourceChannel;
+        }
+
+        /**
+         *  Get the channel map of the encoder.
+         *
+         *  @return the channels of the source to encode, or NULL
+         *          if all of them are encoded as they are.
+         */
+        inline ChannelMap *
+        getChannelMap ( void ) const        throw ()
+        {
+            return channelMap.get();
+        }
+
         /**
          *  Get the number of channels of the input.
          *
@@ -359,6 +629,17 @@ class AudioEncoder : public Sink, public virtual Referable
             return inBigEndian;
         }
 
+        /**
+         *  Tell if the input is 32 bit floats.
+         *
+         *  @return true if the input is floats, false if integers.
+         */
+        inline bool
+        isInFloat ( void ) const             throw ()
+        {
+            return inFloat;
+        }
+
         /**
          *  Get the sample rate of the input.
          *
@@ -477,6 +758,77 @@ class AudioEncoder : public Sink, public virtual Referable
             sink->cut();
         }
 
+        /**
+         *  Cut at a known time.
+         *  This is delegated to the underlying sink.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        inline virtual void
+        cutAt ( double          boundary )              throw ()
+        {
+            sink->cutAt( boundary);
+        }
+
+        /**
+         *  Get ready for a cut coming at a known time.
+         *  This is delegated to the underlying sink.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        inline virtual void
+        prepareCut ( double     boundary )              throw ()
+        {
+            sink->prepareCut( boundary);
+        }
+
+        /**
+         *  Write a frame of audio to the encoder. The frame already holds
+         *  the audio converted to 16 bit and float samples, so encoders
+         *  sharing the same frame don't have to convert it each.
+         *  The default implementation writes the raw audio of the frame.
+         *
+         *  @param frame the audio to encode. the frame must be in the
+         *               input format of the encoder.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writeFrame ( const AudioFrame     * frame )
+        {
+            return write( frame->getData(), frame->getSize());
+        }
+
+        /**
+         *  Write a frame of audio as read from the source, with all of
+         *  its channels. The channels to encode are mapped, and written
+         *  to writeFrame().
+         *
+         *  @param frame the audio to encode, in the format of the source.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        inline unsigned int
+        encodeFrame ( const AudioFrame    * frame )
+        {
+            return writeFrame( mapChannels( frame));
+        }
+
+        /**
+         *  Tell if the encoder resamples its input through a Resampler.
+         *  Encoders that do can share the resampled audio attached to the
+         *  frames written to them, instead of each resampling on its own.
+         *
+         *  @return true if the encoder resamples through a Resampler,
+         *          false otherwise.
+         */
+        inline virtual bool
+        usesResampler ( void ) const                    throw ()
+        {
+            return false;
+        }
+
 };
 
 
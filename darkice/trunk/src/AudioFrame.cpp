@@ -0,0 +1,374 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : AudioFrame.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+
+#include "Exception.h"
+#include "Util.h"
+#include "SampleConv.h"
+#include "AudioFrame.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: init (    unsigned int        sampleRate,
+                        unsigned int        channel,
+                        unsigned int        bitsPerSample,
+                        bool                floatSamples,
+                        bool                bigEndian,
+                        unsigned int        capacity )
+{
+    if ( channel == 0 ) {
+        throw Exception( __FILE__, __LINE__, "no channels in audio frame");
+    }
+    if ( floatSamples && bitsPerSample != 32 ) {
+        throw Exception( __FILE__, __LINE__,
+                         "float samples need 32 bits per sample",
+                         bitsPerSample);
+    }
+    if ( !floatSamples
+      && bitsPerSample != 8 && bitsPerSample != 16
+      && bitsPerSample != 24 && bitsPerSample != 32 ) {
+        throw Exception( __FILE__, __LINE__,
+                         "this number of bits per sample not supported",
+                         bitsPerSample);
+    }
+
+    referenceCount.store( 0);
+
+    this->sampleRate    = sampleRate;
+    this->channel       = channel;
+    this->bitsPerSample = bitsPerSample;
+    this->floatSamples  = floatSamples;
+    this->bigEndian     = bigEndian;
+    this->size          = 0;
+    this->samples       = 0;
+    this->attached      = 0;
+    this->numAttached   = 0;
+    this->time          = 0.0;
+
+    shortChannels = new int16_t*[channel];
+    floatChannels = new float*[channel];
+
+    allocate( capacity);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: strip ( void )
+{
+    for ( unsigned int i = 0; i < numAttached; ++i ) {
+        delete attached[i];
+    }
+    delete[] attached;
+
+    release();
+
+    delete[] floatChannels;
+    delete[] shortChannels;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Allocate the buffers of the frame
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: allocate ( unsigned int   capacity )
+{
+    unsigned int    maxSamples = capacity / (bitsPerSample / 8);
+
+    this->capacity = capacity;
+    this->size     = 0;
+    this->samples  = 0;
+
+    data          = new unsigned char[capacity];
+    shortBuffer   = new int16_t[maxSamples];
+    shortPlanar   = new int16_t[maxSamples];
+    floatBuffer   = new float[maxSamples];
+    floatPlanar   = new float[maxSamples];
+
+    setChannels();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Free the buffers of the frame
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: release ( void )
+{
+    delete[] floatPlanar;
+    delete[] floatBuffer;
+    delete[] shortPlanar;
+    delete[] shortBuffer;
+    delete[] data;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Make sure the frame can hold a number of samples
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: reserve ( unsigned int    samples )
+{
+    unsigned int    len = samples * (bitsPerSample / 8) * channel;
+
+    if ( len > capacity ) {
+        release();
+        allocate( len);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Set the channel pointers into the planar buffers
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: setChannels ( void )
+{
+    // the channels follow each other without gaps, as some resamplers
+    // expect them that way
+    for ( unsigned int c = 0; c < channel; ++c ) {
+        shortChannels[c] = shortPlanar + c * samples;
+        floatChannels[c] = floatPlanar + c * samples;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fill the converted views of the frame
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: convert ( unsigned int    len )
+{
+    unsigned int    sampleSize = (bitsPerSample / 8) * channel;
+
+    if ( len > capacity ) {
+        throw Exception( __FILE__, __LINE__,
+                         "audio frame overflow", len);
+    }
+
+    size    = len - (len % sampleSize);
+    samples = size / sampleSize;
+
+    setChannels();
+
+    if ( floatSamples ) {
+        // keep the float samples as they are, only clip the 16 bit ones
+        memcpy( floatBuffer, data, size);
+        SampleConv::floatToShort( floatBuffer, samples * channel, shortBuffer);
+    } else if ( bitsPerSample == 24 ) {
+        // high resolution samples keep their resolution in the float view
+        SampleConv::int24ToFloat( data, samples * channel, floatBuffer,
+                                  bigEndian);
+        SampleConv::floatToShort( floatBuffer, samples * channel, shortBuffer);
+    } else if ( bitsPerSample == 32 ) {
+#ifdef WORDS_BIGENDIAN
+        if ( !bigEndian ) {
+#else
+        if ( bigEndian ) {
+#endif
+            // the raw audio is not looked at again, swap it in place
+            for ( unsigned int i = 0; i < size; i += 4 ) {
+                unsigned char   b;
+
+                b = data[i];     data[i]     = data[i + 3]; data[i + 3] = b;
+                b = data[i + 1]; data[i + 1] = data[i + 2]; data[i + 2] = b;
+            }
+        }
+        SampleConv::intToFloat( (const int32_t *) data, samples * channel,
+                                floatBuffer);
+        SampleConv::floatToShort( floatBuffer, samples * channel, shortBuffer);
+    } else {
+        Util::conv( bitsPerSample, data, size, shortBuffer, bigEndian);
+        SampleConv::shortToFloat( shortBuffer, samples * channel, floatBuffer);
+    }
+
+    SampleConv::deinterleaveShort( shortBuffer, samples, shortChannels, channel);
+    SampleConv::deinterleaveFloat( floatBuffer, samples, floatChannels, channel);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Copy raw audio into the frame, and fill the converted views
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: setData ( const void        * buf,
+                        unsigned int        len )
+{
+    if ( len > capacity ) {
+        release();
+        allocate( len);
+    }
+
+    memcpy( data, buf, len);
+    convert( len);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fill the frame from interleaved float samples
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: setFloat (    const float       * buf,
+                            unsigned int        samples )
+{
+    unsigned int    count = samples * channel;
+
+    if ( bitsPerSample == 8 ) {
+        throw Exception( __FILE__, __LINE__,
+                         "8 bit frames can't be set from float samples");
+    }
+    reserve( samples);
+
+    this->samples = samples;
+    this->size    = count * (bitsPerSample / 8);
+    setChannels();
+
+    memcpy( floatBuffer, buf, count * sizeof(float));
+    SampleConv::floatToShort( floatBuffer, count, shortBuffer);
+    SampleConv::deinterleaveShort( shortBuffer, samples, shortChannels, channel);
+    SampleConv::deinterleaveFloat( floatBuffer, samples, floatChannels, channel);
+
+    // the raw audio keeps the resolution of the frame
+    if ( floatSamples ) {
+        memcpy( data, floatBuffer, size);
+    } else if ( bitsPerSample == 24 ) {
+        SampleConv::floatToInt24( floatBuffer, count, data, bigEndian);
+    } else if ( bitsPerSample == 32 ) {
+        SampleConv::floatToInt( floatBuffer, count, (int32_t *) data);
+    } else {
+        memcpy( data, shortBuffer, size);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fill the frame from planar 16 bit samples
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: setPlanarShort (  const int16_t     * buf,
+                                unsigned int        stride,
+                                unsigned int        samples )
+{
+    if ( floatSamples || bitsPerSample != 16 ) {
+        throw Exception( __FILE__, __LINE__,
+                         "only 16 bit frames can be set from 16 bit samples",
+                         bitsPerSample);
+    }
+    reserve( samples);
+
+    this->samples = samples;
+    this->size    = samples * channel * 2;
+    setChannels();
+
+    for ( unsigned int i = 0, j = 0; i < samples; ++i ) {
+        for ( unsigned int c = 0; c < channel; ++c, ++j ) {
+            int16_t     s = buf[c * stride + i];
+
+            shortBuffer[j]      = s;
+            shortChannels[c][i] = s;
+            floatBuffer[j]      = ((float) s) / 32768.f;
+            floatChannels[c][i] = floatBuffer[j];
+        }
+    }
+
+    memcpy( data, shortBuffer, size);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Attach a frame holding the same audio at another sample rate
+ *----------------------------------------------------------------------------*/
+void
+AudioFrame :: attach ( AudioFrame     * frame )
+{
+    AudioFrame   ** a = new AudioFrame*[numAttached + 1];
+
+    for ( unsigned int i = 0; i < numAttached; ++i ) {
+        a[i] = attached[i];
+    }
+    a[numAttached++] = frame;
+
+    delete[] attached;
+    attached = a;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the audio of this frame at a specific sample rate
+ *----------------------------------------------------------------------------*/
+const AudioFrame *
+AudioFrame :: getResampled ( unsigned int   sampleRate ) const  throw ()
+{
+    if ( sampleRate == this->sampleRate ) {
+        return this;
+    }
+
+    for ( unsigned int i = 0; i < numAttached; ++i ) {
+        if ( attached[i]->getSampleRate() == sampleRate ) {
+            return attached[i];
+        }
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,637 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : AudioFrame.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef AUDIO_FRAME_H
+#define AUDIO_FRAME_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#else
+#error need inttypes.h
+#endif
+
+#include <atomic>
+
+#include "Exception.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A chunk of PCM audio, as read from an AudioSource, together with
+ *  the converted views the encoders work on: interleaved and planar
+ *  16 bit samples, and interleaved and planar float samples. If the
+ *  raw audio is float already, the float views hold it unchanged.
+ *  The raw audio may be 8, 16, packed 24 or 32 bit integers, with any
+ *  number of channels. 24 and 32 bit samples keep their resolution in
+ *  the float views.
+ *
+ *  The conversion is done once, by whoever fills the frame, and the
+ *  frame is not changed after that. Thus a single frame can be shared
+ *  by any number of encoders, even ones running in different threads.
+ *  The reference count of the frame is atomic for this reason.
+ *
+ *  A frame may own other frames attached to it, holding the same audio
+ *  resampled to other sample rates, so that encoders needing the same
+ *  output sample rate can share a single resampling of the audio.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class AudioFrame
+{
+    private:
+
+        /**
+         *  Number of references to the frame.
+         */
+        std::atomic<unsigned int>   referenceCount;
+
+        /**
+         *  Sample rate of the audio.
+         */
+        unsigned int        sampleRate;
+
+        /**
+         *  Number of channels of the audio.
+         */
+        unsigned int        channel;
+
+        /**
+         *  Number of bits per sample of the raw audio.
+         */
+        unsigned int        bitsPerSample;
+
+        /**
+         *  Is the raw audio 32 bit floats instead of integers?
+         */
+        bool                floatSamples;
+
+        /**
+         *  Is the raw audio big endian or little endian?
+         */
+        bool                bigEndian;
+
+        /**
+         *  The number of bytes the frame can hold.
+         */
+        unsigned int        capacity;
+
+        /**
+         *  The raw audio, as read from the source.
+         */
+        unsigned char     * data;
+
+        /**
+         *  The number of bytes of raw audio in the frame.
+         */
+        unsigned int        size;
+
+        /**
+         *  The number of samples in the frame, for each channel.
+         */
+        unsigned int        samples;
+
+        /**
+         *  The audio as 16 bit samples, channels interleaved.
+         */
+        int16_t           * shortBuffer;
+
+        /**
+         *  The audio as 16 bit samples, one channel after the other,
+         *  each getSamples() long.
+         */
+        int16_t           * shortPlanar;
+
+        /**
+         *  Pointers to each channel inside shortPlanar.
+         */
+        int16_t          ** shortChannels;
+
+        /**
+         *  The audio as float samples, channels interleaved.
+         */
+        float             * floatBuffer;
+
+        /**
+         *  The audio as float samples, one channel after the other,
+         *  each getSamples() long.
+         */
+        float             * floatPlanar;
+
+        /**
+         *  Pointers to each channel inside floatPlanar.
+         */
+        float            ** floatChannels;
+
+        /**
+         *  The frames attached to this one, holding the same audio
+         *  at other sample rates.
+         */
+        AudioFrame       ** attached;
+
+        /**
+         *  The number of frames attached.
+         */
+        unsigned int        numAttached;
+
+        /**
+         *  The wall clock time of the first sample, in seconds since
+         *  the epoch, or 0 if not known.
+         */
+        double              time;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param sampleRate sample rate of the audio.
+         *  @param channel number of channels of the audio.
+         *  @param bitsPerSample number of bits per sample of the raw audio.
+         *  @param floatSamples true if the raw audio is 32 bit floats,
+         *                      in the byte order of the host.
+         *  @param bigEndian true if the raw audio is big endian.
+         *  @param capacity the number of bytes of raw audio the frame
+         *                  can hold.
+         *  @exception Exception
+         */
+        void
+        init (  unsigned int        sampleRate,
+                unsigned int        channel,
+                unsigned int        bitsPerSample,
+                bool                floatSamples,
+                bool                bigEndian,
+                unsigned int        capacity )          ;
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void )                                  ;
+
+        /**
+         *  Allocate the buffers of the frame, for a given capacity.
+         *  The previous contents of the frame are lost.
+         *
+         *  @param capacity the number of bytes of raw audio the frame
+         *                  can hold.
+         */
+        void
+        allocate ( unsigned int     capacity )          ;
+
+        /**
+         *  Free the buffers of the frame.
+         */
+        void
+        release ( void )                                ;
+
+        /**
+         *  Make sure the frame can hold a number of samples,
+         *  enlarging it if needed.
+         *
+         *  @param samples the number of samples per channel.
+         */
+        void
+        reserve ( unsigned int      samples )           ;
+
+        /**
+         *  Set the channel pointers into the planar buffers,
+         *  according to the number of samples in the frame.
+         */
+        void
+        setChannels ( void )                            ;
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        AudioFrame ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception, as frames
+         *  are shared by reference, not copied.
+         *
+         *  @param frame the object to copy.
+         *  @exception Exception
+         */
+        inline
+        AudioFrame ( const AudioFrame     & frame )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param sampleRate sample rate of the audio.
+         *  @param channel number of channels of the audio.
+         *  @param bitsPerSample number of bits per sample of the raw audio.
+         *  @param floatSamples true if the raw audio is 32 bit floats,
+         *                      in the byte order of the host.
+         *  @param bigEndian true if the raw audio is big endian.
+         *  @param capacity the number of bytes of raw audio the frame
+         *                  can hold.
+         *  @exception Exception
+         */
+        inline
+        AudioFrame (    unsigned int        sampleRate,
+                        unsigned int        channel,
+                        unsigned int        bitsPerSample,
+                        bool                floatSamples,
+                        bool                bigEndian,
+                        unsigned int        capacity )
+        {
+            init( sampleRate,
+                  channel,
+                  bitsPerSample,
+                  floatSamples,
+                  bigEndian,
+                  capacity);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline
+        ~AudioFrame ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Increase the reference count.
+         *
+         *  @return the new reference count.
+         */
+        inline unsigned int
+        increaseReferenceCount ( void )                 throw ()
+        {
+            return ++referenceCount;
+        }
+
+        /**
+         *  Decrease the reference count.
+         *
+         *  @return the new reference count.
+         */
+        inline unsigned int
+        decreaseReferenceCount ( void )                 throw ()
+        {
+            return --referenceCount;
+        }
+
+        /**
+         *  Get the reference count.
+         *
+         *  @return the reference count.
+         */
+        inline unsigned int
+        getReferenceCount ( void ) const                throw ()
+        {
+            return referenceCount.load();
+        }
+
+        /**
+         *  Get the buffer to read raw audio into, before calling convert().
+         *
+         *  @return the raw audio buffer, of getCapacity() bytes.
+         */
+        inline unsigned char *
+        getBuffer ( void )                              throw ()
+        {
+            return data;
+        }
+
+        /**
+         *  Get the number of bytes the frame can hold.
+         *
+         *  @return the capacity of the frame, in bytes.
+         */
+        inline unsigned int
+        getCapacity ( void ) const                      throw ()
+        {
+            return capacity;
+        }
+
+        /**
+         *  Fill the converted views of the frame, based on the raw audio
+         *  put into getBuffer().
+         *
+         *  @param len the number of bytes of raw audio in the frame.
+         *             incomplete samples at the end are ignored.
+         *  @exception Exception
+         */
+        void
+        convert ( unsigned int      len )               ;
+
+        /**
+         *  Copy raw audio into the frame, and fill the converted views.
+         *  The frame is enlarged if needed.
+         *
+         *  @param buf the raw audio.
+         *  @param len the number of bytes in buf.
+         *  @exception Exception
+         */
+        void
+        setData (   const void        * buf,
+                    unsigned int        len )           ;
+
+        /**
+         *  Fill the frame from interleaved float samples. The raw audio
+         *  of the frame is set to samples of the number of bits of the
+         *  frame, which is not to be 8, in the byte order of the host,
+         *  or for 24 bits, that of the frame. The frame is enlarged
+         *  if needed.
+         *
+         *  @param buf the samples, channels interleaved.
+         *  @param samples the number of samples per channel in buf.
+         *  @exception Exception
+         */
+        void
+        setFloat (  const float       * buf,
+                    unsigned int        samples )       ;
+
+        /**
+         *  Fill the frame from planar 16 bit samples. The raw audio
+         *  of the frame is set to 16 bit samples in the byte order of the
+         *  host. The frame is enlarged if needed.
+         *
+         *  @param buf the samples, one channel after the other.
+         *  @param stride the distance of the channels in buf, in samples.
+         *  @param samples the number of samples per channel in buf.
+         *  @exception Exception
+         */
+        void
+        setPlanarShort (    const int16_t     * buf,
+                            unsigned int        stride,
+                            unsigned int        samples )   ;
+
+        /**
+         *  Attach a frame to this one, which holds the same audio at
+         *  another sample rate. The attached frame is owned by this one
+         *  from now on.
+         *
+         *  @param frame the frame to attach.
+         */
+        void
+        attach ( AudioFrame       * frame )             ;
+
+        /**
+         *  Get the number of frames attached to this one.
+         *
+         *  @return the number of frames attached.
+         */
+        inline unsigned int
+        getNumAttached ( void ) const                   throw ()
+        {
+            return numAttached;
+        }
+
+        /**
+         *  Get a frame attached to this one.
+         *
+         *  @param ix the index of the frame, in the order they were attached.
+         *  @return the attached frame.
+         */
+        inline AudioFrame *
+        getAttached ( unsigned int  ix )                throw ()
+        {
+            return attached[ix];
+        }
+
+        /**
+         *  Get the audio of this frame at a specific sample rate.
+         *
+         *  @param sampleRate the sample rate needed.
+         *  @return this frame, if it is at the sample rate needed,
+         *          an attached frame at the sample rate needed,
+         *          or 0 if there is no such frame.
+         */
+        const AudioFrame *
+        getResampled ( unsigned int     sampleRate ) const  throw ();
+
+        /**
+         *  Get the sample rate of the audio.
+         *
+         *  @return the sample rate.
+         */
+        inline unsigned int
+        getSampleRate ( void ) const                    throw ()
+        {
+            return sampleRate;
+        }
+
+        /**
+         *  Get the number of channels of the audio.
+         *
+         *  @return the number of channels.
+         */
+        inline unsigned int
+        getChannel ( void ) const                       throw ()
+        {
+            return channel;
+        }
+
+        /**
+         *  Get the number of bits per sample of the raw audio.
+         *
+         *  @return the number of bits per sample.
+         */
+        inline unsigned int
+        getBitsPerSample ( void ) const                 throw ()
+        {
+            return bitsPerSample;
+        }
+
+        /**
+         *  Tell if the raw audio is 32 bit floats.
+         *
+         *  @return true if the raw audio is floats, false if integers.
+         */
+        inline bool
+        isFloat ( void ) const                          throw ()
+        {
+            return floatSamples;
+        }
+
+        /**
+         *  Tell if the raw audio is big endian.
+         *
+         *  @return true if the raw audio is big endian, false otherwise.
+         */
+        inline bool
+        isBigEndian ( void ) const                      throw ()
+        {
+            return bigEndian;
+        }
+
+        /**
+         *  Get the raw audio.
+         *
+         *  @return the raw audio, as read from the source.
+         */
+        inline const unsigned char *
+        getData ( void ) const                          throw ()
+        {
+            return data;
+        }
+
+        /**
+         *  Get the size of the raw audio, in bytes.
+         *
+         *  @return the number of bytes of raw audio, whole samples only.
+         */
+        inline unsigned int
+        getSize ( void ) const                          throw ()
+        {
+            return size;
+        }
+
+        /**
+         *  Get the number of samples in the frame, for each channel.
+         *
+         *  @return the number of samples per channel.
+         */
+        inline unsigned int
+        getSamples ( void ) const                       throw ()
+        {
+            return samples;
+        }
+
+        /**
+         *  Set the wall clock time of the first sample of the frame.
+         *
+         *  @param time the time, in seconds since the epoch.
+         */
+        inline void
+        setTime (   double          time )              throw ()
+        {
+            this->time = time;
+        }
+
+        /**
+         *  Get the wall clock time of the first sample of the frame,
+         *  as kept by the audio itself, thus the time of the next frame
+         *  is that of this one plus the duration of this one.
+         *
+         *  @return the time in seconds since the epoch, or 0 if not
+         *          known.
+         */
+        inline double
+        getTime ( void ) const                          throw ()
+        {
+            return time;
+        }
+
+        /**
+         *  Get the audio as 16 bit samples, with channels interleaved.
+         *
+         *  @return getSamples() * getChannel() 16 bit samples.
+         */
+        inline const int16_t *
+        getShort ( void ) const                         throw ()
+        {
+            return shortBuffer;
+        }
+
+        /**
+         *  Get a single channel of the audio as 16 bit samples.
+         *
+         *  @param ch the channel to get.
+         *  @return getSamples() 16 bit samples.
+         */
+        inline const int16_t *
+        getShort ( unsigned int     ch ) const          throw ()
+        {
+            return shortChannels[ch];
+        }
+
+        /**
+         *  Get the audio as float samples in the range [-1.0, 1.0),
+         *  with channels interleaved.
+         *
+         *  @return getSamples() * getChannel() float samples.
+         */
+        inline const float *
+        getFloat ( void ) const                         throw ()
+        {
+            return floatBuffer;
+        }
+
+        /**
+         *  Get a single channel of the audio as float samples
+         *  in the range [-1.0, 1.0).
+         *
+         *  @param ch the channel to get.
+         *  @return getSamples() float samples.
+         */
+        inline const float *
+        getFloat ( unsigned int     ch ) const          throw ()
+        {
+            return floatChannels[ch];
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* AUDIO_FRAME_H */
+
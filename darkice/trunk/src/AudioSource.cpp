@@ -64,9 +64,18 @@ AudioSource :: createDspSource( const char    * deviceName,
                                 const char    * paSourceName,
                                 int             sampleRate,
                                 int             bitsPerSample,
-                                int             channel)
+                                int             channel,
+                                bool            floatSamples,
+                                bool            alsaMmap )
 {
-    
+    if ( floatSamples
+      && !Util::strEq( deviceName, "jack", 4)
+      && !Util::strEq( deviceName, "pulseaudio", 10) ) {
+        throw Exception( __FILE__, __LINE__,
+                         "float samples only supported for JACK and "
+                         "PulseAudio input", deviceName);
+    }
+
     if ( Util::strEq( deviceName, "/dev/tty", 8) ) {
 #if defined( SUPPORT_SERIAL_ULAW )
         Reporter::reportEvent( 1, "Using Serial Ulaw input device:",
@@ -105,7 +114,8 @@ AudioSource :: createDspSource( const char    * deviceName,
                                   jackClientName,
                                   sampleRate,
                                   bitsPerSample,
-                                  channel);
+                                  channel,
+                                  floatSamples);
 #else
         throw Exception( __FILE__, __LINE__,
                              "trying to open JACK device without "
@@ -117,7 +127,8 @@ AudioSource :: createDspSource( const char    * deviceName,
         return new PulseAudioDspSource( paSourceName,
                                         sampleRate,
                                         bitsPerSample,
-                                        channel);
+                                        channel,
+                                        floatSamples);
 #else
         throw Exception( __FILE__, __LINE__,
                              "trying to open PulseAudio device without "
@@ -129,7 +140,8 @@ AudioSource :: createDspSource( const char    * deviceName,
         return new AlsaDspSource( deviceName,
                                   sampleRate,
                                   bitsPerSample,
-                                  channel);
+                                  channel,
+                                  alsaMmap);
 #else
         throw Exception( __FILE__, __LINE__,
                              "trying to open ALSA DSP device without "
@@ -119,22 +119,42 @@ class AudioSource : public Source, public virtual Reporter
          */
         unsigned int    bitsPerSample;
 
+        /**
+         *  Are the samples 32 bit floats instead of integers?
+         */
+        bool            floatSamples;
+
+        /**
+         *  The number of overruns / underruns of the device so far.
+         */
+        unsigned long   xruns;
+
         /**
          *  Initialize the object.
          *
          *  @param sampleRate samples per second.
          *  @param bitsPerSample bits per sample.
          *  @param channel number of channels of the audio source.
+         *  @param floatSamples true if the samples are 32 bit floats.
          *  @exception Exception
          */
         inline void
         init (   unsigned int   sampleRate,
                  unsigned int   bitsPerSample,
-                 unsigned int   channel )
+                 unsigned int   channel,
+                 bool           floatSamples )
         {
+            if ( floatSamples && bitsPerSample != 32 ) {
+                throw Exception( __FILE__, __LINE__,
+                                 "float samples need 32 bits per sample",
+                                 bitsPerSample);
+            }
+
             this->sampleRate     = sampleRate;
             this->bitsPerSample  = bitsPerSample;
             this->channel        = channel;
+            this->floatSamples   = floatSamples;
+            this->xruns          = 0;
         }
 
         /**
@@ -159,14 +179,17 @@ class AudioSource : public Source, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channel number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param floatSamples true if the samples are 32 bit floats,
+         *                      in the range [-1.0, 1.0).
          *  @exception Exception
          */
         inline
         AudioSource (   unsigned int    sampleRate    = 44100,
                         unsigned int    bitsPerSample = 16,
-                        unsigned int    channel       = 2 )
+                        unsigned int    channel       = 2,
+                        bool            floatSamples  = false )
         {
-            init ( sampleRate, bitsPerSample, channel);
+            init ( sampleRate, bitsPerSample, channel, floatSamples);
         }
 
         /**
@@ -179,7 +202,10 @@ class AudioSource : public Source, public virtual Reporter
         AudioSource (   const AudioSource &     as )
             : Source( as )
         {
-            init ( as.sampleRate, as.bitsPerSample, as.channel);
+            init ( as.sampleRate,
+                   as.bitsPerSample,
+                   as.channel,
+                   as.floatSamples);
         }
 
         /**
@@ -195,12 +221,25 @@ class AudioSource : public Source, public virtual Reporter
             if ( this != &as ) {
                 strip();
                 Source::operator=( as );
-                init ( as.sampleRate, as.bitsPerSample, as.channel);
+                init ( as.sampleRate,
+                       as.bitsPerSample,
+                       as.channel,
+                       as.floatSamples);
             }
 
             return *this;
         }
 
+        /**
+         *  Note that the device over- or underran, and audio was lost.
+         *  Called by the implementations when they notice it.
+         */
+        inline void
+        noteXrun ( void )                   throw ()
+        {
+            ++xruns;
+        }
+
 
     public:
 
@@ -263,6 +302,18 @@ class AudioSource : public Source, public virtual Reporter
             return bitsPerSample;
         }
 
+        /**
+         *  Tell if the samples from this source are 32 bit floats,
+         *  in the byte order of the host.
+         *
+         *  @return true if the samples are floats, false if integers.
+         */
+        inline bool
+        isFloat ( void ) const              throw ()
+        {
+            return floatSamples;
+        }
+
         /**
          *  Get the number of bytes for a sample for each channel
          *  (returns 4 bytes for 16 bits par sample in stereo)
@@ -275,6 +326,31 @@ class AudioSource : public Source, public virtual Reporter
             return bitsPerSample / 8 * channel;
         }
 
+        /**
+         *  Get the number of samples the device delivers at once, if it
+         *  does so in periods of a fixed size. Valid once opened.
+         *
+         *  @return the number of samples for each channel in a period,
+         *          or 0 if not known.
+         */
+        inline virtual unsigned int
+        getPeriodSize ( void ) const     throw ()
+        {
+            return 0;
+        }
+
+        /**
+         *  Get the number of times the device over- or underran so far,
+         *  losing audio. Sources that can not tell always return 0.
+         *
+         *  @return the number of overruns and underruns.
+         */
+        inline unsigned long
+        getXruns ( void ) const             throw ()
+        {
+            return xruns;
+        }
+
         /**
          *  Factory method for creating an AudioSource object of the
          *  appropriate type, based on the compiled DSP support and
@@ -287,6 +363,10 @@ class AudioSource : public Source, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channel number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param floatSamples true to read 32 bit float samples.
+         *                      only supported by JACK and PulseAudio.
+         *  @param alsaMmap true to capture through the memory mapped
+         *                  buffer of the device. only used by ALSA.
          *  @exception Exception
          */
         static AudioSource *
@@ -295,7 +375,9 @@ class AudioSource : public Source, public virtual Reporter
                          const char    * paSourceName,
                          int             sampleRate    = 44100,
                          int             bitsPerSample = 16,
-                         int             channel       = 2);
+                         int             channel       = 2,
+                         bool            floatSamples  = false,
+                         bool            alsaMmap      = false);
 
 };
 
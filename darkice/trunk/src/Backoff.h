@@ -0,0 +1,160 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Backoff.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error need stdlib.h
+#endif
+
+#include "TimeSummary.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  The delays between retries of something that failed, growing
+ *  exponentially up to a limit. Each delay is randomized by a
+ *  quarter up or down, so that outputs that failed at the same time,
+ *  say because the server restarted, don't all retry at once.
+ *
+ *  sample usage:
+ *
+ *  <pre>
+ *  #include "Backoff.h"
+ *
+ *  Backoff     backoff;
+ *
+ *  while ( !tryIt() ) {
+ *      wait( backoff.next());
+ *  }
+ *  backoff.reset();
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class Backoff
+{
+    private:
+
+        /**
+         *  The first delay, in seconds.
+         */
+        double          initial;
+
+        /**
+         *  The longest delay, in seconds.
+         */
+        double          maximum;
+
+        /**
+         *  The next delay, before randomization.
+         */
+        double          current;
+
+        /**
+         *  The state of the random number generator.
+         */
+        unsigned int    seed;
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param initial the first delay, in seconds.
+         *  @param maximum the longest delay, in seconds.
+         */
+        inline
+        Backoff (   double      initial = 1.0,
+                    double      maximum = 30.0 )        throw ()
+        {
+            this->initial = initial;
+            this->maximum = maximum;
+            this->current = initial;
+            this->seed    = (unsigned int) (TimeSummary::now() * 1000000.0)
+                          ^ (unsigned int) (size_t) this;
+        }
+
+        /**
+         *  Get the next delay, and double the one after.
+         *
+         *  @return the delay to wait before the next retry, in seconds.
+         */
+        inline double
+        next ( void )                                   throw ()
+        {
+            double  delay = current;
+
+            current = current * 2.0 < maximum ? current * 2.0 : maximum;
+
+            return delay * (0.75 + 0.5 * rand_r( &seed) / RAND_MAX);
+        }
+
+        /**
+         *  Start over with the first delay, after a success.
+         */
+        inline void
+        reset ( void )                                  throw ()
+        {
+            current = initial;
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* BACKOFF_H */
+
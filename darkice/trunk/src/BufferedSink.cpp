@@ -57,6 +57,7 @@
 
 
 #include "Exception.h"
+#include "TimeSummary.h"
 #include "BufferedSink.h"
 
 
@@ -70,6 +71,22 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The number of attempts to reopen the underlying sink before giving up
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxReopenAttempts = 10;
+
+/*------------------------------------------------------------------------------
+ *  The number of slices the ring holds at first, it grows when needed
+ *----------------------------------------------------------------------------*/
+static const unsigned int initialSlices = 64;
+
+/*------------------------------------------------------------------------------
+ *  The number of packets plain writes are kept in, beyond which packets
+ *  are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxPooledPackets = 256;
+
 
 /* ===============================================  local function prototypes */
 
@@ -82,25 +99,33 @@ static const char fileid[] = "$Id$";
 void
 BufferedSink :: init (  Sink          * sink,
                         unsigned int    size,
-                        unsigned int    chunkSize )
+                        unsigned int    chunkSize,
+                        double          maxLatency,
+                        double          burst )
 {
     if ( !sink ) {
         throw Exception( __FILE__, __LINE__, "no sink");
     }
 
     this->sink         = sink;                    // create a reference
+    this->header       = 0;
     this->chunkSize    = chunkSize ? chunkSize : 1;
     this->bufferSize   = size;
     // make bufferSize a multiple of chunkSize
     this->bufferSize  -= this->bufferSize % this->chunkSize;
     this->peak         = 0;
-    this->misalignment = 0;
-    this->buffer       = new unsigned char[bufferSize];
-    this->bufferEnd    = buffer + bufferSize;
-    this->inp          = buffer;
-    this->outp         = buffer;
+    this->fill         = 0;
+    this->maxLatency   = maxLatency > 0.0 ? maxLatency : 0.0;
+    this->burst        = burst > 0.0 ? burst : 0.0;
+    this->dropped      = 0;
+    this->reconnecting = false;
+    this->maxSlices    = initialSlices;
+    this->slices       = new Slice[maxSlices];
+    this->firstSlice   = 0;
+    this->numSlices    = 0;
+    this->pool         = new PacketPool( maxPooledPackets);
     this->bOpen        = true;
-    this->openAttempts = 0; 
+    this->reconnector  = new Reconnector( sink, maxReopenAttempts);
 }
 
 
@@ -109,13 +134,16 @@ BufferedSink :: init (  Sink          * sink,
  *----------------------------------------------------------------------------*/
 BufferedSink :: BufferedSink (  const BufferedSink &  buffer )
 {
-    init( buffer.sink.get(), buffer.bufferSize, buffer.chunkSize);
+    init( buffer.sink.get(),
+          buffer.bufferSize,
+          buffer.chunkSize,
+          buffer.maxLatency,
+          buffer.burst);
 
     this->peak         = buffer.peak;
-    this->misalignment = buffer.misalignment;
     this->bOpen        = buffer.bOpen;
-    this->openAttempts = buffer.openAttempts; 
-    memcpy( this->buffer, buffer.buffer, this->bufferSize);
+    this->header       = buffer.header;
+    copySlices( buffer);
 }
 
 
@@ -129,8 +157,10 @@ BufferedSink :: strip ( void )
         close();
     }
 
+    reconnector = 0;                            // stops reopening, if any
     sink = 0;                                   // delete the reference
-    delete buffer;
+    delete[] slices;                            // release the packets
+    delete pool;
 }
 
 
@@ -143,24 +173,239 @@ BufferedSink :: operator= (     const BufferedSink &  buffer )
     if ( this != &buffer ) {
         strip();
         Sink::operator=( buffer );
-        init( buffer.sink.get(), buffer.bufferSize, buffer.chunkSize);
+        init( buffer.sink.get(),
+              buffer.bufferSize,
+              buffer.chunkSize,
+              buffer.maxLatency,
+              buffer.burst);
         
         this->peak         = buffer.peak;
-        this->misalignment = buffer.misalignment;
         this->bOpen        = buffer.bOpen;
-        this->openAttempts = buffer.openAttempts;
-        memcpy( this->buffer, buffer.buffer, this->bufferSize);
+        this->header       = buffer.header;
+        copySlices( buffer);
     }
 
     return *this;
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Copy the slices of an other buffer, sharing the packets
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: copySlices (    const BufferedSink &  buffer )
+{
+    for ( unsigned int i = 0; i < buffer.numSlices; ++i ) {
+        const Slice   * slice = buffer.slices
+                              + (buffer.firstSlice + i) % buffer.maxSlices;
+
+        append( slice->packet.get(),
+                slice->offset,
+                slice->given,
+                slice->end,
+                slice->time);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Add a slice to the end of the ring
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: append (    Packet        * packet,
+                            unsigned int    offset,
+                            unsigned int    given,
+                            unsigned int    end,
+                            double          time )
+{
+    Slice     * slice;
+
+    grow();
+
+    slice         = slices + (firstSlice + numSlices) % maxSlices;
+    slice->packet = packet;
+    slice->offset = offset;
+    slice->given  = given;
+    slice->end    = end;
+    slice->time   = time;
+    ++numSlices;
+    fill += end - offset;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Add a slice to the start of the ring
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: prepend (   Packet        * packet,
+                            unsigned int    given,
+                            double          time )
+{
+    Slice     * slice;
+
+    grow();
+
+    firstSlice    = (firstSlice + maxSlices - 1) % maxSlices;
+    slice         = slices + firstSlice;
+    slice->packet = packet;
+    slice->offset = 0;
+    slice->given  = given;
+    slice->end    = packet->getSize();
+    slice->time   = time;
+    ++numSlices;
+    fill += slice->end;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Double the size of the ring, if full
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: grow ( void )
+{
+    Slice         * s;
+    unsigned int    i;
+
+    if ( numSlices < maxSlices ) {
+        return;
+    }
+
+    s = new Slice[maxSlices * 2];
+    for ( i = 0; i < numSlices; ++i ) {
+        s[i] = slices[(firstSlice + i) % maxSlices];
+    }
+    delete[] slices;
+    slices      = s;
+    firstSlice  = 0;
+    maxSlices  *= 2;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Drop the oldest slice that may be dropped
+ *----------------------------------------------------------------------------*/
+bool
+BufferedSink :: dropOldest ( void )                         throw ()
+{
+    unsigned int    ix = oldestDroppable();
+
+    if ( ix == maxSlices ) {
+        return false;
+    }
+
+    dropped += slices[ix].end - slices[ix].offset;
+    if ( ix != firstSlice ) {
+        // the first one is being sent, it takes the place of the dropped
+        fill       -= slices[ix].end - slices[ix].offset;
+        slices[ix]  = slices[firstSlice];
+        slices[firstSlice].packet = 0;
+        firstSlice  = ix;
+        --numSlices;
+    } else {
+        removeFirst();
+    }
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Drop the slices written before some time
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: expire (    double      oldest )            throw ()
+{
+    unsigned int    ix;
+
+    while ( (ix = oldestDroppable()) != maxSlices
+         && slices[ix].time < oldest ) {
+        dropOldest();
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the time the oldest data has been waiting
+ *----------------------------------------------------------------------------*/
+double
+BufferedSink :: getQueuedTime ( void ) const                throw ()
+{
+    if ( !numSlices ) {
+        return 0.0;
+    }
+
+    return TimeSummary::now() - slices[firstSlice].time;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Keep data that could not be written yet
+ *  Drop the oldest data if there is no space for the new
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: hold (  const unsigned char   * buf,
+                        unsigned int            len,
+                        Packet                * packet,
+                        unsigned int            offset,
+                        unsigned int            given,
+                        double                  time )
+{
+    Ref<Packet>     copy;
+
+    if ( offset >= len ) {
+        return;
+    }
+
+    if ( !packet ) {
+        // keep the write as a whole, even the part sent already, so that
+        // it can be sent again as a whole to a reopened sink
+        copy   = pool->get( buf, len);
+        packet = copy.get();
+    }
+
+    // make room by dropping whole writes, but don't drop more than
+    // there is, if the data is larger than the whole buffer
+    while ( fill + (len - offset) > bufferSize ) {
+        if ( !dropOldest() ) {
+            break;
+        }
+    }
+
+    append( packet, offset, given, len, time);
+    updatePeak();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Keep data that could not be written yet, report the first overrun
+ *----------------------------------------------------------------------------*/
+void
+BufferedSink :: store ( const unsigned char   * buf,
+                        unsigned int            len,
+                        Packet                * packet,
+                        unsigned int            offset,
+                        unsigned int            given,
+                        double                  time )
+{
+    unsigned int    remaining = bufferSize - fill;
+
+    // react only to the first overrun whenever there is a series of overruns
+    // when limited in time, the oldest data is simply dropped instead
+    if ( !maxLatency
+      && remaining + chunkSize <= len - offset && remaining > chunkSize ) {
+        reportEvent(3,"BufferedSink :: store, buffer overrun");
+        throw Exception( __FILE__, __LINE__,
+                         "buffer overrun");
+    }
+
+    hold( buf, len, packet, offset, given, time);
+}
+
+
 /*------------------------------------------------------------------------------
  *  Store bufferSize bytes into the buffer
- *  All data is consumed. The return value is less then bufferSize only
- *  if the BufferedSink's internal buffer is smaller than bufferSize,
- *  thus can't hold that much
+ *  All data is consumed, the oldest data in the buffer is dropped to make
+ *  room
  *  The data to be stored is treated as parts with chunkSize size
  *  Only full chunkSize sized parts are stored
  *----------------------------------------------------------------------------*/
@@ -168,98 +413,73 @@ unsigned int
 BufferedSink :: store (     const void    * buffer,
                             unsigned int    bufferSize )
 {
-    const unsigned char   * buf;
-    unsigned int            size;
-    unsigned int            i;
-    unsigned char         * oldInp;
-
     if ( !buffer ) {
         throw Exception( __FILE__, __LINE__, "buffer is null");
     }
 
+    // adjust so it is a multiple of chunkSize
+    bufferSize -= bufferSize % chunkSize;
     if ( !bufferSize ) {
         return 0;
     }
 
-    unsigned int remaining = this->bufferSize - ( outp <= inp ? inp - outp : 
-                             (bufferEnd - outp) + (inp - this->buffer) );
+    store( (const unsigned char *) buffer,
+           bufferSize,
+           0,
+           0,
+           0,
+           TimeSummary::now());
 
-    // react only to the first overrun whenever there is a series of overruns
-    if ( remaining + chunkSize <= bufferSize && remaining > chunkSize  ) {
-        reportEvent(3,"BufferedSink :: store, buffer overrun");
-        throw Exception( __FILE__, __LINE__,
-                         "buffer overrun");
-    }
-
-    oldInp = inp;
-    buf    = (const unsigned char *) buffer;
-    
-    // adjust so it is a multiple of chunkSize
-    bufferSize -= bufferSize % chunkSize;
+    return bufferSize;
+}
 
-    // cut the front of the supplied buffer if it wouldn't fit
-    if ( bufferSize > this->bufferSize ) {
-        size  = this->bufferSize - 1;
-        size -= size % chunkSize;       // keep it a multiple of chunkSize
-        buf  += bufferSize - size;
-    } else {
-        size = bufferSize;
-    }
 
-    // copy the data into the buffer
-    i = bufferEnd - inp;
-    if ( (i % chunkSize) != 0 ) {
-        throw Exception( __FILE__, __LINE__, "copy quantity not aligned", i);
-    }
+/*------------------------------------------------------------------------------
+ *  Write the slices waiting, as much as the sink takes
+ *----------------------------------------------------------------------------*/
+unsigned int
+BufferedSink :: writeSlices (   unsigned int    limit )
+{
+    unsigned int    total = 0;
 
-    if ( size <= i ) {
-        // the place between inp and bufferEnd is
-        // big enough to hold the data
-        
-        memcpy( inp, buf, size);
-        inp = slidePointer( inp, size);
+    while ( numSlices && total < limit && sink->canWrite( 0, 0) ) {
+        Slice               * slice = slices + firstSlice;
+        const unsigned char * data  = slice->packet->getData();
+        unsigned int          size  = slice->end - slice->offset;
+        unsigned int          length;
 
-        // adjust outp, lose the data that was overwritten, if any
-        if ( outp > oldInp && outp <= inp ) {
-            outp = slidePointer( inp, chunkSize);
+        if ( size > limit - total ) {
+            size = limit - total;
         }
 
-    } else {
-        // the place between inp and bufferEnd is not
-        // big enough to hold the data
-        // writing will take place in two turns, once from
-        // inp -> bufferEnd, then from buffer ->
-
-        memcpy( inp, buf, i);
-        i = size - i;
-        if ( (i % chunkSize) != 0 ) {
-            throw Exception(__FILE__, __LINE__, "copy quantity not aligned", i);
-        }
-        memcpy( this->buffer, buf, i);
-        inp = slidePointer( this->buffer, i);
-        
-        // adjust outp, lose the data that was overwritten, if any
-        if ( outp <= oldInp ) {
-            if ( outp < inp ) {
-                outp = slidePointer( inp, chunkSize);
+        try {
+            if ( slice->offset < slice->given ) {
+                // given before, only to be sent now
+                if ( size > slice->given - slice->offset ) {
+                    size = slice->given - slice->offset;
+                }
+                length = sink->writeAgain( data + slice->offset, size);
+            } else {
+                slice->given = slice->offset + size;
+                length       = sink->write( data + slice->offset, size);
             }
-        } else {
-            outp = slidePointer( inp, chunkSize);
+        } catch ( Exception   & e ) {
+            reportEvent(3,"Exception caught in BufferedSink :: writeSlices");
+            break;
+        }
+        if ( !length ) {
+            break;
         }
-    }
-
-    updatePeak();
 
-    if ( ((inp - this->buffer) % chunkSize) != 0 ) {
-        throw Exception( __FILE__, __LINE__,
-                         "inp not aligned", inp - this->buffer);
-    }
-    if ( ((outp - this->buffer) % chunkSize) != 0 ) {
-        throw Exception( __FILE__, __LINE__,
-                         "outp not aligned", outp - this->buffer);
+        slice->offset += length;
+        fill          -= length;
+        total         += length;
+        if ( slice->offset == slice->end ) {
+            removeFirst();
+        }
     }
 
-    return size;
+    return total;
 }
 
 
@@ -268,12 +488,13 @@ BufferedSink :: store (     const void    * buffer,
  *  if len == 0, try to flush the buffer
  *----------------------------------------------------------------------------*/
 unsigned int
-BufferedSink :: write (    const void    * buf,
-                           unsigned int    len )
+BufferedSink :: writeData ( const unsigned char   * buf,
+                            unsigned int            len,
+                            Packet                * packet )
 {
     unsigned int    length = 0;
-    unsigned int    soFar = 0;
-    unsigned char * b = (unsigned char *) buf;
+    unsigned int    given  = 0;
+    double          now    = TimeSummary::now();
 
     if ( !buf ) {
         throw Exception( __FILE__, __LINE__, "buf is null");
@@ -283,128 +504,99 @@ BufferedSink :: write (    const void    * buf,
         return 0;
     }
 
-    if ( !align() ) {
-        return 0;
-    }
-    
-    if ( !sink->isOpen() && openAttempts < 10 ) {
-        // try to reopen underlying sink, because it has closed on its own
-        openAttempts++;
-        try {
-            if( sink->open() ) {
-                // if reopening succeeds, reset open attempts
-                openAttempts = 0;
-            }
-        } catch ( Exception &e ) {
-            reportEvent( 4,"BufferedSink :: write,",
-                         "couldn't reopen underlying sink, attempt",
-                         openAttempts, "/ 10" );
-        }
-        
-        if( openAttempts == 10 ) {
-            // all the attempts have been used, give up
-            close();
-            throw Exception( __FILE__, __LINE__,
-                             "reopen failed");
-        }
-    }
-
     // make it a multiple of chunkSize
     len -= len % chunkSize;
 
-    // try to write data from the buffer first, if any
-    if ( inp != outp ) {
-        unsigned int    size  = 0;
-        unsigned int    total = 0;
-
-        if ( outp > inp ) {
-            // valuable data is between outp -> bufferEnd and buffer -> inp
-            // try to write the outp -> bufferEnd
-            // the rest will be written in the next if
-
-            size    = bufferEnd - outp;
-            size   -= size % chunkSize;
-            if( size > len * 2 ) {
-                // do not try to send the content of the entire buffer at once,
-                // but limit sending to a multiple of len
-                // this prevents a surge of data to underlying buffer
-                // which is important especially during a lot of packet loss
-                size = len * 2;
-            }
-            soFar   = 0;
-
-            while ( outp > inp && soFar < size && sink->canWrite( 0, 0) ) {
-                try {
-                    length  = sink->write( outp + soFar, size - soFar);
-                } catch (Exception &e) {
-                    length = 0;
-                    reportEvent(3,"Exception caught in BufferedSink :: write1");
-                }
-                outp    = slidePointer( outp, length);
-                soFar  += length;
-            }
-
-            total += soFar;
-        }
+    // rather drop what's too late than have the listeners lag behind
+    if ( maxLatency ) {
+        expire( now - maxLatency);
+    }
 
-        if ( outp < inp ) {
-            // valuable data is between outp and inp
-            // in the previous if wrote all data from the end
-            // this part will write the rest
+    if ( reconnector->isBusy() ) {
+        // the underlying sink is being reopened, don't touch it meanwhile
+        hold( buf, len, packet, 0, 0, now);
+        return len;
+    }
 
-            size    = inp - outp;
-            if( size > len * 2 ) {
-                // prevent a surge of data to underlying buffer
-                size = len * 2;
-            }
-            soFar   = 0;
-
-            while ( soFar < size && sink->canWrite( 0, 0) ) {
-                try {
-                    length  = sink->write( outp + soFar, size - soFar);
-                } catch (Exception &e) {
-                    length = 0;
-                    reportEvent(3,"Exception caught in BufferedSink :: write2" );
-                }
-                outp    = slidePointer( outp, length);
-                soFar  += length;
-            }
+    if ( !reconnector->finish() ) {
+        // all the attempts have been used, give up
+        close();
+        throw Exception( __FILE__, __LINE__,
+                         "reopen failed");
+    }
 
-            total += soFar;
+    if ( reconnecting && sink->isOpen() ) {
+        // reopened, start with only the latest of what's waiting
+        reconnecting = false;
+        if ( burst ) {
+            expire( now - burst);
         }
-
-        while ( (outp - buffer) % chunkSize ) {
-            slidePointer( outp, 1);
+        // a listener on the new connection needs the header of the
+        // stream first, unless it is still waiting to be sent anyway.
+        // the underlying sink has been given it already
+        if ( header.get()
+          && (!numSlices
+           || slices[firstSlice].packet.get() != header.get()) ) {
+            prepend( header.get(), header->getSize(), now);
         }
+    }
 
-        // calulate the misalignment to chunkSize boundaries
-        misalignment = (chunkSize - (total % chunkSize)) % chunkSize;
+    if ( !sink->isOpen() ) {
+        // the underlying sink has closed on its own, reopen it in the
+        // background, and keep the data until then. a write sent partly
+        // on the old connection is sent again as a whole on the new one,
+        // but as it has been given already, it is not kept again
+        if ( numSlices ) {
+            fill += slices[firstSlice].offset;
+            slices[firstSlice].offset = 0;
+        }
+        reconnecting = true;
+        reconnector->start();
+        hold( buf, len, packet, 0, 0, now);
+        return len;
     }
 
-    if ( !align() ) {
-        return 0;
+    // try to write data from the buffer first, if any
+    // do not try to send the content of the entire buffer at once,
+    // but limit sending to a multiple of len
+    // this prevents a surge of data to underlying buffer
+    // which is important especially during a lot of packet loss
+    // when limited in time, the backlog is short enough to send at once,
+    // so as to catch up as soon as possible
+    if ( numSlices ) {
+        writeSlices( maxLatency ? fill : len * 2);
     }
 
     // the internal buffer is empty, try to write the fresh data
-    soFar = 0;
-    if ( inp == outp ) { 
-        while ( soFar < len && sink->canWrite( 0, 0) ) {
+    if ( !numSlices ) { 
+        while ( length < len && sink->canWrite( 0, 0) ) {
+            unsigned int    ret;
+
             try {
-                soFar += sink->write( b + soFar, len - soFar);
-            } catch (Exception &e) {
-                reportEvent(3,"Exception caught in BufferedSink :: write3");
+                if ( given ) {
+                    // the rest of what the sink did not take all of
+                    ret = sink->writeAgain( buf + length, len - length);
+                } else if ( packet && len == packet->getSize() ) {
+                    given = len;
+                    ret   = sink->writePacket( packet);
+                } else {
+                    given = len;
+                    ret   = sink->write( buf, len);
+                }
+            } catch ( Exception   & e ) {
+                reportEvent(3,"Exception caught in BufferedSink :: write");
+                break;
+            }
+            if ( !ret ) {
+                break;
             }
+            length += ret;
         }
     }
-    length = soFar;
-
-    // calulate the misalignment to chunkSize boundaries
-    misalignment = (chunkSize - (length % chunkSize)) % chunkSize;
 
     if ( length < len ) {
         // if not all fresh could be written, store the remains
-
-        store( b + length, len - length);
+        store( buf, len, packet, length, given, now);
     }
 
     updatePeak();
@@ -424,9 +616,16 @@ BufferedSink :: close ( void )
         return;
     }
 
-    flush();
+    reconnector->cancel();
+    if ( sink->isOpen() ) {
+        flush();
+    }
     sink->close();
-    inp = outp = buffer;
+    while ( numSlices ) {
+        removeFirst();
+    }
+    reconnecting = false;
+    updatePeak();
     bOpen = false;
 }
 
@@ -39,6 +39,9 @@
 #include "Ref.h"
 #include "Reporter.h"
 #include "Sink.h"
+#include "Packet.h"
+#include "PacketPool.h"
+#include "Reconnector.h"
 
 
 /* ================================================================ constants */
@@ -53,6 +56,22 @@
  *  A Sink First-In First-Out buffer.
  *  This buffer can always be written to, it overwrites any
  *  data contained if needed.
+ *  The data waiting to be written is kept as slices of packets: data
+ *  written as a Packet is kept by reference, other data is copied into
+ *  a new packet once. The size of the buffer limits the number of bytes
+ *  waiting, not the memory of the packets they are a part of.
+ *
+ *  Each write is kept as a whole, as it holds whole frames or pages of
+ *  the encoded stream, or whole chunks of audio. Thus when data has to
+ *  be dropped, whole writes are dropped, never cutting a frame in half.
+ *  A write that has been partly sent already is always completed.
+ *
+ *  As each slice remembers when it was written, the buffer may also
+ *  be limited in time: data older than the maximum latency is dropped,
+ *  oldest first, instead of being sent late, and only the latest burst
+ *  of data is sent after the underlying Sink has been reopened. When
+ *  limited in time, the data waiting is sent as fast as the underlying
+ *  Sink takes it.
  *  The class is not thread-safe.
  *
  *  @author  $Author$
@@ -63,17 +82,49 @@ class BufferedSink : public Sink, public virtual Reporter
     private:
 
         /**
-         *  The buffer.
+         *  The part of a packet still to be written to the underlying
+         *  Sink. The packet, up to end, is what was written to the
+         *  BufferedSink in one go, offset is where sending is at.
+         *  The underlying Sink has been given the packet up to given,
+         *  whether it took it or not: a stream dump keeps all it is
+         *  given, so that part is only to be sent again, not kept again.
+         *  The time is when the slice was written to the BufferedSink.
+         */
+        typedef struct {
+            Ref<Packet>             packet;
+            unsigned int            offset;
+            unsigned int            given;
+            unsigned int            end;
+            double                  time;
+        } Slice;
+
+        /**
+         *  The ring of slices waiting to be written.
+         */
+        Slice             * slices;
+
+        /**
+         *  The number of slices the ring can hold.
+         */
+        unsigned int        maxSlices;
+
+        /**
+         *  The index of the oldest slice in the ring.
          */
-        unsigned char     * buffer;
+        unsigned int        firstSlice;
 
         /**
-         *  The end of the buffer.
+         *  The number of slices in the ring.
          */
-        unsigned char     * bufferEnd;
+        unsigned int        numSlices;
 
         /**
-         *  The size of the buffer.
+         *  The packets plain writes are kept in.
+         */
+        PacketPool        * pool;
+
+        /**
+         *  The size of the buffer: the most bytes kept waiting.
          */
         unsigned int        bufferSize;
 
@@ -81,6 +132,11 @@ class BufferedSink : public Sink, public virtual Reporter
          *  The highest usage of the buffer.
          */
         unsigned int        peak;
+
+        /**
+         *  The usage of the buffer: the number of bytes waiting.
+         */
+        unsigned int        fill;
         
         /**
          *  All data written to this BufferedSink is handled by chuncks
@@ -89,37 +145,50 @@ class BufferedSink : public Sink, public virtual Reporter
         unsigned int        chunkSize;
 
         /**
-         *  Number of bytes the underlying stream is misaligned with
-         *  chunkSize. (It needs this many bytes more to be aligned.)
+         *  The longest time data may wait, in seconds, or 0 if the
+         *  data is limited by the size of the buffer only.
          */
-        unsigned int        misalignment;
+        double              maxLatency;
 
         /**
-         *  Start of free territory in buffer.
+         *  The seconds of data waiting to send after the underlying
+         *  Sink has been reopened, or 0 to send all that is waiting.
          */
-        unsigned char     * inp;
+        double              burst;
 
         /**
-         *  Start of sensible data in buffer.
+         *  The number of bytes dropped so far.
          */
-        unsigned char     * outp;
+        unsigned long       dropped;
 
+        /**
+         *  Tells if the underlying Sink is being reopened, and burst is
+         *  yet to be applied.
+         */
+        bool                reconnecting;
 
         /**
          *  The underlying Sink.
          */
         Ref<Sink>           sink;
+
+        /**
+         *  The data the stream starts with, sent first after the
+         *  underlying Sink has been reopened, or NULL if none.
+         */
+        Ref<Packet>         header;
         
         /**
          *  Is BufferedSink open.
          */
         bool               bOpen;
-         
-         /**
-          * Number of attempts so far to open underlying sink after it has
-          * closed on its own.
-          */
-        unsigned int       openAttempts;  
+
+
+        /**
+         *  Reopens the underlying Sink in the background, after it has
+         *  closed on its own.
+         */
+        Ref<Reconnector>    reconnector;
 
         /**
          *  Initialize the object.
@@ -127,12 +196,18 @@ class BufferedSink : public Sink, public virtual Reporter
          *  @param sink the Sink to attach this BufferedSink to.
          *  @param size the size of the internal buffer to use.
          *  @param chunkSize size of chunks to handle data in.
+         *  @param maxLatency the longest time data may wait, in seconds,
+         *                    0 for no limit.
+         *  @param burst the seconds of data to send after reopening,
+         *               0 for all.
          *  @exception Exception
          */
         void
         init (  Sink              * sink,
                 unsigned int        size,
-                unsigned int        chunkSize );
+                unsigned int        chunkSize,
+                double              maxLatency,
+                double              burst );
 
         /**
          *  De-initialize the object.
@@ -143,26 +218,99 @@ class BufferedSink : public Sink, public virtual Reporter
         strip ( void );
 
         /**
-         *  Slide a pointer in the internal buffer by offset. If the pointer
-         *  would reach beyond the end of the buffer, it goes wraps around.
+         *  Copy the slices of an other BufferedSink, sharing the packets.
+         *
+         *  @param buffer the BufferedSink to copy the slices of.
+         */
+        void
+        copySlices ( const BufferedSink   & buffer );
+
+        /**
+         *  Add a slice to the end of the ring, growing the ring if full.
          *
-         *  @param p the pointer to slide.
-         *  @param offset the amount to slide with.
-         *  @return pointer p + offset, wrapped around if needed.
-         */
-        inline unsigned char *
-        slidePointer (
-                        unsigned char * p,
-                        unsigned int    offset )        throw ()
+         *  @param packet the packet the slice is a part of.
+         *  @param offset the first byte of the slice in the packet.
+         *  @param given the end of what the underlying Sink has been
+         *               given of the packet.
+         *  @param end the end of the slice in the packet.
+         *  @param time the time the slice was written.
+         */
+        void
+        append (    Packet        * packet,
+                    unsigned int    offset,
+                    unsigned int    given,
+                    unsigned int    end,
+                    double          time );
+
+        /**
+         *  Add a slice to the start of the ring, growing the ring if full.
+         *
+         *  @param packet the packet the slice is the whole of.
+         *  @param given the end of what the underlying Sink has been
+         *               given of the packet.
+         *  @param time the time the slice was written.
+         */
+        void
+        prepend (   Packet        * packet,
+                    unsigned int    given,
+                    double          time );
+
+        /**
+         *  Double the size of the ring, if it is full.
+         */
+        void
+        grow ( void );
+
+        /**
+         *  Remove the first slice from the ring.
+         */
+        inline void
+        removeFirst ( void )                            throw ()
         {
-            p += offset;
-            while ( p >= bufferEnd ) {
-                p -= bufferSize;
-            }
+            fill -= slices[firstSlice].end - slices[firstSlice].offset;
+            slices[firstSlice].packet = 0;
+            firstSlice = (firstSlice + 1) % maxSlices;
+            --numSlices;
+        }
 
-            return p;
+        /**
+         *  Get the oldest slice that may be dropped: the first one, unless
+         *  it has been partly sent, or it is the header sent first to the
+         *  reopened Sink, in which case the one after it.
+         *
+         *  @return the index of the oldest slice that may be dropped,
+         *          or maxSlices if there is none.
+         */
+        inline unsigned int
+        oldestDroppable ( void ) const                  throw ()
+        {
+            if ( !numSlices ) {
+                return maxSlices;
+            }
+            if ( slices[firstSlice].offset == 0
+              && slices[firstSlice].packet.get() != header.get() ) {
+                return firstSlice;
+            }
+            return numSlices > 1 ? (firstSlice + 1) % maxSlices : maxSlices;
         }
 
+        /**
+         *  Drop the oldest slice that may be dropped.
+         *
+         *  @return true if a slice was dropped, false if there was none
+         *          that may be dropped.
+         */
+        bool
+        dropOldest ( void )                             throw ();
+
+        /**
+         *  Drop the slices written before some time.
+         *
+         *  @param oldest the time of the oldest slice to keep.
+         */
+        void
+        expire ( double     oldest )                    throw ();
+
         /**
          *  Update the peak buffer usage indicator.
          *
@@ -171,10 +319,8 @@ class BufferedSink : public Sink, public virtual Reporter
         inline void
         updatePeak ( void )                             throw ()
         {
-            unsigned int    u;
+            unsigned int    u = fill;
 
-            u = outp <= inp ? inp - outp : (bufferEnd - outp) + (inp - buffer);
-            
             // report new peaks if it is either significantly more severe than
             // the previously reported peak
             if ( peak * 2 < u ) {
@@ -189,33 +335,74 @@ class BufferedSink : public Sink, public virtual Reporter
         }
 
         /**
-         *  If the underlying Sink is misaligned on chunkSize, write as
-         *  many 0s as needed to get it aligned.
+         *  Keep data that could not be written yet. If there is not
+         *  enough space, the oldest data is dropped, so that the latest
+         *  is sent later on.
          *
-         *  @see #misalignment
-         *  @see #chunkSize
+         *  @param buf the data to keep.
+         *  @param len the number of bytes in buf, a multiple of chunkSize.
+         *  @param packet the packet holding buf, kept by reference,
+         *                or 0 if the data is to be copied.
+         *  @param offset the number of bytes of buf already written.
+         *  @param given the number of bytes of buf the underlying Sink
+         *               has been given, written or not.
+         *  @param time the time the data was written.
+         *  @exception Exception
          */
-        inline bool
-        align ( void )
-        {
-            char    b[] = { 0 };
-
-            while ( misalignment ) {
-                if ( sink->canWrite( 0, 0) ) {
-                    unsigned int    ret;
-                    
-                    if ( !(ret = sink->write( b, 1)) ) {
-                        return false;
-                    }
-                    --misalignment;
-
-                } else {
-                    return false;
-                }
-            }
+        void
+        hold (  const unsigned char   * buf,
+                unsigned int            len,
+                Packet                * packet,
+                unsigned int            offset,
+                unsigned int            given,
+                double                  time );
 
-            return true;
-        }
+        /**
+         *  Keep data that could not be written yet, as hold() does, but
+         *  throw an Exception at the first of a series of overruns,
+         *  unless limited in time.
+         *
+         *  @param buf the data to keep.
+         *  @param len the number of bytes in buf, a multiple of chunkSize.
+         *  @param packet the packet holding buf, kept by reference,
+         *                or 0 if the data is to be copied.
+         *  @param offset the number of bytes of buf already written.
+         *  @param given the number of bytes of buf the underlying Sink
+         *               has been given, written or not.
+         *  @param time the time the data was written.
+         *  @exception Exception on buffer overrun.
+         */
+        void
+        store ( const unsigned char   * buf,
+                unsigned int            len,
+                Packet                * packet,
+                unsigned int            offset,
+                unsigned int            given,
+                double                  time );
+
+        /**
+         *  Write the slices waiting to the underlying Sink, as much as
+         *  it takes right now.
+         *
+         *  @param limit the most bytes to write.
+         *  @return the number of bytes written.
+         */
+        unsigned int
+        writeSlices ( unsigned int  limit );
+
+        /**
+         *  Write data, or a packet holding it, to the BufferedSink.
+         *
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @param packet the packet holding buf, or 0 if none.
+         *  @return the number of bytes consumed.
+         *  @exception Exception
+         */
+        unsigned int
+        writeData ( const unsigned char   * buf,
+                    unsigned int            len,
+                    Packet                * packet );
 
 
     protected:
@@ -231,25 +418,14 @@ class BufferedSink : public Sink, public virtual Reporter
             throw Exception( __FILE__, __LINE__);
         }
 
-        /**
-         *  Get the size of the buffer.
-         *  
-         *  @return the size of the buffer.
-         */
-        inline unsigned int
-        getSize ( void ) const                      throw ()
-        {
-            return bufferSize;
-        }
-
         /**
          *  Store data in the internal buffer. If there is not enough space,
-         *  discard all in the buffer and the beginning of the supplied
-         *  buffer if needed.
+         *  discard the oldest writes in the buffer, as many as needed.
          *  
          *  @param buffer the data to store.
          *  @param bufferSize the amount of data to store in bytes.
          *  @return number of bytes really stored.
+         *  @exception Exception on buffer overrun.
          */
         unsigned int
         store (     const void    * buffer,
@@ -265,14 +441,20 @@ class BufferedSink : public Sink, public virtual Reporter
          *  @param size the size of the buffer to use for buffering.
          *  @param chunkSize hanlde all data in write() as chunks of
          *                   chunkSize
+         *  @param maxLatency the longest time data may wait before sent,
+         *                    in seconds, 0 for no limit.
+         *  @param burst the seconds of data waiting to send after the
+         *               underlying Sink has been reopened, 0 for all.
          *  @exception Exception
          */
         inline 
         BufferedSink (  Sink              * sink,
                         unsigned int        size,
-                        unsigned int        chunkSize = 1 )
+                        unsigned int        chunkSize  = 1,
+                        double              maxLatency = 0.0,
+                        double              burst      = 0.0 )
         {
-            init( sink, size, chunkSize);
+            init( sink, size, chunkSize, maxLatency, burst);
         }
 
         /**
@@ -315,6 +497,50 @@ class BufferedSink : public Sink, public virtual Reporter
             return peak;
         }
 
+        /**
+         *  Get the usage of the internal buffer, as of the last
+         *  read or write.
+         *
+         *  @return the number of bytes in the internal buffer.
+         */
+        inline unsigned int
+        getFill ( void ) const                          throw ()
+        {
+            return fill;
+        }
+
+        /**
+         *  Get the size of the buffer.
+         *  
+         *  @return the size of the buffer.
+         */
+        inline unsigned int
+        getSize ( void ) const                      throw ()
+        {
+            return bufferSize;
+        }
+
+        /**
+         *  Get the time the oldest data in the buffer has been waiting.
+         *
+         *  @return the time the oldest data has been waiting, in seconds,
+         *          0 if the buffer is empty.
+         */
+        double
+        getQueuedTime ( void ) const                    throw ();
+
+        /**
+         *  Get the number of bytes dropped so far, because the buffer
+         *  was full, or the data got too old.
+         *
+         *  @return the number of bytes dropped.
+         */
+        inline unsigned long
+        getDropped ( void ) const                       throw ()
+        {
+            return dropped;
+        }
+
         /**
          *  Open the BufferedSink. Opens the underlying Sink.
          *  
@@ -325,7 +551,6 @@ class BufferedSink : public Sink, public virtual Reporter
         open ( void )
         {
             bOpen = sink->open();
-            openAttempts = 0;
             return bOpen;
         }
 
@@ -368,9 +593,41 @@ class BufferedSink : public Sink, public virtual Reporter
          *  @return the number of bytes written (may be less than len).
          *  @exception Exception
          */
-        virtual unsigned int
+        inline virtual unsigned int
         write (    const void    * buf,
-                   unsigned int    len );
+                   unsigned int    len )
+        {
+            return writeData( (const unsigned char *) buf, len, 0);
+        }
+
+        /**
+         *  Write a packet to the BufferedSink. As write(), but whatever
+         *  can not be written right away is kept by a reference to the
+         *  packet, instead of copying it.
+         *
+         *  @param packet the packet to write.
+         *  @return the number of bytes consumed from the packet.
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writePacket (   Packet        * packet )
+        {
+            return writeData( packet->getData(), packet->getSize(), packet);
+        }
+
+        /**
+         *  Keep the data the stream starts with, to send it first
+         *  to the underlying Sink after reopening it.
+         *
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
+        inline virtual void
+        setHeader ( Packet        * header )
+        {
+            this->header = header;
+            sink->setHeader( header);
+        }
 
         /**
          *  Flush all data that was written to the BufferedSink to the
@@ -395,7 +652,39 @@ class BufferedSink : public Sink, public virtual Reporter
         cut ( void )                                    throw ()
         {
             flush();
-            sink->cut();
+            if ( !reconnector->isBusy() ) {
+                sink->cut();
+            }
+        }
+
+        /**
+         *  Cut at a known time.
+         *  This is delegated to the underlying sink.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        inline virtual void
+        cutAt ( double          boundary )              throw ()
+        {
+            flush();
+            if ( !reconnector->isBusy() ) {
+                sink->cutAt( boundary);
+            }
+        }
+
+        /**
+         *  Get ready for a cut coming at a known time.
+         *  This is delegated to the underlying sink.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        inline virtual void
+        prepareCut ( double     boundary )              throw ()
+        {
+            if ( !reconnector->isBusy() ) {
+                sink->prepareCut( boundary);
+            }
         }
 
         /**
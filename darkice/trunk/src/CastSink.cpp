@@ -120,6 +120,9 @@ CastSink :: open ( void )
         return false;
     }
 
+    // from now on, only audio is sent
+    getSocket()->enterLoop();
+
     if ( streamDump != 0 ) {
         if ( !streamDump->isOpen() ) {
             if ( !streamDump->open() ) {
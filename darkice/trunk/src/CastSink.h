@@ -154,6 +154,12 @@ class CastSink : public Sink, public virtual Reporter
             throw Exception( __FILE__, __LINE__);
         }
 
+        /**
+         *  The number of seconds to wait for the server to answer
+         *  the login.
+         */
+        static const unsigned int   loginTimeout = 10;
+
         /**
          *  Log in to the server using the socket avialable.
          *
@@ -342,6 +348,56 @@ class CastSink : public Sink, public virtual Reporter
             return getSink()->write( buf, len);
         }
 
+        /**
+         *  Write a packet of encoded data to the CastSink. The stream
+         *  dump gets the packet itself, so that it may keep it without
+         *  copying.
+         *
+         *  @param packet the packet to write.
+         *  @return the number of bytes sent from the packet
+         *          (may be less than the size of the packet).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writePacket (  Packet        * packet )
+        {
+            if ( streamDump != 0 ) {
+                streamDump->writePacket( packet);
+            }
+
+            return getSink()->write( packet->getData(), packet->getSize());
+        }
+
+        /**
+         *  Write data again to the server, that the CastSink has been
+         *  given before. The stream dump has it already.
+         *
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @return the number of bytes written (may be less than len).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writeAgain (   const void    * buf,
+                       unsigned int    len )
+        {
+            return getSink()->write( buf, len);
+        }
+
+        /**
+         *  Tell the stream dump the data the stream starts with.
+         *
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
+        inline virtual void
+        setHeader (    Packet        * header )
+        {
+            if ( streamDump != 0 ) {
+                streamDump->setHeader( header);
+            }
+        }
+
         /**
          *  Flush all data that was written to the CastSink to the server.
          *
@@ -370,6 +426,34 @@ class CastSink : public Sink, public virtual Reporter
             }
         }
 
+        /**
+         *  Cut at a known time, naming the next stream dump file after it.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        inline virtual void
+        cutAt ( double          boundary )              throw ()
+        {
+            if ( streamDump != 0 ) {
+                streamDump->cutAt( boundary);
+            }
+        }
+
+        /**
+         *  Get ready for a cut coming at a known time, by letting the
+         *  stream dump create its next file.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        inline virtual void
+        prepareCut ( double     boundary )              throw ()
+        {
+            if ( streamDump != 0 ) {
+                streamDump->prepareCut( boundary);
+            }
+        }
+
         /**
          *  Close the CastSink.
          *
@@ -0,0 +1,221 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : ChannelMap.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error need stdlib.h
+#endif
+
+
+#include "Exception.h"
+#include "Util.h"
+#include "ChannelMap.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+ChannelMap :: init (    const char        * spec,
+                        unsigned int        inChannels )
+{
+    const char    * str;
+    unsigned int    n;
+
+    if ( !spec || !*spec ) {
+        throw Exception( __FILE__, __LINE__, "empty channel map");
+    }
+    if ( inChannels == 0 ) {
+        throw Exception( __FILE__, __LINE__, "no channels to map");
+    }
+
+    // one output channel for each comma separated part
+    outChannels = 1;
+    for ( str = spec; *str; ++str ) {
+        if ( *str == ',' ) {
+            ++outChannels;
+        }
+    }
+
+    this->spec       = Util::strDup( spec);
+    this->inChannels = inChannels;
+    this->gains      = new float[outChannels * inChannels];
+
+    for ( n = 0; n < outChannels * inChannels; ++n ) {
+        gains[n] = 0.0f;
+    }
+
+    try {
+        str = spec;
+        for ( n = 0; n < outChannels; ++n ) {
+            str = parseChannel( str, gains + n * inChannels);
+            if ( *str == ',' ) {
+                ++str;
+            }
+        }
+    } catch ( ... ) {
+        strip();
+        throw;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+ChannelMap :: strip ( void )
+{
+    delete[] gains;
+    delete[] spec;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Parse one output channel of the map
+ *----------------------------------------------------------------------------*/
+const char *
+ChannelMap :: parseChannel (    const char        * str,
+                                float             * row )
+{
+    unsigned int    terms    = 0;
+    bool            weighted = false;
+
+    for (;;) {
+        char      * end;
+        double      gain = 1.0;
+        double      value;
+        long        ch;
+
+        value = strtod( str, &end);
+        if ( end == str ) {
+            throw Exception( __FILE__, __LINE__, "invalid channel map", spec);
+        }
+        if ( *end == '*' ) {
+            gain     = value;
+            weighted = true;
+            str      = end + 1;
+        }
+
+        ch = strtol( str, &end, 10);
+        if ( end == str || ch < 1 || ch > (long) inChannels ) {
+            throw Exception( __FILE__, __LINE__,
+                             "invalid channel in channel map", spec);
+        }
+        row[ch - 1] += gain;
+        ++terms;
+
+        for ( str = end; *str == ' ' || *str == '\t'; ++str ) {
+        }
+        if ( *str != '+' ) {
+            break;
+        }
+        ++str;
+    }
+
+    if ( *str != ',' && *str != '\0' ) {
+        throw Exception( __FILE__, __LINE__, "invalid channel map", spec);
+    }
+
+    // channels summed as they are would clip, average them instead
+    if ( !weighted && terms > 1 ) {
+        for ( unsigned int i = 0; i < inChannels; ++i ) {
+            row[i] /= terms;
+        }
+    }
+
+    return str;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Map the channels of a frame
+ *----------------------------------------------------------------------------*/
+void
+ChannelMap :: apply (   const AudioFrame  * frame,
+                        float             * out ) const         throw ()
+{
+    unsigned int    samples = frame->getSamples();
+
+    for ( unsigned int o = 0; o < outChannels; ++o ) {
+        const float   * row   = gains + o * inChannels;
+        float         * dst   = out + o;
+        bool            first = true;
+
+        for ( unsigned int i = 0; i < inChannels; ++i ) {
+            const float   * src  = frame->getFloat( i);
+            float           gain = row[i];
+
+            if ( gain == 0.0f ) {
+                continue;
+            }
+            if ( first ) {
+                for ( unsigned int n = 0; n < samples; ++n ) {
+                    dst[n * outChannels] = gain * src[n];
+                }
+                first = false;
+            } else {
+                for ( unsigned int n = 0; n < samples; ++n ) {
+                    dst[n * outChannels] += gain * src[n];
+                }
+            }
+        }
+
+        // all the gains of the channel may be zero
+        if ( first ) {
+            for ( unsigned int n = 0; n < samples; ++n ) {
+                dst[n * outChannels] = 0.0f;
+            }
+        }
+    }
+}
+
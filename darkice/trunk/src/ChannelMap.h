@@ -0,0 +1,257 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : ChannelMap.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef CHANNEL_MAP_H
+#define CHANNEL_MAP_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "Referable.h"
+#include "Exception.h"
+#include "AudioFrame.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  Selects and mixes the channels of the input for an output, so that
+ *  a single multichannel capture can feed streams made of different
+ *  channels of it.
+ *
+ *  The map is given as a comma separated list of output channels. Each
+ *  output channel is a sum of input channels, joined by '+', numbered
+ *  from 1. An input channel may be preceded by a gain and a '*'. The
+ *  channels summed without gains are averaged. For example:
+ *
+ *  <pre>
+ *  3,4             channels 3 and 4, as a stereo pair
+ *  1+2             a mono downmix of channels 1 and 2
+ *  1+3,2+4         two stereo pairs mixed into one
+ *  0.7*1+0.3*5     channel 1 mixed with some of channel 5
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class ChannelMap : public virtual Referable
+{
+    private:
+
+        /**
+         *  The map, as given.
+         */
+        char              * spec;
+
+        /**
+         *  The number of channels of the input.
+         */
+        unsigned int        inChannels;
+
+        /**
+         *  The number of channels of the output.
+         */
+        unsigned int        outChannels;
+
+        /**
+         *  The gain of each input channel, for each output channel:
+         *  outChannels rows of inChannels gains each.
+         */
+        float             * gains;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param spec the map.
+         *  @param inChannels the number of channels of the input.
+         *  @exception Exception if the map is invalid.
+         */
+        void
+        init (  const char        * spec,
+                unsigned int        inChannels );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Parse one output channel of the map.
+         *
+         *  @param str the output channel, up to the next ',' or the end.
+         *  @param row the gains to set, inChannels long.
+         *  @return the position after the output channel.
+         *  @exception Exception if the output channel is invalid.
+         */
+        const char *
+        parseChannel (  const char        * str,
+                        float             * row );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        ChannelMap ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param spec the map, as described for the class.
+         *  @param inChannels the number of channels of the input.
+         *  @exception Exception if the map is invalid.
+         */
+        inline
+        ChannelMap (    const char        * spec,
+                        unsigned int        inChannels )
+        {
+            init( spec, inChannels);
+        }
+
+        /**
+         *  Copy constructor.
+         *
+         *  @param map the object to copy.
+         *  @exception Exception
+         */
+        inline
+        ChannelMap (    const ChannelMap  & map )
+        {
+            init( map.spec, map.inChannels);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~ChannelMap ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Assignment operator.
+         *
+         *  @param map the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline virtual ChannelMap &
+        operator= ( const ChannelMap  & map )
+        {
+            if ( this != &map ) {
+                strip();
+                init( map.spec, map.inChannels);
+            }
+            return *this;
+        }
+
+        /**
+         *  Get the map, as given.
+         *
+         *  @return the map.
+         */
+        inline const char *
+        getSpec ( void ) const                          throw ()
+        {
+            return spec;
+        }
+
+        /**
+         *  Get the number of channels of the input.
+         *
+         *  @return the number of channels of the input.
+         */
+        inline unsigned int
+        getInChannels ( void ) const                    throw ()
+        {
+            return inChannels;
+        }
+
+        /**
+         *  Get the number of channels of the output.
+         *
+         *  @return the number of channels of the output.
+         */
+        inline unsigned int
+        getOutChannels ( void ) const                   throw ()
+        {
+            return outChannels;
+        }
+
+        /**
+         *  Map the channels of a frame.
+         *
+         *  @param frame the audio to map, with getInChannels() channels.
+         *  @param out put the mapped float samples here, channels
+         *             interleaved, getSamples() * getOutChannels() long.
+         */
+        void
+        apply ( const AudioFrame  * frame,
+                float             * out ) const         throw ();
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* CHANNEL_MAP_H */
+
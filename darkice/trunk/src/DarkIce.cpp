@@ -40,6 +40,12 @@
 #error need stdlib.h
 #endif
 
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error need stdio.h
+#endif
+
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #else
@@ -72,7 +78,10 @@
 
 
 
+#include <vector>
+
 #include "Util.h"
+#include "SampleConv.h"
 #include "IceCast.h"
 #include "IceCast2.h"
 #include "ShoutCast.h"
@@ -146,13 +155,11 @@ DarkIce :: init ( const Config      & config )
     unsigned int             bufferSecs;
     const ConfigSection    * cs;
     const char             * str;
-    unsigned int             sampleRate;
-    unsigned int             bitsPerSample;
-    unsigned int             channel;
     bool                     reconnect;
-    const char             * device;
-    const char             * jackClientName;
-    const char             * paSourceName;
+    const char             * metricsSocket;
+    unsigned int             metricsPort;
+    char                     section[24];
+    unsigned int             i;
 
     // the [general] section
     if ( !(cs = config.get( "general")) ) {
@@ -181,34 +188,205 @@ DarkIce :: init ( const Config      & config )
     str = cs->get( "rtprio" );
     realTimeSchedPriority = (str != NULL) ? Util::strToL( str ) : 4;
 
-    // the [input] section
-    if ( !(cs = config.get( "input")) ) {
+    // the chunks grow up to the largest size only if it's given
+    str           = cs->get( "chunkMsecs");
+    chunkMsecs    = str ? Util::strToD( str) : 20.0;
+    str           = cs->get( "chunkMaxMsecs");
+    chunkMaxMsecs = str ? Util::strToD( str) : chunkMsecs;
+    if ( chunkMsecs <= 0.0 || chunkMaxMsecs < chunkMsecs ) {
+        throw Exception( __FILE__, __LINE__,
+                         "invalid chunk durations in section [general]");
+    }
+
+    // one encoder thread for each CPU, unless told otherwise
+    str            = cs->get( "encoderThreads");
+    encoderThreads = str ? Util::strToL( str) : 0;
+    str            = cs->get( "encoderAffinity");
+    pinEncoders    = str ? Util::strEq( str, "yes") : false;
+
+    // the metrics endpoint is off unless asked for
+    str           = cs->get( "metricsPort");
+    metricsPort   = str ? Util::strToL( str) : 0;
+    metricsSocket = cs->get( "metricsSocket");
+
+    // the [input] section, and the [input-0], [input-1], ... sections
+    inputs   = new Input[countSections( config, "input-") + 1]();
+    noInputs = 0;
+    if ( (cs = config.get( "input")) ) {
+        configInput( cs, "input", bufferSecs, reconnect);
+    }
+    for ( i = 0; ; ++i ) {
+        snprintf( section, sizeof(section), "input-%u", i);
+        if ( !(cs = config.get( section)) ) {
+            break;
+        }
+        configInput( cs, section, bufferSecs, reconnect);
+    }
+    if ( !noInputs ) {
         throw Exception( __FILE__, __LINE__, "no section [input] in config");
     }
+    reportEvent( 5, "sample conversion kernels: ",
+                 SampleConv::getKernelName());
+
+    netLoop     = new NetworkLoop();
+
+    // there is no limit on the number of outputs, make room for all
+    audioOuts   = new Output[countSections( config, "icecast-")
+                           + countSections( config, "icecast2-")
+                           + countSections( config, "shoutcast-")
+                           + countSections( config, "file-")
+                           + 1]();
+    noAudioOuts = 0;
+    configIceCast( config, bufferSecs);
+    configIceCast2( config, bufferSecs);
+    configShoutCast( config, bufferSecs);
+    configFileCast( config);
+
+    if ( metricsSocket ) {
+        metricsServer = new MetricsServer( this, metricsSocket);
+    } else if ( metricsPort ) {
+        metricsServer = new MetricsServer( this, metricsPort);
+    }
+}
 
-    str        = cs->getForSure( "sampleRate", " missing in section [input]");
+
+/*------------------------------------------------------------------------------
+ *  Create an input from its section of the config file
+ *----------------------------------------------------------------------------*/
+void
+DarkIce :: configInput (    const ConfigSection   * cs,
+                            const char            * name,
+                            unsigned int            bufferSecs,
+                            bool                    reconnect )
+{
+    Input                  * input = inputs + noInputs;
+    const char             * str;
+    unsigned int             sampleRate;
+    unsigned int             bitsPerSample;
+    bool                     floatSamples;
+    bool                     alsaMmap;
+    unsigned int             channel;
+    const char             * device;
+    const char             * jackClientName;
+    const char             * paSourceName;
+
+    str        = cs->getForSure( "sampleRate", " missing in section ", name);
     sampleRate = Util::strToL( str);
-    str       = cs->getForSure( "bitsPerSample", " missing in section [input]");
+    str       = cs->getForSure( "bitsPerSample", " missing in section ", name);
     bitsPerSample = Util::strToL( str);
-    str           = cs->getForSure( "channel", " missing in section [input]");
+    str           = cs->getForSure( "channel", " missing in section ", name);
     channel       = Util::strToL( str);
-    device        = cs->getForSure( "device", " missing in section [input]");
+    device        = cs->getForSure( "device", " missing in section ", name);
     jackClientName = cs->get ( "jackClientName");
     paSourceName = cs->get ( "paSourceName");
+    str          = cs->get( "sampleFormat");
+    if ( !str || Util::strEq( str, "int") ) {
+        floatSamples = false;
+    } else if ( Util::strEq( str, "float") ) {
+        floatSamples = true;
+    } else {
+        throw Exception( __FILE__, __LINE__,
+                         "unsupported sample format: ", str);
+    }
+    str          = cs->get( "alsaMmap");
+    alsaMmap     = str ? Util::strEq( str, "yes") : false;
 
-    dsp             = AudioSource::createDspSource( device,
+    input->dsp      = AudioSource::createDspSource( device,
                                                     jackClientName,
                                                     paSourceName,
                                                     sampleRate,
                                                     bitsPerSample,
-                                                    channel );
-    encConnector    = new MultiThreadedConnector( dsp.get(), reconnect );
+                                                    channel,
+                                                    floatSamples,
+                                                    alsaMmap );
+
+    input->encConnector = new MultiThreadedConnector( input->dsp.get(),
+                                                  reconnect,
+                                                  input->dsp->getSampleSize()
+                                                * input->dsp->getSampleRate()
+                                                * bufferSecs,
+                                                  encoderThreads,
+                                                  pinEncoders );
+    input->darkIce  = this;
+    input->bytes    = 0;
+    Util::strCpy( input->name, name);
+
+    ++noInputs;
+}
 
-    noAudioOuts = 0;
-    configIceCast( config, bufferSecs);
-    configIceCast2( config, bufferSecs);
-    configShoutCast( config, bufferSecs);
-    configFileCast( config);
+
+/*------------------------------------------------------------------------------
+ *  Find the input of an output
+ *----------------------------------------------------------------------------*/
+unsigned int
+DarkIce :: findInput (  const ConfigSection   * cs,
+                        const char            * stream )
+{
+    const char    * str = cs->get( "input");
+    unsigned int    i;
+
+    if ( !str ) {
+        return 0;
+    }
+    for ( i = 0; i < noInputs; ++i ) {
+        if ( Util::strEq( str, inputs[i].name) ) {
+            return i;
+        }
+    }
+
+    throw Exception( __FILE__, __LINE__, stream, ": no such input ", str);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Count the consecutive sections of an output type
+ *----------------------------------------------------------------------------*/
+unsigned int
+DarkIce :: countSections (  const Config      & config,
+                            const char        * prefix )
+{
+    char            section[24];
+    unsigned int    n;
+
+    for ( n = 0; ; ++n ) {
+        snprintf( section, sizeof(section), "%s%u", prefix, n);
+        if ( !config.get( section) ) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Share the encoder of an earlier output with the same settings
+ *----------------------------------------------------------------------------*/
+bool
+DarkIce :: shareEncoder (   unsigned int        u )
+{
+    unsigned int    v;
+
+    for ( v = 0; v < u; ++v ) {
+        if ( audioOuts[v].fanOut.get()
+          && audioOuts[v].ixInput == audioOuts[u].ixInput
+          && Util::strEq( audioOuts[v].encoderKey, audioOuts[u].encoderKey) ) {
+            break;
+        }
+    }
+    if ( v == u ) {
+        return false;
+    }
+
+    audioOuts[v].fanOut->attach( audioOuts[u].buffer.get());
+    audioOuts[u].fanOut  = audioOuts[v].fanOut;
+    audioOuts[u].encoder = audioOuts[v].encoder;
+    audioOuts[u].ixSink  = audioOuts[v].ixSink;
+
+    reportEvent( 3, "sharing the encoder of", audioOuts[v].name,
+                    "with", audioOuts[u].name);
+
+    return true;
 }
 
 
@@ -222,19 +400,19 @@ DarkIce :: configIceCast (  const Config      & config,
 {
     // look for IceCast encoder output streams,
     // sections [icecast-0], [icecast-1], ...
-    char            stream[]        = "icecast- ";
-    size_t          streamLen       = Util::strLen( stream);
+    char            stream[24];
     unsigned int    u;
 
-    for ( u = noAudioOuts; u < maxOutput; ++u ) {
+    for ( u = noAudioOuts; ; ++u ) {
         const ConfigSection    * cs;
 
-        // ugly hack to change the section name to "stream0", "stream1", etc.
-        stream[streamLen-1] = '0' + (u - noAudioOuts);
+        snprintf( stream, sizeof(stream), "icecast-%u", u - noAudioOuts);
 
         if ( !(cs = config.get( stream)) ) {
             break;
         }
+        Util::strCpy( audioOuts[u].name, stream);
+        audioOuts[u].ixInput = findInput( cs, stream);
 
 #if !defined HAVE_LAME_LIB && !defined HAVE_TWOLAME_LIB
         throw Exception( __FILE__, __LINE__,
@@ -244,8 +422,12 @@ DarkIce :: configIceCast (  const Config      & config,
 #else
 
         const char                * str;
+        Input                     * input           = 0;
+        AudioSource               * dsp             = 0;
 
         unsigned int                sampleRate      = 0;
+        unsigned int                inChannel       = 0;
+        Ref<ChannelMap>             channelMap;
         unsigned int                channel         = 0;
         AudioEncoder::BitrateMode   bitrateMode;
         unsigned int                bitrate         = 0;
@@ -266,13 +448,23 @@ DarkIce :: configIceCast (  const Config      & config,
         FileSink                  * localDumpFile   = 0;
         bool                        fileAddDate     = false;
         const char                * fileDateFormat  = 0;
+        unsigned int                fileRotate      = 0;
         BufferedSink              * audioOut        = 0;
         int                         bufferSize      = 0;
+        double                      maxLatency      = 0.0;
+        double                      reconnectBurst  = 0.0;
+
+        input       = inputs + audioOuts[u].ixInput;
+        dsp         = input->dsp.get();
 
         str         = cs->get( "sampleRate");
         sampleRate  = str ? Util::strToL( str) : dsp->getSampleRate();
+        str         = cs->get( "channelMap");
+        channelMap  = str ? new ChannelMap( str, dsp->getChannel()) : 0;
+        inChannel   = channelMap.get() ? channelMap->getOutChannels()
+                                       : dsp->getChannel();
         str         = cs->get( "channel");
-        channel     = str ? Util::strToL( str) : dsp->getChannel();
+        channel     = str ? Util::strToL( str) : inChannel;
 
         str         = cs->get( "bitrate");
         bitrate     = str ? Util::strToL( str) : 0;
@@ -335,10 +527,23 @@ DarkIce :: configIceCast (  const Config      & config,
         str         = cs->get("fileAddDate");
         fileAddDate = str ? (Util::strEq( str, "yes") ? true : false) : false;
         fileDateFormat = cs->get("fileDateFormat");
+        str         = cs->get( "fileRotate");
+        fileRotate  = str ? Util::strToL( str) * 60 : 0;
+        if ( fileRotate && !fileAddDate ) {
+            throw Exception( __FILE__, __LINE__,
+                             "fileRotate needs fileAddDate in section ",
+                             stream);
+        }
 
         bufferSize = dsp->getSampleSize() * dsp->getSampleRate() * bufferSecs;
         reportEvent( 3, "buffer size: ", bufferSize);
 
+        // don't let the listeners fall behind more than the buffer
+        str            = cs->get( "maxLatency");
+        maxLatency     = str ? Util::strToD( str) : bufferSecs;
+        str            = cs->get( "reconnectBurst");
+        reconnectBurst = str ? Util::strToD( str) : 0.0;
+
         localDumpName = cs->get( "localDumpFile");
 
         // go on and create the things
@@ -358,6 +563,7 @@ DarkIce :: configIceCast (  const Config      & config,
         }
         // streaming related stuff
         audioOuts[u].socket = new TcpSocket( server, port);
+        audioOuts[u].socket->setNetworkLoop( netLoop.get());
         audioOuts[u].server = new IceCast( audioOuts[u].socket.get(),
                                            password,
                                            mountPoint,
@@ -380,38 +586,58 @@ DarkIce :: configIceCast (  const Config      & config,
 
         // augment audio outs with a buffer when used from encoder
         audioOut = new BufferedSink( audioOuts[u].server.get(),
-                                                  bufferSize, 1);
+                                     bufferSize,
+                                     1,
+                                     maxLatency,
+                                     reconnectBurst);
+        audioOuts[u].buffer = audioOut;
+
+        // the same encoding for another output is done only once
+        snprintf( audioOuts[u].encoderKey, sizeof(audioOuts[u].encoderKey),
+                  "%s %d %u %u %.17g %u %u %d %d %u %u %u %s",
+                  str, bitrateMode, bitrate, 0, quality,
+                  sampleRate, channel, lowpass, highpass, 0, 0, fileRotate,
+                  channelMap.get() ? channelMap->getSpec() : "-");
+        if ( shareEncoder( u) ) {
+            continue;
+        }
+        audioOuts[u].fanOut = new FanOutSink( audioOut);
 
 #ifdef HAVE_LAME_LIB
         if ( Util::strEq( str, "mp3") ) {
-            audioOuts[u].encoder = new LameLibEncoder( audioOut,
-                                          dsp.get(),
+            audioOuts[u].encoder = new LameLibEncoder(
+                                          audioOuts[u].fanOut.get(),
+                                          dsp,
                                           bitrateMode,
                                           bitrate,
                                           quality,
                                           sampleRate,
                                           channel,
                                           lowpass,
-                                          highpass );
+                                          highpass,
+                                          channelMap.get() );
         }
 #endif
 #ifdef HAVE_TWOLAME_LIB
         if ( Util::strEq( str, "mp2") ) {
             audioOuts[u].encoder = new TwoLameLibEncoder(
-                                            audioOut,
-                                            dsp.get(),
+                                            audioOuts[u].fanOut.get(),
+                                            dsp,
                                             bitrateMode,
                                             bitrate,
                                             sampleRate,
-                                            channel );
+                                            channel,
+                                            channelMap.get() );
         }
 #endif
 
-        encConnector->attach( audioOuts[u].encoder.get());
+        audioOuts[u].ixSink = input->encConnector->getNumSinks();
+        input->encConnector->attach( audioOuts[u].encoder.get());
+        input->encConnector->setRotation( audioOuts[u].ixSink, fileRotate);
 #endif // HAVE_LAME_LIB || HAVE_TWOLAME_LIB
     }
 
-    noAudioOuts += u;
+    noAudioOuts = u;
 }
 
 
@@ -425,24 +651,29 @@ DarkIce :: configIceCast2 (  const Config      & config,
 {
     // look for IceCast2 encoder output streams,
     // sections [icecast2-0], [icecast2-1], ...
-    char            stream[]        = "icecast2- ";
-    size_t          streamLen       = Util::strLen( stream);
+    char            stream[24];
     unsigned int    u;
 
-    for ( u = noAudioOuts; u < maxOutput; ++u ) {
+    for ( u = noAudioOuts; ; ++u ) {
         const ConfigSection    * cs;
 
-        // ugly hack to change the section name to "stream0", "stream1", etc.
-        stream[streamLen-1] = '0' + (u - noAudioOuts);
+        snprintf( stream, sizeof(stream), "icecast2-%u", u - noAudioOuts);
 
         if ( !(cs = config.get( stream)) ) {
             break;
         }
+        Util::strCpy( audioOuts[u].name, stream);
+        audioOuts[u].ixInput = findInput( cs, stream);
 
         const char                * str;
+        Input                     * input           = 0;
+        AudioSource               * dsp             = 0;
 
         IceCast2::StreamFormat      format;
+        const char                * formatName      = 0;
         unsigned int                sampleRate      = 0;
+        unsigned int                inChannel       = 0;
+        Ref<ChannelMap>             channelMap;
         unsigned int                channel         = 0;
         AudioEncoder::BitrateMode   bitrateMode;
         unsigned int                bitrate         = 0;
@@ -465,10 +696,19 @@ DarkIce :: configIceCast2 (  const Config      & config,
         FileSink                  * localDumpFile   = 0;
         bool                        fileAddDate     = false;
         const char                * fileDateFormat  = 0;
+        unsigned int                fileRotate      = 0;
         BufferedSink              * audioOut        = 0;
         int                         bufferSize      = 0;
+        double                      maxLatency      = 0.0;
+        double                      reconnectBurst  = 0.0;
+        unsigned int                pipelineDepth   = 0;
+        unsigned int                pageDuration    = 0;
+
+        input       = inputs + audioOuts[u].ixInput;
+        dsp         = input->dsp.get();
 
         str         = cs->getForSure( "format", " missing in section ", stream);
+        formatName  = str;
         if ( Util::strEq( str, "vorbis") ) {
             format = IceCast2::oggVorbis;
         } else if ( Util::strEq( str, "opus") ) {
@@ -490,8 +730,12 @@ DarkIce :: configIceCast2 (  const Config      & config,
 
         str         = cs->get( "sampleRate");
         sampleRate  = str ? Util::strToL( str) : dsp->getSampleRate();
+        str         = cs->get( "channelMap");
+        channelMap  = str ? new ChannelMap( str, dsp->getChannel()) : 0;
+        inChannel   = channelMap.get() ? channelMap->getOutChannels()
+                                       : dsp->getChannel();
         str         = cs->get( "channel");
-        channel     = str ? Util::strToL( str) : dsp->getChannel();
+        channel     = str ? Util::strToL( str) : inChannel;
 
         // determine fixed bitrate or variable bitrate quality
         str         = cs->get( "bitrate");
@@ -551,13 +795,30 @@ DarkIce :: configIceCast2 (  const Config      & config,
         highpass    = str ? Util::strToL( str) : 0;
         str         = cs->get( "compression");
         compression = str ? Util::strToL( str) : 5;
+        str           = cs->get( "encoderPipeline");
+        pipelineDepth = str ? Util::strToL( str) : 0;
+        str           = cs->get( "oggPageDuration");
+        pageDuration  = str ? Util::strToL( str) : 0;
         str         = cs->get( "fileAddDate");
         fileAddDate = str ? (Util::strEq( str, "yes") ? true : false) : false;
         fileDateFormat = cs->get( "fileDateFormat");
+        str         = cs->get( "fileRotate");
+        fileRotate  = str ? Util::strToL( str) * 60 : 0;
+        if ( fileRotate && !fileAddDate ) {
+            throw Exception( __FILE__, __LINE__,
+                             "fileRotate needs fileAddDate in section ",
+                             stream);
+        }
 
         bufferSize = dsp->getSampleSize() * dsp->getSampleRate() * bufferSecs;
         reportEvent( 3, "buffer size: ", bufferSize);
 
+        // don't let the listeners fall behind more than the buffer
+        str            = cs->get( "maxLatency");
+        maxLatency     = str ? Util::strToD( str) : bufferSecs;
+        str            = cs->get( "reconnectBurst");
+        reconnectBurst = str ? Util::strToD( str) : 0.0;
+
         localDumpName = cs->get( "localDumpFile");
 
         // go on and create the things
@@ -577,6 +838,7 @@ DarkIce :: configIceCast2 (  const Config      & config,
 
         // streaming related stuff
         audioOuts[u].socket = new TcpSocket( server, port);
+        audioOuts[u].socket->setNetworkLoop( netLoop.get());
         audioOuts[u].server = new IceCast2( audioOuts[u].socket.get(),
                                             username,
                                             password,
@@ -591,7 +853,23 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                             localDumpFile);
 
         audioOut = new BufferedSink( audioOuts[u].server.get(),
-                                     bufferSize, 1);
+                                     bufferSize,
+                                     1,
+                                     maxLatency,
+                                     reconnectBurst);
+        audioOuts[u].buffer = audioOut;
+
+        // the same encoding for another output is done only once
+        snprintf( audioOuts[u].encoderKey, sizeof(audioOuts[u].encoderKey),
+                  "%s %d %u %u %.17g %u %u %d %d %u %u %u %u %s",
+                  formatName, bitrateMode, bitrate, maxBitrate, quality,
+                  sampleRate, channel, lowpass, highpass, compression,
+                  pipelineDepth, pageDuration, fileRotate,
+                  channelMap.get() ? channelMap->getSpec() : "-");
+        if ( shareEncoder( u) ) {
+            continue;
+        }
+        audioOuts[u].fanOut = new FanOutSink( audioOut);
 
         switch ( format ) {
             case IceCast2::mp3:
@@ -602,15 +880,16 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                  stream);
 #else
                 audioOuts[u].encoder = new LameLibEncoder(
-                                             audioOut,
-                                             dsp.get(),
+                                             audioOuts[u].fanOut.get(),
+                                             dsp,
                                              bitrateMode,
                                              bitrate,
                                              quality,
                                              sampleRate,
                                              channel,
                                              lowpass,
-                                             highpass );
+                                             highpass,
+                                             channelMap.get() );
 
 #endif // HAVE_LAME_LIB
                 break;
@@ -625,14 +904,17 @@ DarkIce :: configIceCast2 (  const Config      & config,
 #else
 
                 audioOuts[u].encoder = new VorbisLibEncoder(
-                                               audioOut,
-                                               dsp.get(),
+                                               audioOuts[u].fanOut.get(),
+                                               dsp,
                                                bitrateMode,
                                                bitrate,
                                                quality,
                                                sampleRate,
-                                               dsp->getChannel(),
-                                               maxBitrate);
+                                               inChannel,
+                                               maxBitrate,
+                                               pipelineDepth,
+                                               pageDuration,
+                                               channelMap.get());
 
 #endif // HAVE_VORBIS_LIB
                 break;
@@ -646,14 +928,17 @@ DarkIce :: configIceCast2 (  const Config      & config,
 #else
 
                 audioOuts[u].encoder = new OpusLibEncoder(
-                                               audioOut,
-                                               dsp.get(),
+                                               audioOuts[u].fanOut.get(),
+                                               dsp,
                                                bitrateMode,
                                                bitrate,
                                                quality,
                                                sampleRate,
-                                               dsp->getChannel(),
-                                               maxBitrate);
+                                               inChannel,
+                                               maxBitrate,
+                                               pipelineDepth,
+                                               pageDuration,
+                                               channelMap.get());
 
 #endif // HAVE_OPUS_LIB
                 break;
@@ -667,14 +952,15 @@ DarkIce :: configIceCast2 (  const Config      & config,
 #else
 
                 audioOuts[u].encoder = new FlacLibEncoder(
-                                               audioOut,
-                                               dsp.get(),
+                                               audioOuts[u].fanOut.get(),
+                                               dsp,
                                                bitrateMode,
                                                bitrate,
                                                quality,
                                                sampleRate,
-                                               dsp->getChannel(),
-                                               compression);
+                                               inChannel,
+                                               compression,
+                                               channelMap.get());
 
 #endif // HAVE_FLAC_LIB
                 break;
@@ -687,12 +973,13 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                  stream);
 #else
                 audioOuts[u].encoder = new TwoLameLibEncoder(
-                                                audioOut,
-                                                dsp.get(),
+                                                audioOuts[u].fanOut.get(),
+                                                dsp,
                                                 bitrateMode,
                                                 bitrate,
                                                 sampleRate,
-                                                channel );
+                                                channel,
+                                                channelMap.get() );
 
 #endif // HAVE_TWOLAME_LIB
                 break;
@@ -706,13 +993,15 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                 stream);
 #else
                 audioOuts[u].encoder = new FaacEncoder(
-                                          audioOut,
-                                          dsp.get(),
+                                          audioOuts[u].fanOut.get(),
+                                          dsp,
                                           bitrateMode,
                                           bitrate,
                                           quality,
                                           sampleRate,
-                                          dsp->getChannel());
+                                          inChannel,
+                                          0,
+                                          channelMap.get());
 
 #endif // HAVE_FAAC_LIB
                 break;
@@ -725,13 +1014,15 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                 stream);
 #else
                 audioOuts[u].encoder = new aacPlusEncoder(
-                                             audioOut,
-                                             dsp.get(),
+                                             audioOuts[u].fanOut.get(),
+                                             dsp,
                                              bitrateMode,
                                              bitrate,
                                              quality,
                                              sampleRate,
-                                             channel );
+                                             channel,
+                                             0,
+                                             channelMap.get() );
 
 #endif // HAVE_FDKAAC_LIB
                 break;
@@ -741,10 +1032,12 @@ DarkIce :: configIceCast2 (  const Config      & config,
                                 "Illegal stream format: ", format);
         }
 
-        encConnector->attach( audioOuts[u].encoder.get());
+        audioOuts[u].ixSink = input->encConnector->getNumSinks();
+        input->encConnector->attach( audioOuts[u].encoder.get());
+        input->encConnector->setRotation( audioOuts[u].ixSink, fileRotate);
     }
 
-    noAudioOuts += u;
+    noAudioOuts = u;
 }
 
 
@@ -758,19 +1051,19 @@ DarkIce :: configShoutCast (    const Config      & config,
 {
     // look for Shoutcast encoder output streams,
     // sections [shoutcast-0], [shoutcast-1], ...
-    char            stream[]        = "shoutcast- ";
-    size_t          streamLen       = Util::strLen( stream);
+    char            stream[24];
     unsigned int    u;
 
-    for ( u = noAudioOuts; u < maxOutput; ++u ) {
+    for ( u = noAudioOuts; ; ++u ) {
         const ConfigSection    * cs;
 
-        // ugly hack to change the section name to "stream0", "stream1", etc.
-        stream[streamLen-1] = '0' + (u - noAudioOuts);
+        snprintf( stream, sizeof(stream), "shoutcast-%u", u - noAudioOuts);
 
         if ( !(cs = config.get( stream)) ) {
             break;
         }
+        Util::strCpy( audioOuts[u].name, stream);
+        audioOuts[u].ixInput = findInput( cs, stream);
 
 #ifndef HAVE_LAME_LIB
         throw Exception( __FILE__, __LINE__,
@@ -780,8 +1073,12 @@ DarkIce :: configShoutCast (    const Config      & config,
 #else
 
         const char                * str;
+        Input                     * input           = 0;
+        AudioSource               * dsp             = 0;
 
         unsigned int                sampleRate      = 0;
+        unsigned int                inChannel       = 0;
+        Ref<ChannelMap>             channelMap;
         unsigned int                channel         = 0;
         AudioEncoder::BitrateMode   bitrateMode;
         unsigned int                bitrate         = 0;
@@ -803,13 +1100,21 @@ DarkIce :: configShoutCast (    const Config      & config,
         FileSink                  * localDumpFile   = 0;
         bool                        fileAddDate     = false;
         const char                * fileDateFormat  = 0;
+        unsigned int                fileRotate      = 0;
         AudioEncoder              * encoder         = 0;
         int                         bufferSize      = 0;
 
+        input       = inputs + audioOuts[u].ixInput;
+        dsp         = input->dsp.get();
+
         str         = cs->get( "sampleRate");
         sampleRate  = str ? Util::strToL( str) : dsp->getSampleRate();
+        str         = cs->get( "channelMap");
+        channelMap  = str ? new ChannelMap( str, dsp->getChannel()) : 0;
+        inChannel   = channelMap.get() ? channelMap->getOutChannels()
+                                       : dsp->getChannel();
         str         = cs->get( "channel");
-        channel     = str ? Util::strToL( str) : dsp->getChannel();
+        channel     = str ? Util::strToL( str) : inChannel;
 
         str         = cs->get( "bitrate");
         bitrate     = str ? Util::strToL( str) : 0;
@@ -869,6 +1174,13 @@ DarkIce :: configShoutCast (    const Config      & config,
         str         = cs->get("fileAddDate");
         fileAddDate = str ? (Util::strEq( str, "yes") ? true : false) : false;
         fileDateFormat = cs->get( "fileDateFormat");
+        str         = cs->get( "fileRotate");
+        fileRotate  = str ? Util::strToL( str) * 60 : 0;
+        if ( fileRotate && !fileAddDate ) {
+            throw Exception( __FILE__, __LINE__,
+                             "fileRotate needs fileAddDate in section ",
+                             stream);
+        }
 
         bufferSize = dsp->getBitsPerSample() / 8 * dsp->getSampleRate() * dsp->getChannel() * bufferSecs;
         reportEvent( 3, "buffer size: ", bufferSize);
@@ -893,6 +1205,7 @@ DarkIce :: configShoutCast (    const Config      & config,
 
         // streaming related stuff
         audioOuts[u].socket = new TcpSocket( server, port);
+        audioOuts[u].socket->setNetworkLoop( netLoop.get());
         audioOuts[u].server = new ShoutCast( audioOuts[u].socket.get(),
                                              password,
                                              mountPoint,
@@ -908,21 +1221,25 @@ DarkIce :: configShoutCast (    const Config      & config,
 
 
         encoder = new LameLibEncoder( audioOuts[u].server.get(),
-                                      dsp.get(),
+                                      dsp,
                                       bitrateMode,
                                       bitrate,
                                       quality,
                                       sampleRate,
                                       channel,
                                       lowpass,
-                                      highpass );
-        audioOuts[u].encoder = new BufferedSink(encoder, bufferSize, dsp->getSampleSize());
-
-        encConnector->attach( audioOuts[u].encoder.get());
+                                      highpass,
+                                      channelMap.get() );
+        audioOuts[u].buffer  = new BufferedSink(encoder, bufferSize, dsp->getSampleSize());
+        audioOuts[u].encoder = audioOuts[u].buffer.get();
+
+        audioOuts[u].ixSink = input->encConnector->getNumSinks();
+        input->encConnector->attach( audioOuts[u].encoder.get());
+        input->encConnector->setRotation( audioOuts[u].ixSink, fileRotate);
 #endif // HAVE_LAME_LIB
     }
 
-    noAudioOuts += u;
+    noAudioOuts = u;
 }
 
 
@@ -935,21 +1252,23 @@ DarkIce :: configFileCast (  const Config      & config )
 {
     // look for FileCast encoder output streams,
     // sections [file-0], [file-1], ...
-    char            stream[]        = "file- ";
-    size_t          streamLen       = Util::strLen( stream);
+    char            stream[24];
     unsigned int    u;
 
-    for ( u = noAudioOuts; u < maxOutput; ++u ) {
+    for ( u = noAudioOuts; ; ++u ) {
         const ConfigSection    * cs;
 
-        // ugly hack to change the section name to "stream0", "stream1", etc.
-        stream[streamLen-1] = '0' + (u - noAudioOuts);
+        snprintf( stream, sizeof(stream), "file-%u", u - noAudioOuts);
 
         if ( !(cs = config.get( stream)) ) {
             break;
         }
+        Util::strCpy( audioOuts[u].name, stream);
+        audioOuts[u].ixInput = findInput( cs, stream);
 
         const char                * str;
+        Input                     * input           = 0;
+        AudioSource               * dsp             = 0;
 
         const char                * format          = 0;
         AudioEncoder::BitrateMode   bitrateMode;
@@ -957,10 +1276,16 @@ DarkIce :: configFileCast (  const Config      & config )
         double                      quality         = 0.0;
         const char                * targetFileName  = 0;
         unsigned int                sampleRate      = 0;
+        unsigned int                inChannel       = 0;
+        Ref<ChannelMap>             channelMap;
         int                         lowpass         = 0;
         int                         highpass        = 0;
         bool                        fileAddDate     = false;
         const char                * fileDateFormat  = 0;
+        unsigned int                fileRotate      = 0;
+
+        input       = inputs + audioOuts[u].ixInput;
+        dsp         = input->dsp.get();
 
         format      = cs->getForSure( "format", " missing in section ", stream);
         if ( !Util::strEq( format, "vorbis")
@@ -982,9 +1307,20 @@ DarkIce :: configFileCast (  const Config      & config )
         str         = cs->get( "fileAddDate");
         fileAddDate = str ? (Util::strEq( str, "yes") ? true : false) : false;
         fileDateFormat = cs->get( "fileDateFormat");
+        str         = cs->get( "fileRotate");
+        fileRotate  = str ? Util::strToL( str) * 60 : 0;
+        if ( fileRotate && !fileAddDate ) {
+            throw Exception( __FILE__, __LINE__,
+                             "fileRotate needs fileAddDate in section ",
+                             stream);
+        }
 
         str         = cs->get( "sampleRate");
         sampleRate  = str ? Util::strToL( str) : dsp->getSampleRate();
+        str         = cs->get( "channelMap");
+        channelMap  = str ? new ChannelMap( str, dsp->getChannel()) : 0;
+        inChannel   = channelMap.get() ? channelMap->getOutChannels()
+                                       : dsp->getChannel();
 
         str         = cs->get( "bitrate");
         bitrate     = str ? Util::strToL( str) : 0;
@@ -1063,14 +1399,15 @@ DarkIce :: configFileCast (  const Config      & config )
 #else
                 audioOuts[u].encoder = new LameLibEncoder(
                                                     audioOuts[u].server.get(),
-                                                    dsp.get(),
+                                                    dsp,
                                                     bitrateMode,
                                                     bitrate,
                                                     quality,
                                                     sampleRate,
-                                                    dsp->getChannel(),
+                                                    inChannel,
                                                     lowpass,
-                                                    highpass );
+                                                    highpass,
+                                                    channelMap.get() );
 #endif // HAVE_TWOLAME_LIB
         } else if ( Util::strEq( format, "mp2") ) {
 #ifndef HAVE_TWOLAME_LIB
@@ -1081,11 +1418,12 @@ DarkIce :: configFileCast (  const Config      & config )
 #else
                 audioOuts[u].encoder = new TwoLameLibEncoder(
                                                     audioOuts[u].server.get(),
-                                                    dsp.get(),
+                                                    dsp,
                                                     bitrateMode,
                                                     bitrate,
                                                     sampleRate,
-                                                    dsp->getChannel() );
+                                                    inChannel,
+                                                    channelMap.get() );
 #endif // HAVE_TWOLAME_LIB
         } else if ( Util::strEq( format, "vorbis") ) {
 #ifndef HAVE_VORBIS_LIB
@@ -1094,14 +1432,26 @@ DarkIce :: configFileCast (  const Config      & config )
                                 "thus can't Ogg Vorbis stream: ",
                                 stream);
 #else
+                unsigned int    pipelineDepth;
+                unsigned int    pageDuration;
+
+                str           = cs->get( "encoderPipeline");
+                pipelineDepth = str ? Util::strToL( str) : 0;
+                str           = cs->get( "oggPageDuration");
+                pageDuration  = str ? Util::strToL( str) : 0;
+
                 audioOuts[u].encoder = new VorbisLibEncoder(
                                                     audioOuts[u].server.get(),
-                                                    dsp.get(),
+                                                    dsp,
                                                     bitrateMode,
                                                     bitrate,
                                                     quality,
                                                     dsp->getSampleRate(),
-                                                    dsp->getChannel() );
+                                                    inChannel,
+                                                    0,
+                                                    pipelineDepth,
+                                                    pageDuration,
+                                                    channelMap.get() );
 #endif // HAVE_VORBIS_LIB
         } else if ( Util::strEq( format, "opus") ) {
 #ifndef HAVE_OPUS_LIB
@@ -1110,14 +1460,26 @@ DarkIce :: configFileCast (  const Config      & config )
                                 "thus can't Ogg Opus stream: ",
                                 stream);
 #else
+                unsigned int    pipelineDepth;
+                unsigned int    pageDuration;
+
+                str           = cs->get( "encoderPipeline");
+                pipelineDepth = str ? Util::strToL( str) : 0;
+                str           = cs->get( "oggPageDuration");
+                pageDuration  = str ? Util::strToL( str) : 0;
+
                 audioOuts[u].encoder = new OpusLibEncoder(
                                                     audioOuts[u].server.get(),
-                                                    dsp.get(),
+                                                    dsp,
                                                     bitrateMode,
                                                     bitrate,
                                                     quality,
                                                     dsp->getSampleRate(),
-                                                    dsp->getChannel() );
+                                                    inChannel,
+                                                    0,
+                                                    pipelineDepth,
+                                                    pageDuration,
+                                                    channelMap.get() );
 #endif // HAVE_OPUS_LIB
         } else if ( Util::strEq( format, "aac") ) {
 #ifndef HAVE_FAAC_LIB
@@ -1128,12 +1490,14 @@ DarkIce :: configFileCast (  const Config      & config )
 #else
                 audioOuts[u].encoder = new FaacEncoder(
                                                 audioOuts[u].server.get(),
-                                                dsp.get(),
+                                                dsp,
                                                 bitrateMode,
                                                 bitrate,
                                                 quality,
                                                 sampleRate,
-                                                dsp->getChannel());
+                                                inChannel,
+                                                0,
+                                                channelMap.get());
 #endif // HAVE_FAAC_LIB
         } else if ( Util::strEq( format, "aacp") ) {
 #ifndef HAVE_FDKAAC_LIB
@@ -1144,22 +1508,26 @@ DarkIce :: configFileCast (  const Config      & config )
 #else
                 audioOuts[u].encoder = new aacPlusEncoder(
                                                 audioOuts[u].server.get(),
-                                                dsp.get(),
+                                                dsp,
                                                 bitrateMode,
                                                 bitrate,
                                                 quality,
                                                 sampleRate,
-                                                dsp->getChannel());
+                                                inChannel,
+                                                0,
+                                                channelMap.get());
 #endif // HAVE_FDKAAC_LIB
         } else {
                 throw Exception( __FILE__, __LINE__,
                                 "Illegal stream format: ", format);
         }
 
-        encConnector->attach( audioOuts[u].encoder.get());
+        audioOuts[u].ixSink = input->encConnector->getNumSinks();
+        input->encConnector->attach( audioOuts[u].encoder.get());
+        input->encConnector->setRotation( audioOuts[u].ixSink, fileRotate);
     }
 
-    noAudioOuts += u;
+    noAudioOuts = u;
 }
 
 
@@ -1251,26 +1619,179 @@ DarkIce :: setOriginalScheduling ( void )
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Share the encoder threads among the inputs
+ *----------------------------------------------------------------------------*/
+void
+DarkIce :: shareEncoderThreads ( void )
+{
+    long            online   = sysconf( _SC_NPROCESSORS_ONLN);
+    unsigned int    threads  = encoderThreads;
+    unsigned int    sinks    = 0;
+    unsigned int    firstCpu = 0;
+    unsigned int    i;
+
+    // a single input has all of them, as many as asked for
+    if ( noInputs == 1 ) {
+        return;
+    }
+
+    if ( !threads ) {
+        threads = online > 0 ? online : 1;
+    }
+    for ( i = 0; i < noInputs; ++i ) {
+        sinks += inputs[i].encConnector->getNumSinks();
+    }
+    if ( !sinks ) {
+        return;
+    }
+
+    for ( i = 0; i < noInputs; ++i ) {
+        unsigned int    n = inputs[i].encConnector->getNumSinks();
+        unsigned int    share;
+
+        if ( !n ) {
+            continue;
+        }
+        share = threads * n / sinks;
+        share = share ? share : 1;
+        inputs[i].encConnector->setWorkers( share, firstCpu);
+        firstCpu += share;
+
+        reportEvent( 3, "encoder threads for", inputs[i].name, share);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Transfer the audio of an input to its outputs
+ *----------------------------------------------------------------------------*/
+unsigned long
+DarkIce :: transfer (   Input             * input )
+{
+    AudioSource      * dsp = input->dsp.get();
+    unsigned long      bytes;
+    unsigned int       period;
+    unsigned int       chunk;
+    unsigned int       maxChunk;
+    unsigned int       align;
+
+    bytes = dsp->getSampleRate() * dsp->getSampleSize() * duration;
+
+    // read in whole periods of the device, or in even parts of one,
+    // so that each read is served by what the device delivers at once
+    period = dsp->getPeriodSize();
+    chunk  = (unsigned int) (chunkMsecs * dsp->getSampleRate() / 1000.0);
+    chunk  = chunk ? chunk : 1;
+    if ( !period ) {
+        align = 1;
+    } else if ( chunk >= period ) {
+        align = period;
+        chunk = (chunk + period / 2) / period * period;
+    } else {
+        chunk = period / ((period + chunk / 2) / chunk);
+        align = chunk;
+    }
+    maxChunk = (unsigned int) (chunkMaxMsecs * dsp->getSampleRate() / 1000.0);
+    maxChunk = maxChunk / align * align;
+    maxChunk = maxChunk > chunk ? maxChunk : chunk;
+
+    reportEvent( 3, "chunk size, samples: ", chunk, ", at most: ", maxChunk);
+
+    return input->encConnector->transfer( bytes,
+                                          chunk * dsp->getSampleSize(),
+                                          maxChunk * dsp->getSampleSize(),
+                                          align * dsp->getSampleSize(),
+                                          1,
+                                          0 );
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The thread function of the inputs beyond the first one
+ *----------------------------------------------------------------------------*/
+void *
+DarkIce :: inputThread ( void             * param )
+{
+    Input     * input = (Input *) param;
+
+    try {
+        input->bytes = input->darkIce->transfer( input);
+    } catch ( Exception   & e ) {
+        // the other inputs go on without this one
+        input->darkIce->reportEvent( 1, input->name, "stopped:",
+                                     e.getDescription());
+    }
+
+    return 0;
+}
+
+
 /*------------------------------------------------------------------------------
  *  Run the encoder
  *----------------------------------------------------------------------------*/
 bool
 DarkIce :: encode ( void )                          
 {
-    unsigned int       len;
-    unsigned long      bytes;
+    unsigned int       i;
+    unsigned int       opened;
+    unsigned int       started;
 
-    if ( !encConnector->open() ) {
-        throw Exception( __FILE__, __LINE__, "can't open connector");
+    // the connections are handed over to the loop as they open
+    netLoop->start();
+
+    shareEncoderThreads();
+    for ( opened = 0; opened < noInputs; ++opened ) {
+        if ( !inputs[opened].encConnector->open() ) {
+            break;
+        }
+    }
+    if ( opened < noInputs ) {
+        for ( i = 0; i < opened; ++i ) {
+            inputs[i].encConnector->close();
+        }
+        netLoop->stop();
+        throw Exception( __FILE__, __LINE__, "can't open connector",
+                         inputs[opened].name);
     }
 
-    bytes = dsp->getSampleRate() * dsp->getSampleSize() * duration;
+    if ( metricsServer.get() ) {
+        try {
+            metricsServer->start();
+        } catch ( Exception   & e ) {
+            // streaming goes on without the metrics
+            reportEvent( 1, "can't serve metrics:", e.getDescription());
+        }
+    }
 
-    len = encConnector->transfer( bytes, 4096, 1, 0 );
+    // the first input is transferred by this thread, the others by a
+    // thread each, which inherits the real-time scheduling of this one
+    for ( started = 1; started < noInputs; ++started ) {
+        if ( pthread_create( &inputs[started].thread, 0, inputThread,
+                             inputs + started) ) {
+            reportEvent( 1, "can't start the thread of", inputs[started].name);
+            break;
+        }
+    }
 
-    reportEvent( 1, len, "bytes transferred to the encoders");
+    inputs[0].bytes = transfer( inputs);
 
-    encConnector->close();
+    for ( i = 1; i < started; ++i ) {
+        pthread_join( inputs[i].thread, 0);
+    }
+
+    for ( i = 0; i < noInputs; ++i ) {
+        reportEvent( 1, inputs[i].bytes, "bytes transferred to the encoders",
+                        "of", inputs[i].name);
+    }
+
+    if ( metricsServer.get() ) {
+        metricsServer->stop();
+    }
+    for ( i = 0; i < noInputs; ++i ) {
+        inputs[i].encConnector->close();
+    }
+    netLoop->stop();
 
     return true;
 }
@@ -1305,7 +1826,174 @@ DarkIce :: cut ( void )                             throw ()
 {
     reportEvent( 5, "cutting");
 
-    encConnector->cut();
+    for ( unsigned int i = 0; i < noInputs; ++i ) {
+        inputs[i].encConnector->cut();
+    }
 
     reportEvent( 5, "cutting ends");
 }
+
+
+/*------------------------------------------------------------------------------
+ *  Append the current metrics
+ *----------------------------------------------------------------------------*/
+void
+DarkIce :: writeMetrics ( std::string     & out )
+{
+    std::vector<std::string>    labels( noAudioOuts);
+    std::vector<std::string>    inputLabels( noInputs);
+    unsigned int                u;
+    unsigned int                i;
+
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        labels[u]  = "stream=\"";
+        labels[u] += audioOuts[u].name;
+        labels[u] += "\"";
+    }
+    for ( i = 0; i < noInputs; ++i ) {
+        inputLabels[i]  = "input=\"";
+        inputLabels[i] += inputs[i].name;
+        inputLabels[i] += "\"";
+    }
+
+    MetricsServer::appendHelp( out, "darkice_capture_xruns_total", "counter",
+                        "Overruns of the audio input, losing audio.");
+    for ( i = 0; i < noInputs; ++i ) {
+        MetricsServer::appendValue( out, "darkice_capture_xruns_total",
+                                    inputLabels[i].c_str(),
+                                    inputs[i].dsp->getXruns());
+    }
+
+    MetricsServer::appendHelp( out, "darkice_capture_wait_seconds", "summary",
+                        "Time spent waiting for each chunk of audio input.");
+    for ( i = 0; i < noInputs; ++i ) {
+        MetricsServer::appendSummary( out, "darkice_capture_wait_seconds",
+                                      inputLabels[i].c_str(),
+                                      inputs[i].encConnector->getReadTime());
+    }
+
+    MetricsServer::appendHelp( out, "darkice_encoder_threads", "gauge",
+                        "Threads encoding the outputs.");
+    for ( i = 0; i < noInputs; ++i ) {
+        MetricsServer::appendValue( out, "darkice_encoder_threads",
+                                    inputLabels[i].c_str(),
+                                    inputs[i].encConnector->getNumWorkers());
+    }
+
+    MetricsServer::appendHelp( out, "darkice_encode_seconds", "summary",
+                        "Time spent encoding and sending each chunk.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        const TimeSummary     * writeTime =
+                            inputs[audioOuts[u].ixInput].encConnector
+                                        ->getWriteTime( audioOuts[u].ixSink);
+
+        if ( writeTime ) {
+            MetricsServer::appendSummary( out, "darkice_encode_seconds",
+                                          labels[u].c_str(), *writeTime);
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_encoder_lag_chunks", "gauge",
+                        "Chunks of audio captured but not yet encoded.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        MetricsServer::appendValue( out, "darkice_encoder_lag_chunks",
+                                    labels[u].c_str(),
+                                    inputs[audioOuts[u].ixInput]
+                                        .encConnector->getLag(
+                                                    audioOuts[u].ixSink));
+    }
+
+    MetricsServer::appendHelp( out, "darkice_encoder_overruns_total",
+                        "counter",
+                        "Chunks of audio skipped by a slow encoder.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        MetricsServer::appendValue( out, "darkice_encoder_overruns_total",
+                                    labels[u].c_str(),
+                                    inputs[audioOuts[u].ixInput]
+                                        .encConnector->getOverruns(
+                                                    audioOuts[u].ixSink));
+    }
+
+    MetricsServer::appendHelp( out, "darkice_reconnects_total", "counter",
+                        "Attempts to reconnect to the server.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        MetricsServer::appendValue( out, "darkice_reconnects_total",
+                                    labels[u].c_str(),
+                                    inputs[audioOuts[u].ixInput]
+                                        .encConnector->getReconnects(
+                                                    audioOuts[u].ixSink));
+    }
+
+    MetricsServer::appendHelp( out, "darkice_buffer_fill_bytes", "gauge",
+                        "Bytes waiting in the output buffer.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].buffer.get() ) {
+            MetricsServer::appendValue( out, "darkice_buffer_fill_bytes",
+                                        labels[u].c_str(),
+                                        audioOuts[u].buffer->getFill());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_buffer_peak_bytes", "gauge",
+                        "Highest recent usage of the output buffer.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].buffer.get() ) {
+            MetricsServer::appendValue( out, "darkice_buffer_peak_bytes",
+                                        labels[u].c_str(),
+                                        audioOuts[u].buffer->getPeak());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_buffer_size_bytes", "gauge",
+                        "Size of the output buffer.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].buffer.get() ) {
+            MetricsServer::appendValue( out, "darkice_buffer_size_bytes",
+                                        labels[u].c_str(),
+                                        audioOuts[u].buffer->getSize());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_buffer_queued_seconds", "gauge",
+                        "Age of the oldest data in the output buffer.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].buffer.get() ) {
+            MetricsServer::appendValue( out, "darkice_buffer_queued_seconds",
+                                        labels[u].c_str(),
+                                        audioOuts[u].buffer->getQueuedTime());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_buffer_dropped_bytes_total",
+                        "counter",
+                        "Bytes dropped from the output buffer, as too late.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].buffer.get() ) {
+            MetricsServer::appendValue( out,
+                                        "darkice_buffer_dropped_bytes_total",
+                                        labels[u].c_str(),
+                                        audioOuts[u].buffer->getDropped());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_sent_bytes_total", "counter",
+                        "Bytes sent to the server.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].socket.get() ) {
+            MetricsServer::appendValue( out, "darkice_sent_bytes_total",
+                                        labels[u].c_str(),
+                                        audioOuts[u].socket->getBytesSent());
+        }
+    }
+
+    MetricsServer::appendHelp( out, "darkice_send_queue_bytes", "gauge",
+                        "Bytes waiting to be sent to the server.");
+    for ( u = 0; u < noAudioOuts; ++u ) {
+        if ( audioOuts[u].socket.get() ) {
+            MetricsServer::appendValue( out, "darkice_send_queue_bytes",
+                                        labels[u].c_str(),
+                                        audioOuts[u].socket->getQueued());
+        }
+    }
+}
+
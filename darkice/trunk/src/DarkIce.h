@@ -54,11 +54,15 @@
 #include "Ref.h"
 #include "AudioSource.h"
 #include "BufferedSink.h"
+#include "FanOutSink.h"
 #include "Connector.h"
+#include "MultiThreadedConnector.h"
 #include "AudioEncoder.h"
 #include "TcpSocket.h"
+#include "NetworkLoop.h"
 #include "CastSink.h"
 #include "DarkIceConfig.h"
+#include "MetricsServer.h"
 
 
 /* ================================================================ constants */
@@ -75,16 +79,25 @@
  *  @author  $Author$
  *  @version $Revision$
  */
-class DarkIce : public virtual Referable, public virtual Reporter
+class DarkIce : public virtual Referable,
+                public virtual Reporter,
+                public MetricsSource
 {
     private:
 
         /**
-         *  The maximum number of supported outputs. This should be
-         *  <supported output types> * <outputs per type>
+         *  Type describing each input, with the connector feeding
+         *  the outputs that take their audio from it.
          */
-        static const unsigned int       maxOutput = 4 * 7;
-        
+        typedef struct {
+            Ref<AudioSource>            dsp;
+            Ref<MultiThreadedConnector> encConnector;
+            DarkIce                   * darkIce;
+            pthread_t                   thread;
+            unsigned long               bytes;
+            char                        name[24];
+        } Input;
+
         /**
          *  Type describing each lame library output.
          */
@@ -92,12 +105,19 @@ class DarkIce : public virtual Referable, public virtual Reporter
             Ref<Sink>               encoder;
             Ref<TcpSocket>          socket;
             Ref<CastSink>           server;
+            Ref<BufferedSink>       buffer;
+            Ref<FanOutSink>         fanOut;
+            unsigned int            ixInput;
+            unsigned int            ixSink;
+            char                    name[24];
+            char                    encoderKey[192];
         } Output;
 
         /**
-         *  The outputs.
+         *  The outputs, as many as there are output sections in the
+         *  config file.
          */
-        Output                  audioOuts[maxOutput];
+        Output                * audioOuts;
 
         /**
          *  Number of lame library outputs.
@@ -110,14 +130,47 @@ class DarkIce : public virtual Referable, public virtual Reporter
         unsigned int            duration;
 
         /**
-         *  The dsp to record from.
+         *  Duration of the chunks read from the dsp, in milliseconds.
+         */
+        double                  chunkMsecs;
+
+        /**
+         *  Duration of the largest chunks read from the dsp, while the
+         *  encoders fall behind, in milliseconds.
+         */
+        double                  chunkMaxMsecs;
+
+        /**
+         *  The inputs, as many as there are input sections in the
+         *  config file.
+         */
+        Input                 * inputs;
+
+        /**
+         *  Number of inputs.
+         */
+        unsigned int            noInputs;
+
+        /**
+         *  The number of threads encoding the outputs of all the
+         *  inputs, 0 for one for each CPU.
+         */
+        unsigned int            encoderThreads;
+
+        /**
+         *  Pin each thread encoding the outputs to a CPU of its own.
+         */
+        bool                    pinEncoders;
+
+        /**
+         *  The loop sending the data of all the streams.
          */
-        Ref<AudioSource>        dsp;
+        Ref<NetworkLoop>        netLoop;
 
         /**
-         *  The encoding Connector, connecting the dsp to the encoders.
+         *  The server for the metrics, if enabled.
          */
-        Ref<Connector>          encConnector;
+        Ref<MetricsServer>      metricsServer;
 
         /**
          *  Should we turn real-time scheduling on ?
@@ -149,6 +202,61 @@ class DarkIce : public virtual Referable, public virtual Reporter
         void
         init (  const Config   & config )            ;
 
+        /**
+         *  Create an input from its section of the config file.
+         *  Called from init()
+         *
+         *  @param cs the section of the input.
+         *  @param name the name of the section.
+         *  @param bufferSecs number of seconds to buffer audio for
+         *  @param reconnect try to reconnect the outputs of the input,
+         *                   if they are dropped by the other end.
+         *  @exception Exception
+         */
+        void
+        configInput (   const ConfigSection    * cs,
+                        const char             * name,
+                        unsigned int             bufferSecs,
+                        bool                     reconnect )    ;
+
+        /**
+         *  Find the input an output takes its audio from, by the
+         *  input key of its section, the first input by default.
+         *
+         *  @param cs the section of the output.
+         *  @param stream the name of the output, for the errors.
+         *  @return the index of the input.
+         *  @exception Exception if there is no such input.
+         */
+        unsigned int
+        findInput (     const ConfigSection    * cs,
+                        const char             * stream )       ;
+
+        /**
+         *  Count the consecutive sections of an output type in the
+         *  config file, like [icecast2-0], [icecast2-1], ...
+         *
+         *  @param config the config Object to look into.
+         *  @param prefix the name of the sections, up to the number.
+         *  @return the number of sections found.
+         */
+        static unsigned int
+        countSections ( const Config   & config,
+                        const char     * prefix )    ;
+
+        /**
+         *  Make an output share the encoder of an earlier output with
+         *  the same encoder settings, if there is one. The data
+         *  encoded is then written to the buffers of both outputs.
+         *
+         *  @param u the index of the output, with its encoderKey
+         *           and buffer already set.
+         *  @return true if an encoder is shared, false if the output
+         *          needs an encoder of its own.
+         */
+        bool
+        shareEncoder (  unsigned int    u )          ;
+
         /**
          *  Look for the icecast stream outputs from the config file.
          *  Called from init()
@@ -228,6 +336,35 @@ class DarkIce : public virtual Referable, public virtual Reporter
         bool
         encode ( void )                             ;
 
+        /**
+         *  Share the threads encoding the outputs among the inputs,
+         *  in proportion to their outputs, each on CPUs of its own.
+         */
+        void
+        shareEncoderThreads ( void )                ;
+
+        /**
+         *  Transfer the audio of an input to its outputs, in chunks
+         *  sized by the periods of its dsp, until the duration of
+         *  playing is over.
+         *
+         *  @param input the input to transfer.
+         *  @return the number of bytes transferred.
+         *  @exception Exception
+         */
+        unsigned long
+        transfer ( Input              * input )     ;
+
+        /**
+         *  The thread function of the inputs beyond the first one,
+         *  transferring the audio of an input.
+         *
+         *  @param param the Input to transfer.
+         *  @return nothing
+         */
+        static void *
+        inputThread ( void            * param )     ;
+
         /**
          *  Start shouting. fork()-s a process for each output, reads
          *  the output of the encoders and sends them to an IceCast server.
@@ -276,6 +413,10 @@ class DarkIce : public virtual Referable, public virtual Reporter
         inline virtual
         ~DarkIce ( void )                           
         {
+            // the metrics server looks at the outputs until stopped
+            metricsServer = 0;
+            delete[] audioOuts;
+            delete[] inputs;
         }
 
 /* TODO
@@ -310,6 +451,15 @@ class DarkIce : public virtual Referable, public virtual Reporter
         virtual void
         cut ( void )                                throw ();
 
+        /**
+         *  Append the current metrics of the capture, the encoders and
+         *  the streams to a text.
+         *
+         *  @param out the text to append the metrics to.
+         */
+        virtual void
+        writeMetrics ( std::string    & out );
+
 };
 
 
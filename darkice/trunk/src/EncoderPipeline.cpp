@@ -0,0 +1,376 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : EncoderPipeline.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#else
+#error need signal.h
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#else
+#error need sched.h
+#endif
+
+
+#include "Exception.h"
+#include "EncoderPipeline.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The most encoded packets to queue for each block of samples
+ *----------------------------------------------------------------------------*/
+static const unsigned int packetsPerBlock = 4;
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: init (   PipelinedEncoder  * encoder,
+                            unsigned int        depth )
+{
+    if ( !encoder ) {
+        throw Exception( __FILE__, __LINE__, "no encoder");
+    }
+    if ( !depth ) {
+        throw Exception( __FILE__, __LINE__, "no room for the samples");
+    }
+
+    this->encoder  = encoder;
+    this->thread   = 0;
+    this->running  = false;
+    this->stopping = false;
+    this->failed   = false;
+
+    input.blocks   = new Block[depth];
+    input.size     = depth;
+    input.first    = 0;
+    input.count    = 0;
+
+    output.blocks  = new Block[depth * packetsPerBlock];
+    output.size    = depth * packetsPerBlock;
+    output.first   = 0;
+    output.count   = 0;
+
+    // one more block in the hands of each thread
+    inputPool      = new PacketPool( input.size + 2);
+    outputPool     = new PacketPool( output.size + 2);
+
+    pthread_mutex_init( &mutex, 0);
+    pthread_cond_init( &cond, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: strip ( void )
+{
+    stop();
+
+    delete[] input.blocks;
+    delete[] output.blocks;
+    delete inputPool;
+    delete outputPool;
+
+    pthread_cond_destroy( &cond);
+    pthread_mutex_destroy( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start the encoding thread
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: start ( void )
+{
+    pthread_attr_t      attr;
+    struct sched_param  param;
+
+    if ( running ) {
+        return;
+    }
+
+    stopping = false;
+    failed   = false;
+
+    // encoding is no job for a real-time thread
+    pthread_attr_init( &attr);
+    pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam( &attr, &param);
+
+    if ( pthread_create( &thread, &attr, threadFunction, this) ) {
+        pthread_attr_destroy( &attr);
+        throw Exception( __FILE__, __LINE__, "can't create encoder thread");
+    }
+    pthread_attr_destroy( &attr);
+
+    running = true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Stop the encoding thread
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: stop ( void )
+{
+    if ( !running ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex);
+    stopping = true;
+    pthread_cond_broadcast( &cond);
+    pthread_mutex_unlock( &mutex);
+
+    pthread_join( thread, 0);
+    running = false;
+
+    // let go of the blocks left over
+    while ( input.count ) {
+        input.blocks[input.first].packet = 0;
+        input.first = (input.first + 1) % input.size;
+        --input.count;
+    }
+    while ( output.count ) {
+        output.blocks[output.first].packet = 0;
+        output.first = (output.first + 1) % output.size;
+        --output.count;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Throw the error of the encoding thread
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: checkError ( void )
+{
+    if ( failed ) {
+        Exception   e( error);
+
+        pthread_mutex_unlock( &mutex);
+        throw e;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Queue a block of samples for the codec
+ *----------------------------------------------------------------------------*/
+bool
+EncoderPipeline :: push (   Packet    * samples )
+{
+    Block     * block;
+
+    if ( !running ) {
+        throw Exception( __FILE__, __LINE__, "encoder thread not running");
+    }
+
+    pthread_mutex_lock( &mutex);
+    while ( input.count == input.size && !output.count && !failed ) {
+        pthread_cond_wait( &cond, &mutex);
+    }
+    checkError();
+
+    if ( input.count == input.size ) {
+        pthread_mutex_unlock( &mutex);
+        return false;
+    }
+
+    block = &input.blocks[(input.first + input.count) % input.size];
+    block->packet          = samples;
+    block->granulePosition = 0;
+    block->packetNumber    = 0;
+    block->endOfStream     = samples == 0;
+    ++input.count;
+
+    pthread_cond_broadcast( &cond);
+    pthread_mutex_unlock( &mutex);
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the next encoded packet
+ *----------------------------------------------------------------------------*/
+bool
+EncoderPipeline :: pop (    Block     & block,
+                            bool        wait )
+{
+    if ( !running ) {
+        throw Exception( __FILE__, __LINE__, "encoder thread not running");
+    }
+
+    pthread_mutex_lock( &mutex);
+    while ( wait && !output.count && !failed ) {
+        pthread_cond_wait( &cond, &mutex);
+    }
+    if ( !output.count ) {
+        checkError();
+        pthread_mutex_unlock( &mutex);
+        return false;
+    }
+
+    block = output.blocks[output.first];
+    output.blocks[output.first].packet = 0;
+    output.first = (output.first + 1) % output.size;
+    --output.count;
+
+    pthread_cond_broadcast( &cond);
+    pthread_mutex_unlock( &mutex);
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Hand back an encoded packet
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: emit (   Packet    * packet,
+                            long long   granulePosition,
+                            long long   packetNumber,
+                            bool        endOfStream )
+{
+    Block     * block;
+
+    pthread_mutex_lock( &mutex);
+    while ( output.count == output.size && !stopping ) {
+        pthread_cond_wait( &cond, &mutex);
+    }
+    if ( stopping ) {
+        pthread_mutex_unlock( &mutex);
+        return;
+    }
+
+    block = &output.blocks[(output.first + output.count) % output.size];
+    block->packet          = packet;
+    block->granulePosition = granulePosition;
+    block->packetNumber    = packetNumber;
+    block->endOfStream     = endOfStream;
+    ++output.count;
+
+    pthread_cond_broadcast( &cond);
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Encode the queued blocks
+ *----------------------------------------------------------------------------*/
+void
+EncoderPipeline :: run ( void )
+{
+    for (;;) {
+        Ref<Packet>     samples;
+
+        pthread_mutex_lock( &mutex);
+        while ( !input.count && !stopping ) {
+            pthread_cond_wait( &cond, &mutex);
+        }
+        if ( stopping ) {
+            pthread_mutex_unlock( &mutex);
+            break;
+        }
+
+        samples = input.blocks[input.first].packet;
+        input.blocks[input.first].packet = 0;
+        input.first = (input.first + 1) % input.size;
+        --input.count;
+
+        pthread_cond_broadcast( &cond);
+        pthread_mutex_unlock( &mutex);
+
+        try {
+            encoder->encodeBlock( samples.get());
+        } catch ( Exception   & e ) {
+            pthread_mutex_lock( &mutex);
+            failed = true;
+            error  = e;
+            pthread_cond_broadcast( &cond);
+            pthread_mutex_unlock( &mutex);
+            break;
+        }
+
+        // tell the caller that all of the stream has been encoded
+        if ( !samples.get() ) {
+            emit( 0, 0, 0, true);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The thread function
+ *----------------------------------------------------------------------------*/
+void *
+EncoderPipeline :: threadFunction ( void      * param )
+{
+    EncoderPipeline   * pipeline = (EncoderPipeline *) param;
+    sigset_t            sigset;
+
+    // SIGUSR1 is for the main thread, to cut the recordings
+    sigemptyset( &sigset);
+    sigaddset( &sigset, SIGUSR1);
+    pthread_sigmask( SIG_BLOCK, &sigset, 0);
+
+    pipeline->run();
+
+    return 0;
+}
+
@@ -0,0 +1,465 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : EncoderPipeline.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef ENCODER_PIPELINE_H
+#define ENCODER_PIPELINE_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+#include "Referable.h"
+#include "Ref.h"
+#include "Exception.h"
+#include "Packet.h"
+#include "PacketPool.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+class EncoderPipeline;
+
+/**
+ *  An encoder that can run its codec on the thread of an EncoderPipeline.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class PipelinedEncoder
+{
+    friend class EncoderPipeline;
+
+    protected:
+
+        /**
+         *  Encode a block of samples, on the thread of the pipeline.
+         *  The encoded packets are to be handed back by
+         *  EncoderPipeline::emit().
+         *
+         *  @param samples the samples to encode, or NULL to encode
+         *                 the end of the stream.
+         *  @exception Exception
+         */
+        virtual void
+        encodeBlock (   const Packet      * samples )           = 0;
+
+
+    public:
+
+        /**
+         *  Destructor.
+         */
+        inline virtual
+        ~PipelinedEncoder ( void )
+        {
+        }
+};
+
+
+/**
+ *  Runs the codec of an encoder on a thread of its own, so that encoding
+ *  a stream overlaps with the conversion and resampling of the input,
+ *  and the Ogg muxing and writing of the output, done by the thread
+ *  calling the encoder.
+ *
+ *  The samples and the encoded packets are passed between the threads
+ *  in bounded queues, in the same order as they are produced, so the
+ *  output is the same as when encoding on a single thread. When the
+ *  input queue is full, the writer waits for the codec, just as it would
+ *  when encoding itself.
+ *
+ *  sample usage:
+ *
+ *  <pre>
+ *  EncoderPipeline::Block  block;
+ *
+ *  while ( !pipeline->push( samples) ) {
+ *      while ( pipeline->pop( block, false) ) {
+ *          mux( block);
+ *      }
+ *  }
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class EncoderPipeline : public virtual Referable
+{
+    public:
+
+        /**
+         *  A block of samples, or an encoded packet with the Ogg fields
+         *  the codec set for it. A block without a packet marks the
+         *  end of the stream.
+         */
+        struct Block {
+            /**
+             *  The samples or the encoded data.
+             */
+            Ref<Packet>     packet;
+
+            /**
+             *  The granule position of the encoded packet.
+             */
+            long long       granulePosition;
+
+            /**
+             *  The number of the encoded packet in the stream.
+             */
+            long long       packetNumber;
+
+            /**
+             *  Tells if the packet is the last one of the stream.
+             */
+            bool            endOfStream;
+        };
+
+
+    private:
+
+        /**
+         *  A bounded queue of blocks.
+         */
+        struct Queue {
+            /**
+             *  The blocks, a ring buffer.
+             */
+            Block         * blocks;
+
+            /**
+             *  The number of blocks the queue can hold.
+             */
+            unsigned int    size;
+
+            /**
+             *  The index of the first block in the queue.
+             */
+            unsigned int    first;
+
+            /**
+             *  The number of blocks in the queue.
+             */
+            unsigned int    count;
+        };
+
+        /**
+         *  The encoder running its codec on the thread.
+         */
+        PipelinedEncoder      * encoder;
+
+        /**
+         *  The samples waiting to be encoded.
+         */
+        Queue                   input;
+
+        /**
+         *  The encoded packets waiting to be muxed.
+         */
+        Queue                   output;
+
+        /**
+         *  The packets the blocks of samples are pushed in,
+         *  as many as can be queued or in use.
+         */
+        PacketPool            * inputPool;
+
+        /**
+         *  The packets the encoded data is emitted in,
+         *  as many as can be queued or in use.
+         */
+        PacketPool            * outputPool;
+
+        /**
+         *  The encoding thread.
+         */
+        pthread_t               thread;
+
+        /**
+         *  Tells if the thread is running, and has not been joined yet.
+         */
+        bool                    running;
+
+        /**
+         *  Tells if the thread is to stop.
+         */
+        bool                    stopping;
+
+        /**
+         *  Tells if encoding failed on the thread.
+         */
+        bool                    failed;
+
+        /**
+         *  The reason encoding failed.
+         */
+        Exception               error;
+
+        /**
+         *  The mutex protecting the queues and the flags.
+         */
+        pthread_mutex_t         mutex;
+
+        /**
+         *  Signalled when a queue or a flag changes.
+         */
+        pthread_cond_t          cond;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param encoder the encoder to run the codec of.
+         *  @param depth the number of blocks of samples to queue.
+         *  @exception Exception
+         */
+        void
+        init (  PipelinedEncoder  * encoder,
+                unsigned int        depth );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Encode the queued blocks, until stopped.
+         */
+        void
+        run ( void );
+
+        /**
+         *  Throw the error of the encoding thread, if it failed.
+         *  Call with the mutex held.
+         *
+         *  @exception Exception
+         */
+        void
+        checkError ( void );
+
+        /**
+         *  The thread function.
+         *
+         *  @param param the EncoderPipeline to run.
+         *  @return nothing.
+         */
+        static void *
+        threadFunction ( void     * param );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        EncoderPipeline ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception.
+         *
+         *  @param pipeline the object to copy.
+         *  @exception Exception
+         */
+        inline
+        EncoderPipeline ( const EncoderPipeline   & pipeline )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param pipeline the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline EncoderPipeline &
+        operator= ( const EncoderPipeline & pipeline )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param encoder the encoder to run the codec of.
+         *  @param depth the number of blocks of samples to queue
+         *               for the codec.
+         *  @exception Exception
+         */
+        inline
+        EncoderPipeline (   PipelinedEncoder  * encoder,
+                            unsigned int        depth )
+        {
+            init( encoder, depth);
+        }
+
+        /**
+         *  Destructor. Stops the thread, if running.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~EncoderPipeline ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Start the encoding thread.
+         *
+         *  @exception Exception
+         */
+        void
+        start ( void );
+
+        /**
+         *  Stop the encoding thread, dropping whatever is still queued.
+         */
+        void
+        stop ( void );
+
+        /**
+         *  Queue a block of samples for the codec. Waits while the input
+         *  queue is full, unless there are encoded packets to pop, so that
+         *  the codec never waits for the caller, and the other way round.
+         *
+         *  @param samples the samples to encode, or NULL to encode the
+         *                 end of the stream.
+         *  @return true if the block was queued, false if it was not,
+         *          and encoded packets are to be popped first.
+         *  @exception Exception if encoding failed on the thread.
+         */
+        bool
+        push (  Packet    * samples );
+
+        /**
+         *  Get a packet for a block of samples to push, on the thread
+         *  pushing them. The packet is re-used once the codec is done
+         *  with it.
+         *
+         *  @param buf the samples to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @param buf2 more samples to copy into the packet, after buf.
+         *  @param len2 the number of bytes in buf2.
+         *  @return the packet holding the samples.
+         *  @exception Exception
+         */
+        inline Packet *
+        newSamples (    const void    * buf,
+                        unsigned int    len,
+                        const void    * buf2 = 0,
+                        unsigned int    len2 = 0 )
+        {
+            return inputPool->get( buf, len, buf2, len2);
+        }
+
+        /**
+         *  Get the next encoded packet. After the packets for the end
+         *  of the stream, a block without a packet is returned.
+         *
+         *  @param block the block to fill.
+         *  @param wait wait for a packet if none is ready.
+         *  @return true if a block was returned, false if none was ready.
+         *  @exception Exception if encoding failed on the thread.
+         */
+        bool
+        pop (   Block     & block,
+                bool        wait );
+
+        /**
+         *  Get a packet for encoded data to emit, on the encoding thread.
+         *  The packet is re-used once the data is muxed.
+         *
+         *  @param buf the encoded data to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @return the packet holding the data.
+         *  @exception Exception
+         */
+        inline Packet *
+        newPacket (     const void    * buf,
+                        unsigned int    len )
+        {
+            return outputPool->get( buf, len);
+        }
+
+        /**
+         *  Hand back an encoded packet, on the encoding thread.
+         *  Waits while the output queue is full.
+         *
+         *  @param packet the encoded packet.
+         *  @param granulePosition the granule position of the packet.
+         *  @param packetNumber the number of the packet in the stream.
+         *  @param endOfStream tells if it is the last packet.
+         */
+        void
+        emit (  Packet    * packet,
+                long long   granulePosition = 0,
+                long long   packetNumber    = 0,
+                bool        endOfStream     = false );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* ENCODER_PIPELINE_H */
+
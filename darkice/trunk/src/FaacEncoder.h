@@ -52,12 +52,8 @@
 #include "Exception.h"
 #include "Reporter.h"
 #include "AudioEncoder.h"
+#include "ScratchBuffer.h"
 #include "Sink.h"
-#ifdef HAVE_SRC_LIB
-#include <samplerate.h>
-#else
-#include "aflibConverter.h"
-#endif
 
 
 /* ================================================================ constants */
@@ -98,6 +94,11 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
          */
         unsigned long               maxOutputBytes;
 
+        /**
+         *  Buffer for the encoded data, kept between writes.
+         */
+        ScratchBuffer<unsigned char>    outputBuffer;
+
         /**
          *  Lowpass filter. Sound frequency in Hz, from where up the
          *  input is cut.
@@ -105,23 +106,22 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
         int                             lowpass;
 
         /**
-         *  Resample ratio
+         *  Audio collected until there is enough of it for faac to
+         *  encode, channels interleaved. The samples are floats scaled to
+         *  the range of 16 bit samples, as faac expects them.
          */
-        double                      resampleRatio;
+        float                       *resampledOffset;
 
         /**
-         *  sample rate converter object for possible resampling
+         *  The number of samples per channel in resampledOffset.
          */
-#ifdef HAVE_SRC_LIB
-        SRC_STATE                   *converter;
-        SRC_DATA                    converterData;
-        float                       *resampledOffset;
-#else
-        aflibConverter              *converter;
-        short                       *resampledOffset;
-#endif
         unsigned int                resampledOffsetSize;
 
+        /**
+         *  The number of samples per channel resampledOffset can hold.
+         */
+        unsigned int                resampledOffsetCapacity;
+
         /**
          *  Initialize the object.
          *
@@ -137,7 +137,9 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
             this->faacOpen        = false;
             this->lowpass         = lowpass;
 
-            if ( getInBitsPerSample() != 16 && getInBitsPerSample() != 8 ) {
+            if ( !isInFloat()
+              && getInBitsPerSample() != 16 && getInBitsPerSample() != 8
+              && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
                 throw Exception( __FILE__, __LINE__,
                                  "specified bits per sample not supported",
                                  getInBitsPerSample() );
@@ -157,58 +159,10 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
                 throw Exception( __FILE__, __LINE__,
                              "input channels and output channels do not match");
             }
-            if ( getOutSampleRate() == getInSampleRate() ) {
-                resampleRatio = 1;
-                converter     = 0;
-            } else if (getInBitsPerSample() == 16) {
-                resampleRatio = ( (double) getOutSampleRate() /
-                                  (double) getInSampleRate() );
-
-                // Determine if we can use linear interpolation.
-                // The inverse of the ratio must be a power of two for linear mode to
-                // be of sufficient quality.
-
-                bool    useLinear = true;
-                double  inverse   = 1 / resampleRatio;
-                int     integer   = (int) inverse;
-
-                // Check that the inverse of the ratio is an integer
-                if( integer == inverse ) {
-                    while( useLinear && integer ) { // Loop through the bits
-                        // If the lowest order bit is not the only one set
-                        if( integer & 1 && integer != 1 ) {
-                            // Not a power of two; cannot use linear
-                            useLinear = false;
-                        } else {
-                            // Shift all the bits over and try again
-                            integer >>= 1;
-                        }
-                    }
-                } else {
-                   useLinear = false;
-                }
-
-                // If we get here and useLinear is still true, then we have
-                // a power of two.
-
-                // open the aflibConverter in
-                // - high quality
-                // - linear or quadratic (non-linear) based on algorithm
-                // - not filter interpolation
-#ifdef HAVE_SRC_LIB
-                int srcError = 0;
-                converter = src_new(useLinear == true ? SRC_LINEAR : SRC_SINC_FASTEST,
-                                    getInChannel(), &srcError);
-                if(srcError)
-                    throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-#else
-                converter = new aflibConverter( true, useLinear, false);
-#endif
-            } else {
-                throw Exception( __FILE__, __LINE__,
-                                 "specified bits per sample with samplerate conversion not supported",
-                                 getInBitsPerSample() );
-            }
+
+            this->resampledOffset         = 0;
+            this->resampledOffsetSize     = 0;
+            this->resampledOffsetCapacity = 0;
         }
 
         /**
@@ -219,15 +173,7 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
         inline void
         strip ( void )                                  
         {
-            if ( converter ) {
-#ifdef HAVE_SRC_LIB
-                delete [] converterData.data_in;
-                src_delete (converter);
-#else
-                delete converter;
-#endif
-                delete [] resampledOffset;
-            }
+            delete [] resampledOffset;
         }
 
 
@@ -313,6 +259,8 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
          *                 Input above this frequency is cut.
          *                 If 0, faac's default values are used,
          *                 which depends on the out sample rate.
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them.
          *  @exception Exception
          */
         inline
@@ -323,7 +271,8 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
                         double                  outQuality,
                         unsigned int            outSampleRate = 0,
                         unsigned int            outChannel    = 0,
-                        int                     lowpass       = 0)
+                        int                     lowpass       = 0,
+                        ChannelMap            * channelMap    = 0 )
                                                             
             
                     : AudioEncoder ( sink,
@@ -332,7 +281,8 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
                                      outBitrate,
                                      outQuality,
                                      outSampleRate,
-                                     outChannel )
+                                     outChannel,
+                                     channelMap )
         {
             init( lowpass);
         }
@@ -489,6 +439,28 @@ class FaacEncoder : public AudioEncoder, public virtual Reporter
         write (        const void    * buf,
                        unsigned int    len )        ;
 
+        /**
+         *  Write a frame of audio to the encoder, using the already
+         *  converted samples of the frame.
+         *
+         *  @param frame the audio to encode.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        virtual unsigned int
+        writeFrame (   const AudioFrame    * frame )        ;
+
+        /**
+         *  Tell if the encoder resamples its input through a Resampler.
+         *
+         *  @return true if the input and output sample rates differ.
+         */
+        inline virtual bool
+        usesResampler ( void ) const                    throw ()
+        {
+            return getInSampleRate() != getOutSampleRate();
+        }
+
         /**
          *  Flush all data that was written to the encoder to the underlying
          *  connection.
@@ -0,0 +1,408 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : FanOutSink.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+
+#include "Exception.h"
+#include "FanOutSink.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The number of packets shared by plain writes, beyond which packets
+ *  are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxPooledPackets = 256;
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: init (    Sink          * sink )
+{
+    if ( !sink ) {
+        throw Exception( __FILE__, __LINE__, "no sink");
+    }
+
+    targets                 = new Target[1];
+    targets[0].sink         = sink;
+    // try until closed, as the other Sinks go on meanwhile
+    targets[0].reconnector  = new Reconnector( sink, 0);
+    numTargets              = 1;
+    pool               = new PacketPool( maxPooledPackets);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: strip ( void )
+{
+    // even if none is open, some may be being reopened
+    close();
+
+    delete[] targets;
+    targets    = 0;
+    numTargets = 0;
+    delete pool;
+    pool       = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write to one more sink
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: attach (  Sink          * sink )
+{
+    Target        * t;
+    unsigned int    u;
+
+    if ( !sink ) {
+        throw Exception( __FILE__, __LINE__, "no sink");
+    }
+
+    t = new Target[numTargets + 1];
+    for ( u = 0; u < numTargets; ++u ) {
+        t[u].sink        = targets[u].sink.get();
+        t[u].reconnector = targets[u].reconnector.get();
+        t[u].reopening   = targets[u].reopening;
+    }
+    t[numTargets].sink        = sink;
+    t[numTargets].reconnector = new Reconnector( sink, 0);
+
+    delete[] targets;
+    targets = t;
+    ++numTargets;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Open all the sinks
+ *----------------------------------------------------------------------------*/
+bool
+FanOutSink :: open ( void )
+{
+    unsigned int    u;
+    bool            ret = false;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        Target    * target = targets + u;
+
+        // the ones failing now are reopened in the background on the
+        // first write
+        try {
+            target->sink->open();
+        } catch ( Exception   & e ) {
+            reportEvent( 2, "FanOutSink :: open,", e.getDescription());
+        }
+        if ( target->sink->isOpen() ) {
+            ret = true;
+        }
+    }
+
+    return ret;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Check if any of the sinks is open
+ *----------------------------------------------------------------------------*/
+bool
+FanOutSink :: isOpen ( void ) const                     throw ()
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy()
+          && targets[u].sink->isOpen() ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Check if any of the sinks can take data
+ *----------------------------------------------------------------------------*/
+bool
+FanOutSink :: canWrite (    unsigned int    sec,
+                            unsigned int    usec )
+{
+    unsigned int    u;
+
+    // waiting for one of them only, as the others are not waited for
+    // when writing either
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy()
+          && targets[u].sink->isOpen()
+          && targets[u].sink->canWrite( sec, usec) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start reopening a sink that failed
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: reopen (  Target        * target )
+{
+    target->reopening = true;
+    try {
+        target->reconnector->start();
+    } catch ( Exception   & e ) {
+        // try again with the next write
+        target->reopening = false;
+        reportEvent( 2, "FanOutSink :: reopen,", e.getDescription());
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write data or a packet to all the open sinks
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: deliver ( const void    * buf,
+                        unsigned int    len,
+                        Packet        * packet )
+{
+    unsigned int    u;
+    unsigned int    written = 0;
+    unsigned int    waiting = 0;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        Target    * target   = targets + u;
+        bool        reopened = false;
+
+        if ( target->reconnector->isBusy() ) {
+            // being reopened in the background, leave it alone meanwhile
+            ++waiting;
+            continue;
+        }
+
+        if ( target->reopening ) {
+            target->reopening = false;
+            reopened          = target->reconnector->finish()
+                             && target->sink->isOpen();
+            if ( reopened && header.get() ) {
+                target->sink->setHeader( header.get());
+            }
+        }
+
+        if ( !target->sink->isOpen() ) {
+            reopen( target);
+            ++waiting;
+            continue;
+        }
+
+        try {
+            // the stream starts over for a reopened sink, with the header,
+            // unless it is the header being written
+            if ( reopened && header.get() && packet != header.get() ) {
+                target->sink->writePacket( header.get());
+            }
+            if ( packet ) {
+                target->sink->writePacket( packet);
+            } else {
+                target->sink->write( buf, len);
+            }
+            ++written;
+        } catch ( Exception   & e ) {
+            // leave this one out, the others go on
+            reportEvent( 3, "FanOutSink :: write,", e.getDescription());
+            reopen( target);
+            ++waiting;
+        }
+    }
+
+    if ( !written && !waiting ) {
+        throw Exception( __FILE__, __LINE__, "all sinks failed");
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write data to all the open sinks
+ *----------------------------------------------------------------------------*/
+unsigned int
+FanOutSink :: write (   const void    * buf,
+                        unsigned int    len )
+{
+    if ( numTargets == 1 ) {
+        // nothing to share
+        deliver( buf, len, 0);
+        return len;
+    }
+
+    Ref<Packet>     packet = pool->get( buf, len);
+
+    return writePacket( packet.get());
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write a packet to all the open sinks
+ *----------------------------------------------------------------------------*/
+unsigned int
+FanOutSink :: writePacket (     Packet        * packet )
+{
+    deliver( packet->getData(), packet->getSize(), packet);
+
+    return packet->getSize();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Tell all the sinks the data the stream starts with
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: setHeader (       Packet        * header )
+{
+    unsigned int    u;
+
+    // the ones being reopened are given the header once reopened
+    this->header = header;
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy() ) {
+            targets[u].sink->setHeader( header);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Flush all the sinks
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: flush ( void )
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy()
+          && targets[u].sink->isOpen() ) {
+            targets[u].sink->flush();
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Cut all the sinks
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: cut ( void )                              throw ()
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy() ) {
+            targets[u].sink->cut();
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Cut all the sinks at a known time
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: cutAt (           double          boundary )  throw ()
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy() ) {
+            targets[u].sink->cutAt( boundary);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get all the sinks ready for a cut to come
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: prepareCut (      double          boundary )  throw ()
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        if ( !targets[u].reconnector->isBusy() ) {
+            targets[u].sink->prepareCut( boundary);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Close all the sinks
+ *----------------------------------------------------------------------------*/
+void
+FanOutSink :: close ( void )
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numTargets; ++u ) {
+        // take the ones being reopened back first
+        targets[u].reconnector->cancel();
+        targets[u].reopening = false;
+        if ( targets[u].sink->isOpen() ) {
+            targets[u].sink->close();
+        }
+    }
+}
+
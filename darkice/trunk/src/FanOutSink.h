@@ -0,0 +1,366 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : FanOutSink.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef FAN_OUT_SINK_H
+#define FAN_OUT_SINK_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#include "Ref.h"
+#include "Reporter.h"
+#include "Sink.h"
+#include "Reconnector.h"
+#include "PacketPool.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A Sink writing the same data to several Sinks, so that a single
+ *  encoder can feed several servers.
+ *
+ *  A Sink failing does not affect the others: it is left out, and is
+ *  reopened in the background, so that a server that is down does not
+ *  hold up the encoder and the other servers. Writing fails only if
+ *  all the Sinks failed, and none of them is being reopened.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class FanOutSink : public Sink, public virtual Reporter
+{
+    private:
+
+        /**
+         *  A Sink written to, and what reopens it, if failed.
+         */
+        class Target
+        {
+            public:
+                /**
+                 *  The Sink.
+                 */
+                Ref<Sink>           sink;
+
+                /**
+                 *  Reopens the Sink in the background, once it failed.
+                 */
+                Ref<Reconnector>    reconnector;
+
+                /**
+                 *  Marks if the Sink has been handed to the reconnector,
+                 *  and the result has not been collected yet.
+                 */
+                bool                reopening;
+
+                /**
+                 *  Default constructor.
+                 */
+                inline
+                Target ( void )
+                {
+                    reopening = false;
+                }
+        };
+
+        /**
+         *  The Sinks written to.
+         */
+        Target            * targets;
+
+        /**
+         *  The number of Sinks.
+         */
+        unsigned int        numTargets;
+
+        /**
+         *  The packets plain writes are shared by.
+         */
+        PacketPool        * pool;
+
+        /**
+         *  The data the stream starts with, written first to a Sink
+         *  that has been reopened, or NULL if none.
+         */
+        Ref<Packet>         header;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param sink the first Sink to write to.
+         *  @exception Exception
+         */
+        void
+        init (  Sink          * sink );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Start reopening a Sink that failed, in the background.
+         *
+         *  @param target the Sink to reopen.
+         *  @exception Exception
+         */
+        void
+        reopen ( Target       * target );
+
+        /**
+         *  Write data to all the open Sinks, handing the ones that
+         *  failed over to be reopened.
+         *
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @param packet the packet holding the data, handed to the
+         *                Sinks instead of the data, or 0 if none.
+         *  @exception Exception if all the Sinks failed, and none of
+         *             them is being reopened.
+         */
+        void
+        deliver (   const void    * buf,
+                    unsigned int    len,
+                    Packet        * packet );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        FanOutSink ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception.
+         *
+         *  @param sink the object to copy.
+         *  @exception Exception
+         */
+        inline
+        FanOutSink ( const FanOutSink     & sink )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param sink the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline FanOutSink &
+        operator= ( const FanOutSink  & sink )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor by the first Sink to write to.
+         *
+         *  @param sink the Sink to write to.
+         *  @exception Exception
+         */
+        inline
+        FanOutSink (    Sink          * sink )
+        {
+            init( sink);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~FanOutSink ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Write to one more Sink. Must be called before opening.
+         *
+         *  @param sink the Sink to write to.
+         *  @exception Exception
+         */
+        void
+        attach (    Sink          * sink );
+
+        /**
+         *  Get the number of Sinks written to.
+         *
+         *  @return the number of Sinks.
+         */
+        inline unsigned int
+        getNumSinks ( void ) const                      throw ()
+        {
+            return numTargets;
+        }
+
+        /**
+         *  Open all the Sinks.
+         *
+         *  @return true if any of the Sinks could be opened,
+         *          false otherwise.
+         *  @exception Exception
+         */
+        virtual bool
+        open ( void );
+
+        /**
+         *  Check if any of the Sinks is open.
+         *
+         *  @return true if any of the Sinks is open, false otherwise.
+         */
+        virtual bool
+        isOpen ( void ) const                           throw ();
+
+        /**
+         *  Check if any of the Sinks is ready to accept data.
+         *
+         *  @param sec the maximum seconds to block.
+         *  @param usec micro seconds to block after the full seconds.
+         *  @return true if any of the Sinks is ready to accept data,
+         *          false otherwise.
+         *  @exception Exception
+         */
+        virtual bool
+        canWrite (  unsigned int    sec,
+                    unsigned int    usec );
+
+        /**
+         *  Write data to all the open Sinks. If there are more than one,
+         *  the data is copied into a single packet, which all of them
+         *  share.
+         *
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @return len, if any of the Sinks took the data.
+         *  @exception Exception if all the Sinks failed, and none of
+         *             them is being reopened.
+         */
+        virtual unsigned int
+        write (     const void    * buf,
+                    unsigned int    len );
+
+        /**
+         *  Write a packet to all the open Sinks.
+         *
+         *  @param packet the packet to write.
+         *  @return the size of the packet, if any of the Sinks took it.
+         *  @exception Exception if all the Sinks failed, and none of
+         *             them is being reopened.
+         */
+        virtual unsigned int
+        writePacket (   Packet        * packet );
+
+        /**
+         *  Tell all the Sinks the data the stream starts with, and keep
+         *  it to write it first to a Sink once reopened.
+         *
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
+        virtual void
+        setHeader (     Packet        * header );
+
+        /**
+         *  Flush all the Sinks.
+         *
+         *  @exception Exception
+         */
+        virtual void
+        flush ( void );
+
+        /**
+         *  Cut all the Sinks.
+         */
+        virtual void
+        cut ( void )                                    throw ();
+
+        /**
+         *  Cut all the Sinks at a known time.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        virtual void
+        cutAt ( double          boundary )              throw ();
+
+        /**
+         *  Get all the Sinks ready for a cut coming at a known time.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        virtual void
+        prepareCut ( double     boundary )              throw ();
+
+        /**
+         *  Close all the Sinks.
+         *
+         *  @exception Exception
+         */
+        virtual void
+        close ( void );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* FAN_OUT_SINK_H */
+
@@ -227,6 +227,59 @@ class FileCast : public CastSink
             return targetFile->write( buf, len);
         }
 
+        /**
+         *  Write a packet of encoded data to the FileCast.
+         *
+         *  @param packet the packet to write.
+         *  @return the number of bytes written from the packet
+         *          (may be less than the size of the packet).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writePacket (  Packet        * packet )
+        {
+            return targetFile->writePacket( packet);
+        }
+
+        /**
+         *  Write data again to the FileCast. The file is where the data
+         *  goes, and it keeps only what it takes.
+         *
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @return the number of bytes written (may be less than len).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writeAgain (   const void    * buf,
+                       unsigned int    len )
+        {
+            return targetFile->write( buf, len);
+        }
+
+        /**
+         *  Tell the file the data the stream starts with.
+         *
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
+        inline virtual void
+        setHeader (    Packet        * header )
+        {
+            targetFile->setHeader( header);
+        }
+
+        /**
+         *  Check if the FileCast writes to a file only.
+         *
+         *  @return true.
+         */
+        inline virtual bool
+        isFile ( void ) const                       throw ()
+        {
+            return true;
+        }
+
         /**
          *  Flush all data that was written to the FileCast to the server.
          *
@@ -249,6 +302,30 @@ class FileCast : public CastSink
             targetFile->cut();
         }
 
+        /**
+         *  Cut at a known time, naming the next file after it.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        inline virtual void
+        cutAt ( double          boundary )              throw ()
+        {
+            targetFile->cutAt( boundary);
+        }
+
+        /**
+         *  Get ready for a cut coming at a known time, by letting the
+         *  file create the next one.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        inline virtual void
+        prepareCut ( double     boundary )              throw ()
+        {
+            targetFile->prepareCut( boundary);
+        }
+
         /**
          *  Close the FileCast.
          *
@@ -87,6 +87,18 @@
 #error need signal.h
 #endif
 
+#ifdef HAVE_TIME_H
+#include <time.h>
+#else
+#error need time.h
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#else
+#error need sched.h
+#endif
+
 
 #include <iostream>
 #include <sstream>
@@ -108,6 +120,42 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The most packets of data queued for the I/O thread
+ *----------------------------------------------------------------------------*/
+static const unsigned int   queueSize       = 4096;
+
+/*------------------------------------------------------------------------------
+ *  The most bytes of data queued for the I/O thread, more is dropped
+ *----------------------------------------------------------------------------*/
+static const unsigned int   maxQueueBytes   = 32 * 1024 * 1024;
+
+/*------------------------------------------------------------------------------
+ *  The number of packets plain writes are queued in, beyond which packets
+ *  are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int   maxPooledPackets = 256;
+
+/*------------------------------------------------------------------------------
+ *  The size of the buffer the I/O thread collects the data in
+ *----------------------------------------------------------------------------*/
+static const unsigned int   bufferSize      = 1024 * 1024;
+
+/*------------------------------------------------------------------------------
+ *  The alignment of the buffer and of the writes, for O_DIRECT
+ *----------------------------------------------------------------------------*/
+static const unsigned int   blockSize       = 4096;
+
+/*------------------------------------------------------------------------------
+ *  The space to preallocate for the file at a time
+ *----------------------------------------------------------------------------*/
+static const off_t          preallocSize    = 16 * 1024 * 1024;
+
+/*------------------------------------------------------------------------------
+ *  The seconds the collected data may wait before it is written out
+ *----------------------------------------------------------------------------*/
+static const unsigned int   writeInterval   = 1;
+
 
 /* ===============================================  local function prototypes */
 
@@ -123,14 +171,56 @@ FileSink :: init (  const char    * configName,
 		    const bool      nameAddDate,
 		    const char    * fileDateFormat )
 {
+    void  * mem;
+
     this->configName  = Util::strDup(configName);
     fileName          = Util::strDup(name);
     addDate           = nameAddDate;
+    this->fileDateFormat = 0;
     if (fileDateFormat) {
         this->fileDateFormat = Util::strDup(fileDateFormat);
     }
     fileDescriptor    = 0;
     fileNameActual    = 0;
+
+#ifdef HAVE_POSIX_MEMALIGN
+    if ( posix_memalign( &mem, blockSize, bufferSize) ) {
+        mem = 0;
+    }
+#else
+    mem = malloc( bufferSize);
+#endif
+    if ( !mem ) {
+        throw Exception( __FILE__, __LINE__, "can't allocate file buffer");
+    }
+
+    buffer      = (unsigned char *) mem;
+    bufferLen   = 0;
+    fileOffset  = 0;
+    allocated   = 0;
+    synced      = 0;
+    directIO    = false;
+
+    queue       = new Ref<Packet>[queueSize];
+    queueTimes  = new double[queueSize];
+    queueFirst  = 0;
+    queueCount  = 0;
+    queueBytes  = 0;
+    pool        = new PacketPool( maxPooledPackets);
+    dropping    = false;
+
+    running     = false;
+    stopping    = false;
+    flushing    = false;
+
+    prepareTime     = 0.0;
+    nextTime        = 0.0;
+    nextName        = 0;
+    nextDescriptor  = 0;
+    nextDirect      = false;
+
+    pthread_mutex_init( &mutex, 0);
+    pthread_cond_init( &cond, 0);
 }
 
 
@@ -140,14 +230,20 @@ FileSink :: init (  const char    * configName,
 void
 FileSink :: strip ( void)                           
 {
-    if ( isOpen() ) {
-        close();
-    }
+    close();
 
     delete[] fileName;
     delete[] fileNameActual;
     if (fileDateFormat)
         delete[] fileDateFormat;
+
+    delete[] queue;
+    delete[] queueTimes;
+    delete pool;
+    free( buffer);
+
+    pthread_cond_destroy( &cond);
+    pthread_mutex_destroy( &mutex);
 }
 
 
@@ -157,16 +253,7 @@ FileSink :: strip ( void)
 FileSink :: FileSink (  const FileSink &    fs )    
                 : Sink( fs )
 {
-    int     fd;
-    
     init( fs.configName, fs.fileName, fs.addDate, fs.fileDateFormat);
-    
-    if ( (fd = fs.fileDescriptor ? dup( fs.fileDescriptor) : 0) == -1 ) {
-        strip();
-        throw Exception( __FILE__, __LINE__, "dup failure");
-    }
-
-    fileDescriptor = fd;
 }
 
 
@@ -177,8 +264,6 @@ FileSink &
 FileSink :: operator= (  const FileSink &    fs )   
 {
     if ( this != &fs ) {
-        int     fd;
-
         /* first strip */
         strip();
 
@@ -187,13 +272,6 @@ FileSink :: operator= (  const FileSink &    fs )
         Sink::operator=( fs );
         
         init( fs.configName, fs.fileName, fs.addDate, fs.fileDateFormat);
-        
-        if ( (fd = fs.fileDescriptor ? dup( fs.fileDescriptor) : 0) == -1 ) {
-            strip();
-            throw Exception( __FILE__, __LINE__, "dup failure");
-        }
-
-        fileDescriptor = fd;
     }
 
     return *this;
@@ -220,11 +298,12 @@ FileSink :: exists ( void ) const               throw ()
  *  Create a file, truncate if already exists
  *----------------------------------------------------------------------------*/
 bool
-FileSink :: create ( void )                     
+FileSink :: create (    time_t          when )
 {
     int     fd;
     
-    if ( isOpen() ) {
+    // the file is still open, also when called on a cut
+    if ( fileDescriptor ) {
         return false;
     }
     /* filemode default to 0666 */
@@ -235,13 +314,7 @@ FileSink :: create ( void )
     }
 
     if ( addDate ) {
-         if (fileDateFormat == 0) {
-             fileNameActual = Util::fileAddDate(fileName);
-         }
-         else {
-             fileNameActual = Util::fileAddDate( fileName,
-                                                 fileDateFormat );
-         }
+        fileNameActual = Util::fileAddDate( fileName, fileDateFormat, when);
     }
     else {
         fileNameActual = Util::strDup(fileName);
@@ -268,48 +341,276 @@ FileSink :: open ( void )
         return false;
     }
 
-    if ( (fileDescriptor = ::open( fileNameActual, O_WRONLY | O_TRUNC, 0)) == -1 ) {
-        fileDescriptor = 0;
+    if ( !openFile() ) {
         return false;
     }
 
+    startWriter();
+
     return true;
 }
 
 
 /*------------------------------------------------------------------------------
- *  Check whether the file can be written to
+ *  Open a file for writing, with O_DIRECT if the file system allows it
+ *----------------------------------------------------------------------------*/
+int
+FileSink :: openName (  const char    * name,
+                        bool          * direct )
+{
+    int     fd = -1;
+
+#ifdef O_DIRECT
+    // not all file systems take O_DIRECT, fall back to the page cache
+    fd = ::open( name, O_WRONLY | O_TRUNC | O_DIRECT, 0);
+#endif
+    if ( fd == -1 ) {
+        fd = ::open( name, O_WRONLY | O_TRUNC, 0);
+    }
+    if ( fd == -1 ) {
+        return -1;
+    }
+
+    *direct = false;
+#ifdef O_DIRECT
+    *direct = (fcntl( fd, F_GETFL) & O_DIRECT) != 0;
+#endif
+
+    return fd;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Open the file, and reset the state of the I/O thread for it
  *----------------------------------------------------------------------------*/
 bool
-FileSink :: canWrite (     unsigned int    sec,
-                           unsigned int    usec )   
+FileSink :: openFile ( void )
 {
-    fd_set              fdset;
-    struct timespec     timespec;
-    sigset_t            sigset;
-    int                 ret;
+    bool    direct;
+    int     fd = openName( fileNameActual, &direct);
 
-    if ( !isOpen() ) {
+    if ( fd == -1 ) {
         return false;
     }
 
-    FD_ZERO( &fdset);
-    FD_SET( fileDescriptor, &fdset);
+    startFile( fd, direct);
 
-    timespec.tv_sec  = sec;
-    timespec.tv_nsec = usec * 1000L;
+    return true;
+}
 
-    // mask out SIGUSR1, as we're expecting that signal for other reasons
-    sigemptyset(&sigset);
-    sigaddset(&sigset, SIGUSR1);
 
-    ret = pselect( fileDescriptor + 1, NULL, &fdset, NULL, &timespec, &sigset);
-    
-    if ( ret == -1 ) {
-        throw Exception( __FILE__, __LINE__, "select error");
+/*------------------------------------------------------------------------------
+ *  Start writing to a file, and reset the state of the I/O thread for it
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: startFile ( int             fd,
+                        bool            direct )
+{
+    directIO   = direct;
+    bufferLen  = 0;
+    fileOffset = 0;
+    allocated  = 0;
+    synced     = 0;
+
+    pthread_mutex_lock( &mutex);
+    fileDescriptor = fd;
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Create and open the file to start at a cut to come
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: prepareFile (   double      boundary )
+{
+    const int   filemode = (S_IRUSR|S_IWUSR|S_IWGRP|S_IRGRP|S_IROTH|S_IWOTH);
+    char      * name;
+    bool        direct;
+    int         fd;
+
+    // one created for an earlier time, for a cut that didn't come
+    dropNextFile();
+
+    try {
+        name = Util::fileAddDate( fileName,
+                                  fileDateFormat,
+                                  (time_t) boundary);
+    } catch ( Exception &e ) {
+        reportEvent( 2, "couldn't name the next file", e);
+        return;
+    }
+
+    // with a date too coarse to tell the files apart, the file written
+    // now would be truncated: start the next one at the cut instead
+    if ( fileNameActual && !strcmp( name, fileNameActual) ) {
+        delete[] name;
+        return;
+    }
+
+    if ( (fd = ::creat( name, filemode)) == -1 ) {
+        reportEvent( 3, "can't create file", name, errno);
+        delete[] name;
+        return;
+    }
+    ::close( fd);
+
+    if ( (fd = openName( name, &direct)) == -1 ) {
+        reportEvent( 3, "can't open file", name, errno);
+        ::unlink( name);
+        delete[] name;
+        return;
+    }
+
+    nextName       = name;
+    nextDescriptor = fd;
+    nextDirect     = direct;
+    nextTime       = boundary;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Close and remove the file created ahead of a cut, if any
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: dropNextFile ( void )
+{
+    if ( !nextDescriptor ) {
+        return;
+    }
+
+    ::close( nextDescriptor);
+    ::unlink( nextName);
+    delete[] nextName;
+    nextName       = 0;
+    nextDescriptor = 0;
+    nextTime       = 0.0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Close the file, after writing out all the data collected
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: closeFile ( void )
+{
+    writeOut( true);
+
+    // let go of the space preallocated beyond the data
+    if ( allocated > fileOffset ) {
+        if ( ftruncate( fileDescriptor, fileOffset) == -1 ) {
+            reportEvent( 3, "can't truncate file", fileName, errno);
+        }
+    }
+
+    ::close( fileDescriptor);
+
+    pthread_mutex_lock( &mutex);
+    fileDescriptor = 0;
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start the I/O thread
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: startWriter ( void )
+{
+    pthread_attr_t      attr;
+    struct sched_param  param;
+
+    if ( running ) {
+        return;
     }
 
-    return ret > 0;
+    stopping = false;
+    flushing = false;
+    dropping    = false;
+    prepareTime = 0.0;
+
+    // waiting for the disk is no job for a real-time thread
+    pthread_attr_init( &attr);
+    pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam( &attr, &param);
+
+    if ( pthread_create( &thread, &attr, threadFunction, this) ) {
+        pthread_attr_destroy( &attr);
+        throw Exception( __FILE__, __LINE__, "can't create file I/O thread");
+    }
+    pthread_attr_destroy( &attr);
+
+    running = true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Stop the I/O thread, after it has written all that was queued
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: stopWriter ( void )
+{
+    if ( !running ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex);
+    stopping = true;
+    pthread_cond_broadcast( &cond);
+    pthread_mutex_unlock( &mutex);
+
+    pthread_join( thread, 0);
+    running = false;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Queue data for the I/O thread
+ *----------------------------------------------------------------------------*/
+bool
+FileSink :: enqueue (   Packet        * packet,
+                        double          boundary )
+{
+    unsigned int    size   = packet ? packet->getSize() : 0;
+    bool            queued = false;
+
+    pthread_mutex_lock( &mutex);
+    if ( running
+      && queueCount < queueSize
+      && (!packet || queueBytes + size <= maxQueueBytes) ) {
+
+        queue[(queueFirst + queueCount) % queueSize]      = packet;
+        queueTimes[(queueFirst + queueCount) % queueSize] = boundary;
+        ++queueCount;
+        queueBytes += size;
+        queued      = true;
+
+        pthread_cond_signal( &cond);
+    }
+    pthread_mutex_unlock( &mutex);
+
+    return queued;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Check whether the file can be written to
+ *----------------------------------------------------------------------------*/
+bool
+FileSink :: canWrite (     unsigned int    sec,
+                           unsigned int    usec )   
+{
+    bool    ret;
+
+    pthread_mutex_lock( &mutex);
+    ret = running
+       && queueCount < queueSize
+       && queueBytes < maxQueueBytes;
+    pthread_mutex_unlock( &mutex);
+
+    return ret;
 }
 
 
@@ -320,23 +621,254 @@ unsigned int
 FileSink :: write (    const void    * buf,
                        unsigned int    len )        
 {
-    ssize_t     ret;
+    Ref<Packet>     packet;
+
+    if ( !isOpen() || len == 0 ) {
+        return 0;
+    }
 
+    packet = pool->get( buf, len);
+    return writePacket( packet.get());
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write a packet to the FileSink
+ *----------------------------------------------------------------------------*/
+unsigned int
+FileSink :: writePacket (   Packet        * packet )
+{
     if ( !isOpen() ) {
         return 0;
     }
 
-    ret = ::write( fileDescriptor, buf, len);
+    if ( !enqueue( packet) ) {
+        if ( !dropping ) {
+            reportEvent( 2, "file falls behind, dropping data for", fileName);
+            dropping = true;
+        }
+        return 0;
+    }
+
+    dropping = false;
+    return packet->getSize();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Have the I/O thread write out what it has collected
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: flush ( void )
+{
+    pthread_mutex_lock( &mutex);
+    flushing = true;
+    pthread_cond_signal( &cond);
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Collect data, writing it out as the buffer fills up
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: collect (   const unsigned char   * data,
+                        unsigned int            len )
+{
+    while ( len ) {
+        unsigned int    n = bufferSize - bufferLen;
+
+        if ( n > len ) {
+            n = len;
+        }
+        memcpy( buffer + bufferLen, data, n);
+        bufferLen += n;
+        data      += n;
+        len       -= n;
+
+        if ( bufferLen == bufferSize ) {
+            writeOut( false);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write out the data collected so far
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: writeOut (  bool            final )
+{
+    unsigned int    len  = bufferLen;
+    unsigned int    done = 0;
+
+    if ( !fileDescriptor ) {
+        // no file to write to, after failing to start one anew on a cut
+        bufferLen = 0;
+        return;
+    }
+    if ( !bufferLen ) {
+        return;
+    }
+
+#ifdef O_DIRECT
+    if ( directIO && !final ) {
+        // only whole blocks, the rest waits for more data
+        len -= len % blockSize;
+    } else if ( directIO && len % blockSize ) {
+        // the end of the file is not a whole block
+        fcntl( fileDescriptor, F_SETFL,
+               fcntl( fileDescriptor, F_GETFL) & ~O_DIRECT);
+        directIO = false;
+    }
+#endif
+    if ( !len ) {
+        return;
+    }
 
-    if ( ret == -1 ) {
-        if ( errno == EAGAIN ) {
-            ret = 0;
+#ifdef HAVE_FALLOCATE
+    // preallocate ahead of the data, for less fragmentation
+    if ( allocated >= fileOffset && fileOffset + len > allocated ) {
+        if ( fallocate( fileDescriptor,
+                        FALLOC_FL_KEEP_SIZE,
+                        allocated,
+                        preallocSize) == 0 ) {
+            allocated += preallocSize;
         } else {
-            throw Exception( __FILE__, __LINE__, "write error", errno);
+            // not supported by the file system, don't try again
+            allocated = -1;
         }
     }
+#endif
 
-    return ret;
+    while ( done < len ) {
+        ssize_t     ret = ::write( fileDescriptor, buffer + done, len - done);
+
+        if ( ret == -1 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+#ifdef O_DIRECT
+            if ( errno == EINVAL && directIO ) {
+                // the file system took O_DIRECT on open, but not on write
+                fcntl( fileDescriptor, F_SETFL,
+                       fcntl( fileDescriptor, F_GETFL) & ~O_DIRECT);
+                directIO = false;
+                continue;
+            }
+#endif
+            // just let go data that could not be written
+            reportEvent( 2, "write error on file", fileName, errno);
+            break;
+        }
+        done       += ret;
+        fileOffset += ret;
+    }
+
+    // keep the part of a block that was not written
+    memmove( buffer, buffer + len, bufferLen - len);
+    bufferLen -= len;
+
+#ifdef HAVE_SYNC_FILE_RANGE
+    if ( !directIO && fileOffset > synced ) {
+        // start the write-back now, instead of all of it at once later
+        sync_file_range( fileDescriptor,
+                         synced,
+                         fileOffset - synced,
+                         SYNC_FILE_RANGE_WRITE);
+        synced = fileOffset;
+    }
+#endif
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write the queued data, until told to stop
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: run ( void )
+{
+    struct timespec     deadline;
+
+    clock_gettime( CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += writeInterval;
+
+    for (;;) {
+        Ref<Packet>         packet;
+        bool                popped = false;
+        bool                due;
+        double              boundary = 0.0;
+        double              prepare;
+        struct timespec     now;
+
+        pthread_mutex_lock( &mutex);
+        while ( !queueCount && !stopping && !flushing && !prepareTime
+             && pthread_cond_timedwait( &cond, &mutex, &deadline)
+                                                            != ETIMEDOUT ) {
+        }
+        if ( !queueCount && stopping ) {
+            pthread_mutex_unlock( &mutex);
+            break;
+        }
+
+        clock_gettime( CLOCK_REALTIME, &now);
+        due      = flushing
+                || now.tv_sec > deadline.tv_sec
+                || (now.tv_sec == deadline.tv_sec
+                 && now.tv_nsec >= deadline.tv_nsec);
+        flushing = false;
+        prepare     = prepareTime;
+        prepareTime = 0.0;
+
+        if ( queueCount ) {
+            packet   = queue[queueFirst];
+            boundary = queueTimes[queueFirst];
+            queue[queueFirst] = 0;
+            queueFirst = (queueFirst + 1) % queueSize;
+            --queueCount;
+            queueBytes -= packet.get() ? packet->getSize() : 0;
+            popped      = true;
+        }
+        pthread_cond_broadcast( &cond);
+        pthread_mutex_unlock( &mutex);
+
+        // before the cut, which may have been queued already
+        if ( prepare ) {
+            prepareFile( prepare);
+        }
+
+        if ( popped && packet.get() ) {
+            collect( packet->getData(), packet->getSize());
+        } else if ( popped ) {
+            reopen( boundary);
+        }
+
+        if ( due ) {
+            writeOut( false);
+            deadline         = now;
+            deadline.tv_sec += writeInterval;
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The function of the I/O thread
+ *----------------------------------------------------------------------------*/
+void *
+FileSink :: threadFunction (    void      * param )
+{
+    FileSink  * sink = (FileSink *) param;
+    sigset_t    sigset;
+
+    // SIGUSR1 is for the main thread, to cut the recordings
+    sigemptyset( &sigset);
+    sigaddset( &sigset, SIGUSR1);
+    pthread_sigmask( SIG_BLOCK, &sigset, 0);
+
+    sink->run();
+
+    return 0;
 }
 
 
@@ -374,8 +906,58 @@ FileSink :: getArchiveFileName ( void )
 void
 FileSink :: cut ( void )                            throw ()
 {
-    flush();
-    close();
+    cutAt( 0.0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Cut what we've done so far at a known time, and start anew.
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: cutAt (     double          boundary )  throw ()
+{
+    if ( !enqueue( 0, boundary) ) {
+        reportEvent( 2, "couldn't cut file", fileName);
+        return;
+    }
+
+    // so that the new file can be played on its own
+    if ( header.get() && !enqueue( header.get()) ) {
+        reportEvent( 2, "couldn't start new file with header", fileName);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Have the I/O thread create the file to start at a cut to come
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: prepareCut (    double          boundary )  throw ()
+{
+    // without a date, the next file has the same name as this one,
+    // and can only be created once this one is moved away
+    if ( !addDate ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex);
+    if ( running ) {
+        prepareTime = boundary;
+        pthread_cond_signal( &cond);
+    }
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Move the file to its archive name, and start a new one
+ *----------------------------------------------------------------------------*/
+void
+FileSink :: reopen (    double          boundary )
+{
+    if ( fileDescriptor ) {
+        closeFile();
+    }
 
     try {
         std::string     archiveFileName = getArchiveFileName();
@@ -386,11 +968,32 @@ FileSink :: cut ( void )                            throw ()
         }
 
     } catch ( Exception &e ) {
-        reportEvent(2, "error during archive cut", e);
+        // a dated file may stay where it is, when not told where to go
+        reportEvent(addDate ? 5 : 2, "error during archive cut", e);
     }
 
-    create();
-    open();
+    if ( nextDescriptor && boundary && boundary == nextTime ) {
+        // created ahead for this cut, named after its time
+        delete[] fileNameActual;
+        fileNameActual = nextName;
+        nextName       = 0;
+        startFile( nextDescriptor, nextDirect);
+        nextDescriptor = 0;
+        nextTime       = 0.0;
+        return;
+    }
+
+    // a cut at another time comes before the one the file created ahead
+    // is for, which then creates it again, named just the same
+    dropNextFile();
+
+    try {
+        if ( !create( (time_t) boundary) || !openFile() ) {
+            reportEvent( 2, "couldn't start file anew", fileName);
+        }
+    } catch ( Exception &e ) {
+        reportEvent( 2, "error during archive cut", e);
+    }
 }
 
 
@@ -404,9 +1007,12 @@ FileSink :: close ( void )
         return;
     }
 
-    flush();
-    ::close( fileDescriptor);
-    fileDescriptor = 0;
-}
+    stopWriter();
 
+    // there is no file, if it could not be started anew on a cut
+    if ( fileDescriptor ) {
+        closeFile();
+    }
+    dropNextFile();
+}
 
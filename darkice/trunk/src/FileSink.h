@@ -36,6 +36,25 @@
 
 /* ============================================================ include files */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#else
+#error need sys/types.h
+#endif
+
+#include "Ref.h"
+#include "Packet.h"
+#include "PacketPool.h"
 #include "Reporter.h"
 #include "Sink.h"
 
@@ -51,6 +70,15 @@
 /**
  *  File data output
  *
+ *  The data is written to the file by an I/O thread of its own, so that
+ *  a slow disk never holds up the thread writing to the sink. The data
+ *  is queued as it is written, and collected by the I/O thread into
+ *  large, aligned writes, with O_DIRECT where the file system allows it.
+ *  The file is preallocated as it grows, and otherwise its write-back
+ *  is started periodically, instead of all at once when it is closed.
+ *  If the disk falls so far behind that the queue is full, the data is
+ *  dropped, and the sink reports it cannot be written.
+ *
  *  @author  $Author$
  *  @version $Revision$
  */
@@ -103,6 +131,264 @@ class FileSink : public Sink, public virtual Reporter
         std::string
         getArchiveFileName( void )                  ;
 
+        /**
+         *  The data waiting for the I/O thread: a packet to write, or
+         *  NULL to cut the file there.
+         */
+        Ref<Packet>       * queue;
+
+        /**
+         *  The time of each cut in the queue, in seconds since the epoch,
+         *  or 0 for a cut made at no particular time.
+         */
+        double            * queueTimes;
+
+        /**
+         *  The data the stream starts with, written first to each new
+         *  file after a cut, or NULL if none.
+         */
+        Ref<Packet>         header;
+
+        /**
+         *  The index of the oldest element of the queue.
+         */
+        unsigned int        queueFirst;
+
+        /**
+         *  The number of elements in the queue.
+         */
+        unsigned int        queueCount;
+
+        /**
+         *  The number of bytes of data in the queue.
+         */
+        unsigned int        queueBytes;
+
+        /**
+         *  The packets plain writes are queued in.
+         */
+        PacketPool        * pool;
+
+        /**
+         *  Tells if data is being dropped for a full queue, so that it
+         *  is reported only once.
+         */
+        bool                dropping;
+
+        /**
+         *  The I/O thread.
+         */
+        pthread_t           thread;
+
+        /**
+         *  Guards the queue and the state of the I/O thread.
+         */
+        pthread_mutex_t     mutex;
+
+        /**
+         *  Signals changes of the queue and the state of the I/O thread.
+         */
+        pthread_cond_t      cond;
+
+        /**
+         *  Tells if the I/O thread is running.
+         */
+        bool                running;
+
+        /**
+         *  Tells the I/O thread to stop, once the queue is empty.
+         */
+        bool                stopping;
+
+        /**
+         *  Tells the I/O thread to write out what it has collected.
+         */
+        bool                flushing;
+
+        /**
+         *  The time of a cut to come, for the I/O thread to create the
+         *  file to start at it, or 0 if there is nothing to prepare.
+         */
+        double              prepareTime;
+
+        /**
+         *  The time of the cut the file created ahead is for.
+         */
+        double              nextTime;
+
+        /**
+         *  The name of the file created ahead of a cut, or NULL if none.
+         */
+        char              * nextName;
+
+        /**
+         *  The file created ahead of a cut, or 0 if none.
+         */
+        int                 nextDescriptor;
+
+        /**
+         *  Tells if the file created ahead of a cut is open with O_DIRECT.
+         */
+        bool                nextDirect;
+
+        /**
+         *  The data collected by the I/O thread, aligned for O_DIRECT.
+         */
+        unsigned char     * buffer;
+
+        /**
+         *  The number of bytes in buffer.
+         */
+        unsigned int        bufferLen;
+
+        /**
+         *  The number of bytes written to the file so far.
+         */
+        off_t               fileOffset;
+
+        /**
+         *  The number of bytes preallocated for the file.
+         */
+        off_t               allocated;
+
+        /**
+         *  The number of bytes of the file whose write-back was started.
+         */
+        off_t               synced;
+
+        /**
+         *  Tells if the file is open with O_DIRECT.
+         */
+        bool                directIO;
+
+        /**
+         *  Open a file for writing, with O_DIRECT if the file system
+         *  allows it.
+         *
+         *  @param name the name of the file.
+         *  @param direct set to tell if the file is open with O_DIRECT.
+         *  @return the file descriptor, or -1 on error.
+         */
+        static int
+        openName (  const char    * name,
+                    bool          * direct )        ;
+
+        /**
+         *  Open the file, with O_DIRECT if the file system allows it,
+         *  and reset the state of the I/O thread for it.
+         *
+         *  @return true if opening was successful, false otherwise.
+         */
+        bool
+        openFile ( void )                           ;
+
+        /**
+         *  Start writing to a file, resetting the state of the I/O thread
+         *  for it.
+         *
+         *  @param fd the descriptor of the open file.
+         *  @param direct tells if the file is open with O_DIRECT.
+         */
+        void
+        startFile ( int             fd,
+                    bool            direct )        ;
+
+        /**
+         *  Create and open the file to start at a cut to come, named
+         *  after the time of the cut. Called by the I/O thread.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        void
+        prepareFile (   double      boundary )      ;
+
+        /**
+         *  Close and remove the file created ahead of a cut, if any,
+         *  as no data was written to it.
+         */
+        void
+        dropNextFile ( void )                       ;
+
+        /**
+         *  Close the file, after writing out all the data collected.
+         */
+        void
+        closeFile ( void )                          ;
+
+        /**
+         *  Start the I/O thread.
+         *
+         *  @exception Exception
+         */
+        void
+        startWriter ( void )                        ;
+
+        /**
+         *  Stop the I/O thread, after it has written all that was queued.
+         */
+        void
+        stopWriter ( void )                         ;
+
+        /**
+         *  Queue data for the I/O thread.
+         *
+         *  @param packet the data to write, or NULL to cut the file.
+         *  @param boundary the time of the cut, in seconds since the
+         *                  epoch, or 0 for a cut at no particular time.
+         *  @return true if the data was queued, false if the queue is
+         *          full.
+         */
+        bool
+        enqueue (   Packet        * packet,
+                    double          boundary = 0.0 ) ;
+
+        /**
+         *  Collect data into buffer, writing it out as it fills up.
+         *  Called by the I/O thread.
+         *
+         *  @param data the data to collect.
+         *  @param len the number of bytes of data.
+         */
+        void
+        collect (   const unsigned char   * data,
+                    unsigned int            len )   ;
+
+        /**
+         *  Write out the data collected so far. With O_DIRECT, only
+         *  whole blocks are written, unless the file is about to be
+         *  closed. Called by the I/O thread.
+         *
+         *  @param final true if the file is about to be closed.
+         */
+        void
+        writeOut (  bool            final )         ;
+
+        /**
+         *  Move the file to its archive name, and start a new one: the
+         *  one created ahead for the time of the cut if there is one,
+         *  otherwise one created now. Called by the I/O thread.
+         *
+         *  @param boundary the time of the cut, in seconds since the
+         *                  epoch, or 0 for a cut at no particular time.
+         */
+        void
+        reopen (    double          boundary )      ;
+
+        /**
+         *  Write the queued data, until told to stop.
+         */
+        void
+        run ( void )                                ;
+
+        /**
+         *  The function of the I/O thread.
+         *
+         *  @param param the FileSink.
+         *  @return NULL.
+         */
+        static void *
+        threadFunction (    void      * param )     ;
+
 
     protected:
 
@@ -161,7 +447,8 @@ class FileSink : public Sink, public virtual Reporter
         }
 
         /**
-         *  Copy constructor.
+         *  Copy constructor. The copy is not open, as the open file
+         *  belongs to the I/O thread of the original.
          *
          *  @param fsink the FileSink to copy.
          *  @exception Exception
@@ -180,7 +467,8 @@ class FileSink : public Sink, public virtual Reporter
         }
 
         /**
-         *  Assignment operator.
+         *  Assignment operator. This object is left closed, as the
+         *  open file belongs to the I/O thread of the other one.
          *
          *  @param fs the FileSink to assign to this object.
          *  @return a reference to this object.
@@ -212,11 +500,13 @@ class FileSink : public Sink, public virtual Reporter
         /**
          *  Create the file.
          *
+         *  @param when the time to name the file after, if a date is
+         *              added to its name, or 0 for the current time.
          *  @return true if creation was successful, false otherwise.
          *  @exception Exception
          */
         virtual bool
-        create ( void )                             ;
+        create (    time_t          when = 0 )      ;
 
         /**
          *  Open the file. Truncates the file.
@@ -228,22 +518,24 @@ class FileSink : public Sink, public virtual Reporter
         open ( void )                               ;
 
         /**
-         *  Check if the FileSink is open.
+         *  Check if the FileSink is open. It stays open while the I/O
+         *  thread moves on to a new file on a cut, the data written
+         *  meanwhile waits in the queue.
          *
          *  @return true if the FileSink is open, false otherwise.
          */
         inline virtual bool
         isOpen ( void ) const                       throw ()
         {
-            return fileDescriptor != 0;
+            return running;
         }
 
         /**
-         *  Check if the FileSink is ready to accept data.
-         *  Blocks until the specified time for data to be available.
+         *  Check if the FileSink is ready to accept data, that is, if
+         *  the queue of the I/O thread has room. Does not block.
          *
-         *  @param sec the maximum seconds to block.
-         *  @param usec micro seconds to block after the full seconds.
+         *  @param sec not used.
+         *  @param usec not used.
          *  @return true if the Sink is ready to accept data, false otherwise.
          *  @exception Exception
          */
@@ -252,11 +544,13 @@ class FileSink : public Sink, public virtual Reporter
                        unsigned int    usec )       ;
 
         /**
-         *  Write data to the FileSink.
+         *  Write data to the FileSink. The data is queued for the I/O
+         *  thread.
          *
          *  @param buf the data to write.
          *  @param len number of bytes to write from buf.
-         *  @return the number of bytes written (may be less than len).
+         *  @return the number of bytes written: len, or 0 if the data
+         *          was dropped for a full queue.
          *  @exception Exception
          */
         virtual unsigned int
@@ -264,25 +558,86 @@ class FileSink : public Sink, public virtual Reporter
                        unsigned int    len )        ;
 
         /**
-         *  This is a no-op in this FileSink.
+         *  Write a packet of data to the FileSink. The packet itself is
+         *  queued for the I/O thread, without copying its data.
          *
+         *  @param packet the data to write.
+         *  @return the number of bytes written: the size of the packet,
+         *          or 0 if it was dropped for a full queue.
          *  @exception Exception
          */
+        virtual unsigned int
+        writePacket (   Packet        * packet )    ;
+
+        /**
+         *  Keep the data the stream starts with, to write it first to
+         *  each new file after a cut.
+         *
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
         inline virtual void
-        flush ( void )                              
+        setHeader (     Packet        * header )
         {
+            this->header = header;
         }
 
+        /**
+         *  Check if the Sink writes to a file only.
+         *
+         *  @return true.
+         */
+        inline virtual bool
+        isFile ( void ) const                       throw ()
+        {
+            return true;
+        }
+
+        /**
+         *  Have the I/O thread write out what it has collected so far.
+         *  Does not wait for the data to be written.
+         *
+         *  @exception Exception
+         */
+        virtual void
+        flush ( void )                              ;
+
         /**
          *  Cut what the sink has been doing so far, and start anew.
          *  This usually means separating the data sent to the sink up
-         *  until now, and start saving a new chunk of data.
+         *  until now, and start saving a new chunk of data. The file is
+         *  moved and started anew by the I/O thread, after the data
+         *  written before. The new file starts with the header of the
+         *  stream, if any.
          */
         virtual void
         cut ( void )                                    throw ();
 
         /**
-         *  Close the FileSink.
+         *  Cut at a known time, such as the rotation of the file. The
+         *  new file is named after that time, and it is the one created
+         *  ahead by prepareCut(), if any.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch.
+         */
+        virtual void
+        cutAt (     double          boundary )          throw ();
+
+        /**
+         *  Get ready for a cut coming at a known time. When a date is
+         *  added to the file name, the I/O thread creates and opens the
+         *  next file now, named after the time of the cut, so that the
+         *  cutAt() that time only starts writing to it.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        virtual void
+        prepareCut (    double          boundary )      throw ();
+
+        /**
+         *  Close the FileSink, waiting for all the data written to it
+         *  to be written to the file.
          *
          *  @exception Exception
          */
@@ -16,6 +16,7 @@
 
 #include "Exception.h"
 #include "Util.h"
+#include "SampleConv.h"
 #include "FlacLibEncoder.h"
 #include "CastSink.h"
 
@@ -29,6 +30,12 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The number of packets the Ogg pages are written in, beyond which
+ *  packets are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxPooledPackets = 256;
+
 
 /* ===============================================  local function prototypes */
 
@@ -45,9 +52,10 @@ FlacLibEncoder :: init ( unsigned int compression )
 
     this->compression = compression;
 
-    if ( getInBitsPerSample() != 16 ) {
+    if ( !isInFloat() && getInBitsPerSample() != 16
+      && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
         throw Exception( __FILE__, __LINE__,
-                         "only 16 bits per sample supported at the moment",
+                         "only 16, 24 or 32 bits per sample supported",
                          getInBitsPerSample() );
     }
 
@@ -68,7 +76,9 @@ FlacLibEncoder :: init ( unsigned int compression )
                          compression );
     }
 
-    encoderOpen = false;
+    encoderOpen   = false;
+    pageHeaderLen = 0;
+    pool          = new PacketPool( maxPooledPackets);
 }
 
 
@@ -96,11 +106,13 @@ FlacLibEncoder :: open ( void )
     }
     FLAC__stream_encoder_set_channels(se, getInChannel());
     FLAC__stream_encoder_set_ogg_serial_number(se, rand());
-    FLAC__stream_encoder_set_bits_per_sample(se, getInBitsPerSample());
+    FLAC__stream_encoder_set_bits_per_sample(se, getFlacBitsPerSample());
     FLAC__stream_encoder_set_sample_rate(se, getInSampleRate());
     FLAC__stream_encoder_set_compression_level(se, this->compression);
 
     FLAC__StreamEncoderInitStatus status;
+    pageHeaderLen  = 0;
+    headerPagesLen = 0;
     status = FLAC__stream_encoder_init_ogg_stream(se, NULL,
                    FlacLibEncoder::encoder_cb,
                    NULL, NULL, NULL, this);
@@ -109,6 +121,14 @@ FlacLibEncoder :: open ( void )
                          "FLAC encoder initialisation failed");
     }
 
+    // the metadata written on init is the header of the stream, kept by
+    // the sinks to start over with
+    if (headerPagesLen) {
+        Ref<Packet> header = new Packet(headerPages.get(), headerPagesLen);
+        getSink()->setHeader(header.get());
+        getSink()->writePacket(header.get());
+    }
+
     encoderOpen = true;
 
     return true;
@@ -125,9 +145,31 @@ FlacLibEncoder :: encoder_cb (const FLAC__StreamEncoder *encoder,
                               uint32_t current_frame,
                               void *flacencoder ) {
     FlacLibEncoder *fle = (FlacLibEncoder*)flacencoder;
-    unsigned int written = fle->getSink()->write(buffer, len);
     // Write callback is called twice; once for the page header, once for the
-    // page body. When page header is written, samples is 0.
+    // page body. Keep the header until the body arrives, and write the page
+    // as a single packet.
+    if (fle->pageHeaderLen == 0) {
+        memcpy(fle->pageHeader.reserve(len), buffer, len);
+        fle->pageHeaderLen = len;
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+    if (!fle->encoderOpen) {
+        // metadata on init, see open()
+        unsigned int size = fle->headerPagesLen + fle->pageHeaderLen + len;
+        unsigned char *pages = fle->headerPages.grow(size,
+                                                     fle->headerPagesLen);
+        memcpy(pages + fle->headerPagesLen, fle->pageHeader.get(),
+               fle->pageHeaderLen);
+        memcpy(pages + fle->headerPagesLen + fle->pageHeaderLen, buffer, len);
+        fle->headerPagesLen = size;
+        fle->pageHeaderLen = 0;
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+    Ref<Packet> packet = fle->pool->get(fle->pageHeader.get(),
+                                        fle->pageHeaderLen, buffer, len);
+    fle->pageHeaderLen = 0;
+    unsigned int written = fle->getSink()->writePacket(packet.get());
+    // Pages of metadata have no samples.
     if (samples != 0) {
         fle->written = written;
     }
@@ -144,15 +186,37 @@ FlacLibEncoder :: write ( const void   * buf,
     if ( !isOpen() || len == 0 ) {
         return 0;
     }
-    this->written = 0;
+    return writeFrame( toFrame( buf, len));
+}
 
-    unsigned int   bitsPerSample = getInBitsPerSample();
-    unsigned char *b = (unsigned char*)buf;
-    const uint32_t samples = len>>1;
-    const uint32_t samples_per_channel = samples/getInChannel();
-    FLAC__int32 *buffer = new FLAC__int32[samples];
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+FlacLibEncoder :: writeFrame (  const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
+    }
+    this->written = 0;
 
-    Util::conv<FLAC__int32>(bitsPerSample, b, len, buffer, isInBigEndian());
+    const uint32_t samples = frame->getSamples() * frame->getChannel();
+    const uint32_t samples_per_channel = frame->getSamples();
+    FLAC__int32 *buffer = sampleBuffer.reserve(samples);
+
+    if (getFlacBitsPerSample() == 24) {
+        // the float view keeps the resolution of the input
+        SampleConv::floatToInt(frame->getFloat(), samples, buffer);
+        for (uint32_t i = 0; i < samples; ++i) {
+            buffer[i] >>= 8;
+        }
+    } else {
+        const int16_t * b = frame->getShort();
+
+        for (uint32_t i = 0; i < samples; ++i) {
+            buffer[i] = b[i];
+        }
+    }
 
     if (!FLAC__stream_encoder_process_interleaved(se, buffer,
                                                   samples_per_channel)) {
@@ -163,7 +227,6 @@ FlacLibEncoder :: write ( const void   * buf,
         throw Exception( __FILE__, __LINE__, msg);
     }
 
-    delete[] buffer;
     return this->written;
 }
 
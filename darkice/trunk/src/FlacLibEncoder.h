@@ -25,6 +25,8 @@
 #include "Exception.h"
 #include "Reporter.h"
 #include "AudioEncoder.h"
+#include "ScratchBuffer.h"
+#include "PacketPool.h"
 #include "Sink.h"
 #ifdef HAVE_SRC_LIB
 #include <samplerate.h>
@@ -74,6 +76,39 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
          */
         unsigned int                    compression;
 
+        /**
+         *  Buffer for the samples handed to the encoder,
+         *  kept between writes.
+         */
+        ScratchBuffer<FLAC__int32>      sampleBuffer;
+
+        /**
+         *  The header of the Ogg page being written, kept until its
+         *  body arrives, so that the page is written as a whole.
+         */
+        ScratchBuffer<unsigned char>    pageHeader;
+
+        /**
+         *  The number of bytes in pageHeader, 0 if none is kept.
+         */
+        unsigned int                    pageHeaderLen;
+
+        /**
+         *  The metadata pages the encoder writes when opened, collected
+         *  to be the header of the stream.
+         */
+        ScratchBuffer<unsigned char>    headerPages;
+
+        /**
+         *  The number of bytes in headerPages.
+         */
+        unsigned int                    headerPagesLen;
+
+        /**
+         *  The packets the Ogg pages are written in.
+         */
+        PacketPool                    * pool;
+
         /**
          *  Initialize the object.
          *
@@ -83,6 +118,18 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
         void
         init ( unsigned int );
 
+        /**
+         *  Get the number of bits per sample to encode. Float input is
+         *  encoded as 16 bit samples, 32 bit input as 24 bit samples.
+         *
+         *  @return the number of bits per sample of the FLAC stream.
+         */
+        inline unsigned int
+        getFlacBitsPerSample ( void ) const         throw ()
+        {
+            return isInFloat() || getInBitsPerSample() <= 16 ? 16 : 24;
+        }
+
         /**
          * Encoder write callback function
          */
@@ -102,6 +149,7 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
         inline void
         strip ( void )
         {
+            delete pool;
         }
 
 
@@ -181,6 +229,8 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
          *  @param outChannel number of channels of the output.
          *                    If 0, input channel is used.
          *  @param compression compression level
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them.
          *  @exception Exception
          */
         inline
@@ -191,7 +241,8 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
                             double                  outQuality,
                             unsigned int            outSampleRate = 0,
                             unsigned int            outChannel    = 0,
-                            unsigned int            compression = 0)
+                            unsigned int            compression = 0,
+                            ChannelMap            * channelMap    = 0 )
 
                     : AudioEncoder ( sink,
                                      as,
@@ -199,7 +250,8 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
                                      outBitrate,
                                      outQuality,
                                      outSampleRate,
-                                     outChannel )
+                                     outChannel,
+                                     channelMap )
         {
             init( compression );
         }
@@ -353,6 +405,17 @@ class FlacLibEncoder : public AudioEncoder, public virtual Reporter
         write (        const void   * buf,
                        unsigned int   len )        ;
 
+        /**
+         *  Write a frame of audio to the encoder. Float input is encoded
+         *  as 16 bit samples.
+         *
+         *  @param frame the audio to encode.
+         *  @return the number of bytes written to the underlying sink.
+         *  @exception Exception
+         */
+        virtual unsigned int
+        writeFrame (   const AudioFrame    * frame )        ;
+
         /**
          *  Flush all data that was written to the encoder to the underlying
          *  connection.
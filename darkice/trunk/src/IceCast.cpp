@@ -197,6 +197,9 @@ IceCast :: sendLogin ( void )
     sink->flush();
 
     /* read the anticipated response: "OK" */
+    if ( !source->canRead( loginTimeout, 0) ) {
+        return false;
+    }
     len = source->read( resp, STRBUF_SIZE);
 
     reportEvent(5,resp);
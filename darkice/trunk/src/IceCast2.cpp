@@ -247,6 +247,10 @@ IceCast2 :: sendLogin ( void )
     sink->flush();
 
     // read the response, expected response begins with responseOK
+    // a server that doesn't answer in time is as good as one refusing us
+    if ( !source->canRead( loginTimeout, 0) ) {
+        return false;
+    }
     if ( (len = source->read( resp, buflen )) < responseLen ) {
         return false; // short read, no need to continue
     }
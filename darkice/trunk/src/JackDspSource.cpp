@@ -86,9 +86,32 @@
 #include <stdio.h>
 #endif
 
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#else
+#error need errno.h
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#error need fcntl.h
+#endif
+
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#else
+#error need poll.h
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #include <climits>
 
 #include "Util.h"
+#include "SampleConv.h"
 #include "Exception.h"
 #include "JackDspSource.h"
 
@@ -116,13 +139,16 @@ void
 JackDspSource :: init ( const char* name )           
 {
     // Set defaults
-    ports[0]     = NULL;        // Left Port
-    ports[1]     = NULL;        // Right Port
-    rb[0]        = NULL;        // Left Ring Buffer
-    rb[1]        = NULL;        // Right Ring Buffer
+    ports        = new jack_port_t*[getChannel()];
+    for (unsigned int c = 0; c < getChannel(); c++) {
+        ports[c] = NULL;
+    }
+    rb           = NULL;        // Interleaved Ring Buffer
+    wakeFds[0]   = -1;          // Wake up descriptors
+    wakeFds[1]   = -1;
+    readFrames   = 0;
     client       = NULL;
     auto_connect = false;       // Default is to not auto connect the JACK ports
-    tmp_buffer   = NULL;        // Buffer big enough for one 'read' of audio
 
     // Auto connect the ports ?
     if ( Util::strEq( name, "jack_auto", 9) ) {
@@ -130,9 +156,11 @@ JackDspSource :: init ( const char* name )
     }
     
     // Check the sample size
-    if (getBitsPerSample() != 16) {
+    if (getBitsPerSample() != 16 && getBitsPerSample() != 24
+     && getBitsPerSample() != 32) {
         throw Exception( __FILE__, __LINE__,
-                        "JackDspSource doesn't support non 16-bit samples");
+                        "JackDspSource only supports 16, 24 or 32 bit "
+                        "or float samples");
     }
 }
 
@@ -147,18 +175,13 @@ JackDspSource :: strip ( void )
     if ( isOpen() ) {
         close();
     }
-    
-    // Free the temporary buffer
-    if (tmp_buffer) {
-        free(tmp_buffer);
-        tmp_buffer = NULL;
-    }
 
+    delete[] ports;
 }
 
 /*------------------------------------------------------------------------------
  *  Attempt to connect up the JACK ports automatically
- *   - Just connect left&right to the first two output ports we find
+ *   - Just connect each channel to the next output port we find
  *----------------------------------------------------------------------------*/
 void
 JackDspSource :: do_auto_connect ( void )                   
@@ -232,52 +255,56 @@ JackDspSource :: open ( void )
     }
 
 
-    // Register ports with Jack
-    if (getChannel() == 1) {
-        if (!(ports[0] = jack_port_register(client,
-                                            "mono",
-                                            JACK_DEFAULT_AUDIO_TYPE,
-                                            JackPortIsInput,
-                                            0))) {
-            throw Exception( __FILE__, __LINE__,
-                            "Cannot register input port", "mono");
+    // Register ports with Jack, named as usual for mono and stereo
+    for (c = 0; c < getChannel(); c++) {
+        char    port_name[16];
+
+        if (getChannel() == 1) {
+            snprintf(port_name, sizeof(port_name), "mono");
+        } else if (getChannel() == 2) {
+            snprintf(port_name, sizeof(port_name), c ? "right" : "left");
+        } else {
+            snprintf(port_name, sizeof(port_name), "in_%u", c + 1);
         }
-    } else if (getChannel() == 2) {
-        if (!(ports[0] = jack_port_register(client,
-                                            "left",
+
+        if (!(ports[c] = jack_port_register(client,
+                                            port_name,
                                             JACK_DEFAULT_AUDIO_TYPE,
                                             JackPortIsInput,
                                             0))) {
             throw Exception( __FILE__, __LINE__,
-                            "Cannot register input port", "left");
-        }
-        if (!(ports[1] = jack_port_register(client,
-                                            "right",
-                                            JACK_DEFAULT_AUDIO_TYPE,
-                                            JackPortIsInput, 0))) {
-            throw Exception( __FILE__, __LINE__,
-                            "Cannot register input port", "right");
+                            "Cannot register input port", port_name);
         }
-    } else {
-        throw Exception( __FILE__, __LINE__,
-                        "Invalid number of channels", getChannel());
     }
 
 
-    // Create a ring buffer for each channel
+    // Create one ring buffer for all channels, interleaved
     /* will take about 1 MB buffer for each channel */
     rb_size = 5 /* number of seconds */
             * jack_get_sample_rate(client) /* eg 48000 */
+            * getChannel()
             * sizeof (jack_default_audio_sample_t); /* eg 4 bytes */
-            
-    for (c=0; c < getChannel(); c++) {
-        rb[c] = jack_ringbuffer_create(rb_size);
-        if (!rb[c]) {
-            throw Exception( __FILE__, __LINE__,
-                            "Failed to create ringbuffer for", "channel", c);
-        }
+
+    rb = jack_ringbuffer_create(rb_size);
+    if (!rb) {
+        throw Exception( __FILE__, __LINE__, "Failed to create ringbuffer");
     }
 
+    // The process callback wakes up the reader through these
+#ifdef HAVE_SYS_EVENTFD_H
+    wakeFds[0] = eventfd(0, EFD_NONBLOCK);
+    wakeFds[1] = wakeFds[0];
+    if (wakeFds[0] < 0) {
+        throw Exception( __FILE__, __LINE__, "Failed to create eventfd", errno);
+    }
+#else
+    if (pipe(wakeFds)) {
+        throw Exception( __FILE__, __LINE__, "Failed to create pipe", errno);
+    }
+    fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, fcntl(wakeFds[1], F_GETFL) | O_NONBLOCK);
+#endif
+
 
     // Set the callbacks
     jack_on_shutdown(client, JackDspSource::shutdown_callback, (void*)this);
@@ -308,35 +335,44 @@ bool
 JackDspSource :: canRead ( unsigned int   sec,
                            unsigned int   usec )    
 {
-    const unsigned int max_wait_time  = sec * 1000000;
-    const unsigned int wait_increment = 10000;
-    unsigned int       cur_wait       = 0;
+    size_t          frameBytes = getChannel()
+                               * sizeof( jack_default_audio_sample_t );
+    size_t          wanted;
+    struct pollfd   pfd;
+    char            drain[64];
+    int             ret;
 
     if ( !isOpen() ) {
         return false;
     }
 
-    while (max_wait_time > cur_wait) {
-        bool canRead = true;
+    // wait for a whole chunk, rather than waking up on each period,
+    // but not for more than half the ring buffer, which may be all
+    // that's there before the JACK thread has to skip data
+    wanted = readFrames ? readFrames : getPeriodSize();
+    wanted = wanted ? wanted * frameBytes : frameBytes;
+    if (wanted > rb->size / 2) {
+        wanted = rb->size / 2 / frameBytes * frameBytes;
+    }
 
-        for (unsigned int c = 0 ; c < getChannel() ; c++) {
-            if (jack_ringbuffer_read_space(rb[c]) <= 0) {
-                canRead = false;
-            }
-        }
+    pfd.fd     = wakeFds[0];
+    pfd.events = POLLIN;
 
-        if (canRead) {
-            return true;
+    // a wake up sent after the check stays pending on the descriptor,
+    // so it can't get lost between the check and the poll
+    while (jack_ringbuffer_read_space(rb) < wanted) {
+        ret = poll(&pfd, 1, sec * 1000 + usec / 1000);
+        if (ret == 0) {
+            return false;
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw Exception( __FILE__, __LINE__, "poll error", errno);
         }
 
-        cur_wait += wait_increment;
-        usleep ( wait_increment );
-    }
-
-    usleep( usec );
-    for (unsigned int c = 0 ; c < getChannel() ; c++) {
-        if (jack_ringbuffer_read_space(rb[c]) <= 0) {
-            return false;
+        while (::read(wakeFds[0], drain, sizeof(drain)) > 0) {
         }
     }
 
@@ -351,64 +387,69 @@ unsigned int
 JackDspSource :: read (   void          * buf,
                           unsigned int    len )     
 {
-    jack_nframes_t samples         = len / 2 / getChannel();
-    jack_nframes_t samples_read[2] = { 0, 0 };
-    short        * output          = (short*) buf;
-    unsigned int c, n;
+    unsigned int           sampleBytes = getBitsPerSample() / 8;
+    size_t                 frameBytes  = getChannel()
+                                       * sizeof( jack_default_audio_sample_t );
+    size_t                 frames      = len / sampleBytes / getChannel();
+    size_t                 count;
+    size_t                 first;
+    jack_ringbuffer_data_t vec[2];
 
     if ( !isOpen() ) {
         return 0;
     }
+    readFrames = frames;
 
-
-    // Ensure the temporary buffer is big enough
-    tmp_buffer = (jack_default_audio_sample_t*)realloc(tmp_buffer,
-                             samples * sizeof( jack_default_audio_sample_t ) );
-    if (!tmp_buffer) {
-        throw Exception( __FILE__, __LINE__, "realloc on tmp_buffer failed");
+    // Only read whole frames, as much as there is
+    if (frames > jack_ringbuffer_read_space(rb) / frameBytes) {
+        frames = jack_ringbuffer_read_space(rb) / frameBytes;
     }
+    count = frames * getChannel();
 
-    // We must be sure to fetch as many data on both channels
-    int minBytesAvailable = samples * sizeof( jack_default_audio_sample_t );
-
-    for (c=0; c < getChannel(); c++) {
-        int readable = jack_ringbuffer_read_space(rb[c]);
-        if (readable < minBytesAvailable) {
-            minBytesAvailable = readable;
+    // The samples are interleaved already, so float samples are just
+    // copied, and the others converted right out of the ring buffer
+    if (isFloat()) {
+        jack_ringbuffer_read(rb, (char*) buf, frames * frameBytes);
+    } else {
+        jack_ringbuffer_get_read_vector(rb, vec);
+        first = vec[0].len / sizeof( jack_default_audio_sample_t );
+        if (first > count) {
+            first = count;
         }
+        convertOut((const float*) vec[0].buf, first, (unsigned char*) buf);
+        if (count > first) {
+            convertOut((const float*) vec[1].buf, count - first,
+                       (unsigned char*) buf + first * sampleBytes);
+        }
+        jack_ringbuffer_read_advance(rb, frames * frameBytes);
     }
 
-    for (c=0; c < getChannel(); c++) {    
-        // Copy frames from ring buffer to temporary buffer
-        // and then convert samples to output buffer
-        int bytes_read = jack_ringbuffer_read(rb[c],
-                                             (char*)tmp_buffer,
-                              minBytesAvailable);
-        samples_read[c] = bytes_read / sizeof( jack_default_audio_sample_t );
-        
+    // Return the number of bytes put in the output buffer
+    return frames * sampleBytes * getChannel();
+}
 
-        // Convert samples from float to short and put in output buffer
-        for(n=0; n<samples_read[c]; n++) {
-            int tmp = lrintf(tmp_buffer[n] * 32768.0f);
-            if (tmp > SHRT_MAX) {
-                output[n*getChannel()+c] = SHRT_MAX;
-            } else if (tmp < SHRT_MIN) {
-                output[n*getChannel()+c] = SHRT_MIN;
-            } else {
-                output[n*getChannel()+c] = (short) tmp;
-            }
-        }
-    }
 
-    // Didn't get as many samples as we wanted ?
-    if (getChannel() == 2 && samples_read[0] != samples_read[1]) {
-        Reporter::reportEvent( 2,
-                              "Warning: Read a different number of samples "
-                              "for left and right channels");
+/*------------------------------------------------------------------------------
+ *  Convert float samples to the sample format of the source
+ *----------------------------------------------------------------------------*/
+void
+JackDspSource :: convertOut (   const float       * in,
+                                size_t              count,
+                                unsigned char     * out )   throw ()
+{
+    switch (getBitsPerSample()) {
+        case 16:
+            SampleConv::floatToShort(in, count, (int16_t*) out);
+            break;
+
+        case 24:
+            SampleConv::floatToInt24(in, count, out, isBigEndian());
+            break;
+
+        default:
+            SampleConv::floatToInt(in, count, (int32_t*) out);
+            break;
     }
-
-    // Return the number of bytes put in the output buffer
-    return samples_read[0] * 2 * getChannel();
 }
 
 
@@ -430,12 +471,6 @@ JackDspSource :: close ( void )
             jack_port_unregister( client, ports[i] );
             ports[i] = NULL;
         }
-        
-        // Free up the ring buffer for channel
-        if ( rb[i] ) {
-            jack_ringbuffer_free( rb[i] );
-            rb[i] = NULL;
-        }
     }
 
     /* Leave the jack graph */
@@ -444,6 +479,20 @@ JackDspSource :: close ( void )
         client = NULL;
     }
 
+    // The process callback is not called any more, free what it used
+    if ( rb ) {
+        jack_ringbuffer_free( rb );
+        rb = NULL;
+    }
+    if ( wakeFds[0] >= 0 ) {
+        ::close( wakeFds[0] );
+        if ( wakeFds[1] != wakeFds[0] ) {
+            ::close( wakeFds[1] );
+        }
+        wakeFds[0] = -1;
+        wakeFds[1] = -1;
+    }
+
 }
 
 
@@ -451,40 +500,69 @@ JackDspSource :: close ( void )
  *  Callback called by JACK when audio is available
  *
  *  Don't do anything too expensive here
- *      - just shove audio samples in ring buffer
+ *      - just shove audio samples in ring buffer, interleaved,
+ *        and wake up the reader
  *----------------------------------------------------------------------------*/
 int
 JackDspSource :: process_callback( jack_nframes_t nframes, void *arg )
 {
     JackDspSource* self     = (JackDspSource*)arg;
-    size_t         to_write = sizeof (jack_default_audio_sample_t) * nframes;
+    unsigned int   channels = self->getChannel();
+    size_t         to_write = sizeof (jack_default_audio_sample_t)
+                            * nframes * channels;
+    jack_ringbuffer_data_t vec[2];
+    size_t         first;
     unsigned int   c;
+    jack_nframes_t i;
+    uint64_t       one      = 1;
     
     // Wait until it is ready
-    if (self->client == NULL) {
+    if (self->client == NULL || self->rb == NULL) {
         return 0;
     }
     
-    /* copy data to ringbuffer; one per channel */
-    for (c=0; c < self->getChannel(); c++) {
-      /* check space */
-        size_t len;
-        if (jack_ringbuffer_write_space(self->rb[c]) < to_write) {
-            /* buffer is overflowing, skip the incoming data */
-            jack_ringbuffer_write_advance(self->rb[c], to_write); 
-            /* prevent blocking the ring buffer by updating internal pointers 
-             * jack will now not terminate on xruns
-             */
-            Reporter::reportEvent( 1, "ring buffer full, skipping data");
-            /* We do not return error to jack callback handler and keep going */
-        } else {
-            /* buffer has space, put data into ringbuffer */
-            len = jack_ringbuffer_write(self->rb[c], (char *) jack_port_get_buffer(
-                    self->ports[c], nframes), to_write);
-            if (len != to_write) 
-                Reporter::reportEvent( 1, "failed to write to ring buffer (can not happen)");
+    if (jack_ringbuffer_write_space(self->rb) < to_write) {
+        /* buffer is overflowing, skip the incoming data, but keep going
+         * so that jack will not terminate on xruns */
+        Reporter::reportEvent( 1, "ring buffer full, skipping data");
+        self->noteXrun();
+        return 0;
+    }
+
+    /* interleave the channels right into the ring buffer, which may
+     * wrap around anywhere, even in the middle of a frame */
+    jack_ringbuffer_get_write_vector(self->rb, vec);
+    first = vec[0].len / sizeof (jack_default_audio_sample_t);
+    for (c=0; c < channels; c++) {
+        const jack_default_audio_sample_t * in =
+                (const jack_default_audio_sample_t *)
+                        jack_port_get_buffer(self->ports[c], nframes);
+        jack_default_audio_sample_t       * out =
+                (jack_default_audio_sample_t *) vec[0].buf;
+        jack_default_audio_sample_t       * wrapped =
+                (jack_default_audio_sample_t *) vec[1].buf;
+
+        for (i = 0; i < nframes; i++) {
+            size_t  k = (size_t) i * channels + c;
+
+            if (k < first) {
+                out[k] = in[i];
+            } else {
+                wrapped[k - first] = in[i];
+            }
         }
     }
+    jack_ringbuffer_write_advance(self->rb, to_write);
+
+    /* this fails with EAGAIN only if the reader is to be woken up
+     * already */
+#ifdef HAVE_SYS_EVENTFD_H
+    if (write(self->wakeFds[1], &one, sizeof(one)) < 0 && errno != EAGAIN) {
+#else
+    if (write(self->wakeFds[1], &one, 1) < 0 && errno != EAGAIN) {
+#endif
+        Reporter::reportEvent( 1, "can't wake up the reader", errno);
+    }
 
     // Success
     return 0;
@@ -73,25 +73,34 @@ class JackDspSource : public AudioSource, public virtual Reporter
         const char                   * jack_client_name;
 
         /**
-         *  The jack port
+         *  The jack ports, one for each channel.
          */
-        jack_port_t                  * ports[2];
+        jack_port_t                 ** ports;
 
         /**
-         *  The jack ring buffer.
+         *  The jack ring buffer, holding the samples of all channels
+         *  interleaved. Written by the JACK thread, read by read().
          */
-        jack_ringbuffer_t            * rb[2];
+        jack_ringbuffer_t            * rb;
 
         /**
-         *  The jack client.
+         *  The descriptors to wake up the reader when the JACK thread
+         *  has written to the ring buffer: the end to poll and the end
+         *  to write. Both are the same eventfd, where there is one.
          */
-        jack_client_t                * client;
+        int                            wakeFds[2];
+
+        /**
+         *  The frames asked for by the last read, canRead() waits for
+         *  that many to be in the ring buffer. 0 before the first read.
+         */
+        size_t                         readFrames;
 
         /**
-         *  The jack audio sample buffer.
+         *  The jack client.
          */
-        jack_default_audio_sample_t * tmp_buffer;
-        
+        jack_client_t                * client;
+
          /**
          *  Automatically connect the jack ports ? (default is to not)
          */
@@ -127,6 +136,19 @@ class JackDspSource : public AudioSource, public virtual Reporter
         strip ( void )                              ;
 
 
+        /**
+         *  Convert float samples read from the ring buffer
+         *  to the sample format of the source.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the converted samples here.
+         */
+        void
+        convertOut (    const float       * in,
+                        size_t              count,
+                        unsigned char     * out )   throw ();
+
         /**
          *  Attempt to connect up the JACK ports automatically
          */
@@ -156,6 +178,7 @@ class JackDspSource : public AudioSource, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channels number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param floatSamples true to read 32 bit float samples.
          *  @exception Exception
          */
         inline
@@ -163,10 +186,14 @@ class JackDspSource : public AudioSource, public virtual Reporter
                         const char    * jackClientName,
                         int             sampleRate    = 44100,
                         int             bitsPerSample = 16,
-                        int             channels      = 2 )
+                        int             channels      = 2,
+                        bool            floatSamples  = false )
                                                         
 
-                    : AudioSource( sampleRate, bitsPerSample, channels )
+                    : AudioSource( sampleRate,
+                                   bitsPerSample,
+                                   channels,
+                                   floatSamples )
         {
             jack_client_name = jackClientName;
             init( name );
@@ -234,9 +261,22 @@ class JackDspSource : public AudioSource, public virtual Reporter
             return client != NULL;
         }
 
+        /**
+         *  Get the number of samples JACK delivers in a process cycle.
+         *
+         *  @return the JACK buffer size, or 0 if not open.
+         */
+        inline virtual unsigned int
+        getPeriodSize ( void ) const                    throw ()
+        {
+            return client ? jack_get_buffer_size( client) : 0;
+        }
+
         /**
          *  Check if the JackDspSource can be read from.
-         *  Blocks until the specified time for data to be available.
+         *  Blocks until the specified time for as much data as the last
+         *  read asked for, or a JACK period before the first read, to
+         *  be available.
          *  Puts the Jack DSP device into recording mode.
          *
          *  @param sec the maximum seconds to block.
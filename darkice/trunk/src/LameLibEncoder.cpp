@@ -265,7 +265,10 @@ LameLibEncoder :: open ( void )
 	if (getReportVerbosity() >= 3) {
  	   lame_print_config( lameGlobalFlags);
 	}
-	
+
+    // enough for flushing, grows on the first write
+    mp3Buffer.reserve( 7200);
+
     return true;
 }
 
@@ -281,58 +284,43 @@ LameLibEncoder :: write (   const void    * buf,
         return 0;
     }
 
-    unsigned int    bitsPerSample = getInBitsPerSample();
-    unsigned int    inChannels    = getInChannel();
-
-    unsigned int    sampleSize = (bitsPerSample / 8) * inChannels;
-    unsigned char * b = (unsigned char*) buf;
-    unsigned int    processed = len - (len % sampleSize);
-    unsigned int    nSamples = processed / sampleSize;
-    short int     * leftBuffer  = new short int[nSamples];
-    short int     * rightBuffer = new short int[nSamples];
-
-    if ( bitsPerSample == 8 ) {
-        Util::conv8( b, processed, leftBuffer, rightBuffer, inChannels);
-    } else if ( bitsPerSample == 16 ) {
-        Util::conv16( b,
-                      processed,
-                      leftBuffer,
-                      rightBuffer,
-                      inChannels,
-                      isInBigEndian());
-    } else {
-        delete[] leftBuffer;
-        delete[] rightBuffer;
-        throw Exception( __FILE__, __LINE__,
-                        "unsupported number of bits per sample for the encoder",
-                         bitsPerSample );
+    return writeFrame( toFrame( buf, len));
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+LameLibEncoder :: writeFrame (  const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
     }
 
+    unsigned int    inChannels = getInChannel();
+    unsigned int    nSamples   = frame->getSamples();
+
     // data chunk size estimate according to lame documentation
     // NOTE: mp3Size is calculated based on the number of input channels
     //       which may be bigger than need, as output channels can be less
     unsigned int    mp3Size = (unsigned int) (1.25 * nSamples + 7200);
-    unsigned char * mp3Buf  = new unsigned char[mp3Size];
+    unsigned char * mp3Buf  = mp3Buffer.reserve( mp3Size);
     int             ret;
 
     ret = lame_encode_buffer( lameGlobalFlags,
-                              leftBuffer,
-                              inChannels == 2 ? rightBuffer : leftBuffer,
+                              frame->getShort( 0),
+                              frame->getShort( inChannels == 2 ? 1 : 0),
                               nSamples,
                               mp3Buf,
                               mp3Size );
 
-    delete[] leftBuffer;
-    delete[] rightBuffer;
-
     if ( ret < 0 ) {
         reportEvent( 3, "lame encoding error", ret);
-        delete[] mp3Buf;
         return 0;
     }
 
     unsigned int    written = getSink()->write( mp3Buf, ret);
-    delete[] mp3Buf;
     // just let go data that could not be written
     if ( written < (unsigned int) ret ) {
         reportEvent( 2,
@@ -340,7 +328,7 @@ LameLibEncoder :: write (   const void    * buf,
                      ret - written);
     }
 
-    return processed;
+    return frame->getSize();
 }
 
 
@@ -357,13 +345,12 @@ LameLibEncoder :: flush ( void )
 
     // data chunk size estimate according to lame documentation
     unsigned int    mp3Size = 7200;
-    unsigned char * mp3Buf  = new unsigned char[mp3Size];
+    unsigned char * mp3Buf  = mp3Buffer.reserve( mp3Size);
     int             ret;
 
     ret = lame_encode_flush( lameGlobalFlags, mp3Buf, mp3Size );
 
     unsigned int    written = getSink()->write( mp3Buf, ret);
-    delete[] mp3Buf;
 
     // just let go data that could not be written
     if ( written < (unsigned int) ret ) {
@@ -51,6 +51,7 @@
 #include "Exception.h"
 #include "Reporter.h"
 #include "AudioEncoder.h"
+#include "ScratchBuffer.h"
 #include "Sink.h"
 
 
@@ -78,6 +79,11 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
          */
         lame_global_flags             * lameGlobalFlags;
 
+        /**
+         *  Buffer for the encoded mp3 data, kept between writes.
+         */
+        ScratchBuffer<unsigned char>    mp3Buffer;
+
         /**
          *  Lowpass filter. Sound frequency in Hz, from where up the
          *  input is cut.
@@ -111,7 +117,9 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
             this->lowpass         = lowpass;
             this->highpass        = highpass;
 
-            if ( getInBitsPerSample() != 16 && getInBitsPerSample() != 8 ) {
+            if ( !isInFloat()
+              && getInBitsPerSample() != 16 && getInBitsPerSample() != 8
+              && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
                 throw Exception( __FILE__, __LINE__,
                                  "specified bits per sample not supported",
                                  getInBitsPerSample() );
@@ -236,6 +244,8 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
          *                  Input below this frequency is cut.
          *                  If 0, lame's default values are used,
          *                  which depends on the out sample rate.
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them.
          *  @exception Exception
          */
         inline
@@ -247,7 +257,8 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
                             unsigned int            outSampleRate = 0,
                             unsigned int            outChannel    = 0,
                             int                     lowpass       = 0,
-                            int                     highpass      = 0 )
+                            int                     highpass      = 0,
+                            ChannelMap            * channelMap    = 0 )
                                                             
             
                     : AudioEncoder ( sink,
@@ -256,7 +267,8 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
                                      outBitrate,
                                      outQuality,
                                      outSampleRate,
-                                     outChannel )
+                                     outChannel,
+                                     channelMap )
         {
             init( lowpass, highpass);
         }
@@ -409,6 +421,17 @@ class LameLibEncoder : public AudioEncoder, public virtual Reporter
         write (        const void    * buf,
                        unsigned int    len )        ;
 
+        /**
+         *  Write a frame of audio to the encoder, using the already
+         *  converted samples of the frame.
+         *
+         *  @param frame the audio to encode.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        virtual unsigned int
+        writeFrame (   const AudioFrame    * frame )        ;
+
         /**
          *  Flush all data that was written to the encoder to the underlying
          *  connection.
@@ -0,0 +1,481 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : MetricsServer.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error need stdio.h
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#else
+#error need sys/types.h
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#else
+#error need errno.h
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#else
+#error need sys/socket.h
+#endif
+
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#else
+#error need netinet/in.h
+#endif
+
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#else
+#error need sys/un.h
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#error need unistd.h
+#endif
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#error need sys/time.h
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#else
+#error need signal.h
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#else
+#error need sched.h
+#endif
+
+
+#include "Util.h"
+#include "Exception.h"
+#include "MetricsServer.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The maximum size of a request read
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxRequestSize = 4096;
+
+/*------------------------------------------------------------------------------
+ *  The flags to send with
+ *----------------------------------------------------------------------------*/
+#ifdef HAVE_MSG_NOSIGNAL
+static const int sendFlags = MSG_NOSIGNAL;
+#else
+static const int sendFlags = 0;
+#endif
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: init ( MetricsSource     * source,
+                        unsigned int        port,
+                        const char        * socketPath )
+{
+    if ( !source ) {
+        throw Exception( __FILE__, __LINE__, "no metrics source");
+    }
+    if ( !socketPath && (port == 0 || port > 65535) ) {
+        throw Exception( __FILE__, __LINE__, "bad metrics port", port);
+    }
+
+    this->source     = source;
+    this->port       = port;
+    this->socketPath = socketPath ? Util::strDup( socketPath) : 0;
+    this->listenFd   = -1;
+    this->thread     = 0;
+    this->running    = false;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: strip ( void )
+{
+    stop();
+
+    if ( socketPath ) {
+        delete[] socketPath;
+        socketPath = 0;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start listening and serving requests
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: start ( void )
+{
+    pthread_attr_t      attr;
+    struct sched_param  param;
+    int                 optval = 1;
+
+    if ( running ) {
+        return;
+    }
+
+    if ( socketPath ) {
+        struct sockaddr_un  addr;
+
+        if ( Util::strLen( socketPath) >= sizeof(addr.sun_path) ) {
+            throw Exception( __FILE__, __LINE__,
+                             "metrics socket path too long", socketPath);
+        }
+        memset( &addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        Util::strCpy( addr.sun_path, socketPath);
+
+        if ( (listenFd = socket( AF_UNIX, SOCK_STREAM, 0)) == -1 ) {
+            throw Exception( __FILE__, __LINE__, "socket error", errno);
+        }
+        // a socket left over from an earlier run would make bind fail
+        unlink( socketPath);
+        if ( bind( listenFd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ) {
+            ::close( listenFd);
+            listenFd = -1;
+            throw Exception( __FILE__, __LINE__,
+                             "can't bind metrics socket", socketPath, errno);
+        }
+    } else {
+        struct sockaddr_in  addr;
+
+        memset( &addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons( port);
+        addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK);
+
+        if ( (listenFd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1 ) {
+            throw Exception( __FILE__, __LINE__, "socket error", errno);
+        }
+        setsockopt( listenFd, SOL_SOCKET, SO_REUSEADDR,
+                    &optval, sizeof(optval));
+        if ( bind( listenFd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ) {
+            ::close( listenFd);
+            listenFd = -1;
+            throw Exception( __FILE__, __LINE__,
+                             "can't bind metrics port", errno);
+        }
+    }
+
+    if ( listen( listenFd, 4) == -1 ) {
+        ::close( listenFd);
+        listenFd = -1;
+        throw Exception( __FILE__, __LINE__, "listen error", errno);
+    }
+
+    // serving metrics must never compete with the real-time threads
+    pthread_attr_init( &attr);
+    pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam( &attr, &param);
+
+    running = true;
+    if ( pthread_create( &thread, &attr, threadFunction, this) ) {
+        running = false;
+        pthread_attr_destroy( &attr);
+        ::close( listenFd);
+        listenFd = -1;
+        throw Exception( __FILE__, __LINE__, "can't create metrics thread");
+    }
+    pthread_attr_destroy( &attr);
+
+    if ( socketPath ) {
+        reportEvent( 3, "serving metrics on", socketPath);
+    } else {
+        reportEvent( 3, "serving metrics on localhost port", port);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Stop serving requests
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: stop ( void )
+{
+    if ( !running ) {
+        return;
+    }
+
+    // the thread notices this within a second
+    running = false;
+    pthread_join( thread, 0);
+
+    ::close( listenFd);
+    listenFd = -1;
+    if ( socketPath ) {
+        unlink( socketPath);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The thread function
+ *----------------------------------------------------------------------------*/
+void *
+MetricsServer :: threadFunction ( void    * param )
+{
+    MetricsServer     * server = (MetricsServer *) param;
+    sigset_t            sigset;
+
+    // SIGUSR1 is for the main thread, to cut the recordings
+    sigemptyset( &sigset);
+    sigaddset( &sigset, SIGUSR1);
+    pthread_sigmask( SIG_BLOCK, &sigset, 0);
+
+    server->serve();
+
+    return 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Serve requests until stopped
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: serve ( void )
+{
+    while ( running ) {
+        fd_set              fdset;
+        struct timeval      tv;
+        int                 fd;
+
+        FD_ZERO( &fdset);
+        FD_SET( listenFd, &fdset);
+        tv.tv_sec  = 1;
+        tv.tv_usec = 0;
+
+        if ( select( listenFd + 1, &fdset, NULL, NULL, &tv) <= 0 ) {
+            continue;
+        }
+
+        if ( (fd = accept( listenFd, 0, 0)) == -1 ) {
+            continue;
+        }
+
+        // don't let a stuck client hold up the thread
+        tv.tv_sec  = 1;
+        tv.tv_usec = 0;
+        setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        try {
+            answer( fd);
+        } catch ( Exception   & e ) {
+            reportEvent( 3, "metrics request failed:", e.getDescription());
+        }
+        ::close( fd);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Answer a single request
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: answer ( int   fd )
+{
+    char            request[maxRequestSize + 1];
+    unsigned int    len = 0;
+    std::string     response;
+    std::string     body;
+    const char    * status;
+
+    // read the request header, the request itself does not matter
+    // as long as it is a GET
+    while ( len < maxRequestSize ) {
+        ssize_t     ret = recv( fd, request + len, maxRequestSize - len, 0);
+
+        if ( ret <= 0 ) {
+            break;
+        }
+        len += ret;
+        request[len] = '\0';
+        if ( strstr( request, "\r\n\r\n") || strstr( request, "\n\n") ) {
+            break;
+        }
+    }
+    request[len] = '\0';
+
+    if ( Util::strEq( request, "GET ", 4) ) {
+        status = "200 OK";
+        source->writeMetrics( body);
+    } else {
+        status = "405 Method Not Allowed";
+    }
+
+    response  = "HTTP/1.0 ";
+    response += status;
+    response += "\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                "Connection: close\r\n\r\n";
+    response += body;
+
+    for ( size_t sent = 0; sent < response.size(); ) {
+        ssize_t     ret = send( fd,
+                                response.data() + sent,
+                                response.size() - sent,
+                                sendFlags);
+
+        if ( ret <= 0 ) {
+            break;
+        }
+        sent += ret;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Append the description of a metric
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: appendHelp (   std::string       & out,
+                                const char        * name,
+                                const char        * type,
+                                const char        * help )
+{
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Append a value of a metric
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: appendValue (  std::string       & out,
+                                const char        * name,
+                                const char        * labels,
+                                double              value )
+{
+    char    str[32];
+
+    snprintf( str, sizeof(str), "%.17g", value);
+
+    out += name;
+    if ( labels && *labels ) {
+        out += "{";
+        out += labels;
+        out += "}";
+    }
+    out += " ";
+    out += str;
+    out += "\n";
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Append the quantiles, sum and count of a TimeSummary
+ *----------------------------------------------------------------------------*/
+void
+MetricsServer :: appendSummary (    std::string       & out,
+                                    const char        * name,
+                                    const char        * labels,
+                                    const TimeSummary & summary )
+{
+    static const double     quantiles[] = { 0.5, 0.99 };
+    static const char     * names[]     = { "0.5", "0.99" };
+    double                  values[2];
+    std::string             n;
+
+    summary.getQuantiles( quantiles, values, 2);
+
+    for ( unsigned int i = 0; i < 2; ++i ) {
+        std::string     l;
+
+        if ( labels && *labels ) {
+            l  = labels;
+            l += ",";
+        }
+        l += "quantile=\"";
+        l += names[i];
+        l += "\"";
+        appendValue( out, name, l.c_str(), values[i]);
+    }
+
+    n = name;
+    appendValue( out, (n + "_sum").c_str(), labels, summary.getSum());
+    appendValue( out, (n + "_count").c_str(), labels, summary.getCount());
+}
+
@@ -0,0 +1,348 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : MetricsServer.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+#include <string>
+
+#include "Referable.h"
+#include "Reporter.h"
+#include "Exception.h"
+#include "TimeSummary.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  Something that can describe its state as metrics, in the Prometheus
+ *  text exposition format.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class MetricsSource
+{
+    public:
+
+        /**
+         *  Destructor.
+         */
+        inline virtual
+        ~MetricsSource ( void )
+        {
+        }
+
+        /**
+         *  Append the current metrics to a text.
+         *
+         *  @param out the text to append the metrics to.
+         */
+        virtual void
+        writeMetrics ( std::string    & out )               = 0;
+};
+
+
+/**
+ *  A minimal HTTP server, answering each request with the metrics of a
+ *  MetricsSource, in the Prometheus text exposition format. It listens
+ *  either on a TCP port of the loopback interface, or on a Unix domain
+ *  socket, and serves the requests in a thread of its own, one at
+ *  a time.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class MetricsServer : public virtual Referable, public virtual Reporter
+{
+    private:
+
+        /**
+         *  The source of the metrics served.
+         */
+        MetricsSource     * source;
+
+        /**
+         *  The TCP port to listen on, if listening on the loopback
+         *  interface.
+         */
+        unsigned int        port;
+
+        /**
+         *  The path of the Unix domain socket to listen on, or 0 if
+         *  listening on a TCP port.
+         */
+        char              * socketPath;
+
+        /**
+         *  The listening socket, or -1 if not listening.
+         */
+        int                 listenFd;
+
+        /**
+         *  The thread serving the requests.
+         */
+        pthread_t           thread;
+
+        /**
+         *  Tells if the thread is to go on serving requests.
+         */
+        bool                running;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param source the source of the metrics.
+         *  @param port the TCP port to listen on.
+         *  @param socketPath the Unix domain socket to listen on,
+         *                    or 0 to listen on port.
+         *  @exception Exception
+         */
+        void
+        init (  MetricsSource     * source,
+                unsigned int        port,
+                const char        * socketPath );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Serve requests until stopped.
+         */
+        void
+        serve ( void );
+
+        /**
+         *  Answer a single request.
+         *
+         *  @param fd the connection to the client.
+         */
+        void
+        answer ( int    fd );
+
+        /**
+         *  The thread function.
+         *
+         *  @param param the MetricsServer to run.
+         *  @return nothing.
+         */
+        static void *
+        threadFunction ( void     * param );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        MetricsServer ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception, as a
+         *  listening socket can not be shared.
+         *
+         *  @param server the object to copy.
+         *  @exception Exception
+         */
+        inline
+        MetricsServer ( const MetricsServer   & server )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param server the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline MetricsServer &
+        operator= ( const MetricsServer   & server )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor, for listening on a TCP port of the loopback
+         *  interface.
+         *
+         *  @param source the source of the metrics.
+         *  @param port the TCP port to listen on.
+         *  @exception Exception
+         */
+        inline
+        MetricsServer ( MetricsSource     * source,
+                        unsigned int        port )
+        {
+            init( source, port, 0);
+        }
+
+        /**
+         *  Constructor, for listening on a Unix domain socket.
+         *
+         *  @param source the source of the metrics.
+         *  @param socketPath the path of the socket to listen on.
+         *  @exception Exception
+         */
+        inline
+        MetricsServer ( MetricsSource     * source,
+                        const char        * socketPath )
+        {
+            init( source, 0, socketPath);
+        }
+
+        /**
+         *  Destructor. Stops serving if still running.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~MetricsServer ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Start listening, and serving requests in the background.
+         *
+         *  @exception Exception
+         */
+        void
+        start ( void );
+
+        /**
+         *  Stop serving requests, and stop listening.
+         */
+        void
+        stop ( void );
+
+        /**
+         *  Tell if requests are being served.
+         *
+         *  @return true if requests are being served, false otherwise.
+         */
+        inline bool
+        isRunning ( void ) const                    throw ()
+        {
+            return running;
+        }
+
+        /**
+         *  Append the description of a metric to a text.
+         *
+         *  @param out the text to append to.
+         *  @param name the name of the metric.
+         *  @param type the type of the metric, "counter", "gauge"
+         *              or "summary".
+         *  @param help the description of the metric.
+         */
+        static void
+        appendHelp (    std::string       & out,
+                        const char        * name,
+                        const char        * type,
+                        const char        * help );
+
+        /**
+         *  Append a value of a metric to a text.
+         *
+         *  @param out the text to append to.
+         *  @param name the name of the metric.
+         *  @param labels the labels of the value, like stream="x",
+         *                or 0 if none.
+         *  @param value the value.
+         */
+        static void
+        appendValue (   std::string       & out,
+                        const char        * name,
+                        const char        * labels,
+                        double              value );
+
+        /**
+         *  Append the median, the 99th percentile, the sum and the count
+         *  of a TimeSummary to a text.
+         *
+         *  @param out the text to append to.
+         *  @param name the name of the metric.
+         *  @param labels the labels of the values, or 0 if none.
+         *  @param summary the measurements.
+         */
+        static void
+        appendSummary ( std::string       & out,
+                        const char        * name,
+                        const char        * labels,
+                        const TimeSummary & summary );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* METRICS_SERVER_H */
+
@@ -39,6 +39,30 @@
 #error need sys/types.h
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#error need unistd.h
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#else
+#error need sched.h
+#endif
+
+#ifdef HAVE_TIME_H
+#include <time.h>
+#else
+#error need time.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
 
 #include "Exception.h"
 #include "MultiThreadedConnector.h"
@@ -50,6 +74,34 @@
 
 /* ================================================  local constants & macros */
 
+/*------------------------------------------------------------------------------
+ *  The minimum number of slots in the ring buffer
+ *----------------------------------------------------------------------------*/
+#define MIN_RING_SLOTS      4
+
+/*------------------------------------------------------------------------------
+ *  The number of chunks a sink may be behind before the chunks grow
+ *----------------------------------------------------------------------------*/
+#define GROW_CHUNK_LAG      2
+
+/*------------------------------------------------------------------------------
+ *  The number of chunks in a row all the sinks have to keep up with
+ *  before the chunks shrink
+ *----------------------------------------------------------------------------*/
+#define SHRINK_CHUNK_TURNS  64
+
+/*------------------------------------------------------------------------------
+ *  The seconds the time kept by the audio may drift from the wall clock,
+ *  before it is set to the wall clock again
+ *----------------------------------------------------------------------------*/
+#define MAX_CLOCK_DRIFT     2.0
+
+/*------------------------------------------------------------------------------
+ *  The seconds of audio ahead of a cut at which the sink is told to get
+ *  ready for it
+ *----------------------------------------------------------------------------*/
+#define CUT_LEAD_TIME       5.0
+
 /*------------------------------------------------------------------------------
  *  File identity
  *----------------------------------------------------------------------------*/
@@ -58,20 +110,100 @@ static const char fileid[] = "$Id$";
 
 /* ===============================================  local function prototypes */
 
+/*------------------------------------------------------------------------------
+ *  Get the wall clock time
+ *----------------------------------------------------------------------------*/
+static double
+wallClock ( void )                                          throw ();
+
+/*------------------------------------------------------------------------------
+ *  Get the next boundary after a time, aligned to the local wall clock
+ *----------------------------------------------------------------------------*/
+static double
+nextBoundary (  double          time,
+                unsigned int    interval )                  throw ();
+
 
 /* =============================================================  module code */
 
+/*------------------------------------------------------------------------------
+ *  Get the wall clock time, in seconds since the epoch
+ *----------------------------------------------------------------------------*/
+static double
+wallClock ( void )                                          throw ()
+{
+    struct timespec     ts;
+
+    clock_gettime( CLOCK_REALTIME, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the next boundary after a time, aligned to the local wall clock
+ *----------------------------------------------------------------------------*/
+static double
+nextBoundary (  double          time,
+                unsigned int    interval )                  throw ()
+{
+    time_t      sec = (time_t) time;
+    time_t      local;
+    time_t      next;
+    struct tm   tm;
+
+    // in local time, so that hourly cuts are on the hour in any time zone
+    localtime_r( &sec, &tm);
+    local = sec + tm.tm_gmtoff;
+    local = (local / interval + 1) * interval;
+
+    // back from the local fields, with the UTC offset at the boundary,
+    // which is not the one at the time given across a DST change
+    gmtime_r( &local, &tm);
+    tm.tm_isdst = -1;
+    next        = mktime( &tm);
+
+    if ( next == (time_t) -1 || next <= sec ) {
+        next = sec + interval;
+    }
+
+    return next;
+}
+
 /*------------------------------------------------------------------------------
  *  Initialize the object
  *----------------------------------------------------------------------------*/
 void
-MultiThreadedConnector :: init ( bool    reconnect )    
+MultiThreadedConnector :: init ( bool           reconnect,
+                                 unsigned int   ringSize,
+                                 unsigned int   maxWorkers,
+                                 bool           pinWorkers )
 {
-    this->reconnect = reconnect;
+    this->reconnect  = reconnect;
+    this->ringSize   = ringSize;
+    this->maxWorkers = maxWorkers;
+    this->pinWorkers = pinWorkers;
+    this->firstCpu   = 0;
 
     pthread_mutex_init( &mutexProduce, 0);
     pthread_cond_init( &condProduce, 0);
-    threads = 0;
+    sinkData      = 0;
+    workers       = 0;
+    numWorkers    = 0;
+    running.store( false);
+    sleepers.store( 0);
+    frames        = 0;
+    numFrames     = 0;
+    nextFrame     = 0;
+    slotSize      = 0;
+    numSlots      = 0;
+    slots         = 0;
+    steadyChunks  = 0;
+    resamplers    = 0;
+    numResamplers = 0;
+    rotations     = 0;
+    numRotations  = 0;
+    writeSeq.store( 0);
 }
 
 
@@ -81,10 +213,19 @@ MultiThreadedConnector :: init ( bool    reconnect )
 void
 MultiThreadedConnector :: strip ( void )                
 {
-    if ( threads ) {
-        delete[] threads;
-        threads = 0;
+    destroyRing();
+
+    if ( workers ) {
+        delete[] workers;
+        workers = 0;
     }
+    if ( sinkData ) {
+        delete[] sinkData;
+        sinkData = 0;
+    }
+    delete[] rotations;
+    rotations    = 0;
+    numRotations = 0;
 
     pthread_cond_destroy( &condProduce);
     pthread_mutex_destroy( &mutexProduce);
@@ -99,16 +240,23 @@ MultiThreadedConnector :: MultiThreadedConnector (
                                                             
             : Connector( connector)
 {
-    reconnect       = connector.reconnect;
+    init( connector.reconnect,
+          connector.ringSize,
+          connector.maxWorkers,
+          connector.pinWorkers);
+    firstCpu        = connector.firstCpu;
     mutexProduce    = connector.mutexProduce;
     condProduce     = connector.condProduce;
 
-    if ( threads ) {
-        delete[] threads;
+    for ( unsigned int  i = 0; i < connector.numRotations; ++i ) {
+        setRotation( i, connector.rotations[i]);
     }
-    threads = new ThreadData[numSinks];
-    for ( unsigned int  i = 0; i < numSinks; ++i ) {
-        threads[i] = connector.threads[i];
+
+    if ( connector.sinkData ) {
+        sinkData = new SinkData[numSinks];
+        for ( unsigned int  i = 0; i < numSinks; ++i ) {
+            sinkData[i] = connector.sinkData[i];
+        }
     }
 }
 
@@ -123,16 +271,32 @@ MultiThreadedConnector :: operator= ( const MultiThreadedConnector & connector )
     if ( this != &connector ) {
         Connector::operator=( connector);
 
+        destroyRing();
+
         reconnect       = connector.reconnect;
+        ringSize        = connector.ringSize;
+        maxWorkers      = connector.maxWorkers;
+        pinWorkers      = connector.pinWorkers;
+        firstCpu        = connector.firstCpu;
         mutexProduce    = connector.mutexProduce;
         condProduce     = connector.condProduce;
 
-        if ( threads ) {
-            delete[] threads;
+        delete[] rotations;
+        rotations    = 0;
+        numRotations = 0;
+        for ( unsigned int  i = 0; i < connector.numRotations; ++i ) {
+            setRotation( i, connector.rotations[i]);
         }
-        threads = new ThreadData[numSinks];
-        for ( unsigned int  i = 0; i < numSinks; ++i ) {
-            threads[i] = connector.threads[i];
+
+        if ( sinkData ) {
+            delete[] sinkData;
+            sinkData = 0;
+        }
+        if ( connector.sinkData ) {
+            sinkData = new SinkData[numSinks];
+            for ( unsigned int  i = 0; i < numSinks; ++i ) {
+                sinkData[i] = connector.sinkData[i];
+            }
         }
     }
 
@@ -142,19 +306,109 @@ MultiThreadedConnector :: operator= ( const MultiThreadedConnector & connector )
 
 /*------------------------------------------------------------------------------
  *  Open the source and all the sinks if needed
- *  Create the sink threads
+ *  Start the pool of threads writing to the sinks
  *----------------------------------------------------------------------------*/
 bool
 MultiThreadedConnector :: open ( void )                     
 {
     unsigned int        i;
-    size_t              st;
 
     if ( !Connector::open() ) {
         return false;
     }
 
-    running = true;
+    running.store( true);
+    writeSeq.store( 0);
+
+    if ( sinkData ) {
+        delete[] sinkData;
+    }
+    sinkData = new SinkData[numSinks];
+    for ( i = 0; i < numSinks; ++i ) {
+        sinkData[i].encoder   = dynamic_cast<AudioEncoder*>( sinks[i].get());
+        sinkData[i].accepting = true;
+        sinkData[i].rotation  = i < numRotations ? rotations[i] : 0;
+        // try to reopen until stopped, as the sink is needed all along
+        sinkData[i].reconnector = new Reconnector( sinks[i].get(), 0);
+    }
+
+    if ( !startWorkers() ) {
+        delete[] sinkData;
+        sinkData = 0;
+        return false;
+    }
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Have a sink cut periodically, by the audio time
+ *----------------------------------------------------------------------------*/
+void
+MultiThreadedConnector :: setRotation ( unsigned int    ixSink,
+                                        unsigned int    seconds )
+{
+    if ( ixSink >= numRotations ) {
+        unsigned int  * r = new unsigned int[ixSink + 1];
+
+        for ( unsigned int i = 0; i <= ixSink; ++i ) {
+            r[i] = i < numRotations ? rotations[i] : 0;
+        }
+        delete[] rotations;
+        rotations    = r;
+        numRotations = ixSink + 1;
+    }
+
+    rotations[ixSink] = seconds;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start the pool of threads writing to the sinks
+ *----------------------------------------------------------------------------*/
+bool
+MultiThreadedConnector :: startWorkers ( void )
+{
+    unsigned int        i;
+    size_t              st;
+    long                online  = sysconf( _SC_NPROCESSORS_ONLN);
+    unsigned int        numCpus = online > 0 ? online : 1;
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    int                 cpus[CPU_SETSIZE];
+    cpu_set_t           cpuSet;
+    unsigned int        n       = 0;
+
+    // the CPUs we may run on, which are not necessarily the first ones
+    if ( pthread_getaffinity_np( pthread_self(), sizeof(cpuSet), &cpuSet)
+                                                                    == 0 ) {
+        for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+            if ( CPU_ISSET( cpu, &cpuSet) ) {
+                cpus[n++] = cpu;
+            }
+        }
+    }
+    if ( n ) {
+        numCpus = n;
+    } else {
+        for ( i = 0; i < numCpus && i < CPU_SETSIZE; ++i ) {
+            cpus[i] = i;
+        }
+    }
+#else
+    if ( pinWorkers ) {
+        reportEvent( 1, "pinning threads to CPUs not supported "
+                        "on this system");
+    }
+#endif
+
+    numWorkers = maxWorkers ? maxWorkers : numCpus;
+    if ( numWorkers > numSinks ) {
+        numWorkers = numSinks;
+    }
+    if ( numWorkers == 0 ) {
+        return true;
+    }
 
     pthread_attr_init( &threadAttr);
     pthread_attr_getstacksize(&threadAttr, &st);
@@ -166,178 +420,588 @@ MultiThreadedConnector :: open ( void )
     }
     pthread_attr_setdetachstate( &threadAttr, PTHREAD_CREATE_JOINABLE);
 
-    threads = new ThreadData[numSinks];
-    for ( i = 0; i < numSinks; ++i ) {
-        ThreadData    * threadData = threads + i;
+    workers = new Worker[numWorkers];
+    for ( i = 0; i < numWorkers; ++i ) {
+        Worker        * worker = workers + i;
 
-        threadData->connector = this;
-        threadData->ixSink    = i;
-        threadData->accepting = true;
-        threadData->isDone    = true;
-        if ( pthread_create( &(threadData->thread),
+        worker->connector = this;
+        worker->ixWorker  = i;
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+        worker->cpu       = pinWorkers ? cpus[(firstCpu + i) % numCpus] : -1;
+#endif
+        if ( pthread_create( &(worker->thread),
                              &threadAttr,
-                             ThreadData::threadFunction,
-                             threadData ) ) {
+                             Worker::threadFunction,
+                             worker ) ) {
             break;
         }
     }
 
     // if could not create all, delete the ones created
-    if ( i < numSinks ) {
+    if ( i < numWorkers ) {
         unsigned int    j;
 
         // signal to stop for all running threads
         pthread_mutex_lock( &mutexProduce);
-        running = false;
+        running.store( false);
         pthread_cond_broadcast( &condProduce);
         pthread_mutex_unlock( &mutexProduce);
 
         for ( j = 0; j < i; ++j ) {
-            pthread_join( threads[j].thread, 0);
+            pthread_join( workers[j].thread, 0);
         }
+        pthread_attr_destroy( &threadAttr);
 
-        delete[] threads;
-        threads = 0;
+        delete[] workers;
+        workers    = 0;
+        numWorkers = 0;
 
         return false;
     }
 
+    reportEvent( 4, "MultiThreadedConnector :: open, workers for sinks",
+                 numWorkers, numSinks);
+
     return true;
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Allocate the ring buffer and the frames it refers to
+ *----------------------------------------------------------------------------*/
+void
+MultiThreadedConnector :: createRing ( unsigned int     minBufSize,
+                                       unsigned int     maxBufSize )
+{
+    if ( frames ) {
+        // the sink threads may be reading the ring, so it can't be
+        // re-allocated while they are running
+        if ( maxBufSize > slotSize ) {
+            throw Exception( __FILE__, __LINE__,
+                             "chunk size larger than ring slot size",
+                             maxBufSize);
+        }
+        return;
+    }
+
+    // hold the whole ring size even in the smallest chunks
+    slotSize = maxBufSize;
+    numSlots = ringSize / minBufSize;
+    if ( numSlots < MIN_RING_SLOTS ) {
+        numSlots = MIN_RING_SLOTS;
+    }
+    slots    = new RingSlot[numSlots];
+
+    // if the source is not an AudioSource, treat its data as plain bytes
+    AudioSource   * audioSource  = dynamic_cast<AudioSource*>( source.get());
+    unsigned int    sampleRate   = audioSource
+                                 ? audioSource->getSampleRate() : 0;
+    unsigned int    channel      = audioSource ? audioSource->getChannel() : 1;
+    unsigned int    bits         = audioSource
+                                 ? audioSource->getBitsPerSample() : 8;
+    bool            floatSamples = audioSource && audioSource->isFloat();
+    bool            bigEndian    = audioSource && audioSource->isBigEndian();
+
+    numFrames = numSlots + numSinks;
+    nextFrame = 0;
+    frames    = new AudioFrame*[numFrames];
+    for ( unsigned int i = 0; i < numFrames; ++i ) {
+        frames[i] = new AudioFrame( sampleRate,
+                                    channel,
+                                    bits,
+                                    floatSamples,
+                                    bigEndian,
+                                    slotSize);
+    }
+
+    if ( audioSource ) {
+        createResamplers( sampleRate, channel);
+    }
+
+    reportEvent( 5, "MultiThreadedConnector :: createRing, slots", numSlots);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Create the resamplers needed by the encoders
+ *----------------------------------------------------------------------------*/
+void
+MultiThreadedConnector :: createResamplers (    unsigned int    sampleRate,
+                                                unsigned int    channel )
+{
+    unsigned int    i;
+    unsigned int    j;
+
+    resamplers    = new Ref<Resampler>[numSinks];
+    numResamplers = 0;
+
+    for ( i = 0; i < numSinks; ++i ) {
+        AudioEncoder  * encoder = dynamic_cast<AudioEncoder*>( sinks[i].get());
+        unsigned int    outSampleRate;
+
+        if ( !encoder
+          || !encoder->usesResampler()
+          || (unsigned int) encoder->getInSampleRate() != sampleRate
+          || encoder->getSourceChannel() != channel ) {
+            continue;
+        }
+
+        // share the resampler with other encoders of the same output rate
+        outSampleRate = encoder->getOutSampleRate();
+        for ( j = 0; j < numResamplers; ++j ) {
+            if ( resamplers[j]->getOutSampleRate() == outSampleRate ) {
+                break;
+            }
+        }
+        if ( j < numResamplers ) {
+            continue;
+        }
+
+        resamplers[numResamplers++] = new Resampler( sampleRate,
+                                                     outSampleRate,
+                                                     channel );
+
+        // the attached frames are enlarged on demand, start with
+        // the size of a resampled chunk
+        unsigned int    inSamples = frames[0]->getCapacity()
+                                  / (frames[0]->getBitsPerSample() / 8)
+                                  / channel;
+        unsigned int    capacity  = ((unsigned int) ((double) inSamples
+                                                   * outSampleRate
+                                                   / sampleRate) + 2)
+                                  * channel * 2;
+
+        for ( j = 0; j < numFrames; ++j ) {
+            frames[j]->attach( new AudioFrame( outSampleRate,
+                                               channel,
+                                               16,
+                                               false,
+#ifdef WORDS_BIGENDIAN
+                                               true,
+#else
+                                               false,
+#endif
+                                               capacity ));
+        }
+
+        reportEvent( 5, "MultiThreadedConnector :: createResamplers, "
+                        "shared resampler to", outSampleRate);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Free the ring buffer and the frames it refers to
+ *----------------------------------------------------------------------------*/
+void
+MultiThreadedConnector :: destroyRing ( void )
+{
+    if ( slots ) {
+        delete[] slots;
+        slots = 0;
+    }
+    if ( frames ) {
+        for ( unsigned int i = 0; i < numFrames; ++i ) {
+            delete frames[i];
+        }
+        delete[] frames;
+        frames = 0;
+    }
+    if ( resamplers ) {
+        delete[] resamplers;
+        resamplers = 0;
+    }
+    numResamplers = 0;
+    numFrames = 0;
+    slotSize  = 0;
+    numSlots  = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get a frame not referred to by the ring or any sink thread
+ *----------------------------------------------------------------------------*/
+AudioFrame *
+MultiThreadedConnector :: getFreeFrame ( void )
+{
+    for ( unsigned int i = 0; i < numFrames; ++i ) {
+        AudioFrame    * frame = frames[nextFrame];
+
+        nextFrame = (nextFrame + 1) % numFrames;
+        if ( frame->getReferenceCount() == 0 ) {
+            return frame;
+        }
+    }
+
+    throw Exception( __FILE__, __LINE__, "no free audio frame");
+}
+
+
 /*------------------------------------------------------------------------------
  *  Transfer some data from the source to the sink
  *----------------------------------------------------------------------------*/
 unsigned int
 MultiThreadedConnector :: transfer ( unsigned long       bytes,
-                                     unsigned int        bufSize,
+                                     unsigned int        minBufSize,
+                                     unsigned int        maxBufSize,
+                                     unsigned int        align,
                                      unsigned int        sec,
                                      unsigned int        usec )
                                                             
 {   
     unsigned int        b;
+    unsigned int        chunkSize;
+    double              audioTime = 0.0;
 
     if ( numSinks == 0 ) {
         return 0;
     }
 
-    if ( bufSize == 0 ) {
+    if ( minBufSize == 0 || maxBufSize < minBufSize ) {
         return 0;
     }
 
-    dataBuffer   = new unsigned char[bufSize];
-    dataSize     = 0;
+    createRing( minBufSize, maxBufSize);
+    chunkSize    = minBufSize;
+    steadyChunks = 0;
 
     reportEvent( 6, "MultiThreadedConnector :: transfer, bytes", bytes);
 
-    for ( b = 0; !bytes || b < bytes; ) {
+    for ( b = 0; running && (!bytes || b < bytes); ) {
+        double      start = TimeSummary::now();
+
         if ( source->canRead( sec, usec) ) {
-            unsigned int        i;
+            unsigned long       seq      = writeSeq.load();
+            RingSlot          * slot     = slots + seq % numSlots;
+            AudioFrame        * frame;
+            unsigned int        dataSize;
+
+            // mark the slot invalid first, so that a sink thread just
+            // taking a reference to the old frame will notice it's gone
+            slot->seq.store( 0);
+            frame = slot->frame.exchange( 0);
+            if ( frame ) {
+                frame->decreaseReferenceCount();
+            }
 
-            pthread_mutex_lock( &mutexProduce);
-            dataSize = source->read( dataBuffer, bufSize);
+            frame = getFreeFrame();
+            frame->increaseReferenceCount();
+
+            dataSize = source->read( frame->getBuffer(), chunkSize);
             b       += dataSize;
+            readTime.add( TimeSummary::now() - start);
 
             // check for EOF
             if ( dataSize == 0 ) {
+                frame->decreaseReferenceCount();
                 reportEvent( 3, "MultiThreadedConnector :: transfer, EOF");
-                pthread_mutex_unlock( &mutexProduce);
                 break;
             }
 
-            for ( i = 0; i < numSinks; ++i ) {
-                threads[i].isDone = false;
+            // convert and resample the data once, for all the sinks
+            frame->convert( dataSize);
+            audioTime = stampFrame( frame, audioTime);
+            for ( unsigned int i = 0; i < numResamplers; ++i ) {
+                resamplers[i]->resample( frame, frame->getAttached( i));
             }
 
-            // tell sink threads that there is some data available
-            pthread_cond_broadcast( &condProduce);
+            slot->frame.store( frame);
+            slot->seq.store( seq + 1);
+            writeSeq.store( seq + 1);
 
-            // wait for all sink threads to get done with this data
-            while ( true ) {
-                for ( i = 0; i < numSinks && threads[i].isDone; ++i );
-                if ( i == numSinks ) {
-                    break;
-                }
-                pthread_cond_wait( &condProduce, &mutexProduce);
+            // tell sink threads that there is some data available, but
+            // only bother if any of them is waiting: the busy ones look
+            // at writeSeq before they wait, see workerThread()
+            if ( sleepers.load() ) {
+                pthread_mutex_lock( &mutexProduce);
+                pthread_cond_broadcast( &condProduce);
+                pthread_mutex_unlock( &mutexProduce);
+            }
+
+            if ( minBufSize < maxBufSize ) {
+                chunkSize = adaptChunkSize( chunkSize,
+                                            minBufSize,
+                                            maxBufSize,
+                                            align);
             }
-            pthread_mutex_unlock( &mutexProduce);
         } else {
             reportEvent( 3, "MultiThreadedConnector :: transfer, can't read");
             break;
         }
     }
 
-    delete[] dataBuffer;
     return b;
 }
 
 
 /*------------------------------------------------------------------------------
- *  The function for each thread.
- *  Read the presented data
+ *  Set the time of a frame, by the audio read before it
+ *----------------------------------------------------------------------------*/
+double
+MultiThreadedConnector :: stampFrame (  AudioFrame    * frame,
+                                        double          audioTime )
+{
+    double      duration = (double) frame->getSamples()
+                         / frame->getSampleRate();
+    double      wallTime = wallClock() - duration;
+
+    // keep the time by the audio, so that it doesn't jitter with the
+    // reads, unless the clock of the audio drifted too far away
+    if ( fabs( audioTime - wallTime) > MAX_CLOCK_DRIFT ) {
+        if ( audioTime > 0.0 ) {
+            reportEvent( 4, "MultiThreadedConnector :: transfer, "
+                            "audio time reset by seconds",
+                         wallTime - audioTime);
+        }
+        audioTime = wallTime;
+    }
+    frame->setTime( audioTime);
+
+    return audioTime + duration;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Choose the size of the next chunk to read
+ *----------------------------------------------------------------------------*/
+unsigned int
+MultiThreadedConnector :: adaptChunkSize (  unsigned int    chunkSize,
+                                            unsigned int    minBufSize,
+                                            unsigned int    maxBufSize,
+                                            unsigned int    align )
+{
+    unsigned long   lag = 0;
+    unsigned int    size;
+
+    for ( unsigned int i = 0; i < numSinks; ++i ) {
+        if ( sinkData[i].accepting && getLag( i) > lag ) {
+            lag = getLag( i);
+        }
+    }
+
+    if ( lag > GROW_CHUNK_LAG ) {
+        steadyChunks = 0;
+        size         = chunkSize * 2 < maxBufSize ? chunkSize * 2 : maxBufSize;
+    } else if ( ++steadyChunks >= SHRINK_CHUNK_TURNS ) {
+        steadyChunks = 0;
+        size         = chunkSize / 2 / align * align;
+        size         = size > minBufSize ? size : minBufSize;
+    } else {
+        return chunkSize;
+    }
+
+    if ( size != chunkSize ) {
+        reportEvent( 5, "MultiThreadedConnector :: transfer, chunk size",
+                     size);
+    }
+
+    return size;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The function for each thread of the pool.
+ *  Write to the sinks with something to do, until closed.
  *----------------------------------------------------------------------------*/
 void
-MultiThreadedConnector :: sinkThread( int       ixSink )
+MultiThreadedConnector :: workerThread( Worker    * worker )
 {
-    ThreadData    * threadData = &threads[ixSink];
-    Sink          * sink       = sinks[ixSink].get();
+    pthread_mutex_lock( &mutexProduce);
+    while ( true ) {
+        unsigned long   seq    = writeSeq.load();
+        int             ixSink = claimSink( worker, seq);
 
-    while ( running ) {
-        // wait for some data to become available
-        pthread_mutex_lock( &mutexProduce);
-        while ( running && threadData->isDone ) {
-            pthread_cond_wait( &condProduce, &mutexProduce);
+        if ( ixSink >= 0 ) {
+            pthread_mutex_unlock( &mutexProduce);
+            serveSink( ixSink, seq);
+            pthread_mutex_lock( &mutexProduce);
+            sinkData[ixSink].claimed = false;
+            continue;
         }
+
         if ( !running ) {
-            pthread_mutex_unlock( &mutexProduce);
             break;
         }
 
-        if ( threadData->cut) {
-            sink->cut();
-            threadData->cut = false;
+        // wait for some data to become available. announce the wait
+        // before looking at writeSeq again: either the producer sees us
+        // waiting and wakes us, as it has to lock the mutex we hold,
+        // or we see the new chunk here
+        sleepers.fetch_add( 1);
+        if ( writeSeq.load() == seq && running ) {
+            pthread_cond_wait( &condProduce, &mutexProduce);
         }
+        sleepers.fetch_sub( 1);
+    }
+    pthread_mutex_unlock( &mutexProduce);
+}
 
-        if ( threadData->accepting ) {
-            if ( sink->canWrite( 0, 0) ) {
-                try {
-                    sink->write( dataBuffer, dataSize);
-                } catch ( Exception     & e ) {
-                    // something wrong. don't accept more data, try to
-                    // reopen the sink next time around
-                    threadData->accepting = false;
+
+/*------------------------------------------------------------------------------
+ *  Find a sink with something to do, and claim it
+ *----------------------------------------------------------------------------*/
+int
+MultiThreadedConnector :: claimSink (   Worker            * worker,
+                                        unsigned long       seq )
+{
+    unsigned int    numOwn = (numSinks - worker->ixWorker + numWorkers - 1)
+                           / numWorkers;
+    unsigned int    i;
+    unsigned int    j;
+
+    // the worker's own sinks first, taking turns, so that each gets
+    // a chunk written before any of them gets another one
+    for ( j = 0; j < numOwn; ++j ) {
+        i = worker->ixWorker + ((worker->turn + j) % numOwn) * numWorkers;
+        if ( isClaimable( i, seq) ) {
+            worker->turn            = (worker->turn + j + 1) % numOwn;
+            sinkData[i].claimed     = true;
+            return i;
+        }
+    }
+
+    // then help out the other workers, starting with different sinks
+    // in each worker, so that they don't all go for the same one
+    for ( j = 1; j < numSinks; ++j ) {
+        i = (worker->ixWorker + j) % numSinks;
+        if ( i % numWorkers != worker->ixWorker && isClaimable( i, seq) ) {
+            sinkData[i].claimed = true;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write the next chunk to a sink
+ *----------------------------------------------------------------------------*/
+void
+MultiThreadedConnector :: serveSink(    unsigned int    ixSink,
+                                        unsigned long   seq )
+{
+    SinkData      * data = &sinkData[ixSink];
+    Sink          * sink = sinks[ixSink].get();
+    unsigned long   readSeq;
+    unsigned long   skipped;
+    RingSlot      * slot;
+    AudioFrame    * frame;
+
+    // a sink being reopened is not to be touched, it starts anew anyway
+    if ( data->cut.exchange( false) && data->accepting ) {
+        sink->cut();
+    }
+
+    readSeq = data->readSeq.load( std::memory_order_acquire);
+    if ( readSeq == seq ) {
+        return;
+    }
+
+    // the slot after the newest one may be overwritten at any moment,
+    // if we're behind that, skip to the oldest slot still safe to read
+    if ( seq - readSeq > numSlots - 1 ) {
+        skipped         = seq - (numSlots - 1) - readSeq;
+        readSeq        += skipped;
+        data->overruns += skipped;
+        reportEvent( 3, "MultiThreadedConnector :: serveSink overrun, "
+                        "sink, chunks skipped", ixSink, skipped);
+    }
+
+    // take a reference to the frame in the slot, and make sure
+    // the slot wasn't re-filled meanwhile
+    slot  = slots + readSeq % numSlots;
+    frame = slot->frame.load();
+    if ( frame ) {
+        frame->increaseReferenceCount();
+        if ( slot->seq.load() != readSeq + 1 ) {
+            frame->decreaseReferenceCount();
+            frame = 0;
+        }
+    }
+    data->readSeq.store( readSeq + 1, std::memory_order_release);
+    if ( !frame ) {
+        ++data->overruns;
+        return;
+    }
+
+    // tell the sink the time of the cut ahead of it, so that the next
+    // file is named after it and ready by then
+    if ( data->rotation
+      && data->nextRotation > 0.0
+      && !data->prepared
+      && frame->getTime() >= data->nextRotation - CUT_LEAD_TIME
+      && data->accepting ) {
+        sink->prepareCut( data->nextRotation);
+        data->prepared = true;
+    }
+
+    // cut on the audio time, before the first chunk past the boundary
+    if ( data->rotation && frame->getTime() >= data->nextRotation ) {
+        if ( data->nextRotation > 0.0 && data->accepting ) {
+            reportEvent( 4, "MultiThreadedConnector :: serveSink rotating ",
+                         ixSink);
+            sink->cutAt( data->nextRotation);
+        }
+        data->nextRotation = nextBoundary( frame->getTime(), data->rotation);
+        data->prepared     = false;
+    }
+
+    if ( data->accepting ) {
+        if ( sink->canWrite( 0, 0) ) {
+            double  start = TimeSummary::now();
+
+            try {
+                if ( data->encoder ) {
+                    data->encoder->encodeFrame( frame);
+                } else {
+                    sink->write( frame->getData(), frame->getSize());
                 }
-            } else {
-                reportEvent( 4,
-                            "MultiThreadedConnector :: sinkThread can't write ",
-                             ixSink);
-                // don't care if we can't write
+                data->writeTime.add( TimeSummary::now() - start);
+            } catch ( Exception     & e ) {
+                // something wrong. don't accept more data, try to
+                // reopen the sink next time around
+                data->accepting.store( false);
             }
+        } else {
+            reportEvent( 4,
+                         "MultiThreadedConnector :: serveSink can't write ",
+                         ixSink);
+            // don't care if we can't write
         }
-        threadData->isDone = true;
-        pthread_cond_broadcast( &condProduce);
-        pthread_mutex_unlock( &mutexProduce);
-
-        if ( !threadData->accepting ) {
-            if ( reconnect ) {
+    }
+    frame->decreaseReferenceCount();
+
+    if ( !data->accepting && running ) {
+        if ( reconnect ) {
+            // if we're not accepting, reopen the sink in the background,
+            // the chunks arriving meanwhile are skipped
+            Reconnector   * reconnector = data->reconnector.get();
+
+            if ( reconnector->isBusy() ) {
+                // still trying
+            } else if ( data->reopening ) {
+                data->reopening = false;
+                data->accepting.store( reconnector->finish()
+                                    && sink->isOpen());
+            } else {
                 reportEvent( 4,
-                           "MultiThreadedConnector :: sinkThread reconnecting ",
-                            ixSink);
-                // if we're not accepting, try to reopen the sink
+                             "MultiThreadedConnector :: serveSink reconnecting ",
+                             ixSink);
+                ++data->reconnects;
+                data->reopening = true;
                 try {
-                    sink->close();
-                    Util::sleep(1L, 0L);
-                    sink->open();
-                    sched_yield();
-                    threadData->accepting = sink->isOpen();
+                    reconnector->start();
                 } catch ( Exception   & e ) {
-                    // don't care, just try and try again
+                    // try again with the next chunk
+                    data->reopening = false;
                 }
-            } else {
-                // if !reconnect, just stop the connector
-                running = false;
             }
+        } else {
+            // if !reconnect, just stop the connector. the thread reading
+            // the source sees this on its next chunk, and close() wakes
+            // the waiting workers
+            running.store( false);
         }
     }
 }
@@ -349,11 +1013,15 @@ MultiThreadedConnector :: sinkThread( int       ixSink )
 void
 MultiThreadedConnector :: cut ( void )                      throw ()
 {
+    if ( !sinkData ) {
+        return;
+    }
+
     for ( unsigned int i = 0; i < numSinks; ++i ) {
-        threads[i].cut = true;
+        sinkData[i].cut.store( true);
     }
 
-    // TODO: it might be more appropriate to signal all the threads here
+    // TODO: it might be more appropriate to signal all the workers here
     //       but, they'll get signaled on new data anyway, and it might be
     //       enough for them to cut at that time
 }
@@ -370,15 +1038,32 @@ MultiThreadedConnector :: close ( void )
 
     // signal to stop for all threads
     pthread_mutex_lock( &mutexProduce);
-    running = false;
+    running.store( false);
     pthread_cond_broadcast( &condProduce);
     pthread_mutex_unlock( &mutexProduce);
 
     // wait for all the threads to finish
-    for ( i = 0; i < numSinks; ++i ) {
-        pthread_join( threads[i].thread, 0);
+    if ( workers ) {
+        for ( i = 0; i < numWorkers; ++i ) {
+            pthread_join( workers[i].thread, 0);
+        }
+        pthread_attr_destroy( &threadAttr);
+        delete[] workers;
+        workers    = 0;
+        numWorkers = 0;
+    }
+
+    // the sinks being reopened are given back, before closing them
+    if ( sinkData ) {
+        for ( i = 0; i < numSinks; ++i ) {
+            if ( sinkData[i].reconnector.get() ) {
+                sinkData[i].reconnector->cancel();
+            }
+            sinkData[i].reopening = false;
+        }
     }
-    pthread_attr_destroy( &threadAttr);
+
+    destroyRing();
 
     Connector::close();
 }
@@ -388,16 +1073,17 @@ MultiThreadedConnector :: close ( void )
  *  The thread function
  *----------------------------------------------------------------------------*/
 void *
-MultiThreadedConnector :: ThreadData :: threadFunction( void  * param )
+MultiThreadedConnector :: Worker :: threadFunction( void  * param )
 {
     struct sched_param  sched;
     int sched_type;
-    ThreadData     * threadData = (ThreadData*) param;
+    Worker         * worker = (Worker*) param;
+    pthread_t        self   = pthread_self();
     
-    pthread_getschedparam( threadData->thread, &sched_type, &sched );
+    pthread_getschedparam( self, &sched_type, &sched );
 
     reportEvent( 5,
-                 "MultiThreadedConnector :: ThreadData :: threadFunction, "
+                 "MultiThreadedConnector :: Worker :: threadFunction, "
                  "was (thread, priority, type): ",
                  param,
 	             sched.sched_priority,
@@ -408,11 +1094,11 @@ MultiThreadedConnector :: ThreadData :: threadFunction( void  * param )
     );
 
     sched.sched_priority = 1;
-    pthread_setschedparam( threadData->thread, SCHED_FIFO, &sched);
+    pthread_setschedparam( self, SCHED_FIFO, &sched);
 
-    pthread_getschedparam( threadData->thread, &sched_type, &sched );
+    pthread_getschedparam( self, &sched_type, &sched );
     reportEvent( 5,
-                 "MultiThreadedConnector :: ThreadData :: threadFunction, "
+                 "MultiThreadedConnector :: Worker :: threadFunction, "
                  "now is (thread, priority, type): ",
                  param,
 	             sched.sched_priority,
@@ -422,7 +1108,23 @@ MultiThreadedConnector :: ThreadData :: threadFunction( void  * param )
                     "INVALID"
     );
 
-    threadData->connector->sinkThread( threadData->ixSink);
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    if ( worker->cpu >= 0 ) {
+        cpu_set_t       cpuSet;
+
+        CPU_ZERO( &cpuSet);
+        CPU_SET( worker->cpu, &cpuSet);
+        if ( pthread_setaffinity_np( self, sizeof(cpuSet), &cpuSet) ) {
+            reportEvent( 3, "MultiThreadedConnector :: Worker, "
+                            "can't pin to CPU", worker->cpu);
+        } else {
+            reportEvent( 5, "MultiThreadedConnector :: Worker, "
+                            "pinned to CPU", worker->cpu);
+        }
+    }
+#endif
+
+    worker->connector->workerThread( worker);
 
     return 0;
 }
@@ -48,12 +48,19 @@
 #error need pthread.h
 #endif
 
+#include <atomic>
+
 #include "Referable.h"
 #include "Ref.h"
 #include "Reporter.h"
 #include "Source.h"
 #include "Sink.h"
 #include "Connector.h"
+#include "AudioFrame.h"
+#include "AudioEncoder.h"
+#include "Resampler.h"
+#include "TimeSummary.h"
+#include "Reconnector.h"
 
 
 /* ================================================================ constants */
@@ -68,6 +75,29 @@
  *  Connects a source to one or more sinks, using a multi-threaded
  *  producer - consumer approach.
  *
+ *  The data read from the source is converted into an AudioFrame once,
+ *  and put into a ring of slots, which is shared by all the sinks.
+ *  Sinks that are AudioEncoders are handed the converted frame, other
+ *  sinks get the raw data. Each sink has its own read cursor into the
+ *  ring, thus the thread reading the source never waits for the sinks.
+ *  The chunks are handed over through atomic sequence numbers, a lock
+ *  is only taken to wake the threads of the sinks that ran out of work.
+ *  A sink that falls behind by more than the size of the ring skips the
+ *  data it missed, and continues with the oldest data still available,
+ *  without affecting the other sinks.
+ *
+ *  The sinks are written to by a pool of threads, by default one for
+ *  each CPU, but never more than one for each sink. Each sink has a
+ *  worker of its own, which keeps the encoder's state in the cache of
+ *  the same CPU, especially if the workers are pinned to the CPUs.
+ *  A worker with nothing to do takes on the chunks waiting for other
+ *  workers' sinks, but a sink is only ever written to by one worker at
+ *  a time, as the chunks have to be encoded in order.
+ *
+ *  Encoders that need the audio at another sample rate share a single
+ *  Resampler for each distinct output sample rate. The audio is resampled
+ *  once, on the thread reading the source, and is attached to the frames.
+ *
  *  @author  $Author$
  *  @version $Revision$
  */
@@ -76,67 +106,219 @@ class MultiThreadedConnector : public virtual Connector
     private:
 
         /**
-         *  Helper class to collect information for starting threads.
+         *  The state of writing to a sink.
          */
-        class ThreadData
+        class SinkData
         {
             public:
                 /**
-                 *  The connector starting the thread
+                 *  Marks if the sink is accepting data. Written by the
+                 *  worker serving the sink, read by the others and by
+                 *  the thread reading the source.
                  */
-                MultiThreadedConnector    * connector;
+                std::atomic<bool>           accepting;
 
                 /**
-                 *  The index of the sink this thread writes to.
+                 *  Marks if a worker is writing to the sink right now.
+                 *  Protected by mutexProduce.
                  */
-                unsigned int                ixSink;
+                bool                        claimed;
 
                 /**
-                 *  The POSIX thread itself.
+                 *  A flag to show that the sink should be made to cut in the
+                 *  next iteration. Set by any thread, cleared by the worker
+                 *  serving the sink.
                  */
-                pthread_t                   thread;
+                std::atomic<bool>           cut;
 
                 /**
-                 *  Marks if the thread is accepting data.
+                 *  The sequence number of the next ring slot to write
+                 *  to the sink. Written by the worker serving the sink,
+                 *  read by others to tell its lag.
                  */
-                bool                        accepting;
+                std::atomic<unsigned long>  readSeq;
 
                 /**
-                 *  Marks if the thread has processed the last batch
-                 *  of data.
+                 *  The number of chunks the sink had to skip, because
+                 *  it fell too much behind the source.
                  */
-                bool                        isDone;
+                unsigned long               overruns;
 
                 /**
-                 *  A flag to show that the sink should be made to cut in the
-                 *  next iteration.
+                 *  The number of times the sink failed, and was handed
+                 *  over to be reopened.
+                 */
+                unsigned long               reconnects;
+
+                /**
+                 *  The time it took to write each chunk to the sink.
+                 */
+                TimeSummary                 writeTime;
+
+                /**
+                 *  Reopens the sink in the background, once it failed,
+                 *  so that the worker does not wait for the network.
+                 */
+                Ref<Reconnector>            reconnector;
+
+                /**
+                 *  Marks if the sink has been handed to the reconnector,
+                 *  and the result has not been collected yet.
+                 */
+                bool                        reopening;
+
+                /**
+                 *  The sink, if it is an AudioEncoder.
+                 */
+                AudioEncoder              * encoder;
+
+                /**
+                 *  The seconds between the cuts made by the audio time,
+                 *  or 0 for none.
+                 */
+                unsigned int                rotation;
+
+                /**
+                 *  The audio time of the next cut, in seconds since the
+                 *  epoch, or 0 if not known yet.
+                 */
+                double                      nextRotation;
+
+                /**
+                 *  Tells if the sink was told to get ready for the next cut.
+                 */
+                bool                        prepared;
+
+                /**
+                 *  Default constructor.
+                 */
+                inline
+                SinkData()
+                {
+                    this->accepting.store( false);
+                    this->claimed       = false;
+                    this->cut.store( false);
+                    this->readSeq.store( 0, std::memory_order_relaxed);
+                    this->overruns      = 0;
+                    this->reconnects    = 0;
+                    this->reopening     = false;
+                    this->encoder       = 0;
+                    this->rotation      = 0;
+                    this->nextRotation  = 0.0;
+                    this->prepared      = false;
+                }
+
+                /**
+                 *  Assignment operator.
+                 *
+                 *  @param data the object to assign to this one.
+                 *  @return a reference to this object.
+                 */
+                inline SinkData &
+                operator= ( const SinkData    & data )
+                {
+                    this->accepting.store( data.accepting.load());
+                    this->claimed       = data.claimed;
+                    this->cut.store( data.cut.load());
+                    this->readSeq.store( data.readSeq.load(
+                                                std::memory_order_acquire),
+                                         std::memory_order_release);
+                    this->overruns      = data.overruns;
+                    this->reconnects    = data.reconnects;
+                    this->writeTime     = data.writeTime;
+                    this->reconnector   = data.reconnector;
+                    this->reopening     = data.reopening;
+                    this->encoder       = data.encoder;
+                    this->rotation      = data.rotation;
+                    this->nextRotation  = data.nextRotation;
+                    this->prepared      = data.prepared;
+                    return *this;
+                }
+        };
+
+        /**
+         *  A thread of the pool writing to the sinks.
+         */
+        class Worker
+        {
+            public:
+                /**
+                 *  The connector the worker works for.
+                 */
+                MultiThreadedConnector    * connector;
+
+                /**
+                 *  The index of the worker. The sinks with the same
+                 *  index modulo the number of workers are its own.
+                 */
+                unsigned int                ixWorker;
+
+                /**
+                 *  The POSIX thread itself.
+                 */
+                pthread_t                   thread;
+
+                /**
+                 *  The CPU to pin the thread to, or -1 for any.
+                 */
+                int                         cpu;
+
+                /**
+                 *  Which of its own sinks the worker looks at first.
                  */
-                bool                    cut;
+                unsigned int                turn;
 
                 /**
                  *  Default constructor.
                  */
                 inline
-                ThreadData()
+                Worker()
                 {
                     this->connector = 0;
-                    this->ixSink    = 0;
+                    this->ixWorker  = 0;
                     this->thread    = 0;
-                    this->accepting = false;
-                    this->isDone    = false;
-                    this->cut       = false;
+                    this->cpu       = -1;
+                    this->turn      = 0;
                 }
 
                 /**
                  *  The thread function.
                  *
-                 *  @param param thread parameter, a pointer to a
-                 *               ThreadData
+                 *  @param param thread parameter, a pointer to a Worker
                  *  @return nothing
                  */
                 static void *
                 threadFunction( void      * param );
         };
+
+        /**
+         *  A slot in the ring buffer shared by the sinks.
+         */
+        class RingSlot
+        {
+            public:
+                /**
+                 *  The sequence number of the data in the slot, plus one.
+                 *  Zero while the slot is being filled.
+                 */
+                std::atomic<unsigned long>  seq;
+
+                /**
+                 *  The frame in the slot. The slot holds a reference
+                 *  to the frame.
+                 */
+                std::atomic<AudioFrame*>    frame;
+
+                /**
+                 *  Default constructor.
+                 */
+                inline
+                RingSlot()
+                {
+                    seq.store( 0);
+                    frame.store( 0);
+                }
+        };
         
         /**
          *  The mutex of this object.
@@ -154,14 +336,51 @@ class MultiThreadedConnector : public virtual Connector
         pthread_attr_t          threadAttr;
 
         /**
-         *  The threads for the sinks.
+         *  The state of writing to each sink.
+         */
+        SinkData              * sinkData;
+
+        /**
+         *  The pool of threads writing to the sinks.
+         */
+        Worker                * workers;
+
+        /**
+         *  The number of threads in the pool.
+         */
+        unsigned int            numWorkers;
+
+        /**
+         *  The requested number of threads in the pool, 0 for one
+         *  for each CPU.
          */
-        ThreadData            * threads;
+        unsigned int            maxWorkers;
+
+        /**
+         *  Flag to tell if each thread of the pool is to be pinned
+         *  to a CPU of its own.
+         */
+        bool                    pinWorkers;
+
+        /**
+         *  The first of the CPUs the threads of the pool are pinned to,
+         *  so that connectors sharing the CPUs pin to different ones.
+         */
+        unsigned int            firstCpu;
 
         /**
          *  Signal if we're running or not, so the threads no if to stop.
+         *  Read by all the threads without locking.
+         */
+        std::atomic<bool>       running;
+
+        /**
+         *  The number of workers waiting on condProduce, or about to.
+         *  The thread reading the source only locks mutexProduce to
+         *  wake them if there is any, otherwise it hands the chunks
+         *  over without locking.
          */
-        bool                    running;
+        std::atomic<unsigned int>   sleepers;
 
         /**
          *  Flag to show if the connector should try to reconnect if
@@ -170,14 +389,79 @@ class MultiThreadedConnector : public virtual Connector
         bool                    reconnect;
 
         /**
-         *  The buffer of information presented to each thread.
+         *  The requested size of the ring buffer, in bytes.
+         */
+        unsigned int            ringSize;
+
+        /**
+         *  The frames the ring slots refer to. There are enough of them
+         *  so that one is always free, even if each slot and each sink
+         *  thread holds one.
+         */
+        AudioFrame           ** frames;
+
+        /**
+         *  The number of frames.
+         */
+        unsigned int            numFrames;
+
+        /**
+         *  The index of the frame to look at first for a free frame.
+         */
+        unsigned int            nextFrame;
+
+        /**
+         *  The size of each frame, in bytes.
+         */
+        unsigned int            slotSize;
+
+        /**
+         *  The number of slots in the ring.
+         */
+        unsigned int            numSlots;
+
+        /**
+         *  The slots of the ring.
+         */
+        RingSlot              * slots;
+
+        /**
+         *  The number of chunks in a row all the sinks kept up with.
+         */
+        unsigned int            steadyChunks;
+
+        /**
+         *  The resamplers shared by the encoders, one for each distinct
+         *  output sample rate. The frames have the output of each
+         *  attached, in the same order.
+         */
+        Ref<Resampler>        * resamplers;
+
+        /**
+         *  The number of resamplers.
+         */
+        unsigned int            numResamplers;
+
+        /**
+         *  The number of chunks published into the ring so far.
          */
-        unsigned char         * dataBuffer;
+        std::atomic<unsigned long>  writeSeq;
 
         /**
-         *  The amount of information presented to each thread.
+         *  The time it took the source to deliver each chunk.
          */
-        unsigned int            dataSize;
+        TimeSummary             readTime;
+
+        /**
+         *  The seconds between the cuts of each sink, see setRotation(),
+         *  for the first numRotations sinks.
+         */
+        unsigned int          * rotations;
+
+        /**
+         *  The number of elements of rotations.
+         */
+        unsigned int            numRotations;
 
         /**
          *  Initialize the object.
@@ -185,10 +469,137 @@ class MultiThreadedConnector : public virtual Connector
          *  @param reconnect flag to indicate if the connector should
          *                   try to reconnect if the connection was
          *                   dropped by the other end
+         *  @param ringSize the size of the ring buffer shared by the sinks,
+         *                  in bytes.
+         *  @param maxWorkers the number of threads writing to the sinks,
+         *                    0 for one for each CPU.
+         *  @param pinWorkers pin each thread writing to the sinks to
+         *                    a CPU of its own.
+         *  @exception Exception
+         */
+        void
+        init ( bool             reconnect,
+               unsigned int     ringSize,
+               unsigned int     maxWorkers,
+               bool             pinWorkers )        ;
+
+        /**
+         *  Start the pool of threads writing to the sinks.
+         *
+         *  @return true if all threads could be started, false otherwise.
+         */
+        bool
+        startWorkers ( void )                       ;
+
+        /**
+         *  Find a sink with something to do, and claim it for a worker.
+         *  The worker's own sinks come first, then the others'.
+         *  Called with mutexProduce locked.
+         *
+         *  @param worker the worker looking for something to do.
+         *  @param seq the sequence number of the newest chunk.
+         *  @return the index of the sink claimed, or -1 if none.
+         */
+        int
+        claimSink ( Worker            * worker,
+                    unsigned long       seq )       ;
+
+        /**
+         *  Tell if a sink has something to do, and is free to be claimed.
+         *  Called with mutexProduce locked.
+         *
+         *  @param ixSink the index of the sink.
+         *  @param seq the sequence number of the newest chunk.
+         *  @return true if the sink may be claimed.
+         */
+        inline bool
+        isClaimable (   unsigned int    ixSink,
+                        unsigned long   seq ) const         throw ()
+        {
+            const SinkData    * data = sinkData + ixSink;
+
+            // when stopped, only go on while there is data left to write
+            return !data->claimed
+                && (data->cut
+                 || (data->readSeq.load( std::memory_order_acquire) != seq
+                  && (running || data->accepting)));
+        }
+
+        /**
+         *  Allocate the ring buffer, and the frames it refers to.
+         *  The ring has enough slots to hold ringSize bytes in the
+         *  smallest chunks, each slot large enough for the largest one.
+         *
+         *  @param minBufSize the size of the smallest chunk read from
+         *                    the source.
+         *  @param maxBufSize the size of the largest chunk read from
+         *                    the source.
          *  @exception Exception
          */
         void
-        init ( bool     reconnect )                 ;
+        createRing ( unsigned int   minBufSize,
+                     unsigned int   maxBufSize )    ;
+
+        /**
+         *  Set the wall clock time of a frame, as kept by the audio read
+         *  before it. The time is set to the wall clock at the start,
+         *  and whenever the audio drifted too far from it, for example
+         *  after the source stalled.
+         *
+         *  @param frame the frame just read.
+         *  @param audioTime the time of the end of the previous frame,
+         *                   0 at the start.
+         *  @return the time of the end of this frame.
+         */
+        double
+        stampFrame (    AudioFrame    * frame,
+                        double          audioTime ) ;
+
+        /**
+         *  Choose the size of the next chunk to read, by how far the
+         *  sinks are behind: larger chunks while any of them falls
+         *  behind, so that less time goes on handing over each chunk,
+         *  and smaller ones again once all of them keep up, for a
+         *  lower latency.
+         *
+         *  @param chunkSize the size of the last chunk.
+         *  @param minBufSize the size of the smallest chunk.
+         *  @param maxBufSize the size of the largest chunk.
+         *  @param align the chunk sizes are multiples of this.
+         *  @return the size of the next chunk.
+         */
+        unsigned int
+        adaptChunkSize ( unsigned int   chunkSize,
+                         unsigned int   minBufSize,
+                         unsigned int   maxBufSize,
+                         unsigned int   align )     ;
+
+        /**
+         *  Free the ring buffer, and the frames it refers to.
+         */
+        void
+        destroyRing ( void )                        ;
+
+        /**
+         *  Get a frame not referred to by the ring or any sink thread.
+         *
+         *  @return a free frame.
+         *  @exception Exception
+         */
+        AudioFrame *
+        getFreeFrame ( void )                       ;
+
+        /**
+         *  Create the resamplers needed by the encoders among the sinks,
+         *  and attach the frames for their output to each frame.
+         *
+         *  @param sampleRate the sample rate of the source.
+         *  @param channel the number of channels of the source.
+         *  @exception Exception
+         */
+        void
+        createResamplers (  unsigned int    sampleRate,
+                            unsigned int    channel )   ;
 
         /**
          *  De-initialize the object.
@@ -221,15 +632,26 @@ class MultiThreadedConnector : public virtual Connector
          *  @param reconnect flag to indicate if the connector should
          *                   try to reconnect if the connection was
          *                   dropped by the other end
+         *  @param ringSize the size of the ring buffer shared by the sinks,
+         *                  in bytes. this is how much a sink may fall
+         *                  behind the source before it starts to lose data.
+         *  @param maxWorkers the number of threads writing to the sinks,
+         *                    0 for one for each CPU. there is never more
+         *                    than one for each sink.
+         *  @param pinWorkers pin each thread writing to the sinks to
+         *                    a CPU of its own.
          *  @exception Exception
          */
         inline
         MultiThreadedConnector (    Source        * source,
-                                    bool            reconnect )
+                                    bool            reconnect,
+                                    unsigned int    ringSize = 0,
+                                    unsigned int    maxWorkers = 0,
+                                    bool            pinWorkers = false )
                                                             
                     : Connector( source )
         {
-            init(reconnect);
+            init(reconnect, ringSize, maxWorkers, pinWorkers);
         }
 
         /**
@@ -240,16 +662,25 @@ class MultiThreadedConnector : public virtual Connector
          *  @param reconnect flag to indicate if the connector should
          *                   try to reconnect if the connection was
          *                   dropped by the other end
+         *  @param ringSize the size of the ring buffer shared by the sinks,
+         *                  in bytes.
+         *  @param maxWorkers the number of threads writing to the sinks,
+         *                    0 for one for each CPU.
+         *  @param pinWorkers pin each thread writing to the sinks to
+         *                    a CPU of its own.
          *  @exception Exception
          */
         inline
         MultiThreadedConnector ( Source            * source,
                                  Sink              * sink,
-                                 bool                reconnect )
+                                 bool                reconnect,
+                                 unsigned int        ringSize = 0,
+                                 unsigned int        maxWorkers = 0,
+                                 bool                pinWorkers = false )
                                                             
                     : Connector( source, sink)
         {
-            init(reconnect);
+            init(reconnect, ringSize, maxWorkers, pinWorkers);
         }
 
         /**
@@ -295,6 +726,8 @@ class MultiThreadedConnector : public virtual Connector
         /**
          *  Transfer a given amount of data from the Source to all the
          *  Sinks attached.
+         *  The data is put into the ring buffer, from where each sink
+         *  thread picks it up at its own pace.
          *  If an attached Sink closes or encounteres an error during the
          *  process, it is detached and the function carries on with the
          *  rest of the Sinks. If no Sinks remain, or an error is encountered
@@ -314,10 +747,42 @@ class MultiThreadedConnector : public virtual Connector
          *  @return the number of bytes read from the Source.
          *  @exception Exception
          */
-        virtual unsigned int
+        inline virtual unsigned int
         transfer (  unsigned long       bytes,
                     unsigned int        bufSize,
                     unsigned int        sec,
+                    unsigned int        usec )
+        {
+            return transfer( bytes, bufSize, bufSize, 1, sec, usec);
+        }
+
+        /**
+         *  Transfer a given amount of data from the Source to all the
+         *  Sinks attached, in chunks of a size adapting to how well the
+         *  sinks keep up, between a smallest and a largest size.
+         *  If both sizes are the same, the chunk size is fixed.
+         *
+         *  @param bytes the amount of data to transfer, in bytes.
+         *               If 0, transfer forever.
+         *  @param minBufSize the size of the smallest chunk to read,
+         *                    used while the sinks keep up.
+         *  @param maxBufSize the size of the largest chunk to read,
+         *                    used while the sinks fall behind.
+         *  @param align the chunk sizes are multiples of this, say the
+         *               size of a period of the source.
+         *  @param sec the number of seconds to wait for the Source to have
+         *             data available in each turn.
+         *  @param usec the number of micros seconds to wait for the Source
+         *              to have data available in each turn.
+         *  @return the number of bytes read from the Source.
+         *  @exception Exception
+         */
+        unsigned int
+        transfer (  unsigned long       bytes,
+                    unsigned int        minBufSize,
+                    unsigned int        maxBufSize,
+                    unsigned int        align,
+                    unsigned int        sec,
                     unsigned int        usec )          ;
 
         /**
@@ -331,6 +796,8 @@ class MultiThreadedConnector : public virtual Connector
 
         /**
          *  Close the Connector. The Source and all Sinks are closed.
+         *  Data still in the ring buffer is written to the sinks
+         *  before closing.
          *
          *  @exception Exception
          */
@@ -338,13 +805,134 @@ class MultiThreadedConnector : public virtual Connector
         close ( void )                                  ;
 
         /**
-         *  This is the worker function for each thread.
-         *  This function has to return fast
+         *  This is the function of each thread of the pool, writing
+         *  to the sinks until the connector is closed.
+         *
+         *  @param worker the worker this thread is.
+         */
+        void
+        workerThread( Worker    * worker );
+
+        /**
+         *  Write the next chunk to a sink claimed by a worker.
          *
-         *  @param ixSink the index of the sink this thread works on.
+         *  @param ixSink the index of the sink.
+         *  @param seq the sequence number of the newest chunk.
          */
         void
-        sinkThread( int     ixSink );
+        serveSink(  unsigned int    ixSink,
+                    unsigned long   seq );
+
+        /**
+         *  Set the threads writing to the sinks, for when several
+         *  connectors share the CPUs. Takes effect on the next open().
+         *
+         *  @param maxWorkers the number of threads writing to the sinks,
+         *                    0 for one for each CPU.
+         *  @param firstCpu the first CPU to pin the threads to, if
+         *                  pinned, the next ones following it.
+         */
+        inline void
+        setWorkers (    unsigned int    maxWorkers,
+                        unsigned int    firstCpu )          throw ()
+        {
+            this->maxWorkers = maxWorkers;
+            this->firstCpu   = firstCpu;
+        }
+
+        /**
+         *  Have a sink cut what it has done so far periodically, by the
+         *  time kept by the audio, at boundaries aligned to the local
+         *  wall clock: every hour on the hour, for example. The sink is
+         *  cut between two chunks, before the first one starting at or
+         *  after the boundary, so that no audio is lost or written
+         *  twice. To take effect, call before open().
+         *
+         *  @param ixSink the index of the sink, as attached.
+         *  @param seconds the seconds between the cuts, 0 for none.
+         */
+        void
+        setRotation (   unsigned int    ixSink,
+                        unsigned int    seconds )           ;
+
+        /**
+         *  Get the number of threads writing to the sinks.
+         *
+         *  @return the number of threads in the pool, 0 if not open.
+         */
+        inline unsigned int
+        getNumWorkers ( void ) const                        throw ()
+        {
+            return numWorkers;
+        }
+
+        /**
+         *  Get the number of chunks a sink had to skip so far, because
+         *  it could not keep up with the source.
+         *
+         *  @param ixSink the index of the sink.
+         *  @return the number of chunks skipped by the sink.
+         */
+        inline unsigned long
+        getOverruns ( unsigned int  ixSink ) const          throw ()
+        {
+            return sinkData && ixSink < numSinks ? sinkData[ixSink].overruns : 0;
+        }
+
+        /**
+         *  Get the number of times a sink failed and was reopened so far.
+         *
+         *  @param ixSink the index of the sink.
+         *  @return the number of reconnections of the sink.
+         */
+        inline unsigned long
+        getReconnects ( unsigned int    ixSink ) const      throw ()
+        {
+            return sinkData && ixSink < numSinks
+                 ? sinkData[ixSink].reconnects : 0;
+        }
+
+        /**
+         *  Get the number of chunks a sink is behind the source.
+         *
+         *  @param ixSink the index of the sink.
+         *  @return the number of chunks not yet written to the sink.
+         */
+        inline unsigned long
+        getLag ( unsigned int   ixSink ) const              throw ()
+        {
+            return sinkData && ixSink < numSinks
+                 ? writeSeq.load() - sinkData[ixSink].readSeq.load(
+                                                std::memory_order_acquire)
+                 : 0;
+        }
+
+        /**
+         *  Get the times it took to write the chunks to a sink.
+         *  For encoders this is the time spent encoding.
+         *
+         *  @param ixSink the index of the sink.
+         *  @return the write times of the sink, or 0 if there is no
+         *          such sink.
+         */
+        inline const TimeSummary *
+        getWriteTime ( unsigned int ixSink ) const          throw ()
+        {
+            return sinkData && ixSink < numSinks
+                 ? &sinkData[ixSink].writeTime : 0;
+        }
+
+        /**
+         *  Get the times it took the source to deliver the chunks,
+         *  that is, the time spent waiting for the audio.
+         *
+         *  @return the read times of the source.
+         */
+        inline const TimeSummary &
+        getReadTime ( void ) const                          throw ()
+        {
+            return readTime;
+        }
 };
 
 
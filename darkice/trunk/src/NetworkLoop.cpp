@@ -0,0 +1,641 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : NetworkLoop.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#else
+#error need sys/types.h
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#else
+#error need errno.h
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#error need unistd.h
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#error need fcntl.h
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#else
+#error need sys/socket.h
+#endif
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#error need sys/time.h
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#else
+#error need signal.h
+#endif
+
+
+#include "Exception.h"
+#include "NetworkLoop.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The longest the loop waits without looking at the connections, in ms
+ *----------------------------------------------------------------------------*/
+static const int maxWait = 1000;
+
+/*------------------------------------------------------------------------------
+ *  The flags to send with
+ *----------------------------------------------------------------------------*/
+#ifdef HAVE_MSG_NOSIGNAL
+static const int sendFlags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#else
+static const int sendFlags = MSG_DONTWAIT;
+#endif
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Create a connection
+ *----------------------------------------------------------------------------*/
+NetworkLoop :: Connection :: Connection (   int             fd,
+                                            unsigned int    queueSize )
+{
+    this->fd        = fd;
+    this->queue     = new unsigned char[queueSize];
+    this->queueSize = queueSize;
+    this->head      = 0;
+    this->length    = 0;
+    this->blocked   = false;
+    this->error     = 0;
+    this->sent.store( 0, std::memory_order_relaxed);
+    this->next      = 0;
+
+    pthread_mutex_init( &mutex, 0);
+    pthread_cond_init( &cond, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Destroy a connection
+ *----------------------------------------------------------------------------*/
+NetworkLoop :: Connection :: ~Connection ( void )
+{
+    pthread_cond_destroy( &cond);
+    pthread_mutex_destroy( &mutex);
+    delete[] queue;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: init ( unsigned int      queueSize )
+{
+    if ( queueSize == 0 ) {
+        throw Exception( __FILE__, __LINE__, "no queue size");
+    }
+
+    this->queueSize      = queueSize;
+    this->connections    = 0;
+    this->numConnections = 0;
+    this->thread         = 0;
+    this->running        = false;
+    this->pollFd         = -1;
+    this->wakePending.store( false);
+
+    if ( pipe( wakeFds) == -1 ) {
+        throw Exception( __FILE__, __LINE__, "pipe error", errno);
+    }
+    fcntl( wakeFds[0], F_SETFL, fcntl( wakeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl( wakeFds[1], F_SETFL, fcntl( wakeFds[1], F_GETFL) | O_NONBLOCK);
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event  event;
+
+    if ( (pollFd = epoll_create( 16)) == -1 ) {
+        ::close( wakeFds[0]);
+        ::close( wakeFds[1]);
+        throw Exception( __FILE__, __LINE__, "epoll_create error", errno);
+    }
+
+    memset( &event, 0, sizeof(event));
+    event.events  = EPOLLIN;
+    event.data.fd = wakeFds[0];
+    epoll_ctl( pollFd, EPOLL_CTL_ADD, wakeFds[0], &event);
+#endif
+
+    pthread_mutex_init( &mutex, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: strip ( void )
+{
+    stop();
+
+    while ( connections ) {
+        remove( connections);
+    }
+
+    if ( pollFd != -1 ) {
+        ::close( pollFd);
+    }
+    ::close( wakeFds[0]);
+    ::close( wakeFds[1]);
+
+    pthread_mutex_destroy( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start the loop
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: start ( void )
+{
+    if ( running ) {
+        return;
+    }
+
+    running = true;
+    if ( pthread_create( &thread, 0, threadFunction, this) ) {
+        running = false;
+        throw Exception( __FILE__, __LINE__, "can't create network thread");
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Stop the loop
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: stop ( void )
+{
+    if ( !running ) {
+        return;
+    }
+
+    running = false;
+    wakePending.store( false);
+    wakeUp();
+    pthread_join( thread, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Hand a socket over to the loop
+ *----------------------------------------------------------------------------*/
+NetworkLoop :: Connection *
+NetworkLoop :: add ( int    fd )
+{
+    Connection    * conn;
+    int             flags;
+
+    if ( (flags = fcntl( fd, F_GETFL)) == -1
+      || fcntl( fd, F_SETFL, flags | O_NONBLOCK) == -1 ) {
+        throw Exception( __FILE__, __LINE__,
+                         "can't make socket non-blocking", errno);
+    }
+
+    conn = new Connection( fd, queueSize);
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event  event;
+
+    // edge triggered: only tell when the socket turns writable again,
+    // new data is announced by waking up the loop
+    memset( &event, 0, sizeof(event));
+    event.events  = EPOLLOUT | EPOLLET;
+    event.data.fd = fd;
+    if ( epoll_ctl( pollFd, EPOLL_CTL_ADD, fd, &event) == -1 ) {
+        delete conn;
+        throw Exception( __FILE__, __LINE__, "epoll_ctl error", errno);
+    }
+#endif
+
+    pthread_mutex_lock( &mutex);
+    conn->next  = connections;
+    connections = conn;
+    ++numConnections;
+    pthread_mutex_unlock( &mutex);
+
+    return conn;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Take a connection away from the loop
+ *----------------------------------------------------------------------------*/
+unsigned long
+NetworkLoop :: remove ( Connection    * conn )
+{
+    Connection   ** c;
+    unsigned long   sent;
+
+    // the loop only touches the connections while holding the mutex
+    pthread_mutex_lock( &mutex);
+    for ( c = &connections; *c; c = &(*c)->next ) {
+        if ( *c == conn ) {
+            *c = conn->next;
+            --numConnections;
+            break;
+        }
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event  event;
+
+    memset( &event, 0, sizeof(event));
+    epoll_ctl( pollFd, EPOLL_CTL_DEL, conn->fd, &event);
+#endif
+    pthread_mutex_unlock( &mutex);
+
+    sent = conn->getSent();
+    delete conn;
+
+    return sent;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Queue data to be sent
+ *----------------------------------------------------------------------------*/
+unsigned int
+NetworkLoop :: send (   Connection    * conn,
+                        const void    * buf,
+                        unsigned int    len )
+{
+    const unsigned char   * b = (const unsigned char *) buf;
+    unsigned int            tail;
+    unsigned int            size;
+    bool                    wake;
+
+    pthread_mutex_lock( &conn->mutex);
+
+    if ( conn->error ) {
+        int     error = conn->error;
+
+        pthread_mutex_unlock( &conn->mutex);
+        throw Exception( __FILE__, __LINE__, "send error", error);
+    }
+
+    if ( len > conn->queueSize - conn->length ) {
+        len = conn->queueSize - conn->length;
+    }
+
+    // copy in two turns if the data wraps around the end of the queue
+    tail = (conn->head + conn->length) % conn->queueSize;
+    size = conn->queueSize - tail;
+    if ( size > len ) {
+        size = len;
+    }
+    memcpy( conn->queue + tail, b, size);
+    memcpy( conn->queue, b + size, len - size);
+
+    // the loop only needs to know if it wasn't sending anyway
+    wake          = len > 0 && conn->length == 0 && !conn->blocked;
+    conn->length += len;
+
+    pthread_mutex_unlock( &conn->mutex);
+
+    if ( wake ) {
+        wakeUp();
+    }
+
+    return len;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Check if a connection can take more data
+ *----------------------------------------------------------------------------*/
+bool
+NetworkLoop :: canSend (    Connection    * conn,
+                            unsigned int    sec,
+                            unsigned int    usec )
+{
+    bool    ret;
+
+    pthread_mutex_lock( &conn->mutex);
+
+    if ( conn->length == conn->queueSize && !conn->error
+      && (sec || usec) ) {
+        struct timeval      now;
+        struct timespec     timeout;
+
+        gettimeofday( &now, 0);
+        timeout.tv_sec  = now.tv_sec + sec + (now.tv_usec + usec) / 1000000;
+        timeout.tv_nsec = ((now.tv_usec + usec) % 1000000) * 1000;
+
+        while ( conn->length == conn->queueSize && !conn->error ) {
+            if ( pthread_cond_timedwait( &conn->cond,
+                                         &conn->mutex,
+                                         &timeout) == ETIMEDOUT ) {
+                break;
+            }
+        }
+    }
+
+    ret = conn->length < conn->queueSize || conn->error;
+
+    pthread_mutex_unlock( &conn->mutex);
+
+    return ret;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wait for the queue of a connection to be sent
+ *----------------------------------------------------------------------------*/
+bool
+NetworkLoop :: drain (  Connection    * conn,
+                        unsigned int    sec )
+{
+    struct timeval      now;
+    struct timespec     timeout;
+    bool                ret;
+
+    gettimeofday( &now, 0);
+    timeout.tv_sec  = now.tv_sec + sec;
+    timeout.tv_nsec = now.tv_usec * 1000;
+
+    pthread_mutex_lock( &conn->mutex);
+    while ( running && conn->length > 0 && !conn->error ) {
+        if ( pthread_cond_timedwait( &conn->cond,
+                                     &conn->mutex,
+                                     &timeout) == ETIMEDOUT ) {
+            break;
+        }
+    }
+    ret = conn->length == 0;
+    pthread_mutex_unlock( &conn->mutex);
+
+    return ret;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wake up the loop
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: wakeUp ( void )
+{
+    char    c = 0;
+
+    if ( !wakePending.exchange( true) ) {
+        if ( ::write( wakeFds[1], &c, 1) == -1 && errno != EAGAIN ) {
+            reportEvent( 2, "NetworkLoop :: wakeUp, write error", errno);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wait for connections to become ready, or to be woken up
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: waitForEvents ( void )
+{
+    char            buf[64];
+    bool            woken = false;
+    int             n;
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event    * ev;
+    unsigned int            maxEvents;
+
+    pthread_mutex_lock( &mutex);
+    maxEvents = numConnections + 1;
+    pthread_mutex_unlock( &mutex);
+    ev = events.reserve( maxEvents);
+
+    n = epoll_wait( pollFd, ev, maxEvents, maxWait);
+
+    pthread_mutex_lock( &mutex);
+    for ( int i = 0; i < n; ++i ) {
+        if ( ev[i].data.fd == wakeFds[0] ) {
+            woken = true;
+            continue;
+        }
+        for ( Connection * conn = connections; conn; conn = conn->next ) {
+            if ( conn->fd == ev[i].data.fd ) {
+                pthread_mutex_lock( &conn->mutex);
+                conn->blocked = false;
+                pthread_mutex_unlock( &conn->mutex);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock( &mutex);
+#else
+    struct pollfd         * pfd;
+    unsigned int            nfds = 1;
+
+    // the list only changes under the mutex, but the poll itself
+    // must not hold it, so collect the sockets waited for first
+    pthread_mutex_lock( &mutex);
+    pfd            = events.reserve( numConnections + 1);
+    pfd[0].fd      = wakeFds[0];
+    pfd[0].events  = POLLIN;
+    pfd[0].revents = 0;
+    for ( Connection * conn = connections; conn; conn = conn->next ) {
+        bool    blocked;
+
+        pthread_mutex_lock( &conn->mutex);
+        blocked = conn->blocked;
+        pthread_mutex_unlock( &conn->mutex);
+        if ( blocked ) {
+            pfd[nfds].fd      = conn->fd;
+            pfd[nfds].events  = POLLOUT;
+            pfd[nfds].revents = 0;
+            ++nfds;
+        }
+    }
+    pthread_mutex_unlock( &mutex);
+
+    n = poll( pfd, nfds, maxWait);
+
+    pthread_mutex_lock( &mutex);
+    woken = n > 0 && pfd[0].revents;
+    for ( unsigned int i = 1; n > 0 && i < nfds; ++i ) {
+        if ( !pfd[i].revents ) {
+            continue;
+        }
+        for ( Connection * conn = connections; conn; conn = conn->next ) {
+            if ( conn->fd == pfd[i].fd ) {
+                pthread_mutex_lock( &conn->mutex);
+                conn->blocked = false;
+                pthread_mutex_unlock( &conn->mutex);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock( &mutex);
+#endif
+
+    if ( woken ) {
+        // clear the flag before looking at the queues, so that data
+        // queued from now on wakes the loop again
+        while ( ::read( wakeFds[0], buf, sizeof(buf)) > 0 ) {
+        }
+        wakePending.store( false);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Send what is in the queue of a connection
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: sendQueue ( Connection     * conn )
+{
+    struct iovec    iov[2];
+    struct msghdr   msg;
+    unsigned int    size;
+    ssize_t         ret;
+
+    pthread_mutex_lock( &conn->mutex);
+
+    if ( conn->blocked || conn->error || conn->length == 0 ) {
+        pthread_mutex_unlock( &conn->mutex);
+        return;
+    }
+
+    // send everything queued at once, even if it wraps around
+    size = conn->queueSize - conn->head;
+    if ( size > conn->length ) {
+        size = conn->length;
+    }
+    iov[0].iov_base = conn->queue + conn->head;
+    iov[0].iov_len  = size;
+    iov[1].iov_base = conn->queue;
+    iov[1].iov_len  = conn->length - size;
+
+    memset( &msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iov[1].iov_len ? 2 : 1;
+
+    ret = sendmsg( conn->fd, &msg, sendFlags);
+
+    if ( ret > 0 ) {
+        conn->head    = (conn->head + ret) % conn->queueSize;
+        conn->length -= ret;
+        conn->sent.fetch_add( ret, std::memory_order_relaxed);
+        if ( conn->length > 0 ) {
+            // the socket took less than offered, so it's full
+            conn->blocked = true;
+        }
+    } else if ( ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) ) {
+        conn->blocked = true;
+    } else if ( ret == -1 && errno != EINTR ) {
+        conn->error = errno;
+        reportEvent( 4, "NetworkLoop :: sendQueue, send error", errno);
+    }
+
+    pthread_cond_broadcast( &conn->cond);
+    pthread_mutex_unlock( &conn->mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The loop itself
+ *----------------------------------------------------------------------------*/
+void
+NetworkLoop :: loop ( void )
+{
+    while ( running ) {
+        waitForEvents();
+
+        pthread_mutex_lock( &mutex);
+        for ( Connection * conn = connections; conn; conn = conn->next ) {
+            sendQueue( conn);
+        }
+        pthread_mutex_unlock( &mutex);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The thread function
+ *----------------------------------------------------------------------------*/
+void *
+NetworkLoop :: threadFunction ( void      * param )
+{
+    NetworkLoop   * loop = (NetworkLoop *) param;
+    sigset_t        sigset;
+
+    // SIGUSR1 is for the main thread, to cut the recordings
+    sigemptyset( &sigset);
+    sigaddset( &sigset, SIGUSR1);
+    pthread_sigmask( SIG_BLOCK, &sigset, 0);
+
+    loop->loop();
+
+    return 0;
+}
+
@@ -0,0 +1,462 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : NetworkLoop.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef NETWORK_LOOP_H
+#define NETWORK_LOOP_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+#if defined( HAVE_SYS_EPOLL_H )
+#include <sys/epoll.h>
+#elif defined( HAVE_POLL_H )
+#include <poll.h>
+#else
+#error need sys/epoll.h or poll.h
+#endif
+
+#include <atomic>
+
+#include "Referable.h"
+#include "Reporter.h"
+#include "Exception.h"
+#include "ScratchBuffer.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A single thread sending the data of all the network connections.
+ *
+ *  Connections handed over to the loop are made non-blocking. The data
+ *  written to them is put into a queue of each connection, and is sent
+ *  by the loop whenever the connection is ready to accept data, with
+ *  everything queued going out in a single system call. Thus the
+ *  threads writing to the connections never wait for the network,
+ *  and do no system calls themselves, except for waking up the loop
+ *  when it is idle.
+ *
+ *  The loop waits with epoll where available, and with poll otherwise.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class NetworkLoop : public virtual Referable, public virtual Reporter
+{
+    public:
+
+        /**
+         *  A connection handed over to the loop.
+         */
+        class Connection
+        {
+            friend class NetworkLoop;
+
+            private:
+
+                /**
+                 *  The socket of the connection.
+                 */
+                int                     fd;
+
+                /**
+                 *  The queue of the data to send.
+                 */
+                unsigned char         * queue;
+
+                /**
+                 *  The size of the queue.
+                 */
+                unsigned int            queueSize;
+
+                /**
+                 *  The position of the first byte to send in the queue.
+                 */
+                unsigned int            head;
+
+                /**
+                 *  The number of bytes in the queue.
+                 */
+                unsigned int            length;
+
+                /**
+                 *  Tells if the socket can not accept more data right now.
+                 *  Read and written under the mutex of the connection, as
+                 *  send() looks at it too.
+                 */
+                bool                    blocked;
+
+                /**
+                 *  The error that broke the connection, or 0 if none.
+                 */
+                int                     error;
+
+                /**
+                 *  The number of bytes sent so far. Counted by the loop,
+                 *  read by the writer.
+                 */
+                std::atomic<unsigned long>  sent;
+
+                /**
+                 *  The mutex protecting the queue and the flags.
+                 */
+                pthread_mutex_t         mutex;
+
+                /**
+                 *  Signalled whenever data has left the queue.
+                 */
+                pthread_cond_t          cond;
+
+                /**
+                 *  The next connection of the loop.
+                 */
+                Connection            * next;
+
+                /**
+                 *  Constructor.
+                 *
+                 *  @param fd the socket of the connection.
+                 *  @param queueSize the size of the queue, in bytes.
+                 */
+                Connection (    int             fd,
+                                unsigned int    queueSize );
+
+                /**
+                 *  Destructor.
+                 */
+                ~Connection ( void );
+
+                /**
+                 *  Copy constructor. Not implemented, a connection can
+                 *  not be copied.
+                 *
+                 *  @param conn the connection to copy.
+                 */
+                Connection ( const Connection  & conn );
+
+            public:
+
+                /**
+                 *  Get the number of bytes waiting to be sent.
+                 *
+                 *  @return the number of bytes in the queue.
+                 */
+                inline unsigned int
+                getQueued ( void ) const                    throw ()
+                {
+                    return length;
+                }
+
+                /**
+                 *  Get the number of bytes sent on the connection so far.
+                 *
+                 *  @return the number of bytes sent.
+                 */
+                inline unsigned long
+                getSent ( void ) const                      throw ()
+                {
+                    return sent.load( std::memory_order_relaxed);
+                }
+        };
+
+
+    private:
+
+        /**
+         *  The size of the queue of each connection.
+         */
+        unsigned int            queueSize;
+
+        /**
+         *  The connections handed over to the loop.
+         */
+        Connection            * connections;
+
+        /**
+         *  The number of connections.
+         */
+        unsigned int            numConnections;
+
+        /**
+         *  The mutex protecting the list of connections.
+         */
+        pthread_mutex_t         mutex;
+
+        /**
+         *  The epoll descriptor, or -1 if polling.
+         */
+        int                     pollFd;
+
+        /**
+         *  The pipe used to wake up the loop. The loop waits on the
+         *  first one, others write into the second one.
+         */
+        int                     wakeFds[2];
+
+        /**
+         *  Tells if a wake-up is already pending, so that no more
+         *  are needed until the loop gets to it.
+         */
+        std::atomic<bool>       wakePending;
+
+        /**
+         *  The events waited for, or received.
+         */
+#ifdef HAVE_SYS_EPOLL_H
+        ScratchBuffer<struct epoll_event>   events;
+#else
+        ScratchBuffer<struct pollfd>        events;
+#endif
+
+        /**
+         *  The thread of the loop.
+         */
+        pthread_t               thread;
+
+        /**
+         *  Tells if the loop is to go on.
+         */
+        bool                    running;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param queueSize the size of the queue of each connection.
+         *  @exception Exception
+         */
+        void
+        init ( unsigned int     queueSize );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Wake up the loop, if it is not about to wake up anyway.
+         */
+        void
+        wakeUp ( void );
+
+        /**
+         *  Wait for connections to be ready to send, or for the loop
+         *  to be woken up. Marks the connections ready as not blocked.
+         */
+        void
+        waitForEvents ( void );
+
+        /**
+         *  Send as much of the queue of a connection as it takes.
+         *
+         *  @param conn the connection to send on.
+         */
+        void
+        sendQueue ( Connection    * conn );
+
+        /**
+         *  The loop itself.
+         */
+        void
+        loop ( void );
+
+        /**
+         *  The thread function.
+         *
+         *  @param param the NetworkLoop to run.
+         *  @return nothing.
+         */
+        static void *
+        threadFunction ( void     * param );
+
+
+    protected:
+
+        /**
+         *  Copy constructor. Always throws an Exception, as the
+         *  connections can not be shared.
+         *
+         *  @param loop the object to copy.
+         *  @exception Exception
+         */
+        inline
+        NetworkLoop ( const NetworkLoop   & loop )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param loop the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline NetworkLoop &
+        operator= ( const NetworkLoop & loop )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param queueSize the size of the send queue of each connection,
+         *                   in bytes.
+         *  @exception Exception
+         */
+        inline
+        NetworkLoop ( unsigned int  queueSize = 32768 )
+        {
+            init( queueSize);
+        }
+
+        /**
+         *  Destructor. Stops the loop if still running.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~NetworkLoop ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Start the loop in a thread of its own.
+         *
+         *  @exception Exception
+         */
+        void
+        start ( void );
+
+        /**
+         *  Stop the loop. Data still queued is not sent.
+         */
+        void
+        stop ( void );
+
+        /**
+         *  Hand a connected socket over to the loop. The socket is made
+         *  non-blocking. The socket stays owned by the caller, and must
+         *  not be closed before the connection is removed.
+         *
+         *  @param fd the socket.
+         *  @return the connection, to send data on.
+         *  @exception Exception
+         */
+        Connection *
+        add ( int   fd );
+
+        /**
+         *  Take a connection away from the loop. Data still in its
+         *  queue is lost.
+         *
+         *  @param conn the connection to remove, it is deleted.
+         *  @return the number of bytes sent on the connection.
+         */
+        unsigned long
+        remove ( Connection   * conn );
+
+        /**
+         *  Queue data to be sent on a connection.
+         *
+         *  @param conn the connection to send on.
+         *  @param buf the data to send.
+         *  @param len the number of bytes to send.
+         *  @return the number of bytes queued, may be less than len
+         *          if the queue is full.
+         *  @exception Exception if the connection is broken.
+         */
+        unsigned int
+        send (  Connection    * conn,
+                const void    * buf,
+                unsigned int    len );
+
+        /**
+         *  Check if a connection can take more data, waiting for the
+         *  specified time for space in its queue.
+         *
+         *  @param conn the connection.
+         *  @param sec the maximum seconds to wait.
+         *  @param usec micro seconds to wait after the full seconds.
+         *  @return true if data can be queued, or if the connection is
+         *          broken and send() would tell so, false otherwise.
+         */
+        bool
+        canSend (   Connection    * conn,
+                    unsigned int    sec,
+                    unsigned int    usec );
+
+        /**
+         *  Wait for the queue of a connection to be sent.
+         *
+         *  @param conn the connection.
+         *  @param sec the maximum seconds to wait.
+         *  @return true if everything was sent, false otherwise.
+         */
+        bool
+        drain ( Connection    * conn,
+                unsigned int    sec );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* NETWORK_LOOP_H */
+
@@ -0,0 +1,443 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : OggCutCheck.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error need stdlib.h
+#endif
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error need stdio.h
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#error need unistd.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+#include <dirent.h>
+#include <iostream>
+
+#include "Exception.h"
+#include "Ref.h"
+#include "Reporter.h"
+#include "FileSink.h"
+#include "FileCast.h"
+
+#if defined( HAVE_VORBIS_LIB ) || defined( HAVE_OPUS_LIB )
+#include <ogg/ogg.h>
+#endif
+#ifdef HAVE_VORBIS_LIB
+#include <vorbis/codec.h>
+#include "VorbisLibEncoder.h"
+#endif
+#ifdef HAVE_OPUS_LIB
+#include "OpusLibEncoder.h"
+#endif
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The sample rate of the audio encoded
+ *----------------------------------------------------------------------------*/
+static const unsigned int   sampleRate  = 44100;
+
+/*------------------------------------------------------------------------------
+ *  The size of the chunks written, as DarkIce reads by default
+ *----------------------------------------------------------------------------*/
+static const unsigned int   chunkSize   = 4096;
+
+/*------------------------------------------------------------------------------
+ *  The chunks written between two cuts, about two seconds
+ *----------------------------------------------------------------------------*/
+static const unsigned int   cutChunks   = 86;
+
+/*------------------------------------------------------------------------------
+ *  The chunks written between getting ready for a cut and the cut
+ *----------------------------------------------------------------------------*/
+static const unsigned int   leadChunks  = 20;
+
+/*------------------------------------------------------------------------------
+ *  The number of rotations, the files of an output being two more, with
+ *  the one started by the cut as by SIGUSR1
+ *----------------------------------------------------------------------------*/
+static const unsigned int   numCuts     = 3;
+
+/*------------------------------------------------------------------------------
+ *  The time the first file is named after, and the rotations of the
+ *  others, an hour apart
+ *----------------------------------------------------------------------------*/
+static const time_t         firstTime   = 1000000000;
+
+/*------------------------------------------------------------------------------
+ *  The part of the audio of an output that may be missing from its files,
+ *  or added to them, for the codec delay and padding of each file
+ *----------------------------------------------------------------------------*/
+static const double         tolerance   = 0.02;
+
+
+/* =============================================================  module code */
+
+#if defined( HAVE_VORBIS_LIB ) || defined( HAVE_OPUS_LIB )
+
+/*------------------------------------------------------------------------------
+ *  Check the Ogg stream of a file: a single logical stream, starting with
+ *  the headers of the codec, its pages in sequence with valid checksums,
+ *  ending with an end of stream page. Get the number of samples in it.
+ *----------------------------------------------------------------------------*/
+static bool
+checkFile (     const char        * path,
+                bool                opus,
+                long              * samples )
+{
+    FILE              * f;
+    ogg_sync_state      oy;
+    ogg_stream_state    os;
+    ogg_page            og;
+    ogg_packet          op;
+    long                pages    = 0;
+    long                packets  = 0;
+    long                seq      = -1;
+    ogg_int64_t         granule  = 0;
+    long                preSkip  = 0;
+    bool                eos      = false;
+    bool                ok       = true;
+    bool                more     = true;
+#ifdef HAVE_VORBIS_LIB
+    vorbis_info         vi;
+    vorbis_comment      vc;
+#endif
+
+    *samples = 0;
+    if ( !(f = fopen( path, "rb")) ) {
+        std::cerr << path << ": can't open" << std::endl;
+        return false;
+    }
+    ogg_sync_init( &oy);
+#ifdef HAVE_VORBIS_LIB
+    vorbis_info_init( &vi);
+    vorbis_comment_init( &vc);
+#endif
+
+    while ( ok && more ) {
+        long    ret = ogg_sync_pageseek( &oy, &og);
+
+        if ( ret < 0 ) {
+            std::cerr << path << ": bad page, " << -ret << " bytes skipped"
+                      << std::endl;
+            ok = false;
+            break;
+        }
+        if ( ret == 0 ) {
+            char      * buf = ogg_sync_buffer( &oy, 4096);
+            size_t      len = fread( buf, 1, 4096, f);
+
+            ogg_sync_wrote( &oy, len);
+            more = len > 0;
+            continue;
+        }
+
+        if ( pages == 0 ) {
+            if ( !ogg_page_bos( &og) ) {
+                std::cerr << path << ": no start of stream" << std::endl;
+                ok = false;
+            }
+            ogg_stream_init( &os, ogg_page_serialno( &og));
+        } else if ( eos
+                 || ogg_page_bos( &og)
+                 || ogg_page_serialno( &og) != os.serialno ) {
+            std::cerr << path << ": more than one logical stream" << std::endl;
+            ok = false;
+        }
+        if ( ogg_page_pageno( &og) != seq + 1 ) {
+            std::cerr << path << ": page " << ogg_page_pageno( &og)
+                      << " after " << seq << std::endl;
+            ok = false;
+        }
+        if ( ogg_page_granulepos( &og) != -1 ) {
+            if ( ogg_page_granulepos( &og) < granule ) {
+                std::cerr << path << ": granule position goes back"
+                          << std::endl;
+                ok = false;
+            }
+            granule = ogg_page_granulepos( &og);
+        }
+        seq = ogg_page_pageno( &og);
+        eos = ogg_page_eos( &og);
+        ++pages;
+
+        ogg_stream_pagein( &os, &og);
+        while ( ok && (ret = ogg_stream_packetout( &os, &op)) != 0 ) {
+            if ( ret < 0 ) {
+                std::cerr << path << ": packets missing" << std::endl;
+                ok = false;
+                break;
+            }
+            if ( opus && packets == 0 ) {
+                if ( op.bytes < 19 || memcmp( op.packet, "OpusHead", 8) ) {
+                    std::cerr << path << ": no OpusHead" << std::endl;
+                    ok = false;
+                }
+                preSkip = op.packet[10] | (op.packet[11] << 8);
+            } else if ( opus && packets == 1 ) {
+                if ( op.bytes < 8 || memcmp( op.packet, "OpusTags", 8) ) {
+                    std::cerr << path << ": no OpusTags" << std::endl;
+                    ok = false;
+                }
+            }
+#ifdef HAVE_VORBIS_LIB
+            if ( !opus && packets < 3
+              && vorbis_synthesis_headerin( &vi, &vc, &op) ) {
+                std::cerr << path << ": bad vorbis header " << packets
+                          << std::endl;
+                ok = false;
+            }
+#endif
+            ++packets;
+        }
+    }
+
+    if ( ok && oy.fill > oy.returned ) {
+        std::cerr << path << ": partial page at the end" << std::endl;
+        ok = false;
+    }
+    if ( ok && !eos ) {
+        std::cerr << path << ": no end of stream" << std::endl;
+        ok = false;
+    }
+    if ( pages ) {
+        ogg_stream_clear( &os);
+    }
+    ogg_sync_clear( &oy);
+    fclose( f);
+#ifdef HAVE_VORBIS_LIB
+    vorbis_comment_clear( &vc);
+    vorbis_info_clear( &vi);
+#endif
+
+    *samples = (long) granule - preSkip;
+    return ok;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Encode a tone to files in a directory of their own, cutting them as
+ *  a rotation and as SIGUSR1 would, and check each file on its own
+ *----------------------------------------------------------------------------*/
+static bool
+checkOutput (   const char        * name,
+                bool                opus,
+                unsigned int        outSampleRate,
+                unsigned int        pipelineDepth )
+{
+    char                    dir[]   = "/tmp/darkice-oggcutcheck-XXXXXX";
+    char                    path[512];
+    Ref<FileSink>           file;
+    Ref<AudioEncoder>       encoder;
+    int16_t                 buf[chunkSize / 2];
+    unsigned long           frames  = 0;
+    unsigned int            c;
+    unsigned int            n;
+    long                    total   = 0;
+    unsigned int            files   = 0;
+    double                  expected;
+    bool                    ok      = true;
+    DIR                   * d;
+    struct dirent         * e;
+
+    if ( !mkdtemp( dir) ) {
+        std::cerr << "can't create " << dir << std::endl;
+        return false;
+    }
+    snprintf( path, sizeof( path), "%s/%s.%s", dir, name, opus ? "opus"
+                                                                : "ogg");
+
+    file = new FileSink( "oggcutcheck", path, true, "-%Y%m%d-%H%M%S");
+    if ( !file->create( firstTime) ) {
+        return false;
+    }
+
+#ifdef HAVE_VORBIS_LIB
+    if ( !opus ) {
+        encoder = new VorbisLibEncoder( new FileCast( file.get()),
+                                        sampleRate, 16, 2, false,
+                                        AudioEncoder::vbr, 128, 0.4,
+                                        outSampleRate, 2, 0,
+                                        pipelineDepth);
+    }
+#endif
+#ifdef HAVE_OPUS_LIB
+    if ( opus ) {
+        encoder = new OpusLibEncoder( new FileCast( file.get()),
+                                      sampleRate, 16, 2, false,
+                                      AudioEncoder::vbr, 96, 0.5,
+                                      outSampleRate, 2, 0,
+                                      pipelineDepth);
+    }
+#endif
+    if ( !encoder->open() ) {
+        std::cerr << name << ": can't open the encoder" << std::endl;
+        return false;
+    }
+
+    for ( c = 0; c <= numCuts * cutChunks; ++c ) {
+        // as the connector does, a while ahead of each rotation
+        if ( c % cutChunks == cutChunks - leadChunks ) {
+            encoder->prepareCut( firstTime + (c / cutChunks + 1) * 3600);
+        }
+        // as SIGUSR1 would, after the file of the rotation was created
+        if ( c == 2 * cutChunks - leadChunks / 2 ) {
+            encoder->cut();
+        }
+        if ( c && c % cutChunks == 0 ) {
+            encoder->cutAt( firstTime + (c / cutChunks) * 3600);
+        }
+
+        for ( n = 0; n < chunkSize / 4; ++n, ++frames ) {
+            int16_t     v = (int16_t) (8000.0 * sin( frames * 0.0627));
+
+            buf[2 * n]     = v;
+            buf[2 * n + 1] = (int16_t) -v;
+        }
+        encoder->write( buf, chunkSize);
+    }
+    encoder->close();
+
+    // all the files cut from the stream, named after the time of the
+    // rotations and of the cut by SIGUSR1
+    if ( !(d = opendir( dir)) ) {
+        return false;
+    }
+    while ( (e = readdir( d)) ) {
+        long    samples;
+
+        if ( e->d_name[0] == '.' ) {
+            continue;
+        }
+        snprintf( path, sizeof( path), "%s/%s", dir, e->d_name);
+        if ( !checkFile( path, opus, &samples) ) {
+            ok = false;
+        }
+        std::cout << "  " << e->d_name << ": " << samples << " samples"
+                  << std::endl;
+        total += samples;
+        ++files;
+        unlink( path);
+    }
+    closedir( d);
+    rmdir( dir);
+
+    expected = (double) frames * outSampleRate / sampleRate;
+    if ( files != numCuts + 2 ) {
+        std::cerr << name << ": " << files << " files instead of "
+                  << numCuts + 2 << std::endl;
+        ok = false;
+    }
+    if ( fabs( total - expected) > expected * tolerance ) {
+        std::cerr << name << ": " << total << " samples in all instead of "
+                  << expected << std::endl;
+        ok = false;
+    }
+    std::cout << name << (ok ? ": ok" : ": failed") << std::endl;
+
+    return ok;
+}
+
+#endif
+
+
+/*------------------------------------------------------------------------------
+ *  Cut Ogg Vorbis and Opus file outputs, with and without a codec thread,
+ *  and check that each file cut is a whole stream of its own
+ *----------------------------------------------------------------------------*/
+int
+main (  int         argc,
+        char      * argv[] )
+{
+    bool    ok      = true;
+    bool    checked = false;
+
+    Reporter::setReportVerbosity( 0);
+
+    try {
+#ifdef HAVE_VORBIS_LIB
+        ok = checkOutput( "vorbis", false, 44100, 0) && ok;
+        ok = checkOutput( "vorbis-pipelined", false, 22050, 2) && ok;
+        checked = true;
+#endif
+#ifdef HAVE_OPUS_LIB
+        ok = checkOutput( "opus", true, 48000, 0) && ok;
+        ok = checkOutput( "opus-pipelined", true, 48000, 2) && ok;
+        checked = true;
+#endif
+    } catch ( Exception   & e ) {
+        std::cerr << "ogg cut check failed: " << e << std::endl;
+        return 1;
+    }
+
+    if ( !checked ) {
+        std::cout << "no Ogg encoder built in, skipped" << std::endl;
+        // skipped, for automake
+        return 77;
+    }
+
+    return ok ? 0 : 1;
+}
+
@@ -58,6 +58,19 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The most page body to ask libogg for when the page duration is set,
+ *  which is as much as a page can hold, so that the duration decides
+ *  alone
+ *----------------------------------------------------------------------------*/
+static const int    maxPageFill = 255 * 255;
+
+/*------------------------------------------------------------------------------
+ *  The number of packets the pages are sent in, beyond which packets
+ *  are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxPooledPackets = 256;
+
 
 /* ===============================================  local function prototypes */
 
@@ -68,12 +81,21 @@ static const char fileid[] = "$Id$";
  *  Initialize the encoder
  *----------------------------------------------------------------------------*/
 void
-OpusLibEncoder :: init ( unsigned int     outMaxBitrate )
+OpusLibEncoder :: init ( unsigned int     outMaxBitrate,
+                         unsigned int     pipelineDepth,
+                         unsigned int     pageDuration )
                                                             
 {
     this->outMaxBitrate = outMaxBitrate;
-
-    if ( getInBitsPerSample() != 16 && getInBitsPerSample() != 8 ) {
+    this->pipelineDepth = pipelineDepth;
+    this->pageDuration  = pageDuration;
+    this->pageSamples   = (ogg_int64_t) pageDuration * 48000 / 1000;
+    this->pageGranule   = 0;
+    this->pageBufferLen = 0;
+
+    if ( !isInFloat()
+      && getInBitsPerSample() != 16 && getInBitsPerSample() != 8
+      && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
         throw Exception( __FILE__, __LINE__,
                          "specified bits per sample not supported",
                          getInBitsPerSample() );
@@ -91,56 +113,12 @@ OpusLibEncoder :: init ( unsigned int     outMaxBitrate )
                          getOutSampleRate() );
     }
 
-    if ( getOutSampleRate() == getInSampleRate() ) {
-        resampleRatio = 1;
-        converter     = 0;
-    } else {
-        resampleRatio = ( (double) getOutSampleRate() /
-                          (double) getInSampleRate() );
-
-        // Determine if we can use linear interpolation.
-        // The inverse of the ratio must be a power of two for linear mode to
-        // be of sufficient quality.
-
-        bool    useLinear = true;
-        double  inverse   = 1 / resampleRatio;
-        int     integer   = (int) inverse;
-
-        // Check that the inverse of the ratio is an integer
-        if( integer == inverse ) {
-            while( useLinear && integer ) { // Loop through the bits
-                // If the lowest order bit is not the only one set
-                if( integer & 1 && integer != 1 ) {
-                    // Not a power of two; cannot use linear
-                    useLinear = false;
-                } else {
-                    // Shift all the bits over and try again
-                    integer >>= 1;
-                }
-            }
-        } else {
-           useLinear = false;
-        }
-
-        // If we get here and useLinear is still true, then we have
-        // a power of two.
-
-        // open the aflibConverter in
-        // - high quality
-        // - linear or quadratic (non-linear) based on algorithm
-        // - not filter interpolation
-#ifdef HAVE_SRC_LIB
-        int srcError = 0;
-        converter = src_new(useLinear == true ? SRC_LINEAR : SRC_SINC_FASTEST,
-                            getInChannel(), &srcError);
-        if(srcError)
-            throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-#else
-        converter = new aflibConverter( true, useLinear, false);
-#endif
-    }
-
     encoderOpen = false;
+    codecLink   = 0;
+    muxLink     = 0;
+    spareLink   = 0;
+    restarting  = false;
+    pool        = new PacketPool( maxPooledPackets);
 }
 
 
@@ -151,8 +129,6 @@ bool
 OpusLibEncoder :: open ( void )
                                                             
 {
-    int     ret;
-
     if ( isOpen() ) {
         close();
     }
@@ -163,22 +139,60 @@ OpusLibEncoder :: open ( void )
                          "opus lib opening underlying sink error");
     }
 
-    int bufferSize = (getInBitsPerSample()/8) * getInChannel() * 480;
-    internalBuffer = new unsigned char[bufferSize];
+    // holds the samples of an incomplete 10ms frame between writes
+    internalBuffer = new float[480 * getOutChannel()];
     internalBufferLength = 0;
-    memset( internalBuffer, 0, bufferSize);
 
-    int err;
+    // room for the largest packet of 3 frames
+    packetBuffer.reserve( (1275*3+7) * getOutChannel());
+
+    // the first logical stream is started just as the ones after a cut
+    streamSerial  = 0;
+    pageBufferLen = 0;
+    codecNext();
+    muxNext();
+    pagesWrite( true);
+
+    // from now on the codec state belongs to the codec thread, if any
+    if ( pipelineDepth ) {
+        pipeline = new EncoderPipeline( this, pipelineDepth);
+        pipeline->start();
+    }
+
+    encoderOpen = true;
+    reconnectError = false;
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Make a logical stream
+ *----------------------------------------------------------------------------*/
+OpusLibEncoder :: Link *
+OpusLibEncoder :: linkCreate ( void )
+{
+    Link          * link = new Link;
+    OpusEncoder   * opusEncoder;
+    int             err;
+    int             ret;
+
+    // all cleared, so that it can be let go of when half made
+    memset( link, 0, sizeof(Link));
+
     opusEncoder = opus_encoder_create( getOutSampleRate(),
-                                       getInChannel(),
+                                       getOutChannel(),
                                        OPUS_APPLICATION_AUDIO,
                                        &err);
     if( err != OPUS_OK ) {
+        delete link;
         throw Exception( __FILE__, __LINE__,
                          "opus encoder creation error",
                          err);
     }
 
+    link->opusEncoder = opusEncoder;
+
     opus_encoder_ctl(opusEncoder, OPUS_SET_COMPLEXITY(10));
     opus_encoder_ctl(opusEncoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
 
@@ -215,7 +229,8 @@ OpusLibEncoder :: open ( void )
                 break;
     }
 
-    if ( (ret = ogg_stream_init( &oggStreamState, 0)) ) {
+    if ( (ret = ogg_stream_init( &link->oggStreamState, streamSerial++)) ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "ogg stream init error", ret);
     }
 
@@ -247,6 +262,7 @@ OpusLibEncoder :: open ( void )
     tags[0].tag_len = strlen(titlestr) + strlen(name);
     tags[0].tag_str = (char*) malloc( tags[0].tag_len + 1 );
     if( tags[0].tag_str == NULL ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "malloc failed");
     }
     strncpy( tags[0].tag_str, titlestr, tags[0].tag_len);
@@ -285,40 +301,64 @@ OpusLibEncoder :: open ( void )
     oggCommentHeader.granulepos = 0;
     oggCommentHeader.packetno = 1;
 
-    oggPacketNumber = 2;
-    oggGranulePosition = 0;
-
-    ogg_stream_packetin( &oggStreamState, &oggHeader);
-    ogg_stream_packetin( &oggStreamState, &oggCommentHeader);
-
-    ogg_page oggPage;
-    while ( ogg_stream_flush( &oggStreamState, &oggPage) ) {
-        getSink()->write( oggPage.header, oggPage.header_len);
-        getSink()->write( oggPage.body, oggPage.body_len);
-    }
+    ogg_stream_packetin( &link->oggStreamState, &oggHeader);
+    ogg_stream_packetin( &link->oggStreamState, &oggCommentHeader);
 
     free(tags[0].tag_str);
     free(headerData);
     free(commentData);
 
-    // initialize the resampling coverter if needed
-    if ( converter ) {
-#ifdef HAVE_SRC_LIB
-        converterData.input_frames   = 4096/((getInBitsPerSample() / 8) * getInChannel());
-        converterData.data_in        = new float[converterData.input_frames*getInChannel()];
-        converterData.output_frames  = (int) (converterData.input_frames * resampleRatio + 1);
-        converterData.data_out       = new float[getInChannel() * converterData.output_frames];
-        converterData.src_ratio      = resampleRatio;
-        converterData.end_of_input   = 0;
-#else
-        converter->initialize( resampleRatio, getInChannel());
-#endif
+    return link;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Let go of a logical stream
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: linkDelete (  Link      * link )
+{
+    if ( !link ) {
+        return;
     }
 
-    encoderOpen = true;
-    reconnectError = false;
+    ogg_stream_clear( &link->oggStreamState);
+    if ( link->opusEncoder ) {
+        opus_encoder_destroy( link->opusEncoder);
+    }
+    delete link;
+}
 
-    return true;
+
+/*------------------------------------------------------------------------------
+ *  Have the codec encode into the next logical stream
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: codecNext ( void )
+{
+    // the previous logical stream is let go by the muxer, see muxNext()
+    codecLink = spareLink ? spareLink : linkCreate();
+    spareLink = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Mux into the logical stream of the codec
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: muxNext ( void )
+{
+    ogg_page        oggPage;
+
+    linkDelete( muxLink);
+    muxLink            = codecLink;
+    oggPacketNumber    = 2;
+    oggGranulePosition = 0;
+    pageGranule        = 0;
+
+    while ( ogg_stream_flush( &muxLink->oggStreamState, &oggPage) ) {
+        pageCollect( &oggPage);
+    }
 }
 
 
@@ -333,136 +373,184 @@ OpusLibEncoder :: write ( const void    * buf,
         return 0;
     }
 
-    unsigned int    channels      = getInChannel();
-    unsigned int    bitsPerSample = getInBitsPerSample();
-    unsigned int    sampleSize = (bitsPerSample / 8) * channels;
+    return writeFrame( toFrame( buf, len));
+}
 
-    unsigned int i;
 
-    if ( getInChannel() == 2 && getOutChannel() == 1 ) {
-        for ( i = 0; i < len/sampleSize; i++) {
-            if ( bitsPerSample == 8 ) {
-                char          * buf8 = (char *) buf;
-                unsigned int    ix   = sampleSize * i;
-                unsigned int    iix  = ix;
-                buf8[i] = (buf8[ix] + buf8[++iix]) / 2;
-            }
-            if ( bitsPerSample == 16 ) {
-                short         * buf16 = (short *) buf;
-                unsigned int    ix    = (bitsPerSample >> 3) * i;
-                unsigned int    iix   = ix;
-                buf16[i] = (buf16[ix] + buf16[++iix]) / 2;
-            }
-        }
-        len      >>= 1;
-        channels   = 1;
-    }
-
-    sampleSize = (bitsPerSample / 8) * channels;
-    unsigned int    processed = 0;
-    unsigned int    bytesToProcess = len - (len % sampleSize);
-    unsigned int    totalProcessed = 0;
-    unsigned char * b = (unsigned char*) buf;
-    unsigned char * tempBuffer = NULL;
-
-    if( internalBufferLength > 0 ) {
-        tempBuffer = new unsigned char[len + internalBufferLength];
-        memset( tempBuffer, 0, len + internalBufferLength);
-        if( !tempBuffer ) {
-            throw Exception( __FILE__, __LINE__, "could not allocate temp buffer");
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+OpusLibEncoder :: writeFrame (  const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
+    }
+
+    // resample if needed, the frame may already hold the resampled audio
+    const AudioFrame  * in = resample( frame);
+
+    if ( pipeline.get() ) {
+        Ref<Packet>     samples = pipeline->newSamples( in->getFloat(),
+                                                        in->getSamples()
+                                                      * getInChannel()
+                                                      * sizeof(float));
+
+        // mux what the codec thread has encoded meanwhile
+        while ( !pipeline->push( samples.get()) ) {
+            pipelineOut( false);
         }
-        memcpy( tempBuffer, internalBuffer, internalBufferLength);
-        memcpy( tempBuffer+internalBufferLength, buf, len);
-        b = tempBuffer;
-        bytesToProcess += internalBufferLength;
+        pipelineOut( false);
+    } else {
+        encodeSamples( in->getFloat(), in->getSamples());
+    }
+    pagesWrite();
+
+    return frame->getSize();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Encode samples in 10ms frames
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: encodeSamples (   const float       * samples,
+                                    unsigned int        nSamples )
+{
+    unsigned int        inChannels  = getInChannel();
+    unsigned int        outChannels = getOutChannel();
+    bool                downmix     = inChannels == 2 && outChannels == 1;
+    unsigned int        i;
+
+    int             opusBufferSize = packetBuffer.getSize();
+    unsigned char * opusBuffer     = packetBuffer.get();
+
+    // make the next logical stream ready ahead of a cut, here on the
+    // codec thread if pipelined, so that the cut itself doesn't wait
+    // for the codec to be set up. only a stream to a file starts anew
+    if ( !spareLink && getSink()->isFile() ) {
+        spareLink = linkCreate();
     }
 
+    // collect the samples into 10ms frames, and encode each one of them
+    for ( i = 0; i < nSamples; ) {
+        unsigned int    n   = 480 - internalBufferLength;
+        float         * out = internalBuffer
+                            + internalBufferLength * outChannels;
 
-    while ( bytesToProcess / resampleRatio >= 480 * sampleSize ) {
-        unsigned int toProcess = bytesToProcess / (resampleRatio * sampleSize);
-        if( toProcess >= 480 / resampleRatio) {
-            processed = 480 / resampleRatio;
+        if ( n > nSamples - i ) {
+            n = nSamples - i;
         }
 
-        int opusBufferSize = (1275*3+7)*channels;
-        unsigned char*   opusBuffer = new unsigned char[opusBufferSize];
-
-        // convert the byte-based raw input into a short buffer
-        // with channels still interleaved
-        unsigned int    totalSamples = processed * channels;
-        short int     * shortBuffer  = new short int[totalSamples];
-
-        Util::conv( bitsPerSample, b, processed*sampleSize, shortBuffer, isInBigEndian());
-
-        if ( converter && processed > 0 ) {
-            // resample if needed
-            int         inCount  = processed;
-            int         outCount = 480; //(int) (inCount * resampleRatio);
-            short int * resampledBuffer = new short int[(outCount+1)* channels];
-            int         converted;
-#ifdef HAVE_SRC_LIB
-            (void)inCount;
-            converterData.input_frames   = processed;
-            src_short_to_float_array (shortBuffer, (float *) converterData.data_in, totalSamples);
-            int srcError = src_process (converter, &converterData);
-            if (srcError)
-                 throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-            converted = converterData.output_frames_gen;
-
-            src_float_to_short_array(converterData.data_out, resampledBuffer, converted*channels);
-
-#else
-            converted = converter->resample( inCount,
-                                             outCount,
-                                             shortBuffer,
-                                             resampledBuffer );
-#endif
-            if( converted != 480) {
-                throw Exception( __FILE__, __LINE__, "resampler error: expected 480 samples", converted);
+        if ( downmix ) {
+            for ( unsigned int j = 0; j < n; ++j ) {
+                out[j] = (samples[2*(i+j)] + samples[2*(i+j)+1]) / 2;
             }
-            int encBytes = opus_encode( opusEncoder, resampledBuffer, 480, opusBuffer, opusBufferSize);
-            if( encBytes == -1 ) {
-                throw Exception( __FILE__, __LINE__, "opus encoder error");
+        } else {
+            memcpy( out,
+                    samples + i * inChannels,
+                    n * inChannels * sizeof(float));
+        }
+        internalBufferLength += n;
+        i                    += n;
+
+        if ( internalBufferLength == 480 ) {
+            int encBytes = opus_encode_float( codecLink->opusEncoder,
+                                              internalBuffer,
+                                              480,
+                                              opusBuffer,
+                                              opusBufferSize);
+            if( encBytes < 0 ) {
+                throw Exception( __FILE__, __LINE__, "opus encoder error",
+                                 encBytes);
             }
-            oggGranulePosition += converted;
-            opusBlocksOut( encBytes, opusBuffer);
+            packetOut( encBytes, opusBuffer, false);
+            internalBufferLength = 0;
+        }
+    }
+}
 
-            delete[] resampledBuffer;
 
-        } else if( processed > 0) {
-            memset( opusBuffer, 0, opusBufferSize);
-            int encBytes = opus_encode( opusEncoder, shortBuffer, processed, opusBuffer, opusBufferSize);
-            if( encBytes == -1 ) {
-                throw Exception( __FILE__, __LINE__, "opus encoder error");
-            }
-            oggGranulePosition += processed;
-            opusBlocksOut( encBytes, opusBuffer);
+/*------------------------------------------------------------------------------
+ *  Encode an empty frame to end the stream
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: encodeEnd ( void )
+{
+    int opusBufferSize = packetBuffer.getSize();
+    unsigned char * opusBuffer = packetBuffer.get();
+    float * floatBuffer = new float[480*getOutChannel()];
 
-        }
-        delete[] shortBuffer;
-        delete[] opusBuffer;
-        bytesToProcess -= processed * sampleSize;
-        totalProcessed += processed * sampleSize;
-        b = ((unsigned char*)b) + (processed * sampleSize);
+    // Send an empty audio packet along to flush out the stream.
+    memset( floatBuffer, 0, 480*getOutChannel()*sizeof(*floatBuffer));
+    memset( opusBuffer, 0, opusBufferSize);
+    int encBytes = opus_encode_float( codecLink->opusEncoder, floatBuffer, 480,
+                                      opusBuffer, opusBufferSize);
+    delete[] floatBuffer;
+    if( encBytes == -1 ) {
+        throw Exception( __FILE__, __LINE__, "opus encoder error");
     }
 
-    int newLen = len - (len % sampleSize) + internalBufferLength - totalProcessed;
-    newLen -= newLen % sampleSize;
+    // Send the empty block to the Ogg layer, and mark the
+    // EOS flag.  This will trigger any remaining packets to be
+    // sent.
+    packetOut( encBytes, opusBuffer, true);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Pass on an encoded packet
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: packetOut (   int                 bytes,
+                                unsigned char     * data,
+                                bool                eos )
+{
+    if ( pipeline.get() ) {
+        // on the codec thread, the Ogg stream is muxed by the writer
+        Ref<Packet>     packet = pipeline->newPacket( data, bytes);
 
-    if( newLen > 0 ) {
-        memcpy( internalBuffer, b, newLen);
-        totalProcessed += newLen;
-        internalBufferLength = newLen;
+        pipeline->emit( packet.get(), 0, 0, eos);
     } else {
-        internalBufferLength = 0;
+        oggGranulePosition += 480;
+        opusBlocksOut( bytes, data, eos);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Send the packets encoded by the codec thread to the Ogg stream
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: pipelineOut ( bool    wait )
+{
+    EncoderPipeline::Block      block;
+
+    while ( pipeline->pop( block, wait) && block.packet.get() ) {
+        oggGranulePosition += 480;
+        opusBlocksOut( block.packet->getSize(),
+                       (unsigned char *) block.packet->getData(),
+                       block.endOfStream);
     }
+}
+
 
-    if( tempBuffer ) {
-        delete[] tempBuffer;
-        tempBuffer = NULL;
+/*------------------------------------------------------------------------------
+ *  Encode a block of samples on the codec thread
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: encodeBlock ( const Packet      * samples )
+{
+    if ( !samples ) {
+        encodeEnd();
+        if ( restarting ) {
+            codecNext();
+        }
+        return;
     }
 
-    return totalProcessed;
+    encodeSamples( (const float *) samples->getData(),
+                   samples->getSize() / (getInChannel() * sizeof(float)));
 }
 
 
@@ -477,26 +565,67 @@ OpusLibEncoder :: flush ( void )
         return;
     }
 
-    int opusBufferSize = (1275*3+7)*getOutChannel();
-    unsigned char * opusBuffer = new unsigned char[opusBufferSize];
-    short int * shortBuffer = new short int[480*getInChannel()];
+    if ( pipeline.get() ) {
+        // wait for the codec thread to encode all of the stream
+        while ( !pipeline->push( 0) ) {
+            pipelineOut( false);
+        }
+        pipelineOut( true);
+    } else {
+        encodeEnd();
+    }
+    pagesWrite();
+    getSink()->flush();
+}
+
 
-    // Send an empty audio packet along to flush out the stream.
-    memset( shortBuffer, 0, 480*getInChannel()*sizeof(*shortBuffer));
-    memset( opusBuffer, 0, opusBufferSize);
-    int encBytes = opus_encode( opusEncoder, shortBuffer, 480, opusBuffer, opusBufferSize);
-    if( encBytes == -1 ) {
-        throw Exception( __FILE__, __LINE__, "opus encoder error");
+/*------------------------------------------------------------------------------
+ *  Cut the stream at a time, and go on in a new logical stream
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: cutAt ( double          boundary )         throw ()
+{
+    if ( !isOpen() || reconnectError == true
+      || !getSink()->isFile() ) {
+        // the listeners keep their stream, sinks with a file to cut
+        // start the new one with the header of the stream
+        getSink()->cutAt( boundary);
+        return;
     }
-    oggGranulePosition += 480;
 
-    // Send the empty block to the Ogg layer, and mark the
-    // EOS flag.  This will trigger any remaining packets to be
-    // sent.
-    opusBlocksOut( encBytes, opusBuffer, true);
-    delete[] opusBuffer;
-    delete[] shortBuffer;
-    getSink()->flush();
+    try {
+        // end the logical stream, so that all of it goes before the cut
+        if ( pipeline.get() ) {
+            restarting = true;
+            while ( !pipeline->push( 0) ) {
+                pipelineOut( false);
+            }
+            pipelineOut( true);
+            restarting = false;
+        } else {
+            encodeEnd();
+            codecNext();
+        }
+        pagesWrite();
+    } catch ( Exception     & e ) {
+        restarting = false;
+        reportEvent( 2, "couldn't end opus stream for cut", e);
+    }
+
+    // the new file starts with the header of the next logical stream,
+    // not with the one of the stream ended
+    getSink()->setHeader( 0);
+    getSink()->cutAt( boundary);
+
+    // the next logical stream, ready by now, starts after the cut
+    if ( codecLink != muxLink ) {
+        muxNext();
+        try {
+            pagesWrite( true);
+        } catch ( Exception     & e ) {
+            reportEvent( 2, "couldn't start opus stream after cut", e);
+        }
+    }
 }
 
 
@@ -508,8 +637,9 @@ OpusLibEncoder :: opusBlocksOut ( int bytes,
                                   unsigned char* data,
                                   bool eos )               
 {
-    ogg_packet      oggPacket;
-    ogg_page        oggPage;
+    ogg_stream_state  * streamState = &muxLink->oggStreamState;
+    ogg_packet          oggPacket;
+    ogg_page            oggPage;
 
     oggPacket.packet = data;
     oggPacket.bytes = bytes;
@@ -519,24 +649,86 @@ OpusLibEncoder :: opusBlocksOut ( int bytes,
     oggPacket.packetno = oggPacketNumber;
     oggPacketNumber++;
 
-    if( ogg_stream_packetin( &oggStreamState, &oggPacket) == 0) {
-        while( ogg_stream_pageout( &oggStreamState, &oggPage) ||
-            ( eos && ogg_stream_flush( &oggStreamState, &oggPage) ) ) {
-            int    written;
+    if( ogg_stream_packetin( streamState, &oggPacket) != 0) {
+        throw Exception( __FILE__, __LINE__, "internal ogg error");
+    }
+
+    for (;;) {
+        int     ret;
 
-            written  = getSink()->write(oggPage.header, oggPage.header_len);
-            written += getSink()->write( oggPage.body, oggPage.body_len);
+        if ( eos ) {
+            ret = ogg_stream_flush( streamState, &oggPage);
+        } else if ( !pageSamples ) {
+            ret = ogg_stream_pageout( streamState, &oggPage);
+        } else if ( oggGranulePosition - pageGranule >= pageSamples ) {
+            // the page is long enough, end it with this packet
+            ret = ogg_stream_flush_fill( streamState, &oggPage, maxPageFill);
+        } else {
+            // only full pages until then
+            ret = ogg_stream_pageout_fill( streamState,
+                                           &oggPage,
+                                           maxPageFill);
+        }
+        if ( !ret ) {
+            break;
+        }
 
-            if ( written < oggPage.header_len + oggPage.body_len ) {
-                reconnectError = true;
-                // just let go data that could not be written
-                reportEvent( 2,
-                       "couldn't write full opus data to underlying sink",
-                       oggPage.header_len + oggPage.body_len - written);
-            }
+        if ( ogg_page_granulepos( &oggPage) != -1 ) {
+            pageGranule = ogg_page_granulepos( &oggPage);
         }
+        pageCollect( &oggPage);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Collect an Ogg page
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: pageCollect ( const ogg_page    * oggPage )
+{
+    unsigned int        len = oggPage->header_len + oggPage->body_len;
+    unsigned char     * buf;
+
+    buf = pageBuffer.grow( pageBufferLen + len, pageBufferLen);
+    memcpy( buf + pageBufferLen, oggPage->header, oggPage->header_len);
+    memcpy( buf + pageBufferLen + oggPage->header_len,
+            oggPage->body,
+            oggPage->body_len);
+    pageBufferLen += len;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Send the collected pages to the underlying sink
+ *----------------------------------------------------------------------------*/
+void
+OpusLibEncoder :: pagesWrite ( bool       header )
+{
+    Ref<Packet>     packet;
+    unsigned int    written;
+
+    if ( !pageBufferLen ) {
+        return;
+    }
+
+    // the pages in one, so that buffers drop whole pages
+    if ( header ) {
+        // kept for as long as the stream goes on, not to be re-used
+        packet    = new Packet( pageBuffer.get(), pageBufferLen);
+        getSink()->setHeader( packet.get());
     } else {
-        throw Exception( __FILE__, __LINE__, "internal ogg error");
+        packet    = pool->get( pageBuffer.get(), pageBufferLen);
+    }
+    written       = getSink()->writePacket( packet.get());
+    pageBufferLen = 0;
+
+    if ( written < packet->getSize() ) {
+        reconnectError = true;
+        // just let go data that could not be written
+        reportEvent( 2,
+                     "couldn't write full opus data to underlying sink",
+                     packet->getSize() - written);
     }
 }
 
@@ -550,9 +742,19 @@ OpusLibEncoder :: close ( void )
     if ( isOpen() ) {
         flush();
 
-        ogg_stream_clear( &oggStreamState);
-        opus_encoder_destroy( opusEncoder);
-        opusEncoder = NULL;
+        if ( pipeline.get() ) {
+            pipeline->stop();
+            pipeline = 0;
+        }
+
+        if ( codecLink != muxLink ) {
+            linkDelete( codecLink);
+        }
+        linkDelete( muxLink);
+        linkDelete( spareLink);
+        codecLink = 0;
+        muxLink   = 0;
+        spareLink = 0;
 
         encoderOpen = false;
         if (internalBuffer) {
@@ -0,0 +1,132 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Packet.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+
+#include "Exception.h"
+#include "Packet.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Packet :: init (    const void        * buf,
+                    unsigned int        len,
+                    const void        * buf2,
+                    unsigned int        len2 )
+{
+    if ( (!buf && len) || (!buf2 && len2) ) {
+        throw Exception( __FILE__, __LINE__, "buf is null");
+    }
+
+    referenceCount.store( 0);
+
+    this->size     = len + len2;
+    this->capacity = size ? size : 1;
+    this->data     = new unsigned char[capacity];
+    if ( len ) {
+        memcpy( this->data, buf, len);
+    }
+    if ( len2 ) {
+        memcpy( this->data + len, buf2, len2);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Packet :: strip ( void )
+{
+    delete[] data;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Put new data into the packet
+ *----------------------------------------------------------------------------*/
+void
+Packet :: fill (    const void        * buf,
+                    unsigned int        len,
+                    const void        * buf2,
+                    unsigned int        len2 )
+{
+    if ( (!buf && len) || (!buf2 && len2) ) {
+        throw Exception( __FILE__, __LINE__, "buf is null");
+    }
+
+    // only grows, to the next power of two, so that a packet re-used for
+    // data of about the same size stops allocating after a while, even
+    // if the size creeps up a few bytes at a time
+    if ( len + len2 > capacity ) {
+        delete[] data;
+        while ( capacity < len + len2 ) {
+            capacity *= 2;
+        }
+        data     = new unsigned char[capacity];
+    }
+
+    size = len + len2;
+    if ( len ) {
+        memcpy( data, buf, len);
+    }
+    if ( len2 ) {
+        memcpy( data + len, buf2, len2);
+    }
+}
+
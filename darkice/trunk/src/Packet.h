@@ -0,0 +1,303 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Packet.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef PACKET_H
+#define PACKET_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <atomic>
+
+#include "Exception.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A piece of encoded data, as produced by an encoder. The data is
+ *  copied into the packet once, when the packet is made, and is never
+ *  changed after that. Thus sinks can keep references to a packet
+ *  instead of copying its data, and a single packet can be held by any
+ *  number of sinks at the same time: the buffers of several servers,
+ *  a local dump file, an archive.
+ *
+ *  Encoders put whole frames or pages into a packet, so that sinks
+ *  dropping data drop whole packets, without breaking the framing of
+ *  the stream. An Ogg page, given as a header and a body, makes up
+ *  a single packet.
+ *
+ *  The reference count is atomic, as the holders of a packet may
+ *  live in different threads.
+ *
+ *  sample usage:
+ *
+ *  <pre>
+ *  #include "Packet.h"
+ *
+ *  Ref<Packet>     packet = new Packet( buf, len);
+ *
+ *  sink->writePacket( packet.get());
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class Packet
+{
+    friend class PacketPool;
+
+    private:
+
+        /**
+         *  Number of references to the packet.
+         */
+        std::atomic<unsigned int>   referenceCount;
+
+        /**
+         *  The data of the packet.
+         */
+        unsigned char     * data;
+
+        /**
+         *  The number of bytes in the packet.
+         */
+        unsigned int        size;
+
+        /**
+         *  The number of bytes data can hold.
+         */
+        unsigned int        capacity;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param buf the data to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @param buf2 more data to copy into the packet, after buf.
+         *  @param len2 the number of bytes in buf2.
+         *  @exception Exception
+         */
+        void
+        init (  const void        * buf,
+                unsigned int        len,
+                const void        * buf2,
+                unsigned int        len2 )              ;
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void )                                  ;
+
+        /**
+         *  Put new data into the packet, for a PacketPool re-using it
+         *  once nobody else holds it.
+         *
+         *  @param buf the data to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @param buf2 more data to copy into the packet, after buf.
+         *  @param len2 the number of bytes in buf2.
+         *  @exception Exception
+         */
+        void
+        fill (  const void        * buf,
+                unsigned int        len,
+                const void        * buf2,
+                unsigned int        len2 )              ;
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        Packet ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception, share the
+         *  packet by reference instead.
+         *
+         *  @param packet the object to copy.
+         *  @exception Exception
+         */
+        inline
+        Packet ( const Packet     & packet )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception, as
+         *  a packet is not changed once made.
+         *
+         *  @param packet the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline Packet &
+        operator= ( const Packet  & packet )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param buf the data to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @exception Exception
+         */
+        inline
+        Packet (    const void        * buf,
+                    unsigned int        len )
+        {
+            init( buf, len, 0, 0);
+        }
+
+        /**
+         *  Constructor by two pieces of data, such as the header and
+         *  the body of an Ogg page.
+         *
+         *  @param header the data to copy into the packet first.
+         *  @param headerLen the number of bytes in header.
+         *  @param body the data to copy into the packet after header.
+         *  @param bodyLen the number of bytes in body.
+         *  @exception Exception
+         */
+        inline
+        Packet (    const void        * header,
+                    unsigned int        headerLen,
+                    const void        * body,
+                    unsigned int        bodyLen )
+        {
+            init( header, headerLen, body, bodyLen);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline
+        ~Packet ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Increase the reference count of the packet.
+         *
+         *  @return the new reference count.
+         */
+        inline unsigned int
+        increaseReferenceCount ( void )                 throw ()
+        {
+            return ++referenceCount;
+        }
+
+        /**
+         *  Decrease the reference count of the packet.
+         *
+         *  @return the new reference count.
+         */
+        inline unsigned int
+        decreaseReferenceCount ( void )                 throw ()
+        {
+            return --referenceCount;
+        }
+
+        /**
+         *  Get the reference count of the packet.
+         *
+         *  @return the reference count.
+         */
+        inline unsigned int
+        getReferenceCount ( void ) const                throw ()
+        {
+            return referenceCount.load();
+        }
+
+        /**
+         *  Get the data of the packet.
+         *
+         *  @return the data of the packet.
+         */
+        inline const unsigned char *
+        getData ( void ) const                          throw ()
+        {
+            return data;
+        }
+
+        /**
+         *  Get the number of bytes in the packet.
+         *
+         *  @return the number of bytes in the packet.
+         */
+        inline unsigned int
+        getSize ( void ) const                          throw ()
+        {
+            return size;
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* PACKET_H */
+
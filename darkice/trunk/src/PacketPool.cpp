@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : PacketPool.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "Exception.h"
+#include "PacketPool.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+PacketPool :: init (    unsigned int        maxPackets )
+{
+    if ( !maxPackets ) {
+        throw Exception( __FILE__, __LINE__, "no packets");
+    }
+
+    this->maxPackets = maxPackets;
+    this->packets    = new Packet*[maxPackets];
+    this->numPackets = 0;
+    this->next       = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+PacketPool :: strip ( void )
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numPackets; ++u ) {
+        // the ones still held are deleted by their last holder
+        if ( packets[u]->decreaseReferenceCount() == 0 ) {
+            delete packets[u];
+        }
+    }
+    delete[] packets;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get a packet holding a copy of the data
+ *----------------------------------------------------------------------------*/
+Packet *
+PacketPool :: get (     const void        * buf,
+                        unsigned int        len,
+                        const void        * buf2,
+                        unsigned int        len2 )
+{
+    unsigned int    u;
+
+    for ( u = 0; u < numPackets; ++u ) {
+        Packet    * packet = packets[next];
+
+        next = (next + 1) % numPackets;
+        if ( packet->getReferenceCount() == 1 ) {
+            packet->fill( buf, len, buf2, len2);
+            return packet;
+        }
+    }
+
+    if ( numPackets == maxPackets ) {
+        // all held, make one outside the pool
+        return new Packet( buf, len, buf2, len2);
+    }
+
+    Packet    * packet = new Packet( buf, len, buf2, len2);
+
+    packet->increaseReferenceCount();
+    packets[numPackets++] = packet;
+
+    return packet;
+}
+
@@ -0,0 +1,213 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : PacketPool.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#include "Exception.h"
+#include "Packet.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A bounded set of packets, re-used once all the sinks holding them
+ *  let them go, so that making a packet for each write does not cost
+ *  an allocation.
+ *
+ *  The pool holds a reference to each of its packets: a packet is free
+ *  when its reference count drops back to 1. The pool grows one packet
+ *  at a time, up to a maximum number of packets; when all of those are
+ *  held, packets not belonging to the pool are made instead.
+ *
+ *  Packets may be let go by any thread, but get() is to be called by
+ *  a single thread, the one producing the data.
+ *
+ *  sample usage:
+ *
+ *  <pre>
+ *  #include "PacketPool.h"
+ *
+ *  PacketPool      pool( 64);
+ *  Ref<Packet>     packet = pool.get( buf, len);
+ *
+ *  sink->writePacket( packet.get());
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class PacketPool
+{
+    private:
+
+        /**
+         *  The packets of the pool.
+         */
+        Packet           ** packets;
+
+        /**
+         *  The number of packets made so far.
+         */
+        unsigned int        numPackets;
+
+        /**
+         *  The maximum number of packets.
+         */
+        unsigned int        maxPackets;
+
+        /**
+         *  The packet to look at first, the one given out the longest
+         *  time ago.
+         */
+        unsigned int        next;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param maxPackets the maximum number of packets.
+         *  @exception Exception
+         */
+        void
+        init (  unsigned int        maxPackets );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        PacketPool ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception.
+         *
+         *  @param pool the object to copy.
+         *  @exception Exception
+         */
+        inline
+        PacketPool ( const PacketPool     & pool )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param pool the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline PacketPool &
+        operator= ( const PacketPool  & pool )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param maxPackets the maximum number of packets in the pool.
+         *  @exception Exception
+         */
+        inline
+        PacketPool (    unsigned int        maxPackets )
+        {
+            init( maxPackets);
+        }
+
+        /**
+         *  Destructor. The packets still held by others are deleted
+         *  when let go.
+         *
+         *  @exception Exception
+         */
+        inline
+        ~PacketPool ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Get a packet holding a copy of the data given.
+         *  The packet is to be held by a Ref<Packet>.
+         *
+         *  @param buf the data to copy into the packet.
+         *  @param len the number of bytes in buf.
+         *  @param buf2 more data to copy into the packet, after buf.
+         *  @param len2 the number of bytes in buf2.
+         *  @return a packet holding the data.
+         *  @exception Exception
+         */
+        Packet *
+        get (   const void        * buf,
+                unsigned int        len,
+                const void        * buf2 = 0,
+                unsigned int        len2 = 0 );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* PACKET_POOL_H */
+
@@ -0,0 +1,642 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : PolyphaseBench.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+#include <iostream>
+#include <iomanip>
+
+#ifdef HAVE_SRC_LIB
+#include <samplerate.h>
+#endif
+
+#include "Exception.h"
+#include "TimeSummary.h"
+#include "aflibConverter.h"
+#include "PolyphaseConverter.h"
+
+
+/* ===================================================  local data structures */
+
+/*------------------------------------------------------------------------------
+ *  The input of a converter and room for its output, a frame at a time:
+ *  16 bit samples one channel after the other, as the converters of
+ *  DarkIce get them from AudioFrame, and interleaved floats for
+ *  libsamplerate
+ *----------------------------------------------------------------------------*/
+struct Buffers {
+    unsigned int        channels;
+    unsigned int        samples;
+    unsigned int        outSize;
+    short             * shortIn;
+    float             * floatIn;
+    short             * shortOut;
+    float             * floatOut;
+};
+
+/*------------------------------------------------------------------------------
+ *  A converter measured, driven the way Resampler drives it
+ *----------------------------------------------------------------------------*/
+class Converter
+{
+    public:
+
+        /**
+         *  Destructor.
+         */
+        inline virtual
+        ~Converter ( void )
+        {
+        }
+
+        /**
+         *  Convert the frame in the buffers.
+         *
+         *  @param b the buffers.
+         *  @return the number of output samples per channel.
+         */
+        virtual unsigned int
+        convert (   Buffers       * b )                 = 0;
+
+        /**
+         *  Get an output sample of the last conversion.
+         *
+         *  @param b the buffers.
+         *  @param count the number of output samples per channel.
+         *  @param i the index of the sample in the first channel.
+         *  @return the sample, in [-1.0, 1.0).
+         */
+        virtual float
+        output (    const Buffers * b,
+                    unsigned int    count,
+                    unsigned int    i ) const           = 0;
+};
+
+/*------------------------------------------------------------------------------
+ *  The converter of DarkIce without libsamplerate
+ *----------------------------------------------------------------------------*/
+class PolyphaseBench : public Converter
+{
+    private:
+
+        /**
+         *  The converter.
+         */
+        PolyphaseConverter      converter;
+
+        /**
+         *  The output sample rate divided by the input sample rate.
+         */
+        double                  ratio;
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param inRate the input sample rate.
+         *  @param outRate the output sample rate.
+         *  @param channels the number of channels.
+         */
+        inline
+        PolyphaseBench (    unsigned int    inRate,
+                            unsigned int    outRate,
+                            unsigned int    channels )
+                    : converter( inRate, outRate, channels)
+        {
+            ratio = (double) outRate / inRate;
+        }
+
+        virtual unsigned int
+        convert (   Buffers       * b )
+        {
+            int     count    = b->samples;
+            int     outCount = (int) (b->samples * ratio) + 2;
+
+            return converter.resample( count, outCount, b->shortIn,
+                                       b->shortOut);
+        }
+
+        virtual float
+        output (    const Buffers * b,
+                    unsigned int    count,
+                    unsigned int    i ) const
+        {
+            // the channels are outCount long each, not count
+            return b->shortOut[i] / 32768.f;
+        }
+};
+
+/*------------------------------------------------------------------------------
+ *  The converter it replaced, the large filter of aflibConverter. It is
+ *  driven as Resampler did, asking for the output that keeps it in step
+ *  with the input, which does not take all the input of each frame
+ *----------------------------------------------------------------------------*/
+class AflibBench : public Converter
+{
+    private:
+
+        /**
+         *  The converter.
+         */
+        aflibConverter          converter;
+
+        /**
+         *  The sample rates.
+         */
+        unsigned int            inRate;
+        unsigned int            outRate;
+
+        /**
+         *  The samples per channel converted so far, in and out.
+         */
+        unsigned long           inTotal;
+        unsigned long           outTotal;
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param inRate the input sample rate.
+         *  @param outRate the output sample rate.
+         *  @param channels the number of channels.
+         */
+        inline
+        AflibBench (    unsigned int    inRate,
+                        unsigned int    outRate,
+                        unsigned int    channels )
+                    : converter( true, false, false)
+        {
+            this->inRate   = inRate;
+            this->outRate  = outRate;
+            this->inTotal  = 0;
+            this->outTotal = 0;
+            converter.initialize( (double) outRate / inRate, channels);
+        }
+
+        virtual unsigned int
+        convert (   Buffers       * b )
+        {
+            int             count = b->samples;
+            unsigned int    outCount;
+
+            inTotal  += b->samples;
+            outCount  = (unsigned int) (inTotal * outRate / inRate - outTotal);
+            outTotal += outCount;
+
+            return converter.resample( count, outCount, b->shortIn,
+                                       b->shortOut);
+        }
+
+        virtual float
+        output (    const Buffers * b,
+                    unsigned int    count,
+                    unsigned int    i ) const
+        {
+            return b->shortOut[i] / 32768.f;
+        }
+};
+
+#ifdef HAVE_SRC_LIB
+/*------------------------------------------------------------------------------
+ *  The converter of DarkIce with libsamplerate
+ *----------------------------------------------------------------------------*/
+class SrcBench : public Converter
+{
+    private:
+
+        /**
+         *  The converter.
+         */
+        SRC_STATE             * converter;
+
+        /**
+         *  The parameters of the conversion.
+         */
+        SRC_DATA                data;
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param inRate the input sample rate.
+         *  @param outRate the output sample rate.
+         *  @param channels the number of channels.
+         *  @exception Exception
+         */
+        inline
+        SrcBench (  unsigned int    inRate,
+                    unsigned int    outRate,
+                    unsigned int    channels )
+        {
+            int     error = 0;
+
+            converter = src_new( SRC_SINC_FASTEST, channels, &error);
+            if ( error ) {
+                throw Exception( __FILE__, __LINE__, "libsamplerate error: ",
+                                 src_strerror( error));
+            }
+            data.src_ratio    = (double) outRate / inRate;
+            data.end_of_input = 0;
+        }
+
+        inline virtual
+        ~SrcBench ( void )
+        {
+            src_delete( converter);
+        }
+
+        virtual unsigned int
+        convert (   Buffers       * b )
+        {
+            data.data_in       = b->floatIn;
+            data.input_frames  = b->samples;
+            data.data_out      = b->floatOut;
+            data.output_frames = b->outSize;
+            src_process( converter, &data);
+
+            return data.output_frames_gen;
+        }
+
+        virtual float
+        output (    const Buffers * b,
+                    unsigned int    count,
+                    unsigned int    i ) const
+        {
+            return b->floatOut[i * b->channels];
+        }
+};
+#endif
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The samples per channel in each frame converted, as in a 4096 byte
+ *  chunk of 16 bit stereo
+ *----------------------------------------------------------------------------*/
+static const unsigned int   frameSamples = 1024;
+
+/*------------------------------------------------------------------------------
+ *  The seconds to spend on measuring the speed of each conversion
+ *----------------------------------------------------------------------------*/
+static const double         measureTime  = 0.5;
+
+/*------------------------------------------------------------------------------
+ *  The seconds of the tone converted to measure the distortion, and the
+ *  seconds at the start left out, while the filters fill up
+ *----------------------------------------------------------------------------*/
+static const double         toneTime     = 2.0;
+static const double         settleTime   = 0.1;
+
+/*------------------------------------------------------------------------------
+ *  The seconds of the output fitted with the tone at once
+ *----------------------------------------------------------------------------*/
+static const double         fitTime      = 0.1;
+
+/*------------------------------------------------------------------------------
+ *  The frequency and the amplitude of the tone
+ *----------------------------------------------------------------------------*/
+static const double         toneFreq     = 1000.0;
+static const double         toneLevel    = 0.5;
+
+/*------------------------------------------------------------------------------
+ *  The conversions compared, input and output sample rates
+ *----------------------------------------------------------------------------*/
+static const unsigned int   rates[][2]   = { { 44100, 48000 },
+                                             { 48000, 44100 },
+                                             { 44100, 32000 },
+                                             { 32000, 48000 } };
+
+/*------------------------------------------------------------------------------
+ *  The numbers of channels to compare at
+ *----------------------------------------------------------------------------*/
+static const unsigned int   channelCounts[] = { 1, 2 };
+
+/*------------------------------------------------------------------------------
+ *  The names of the converters compared
+ *----------------------------------------------------------------------------*/
+static const char         * names[]      = { "polyphase",
+                                             "aflib",
+#ifdef HAVE_SRC_LIB
+                                             "src fastest",
+#endif
+                                           };
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Create a converter by its index in names[]
+ *----------------------------------------------------------------------------*/
+static Converter *
+createConverter (   unsigned int    ix,
+                    unsigned int    inRate,
+                    unsigned int    outRate,
+                    unsigned int    channels )
+{
+    switch ( ix ) {
+        case 0:
+            return new PolyphaseBench( inRate, outRate, channels);
+        case 1:
+            return new AflibBench( inRate, outRate, channels);
+#ifdef HAVE_SRC_LIB
+        case 2:
+            return new SrcBench( inRate, outRate, channels);
+#endif
+        default:
+            throw Exception( __FILE__, __LINE__, "no such converter", ix);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Allocate the buffers of a frame
+ *----------------------------------------------------------------------------*/
+static void
+createBuffers ( Buffers         * b,
+                unsigned int      channels,
+                double            ratio )
+{
+    b->channels = channels;
+    b->samples  = frameSamples;
+    b->outSize  = (unsigned int) (frameSamples * ratio) + 64;
+    b->shortIn  = new short[frameSamples * channels];
+    b->floatIn  = new float[frameSamples * channels];
+    b->shortOut = new short[b->outSize * channels];
+    b->floatOut = new float[b->outSize * channels];
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fill a frame with the tone, in all the channels
+ *----------------------------------------------------------------------------*/
+static void
+fillBuffers (   Buffers       * b,
+                unsigned long   start,
+                unsigned int    rate )
+{
+    for ( unsigned int i = 0; i < b->samples; ++i ) {
+        double  v = toneLevel * sin( 2.0 * M_PI * toneFreq * (start + i)
+                                   / rate);
+        short   s = (short) lrint( v * 32767.0);
+
+        for ( unsigned int c = 0; c < b->channels; ++c ) {
+            b->shortIn[c * b->samples + i] = s;
+            b->floatIn[i * b->channels + c] = (float) v;
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Free the buffers of a frame
+ *----------------------------------------------------------------------------*/
+static void
+deleteBuffers ( Buffers   * b )
+{
+    delete[] b->floatOut;
+    delete[] b->shortOut;
+    delete[] b->floatIn;
+    delete[] b->shortIn;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Measure the speed of a converter, in nanoseconds per input sample
+ *----------------------------------------------------------------------------*/
+static double
+measureSpeed (  Converter     * converter,
+                Buffers       * b )
+{
+    unsigned long   rounds = 0;
+    double          start;
+    double          elapsed;
+
+    // once to warm up the caches
+    converter->convert( b);
+
+    start = TimeSummary::now();
+    do {
+        for ( unsigned int i = 0; i < 16; ++i ) {
+            converter->convert( b);
+        }
+        rounds  += 16;
+        elapsed  = TimeSummary::now() - start;
+    } while ( elapsed < measureTime );
+
+    return elapsed * 1e9 / rounds / (b->samples * b->channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fit a block of the output with a sine of the frequency of the tone,
+ *  by least squares, and add up the power of the fitted sine and of
+ *  what is left over
+ *----------------------------------------------------------------------------*/
+static void
+fitBlock (  const float   * out,
+            unsigned long   start,
+            unsigned long   len,
+            double          w,
+            double        * signal,
+            double        * noise )
+{
+    double          m[3][3] = { { 0.0 } };
+    double          r[3]    = { 0.0 };
+    double          det;
+    double          a;
+    double          c;
+    double          d;
+
+    // a * sin + c * cos + d, by the normal equations
+    for ( unsigned long i = start; i < start + len; ++i ) {
+        double  f[3] = { sin( w * i), cos( w * i), 1.0 };
+
+        for ( unsigned int j = 0; j < 3; ++j ) {
+            for ( unsigned int k = 0; k < 3; ++k ) {
+                m[j][k] += f[j] * f[k];
+            }
+            r[j] += f[j] * out[i];
+        }
+    }
+    det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+        - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+        + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    a   = (r[0]    * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+         - m[0][1] * (r[1]    * m[2][2] - m[1][2] * r[2])
+         + m[0][2] * (r[1]    * m[2][1] - m[1][1] * r[2])) / det;
+    c   = (m[0][0] * (r[1]    * m[2][2] - m[1][2] * r[2])
+         - r[0]    * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+         + m[0][2] * (m[1][0] * r[2]    - r[1]    * m[2][0])) / det;
+    d   = (m[0][0] * (m[1][1] * r[2]    - r[1]    * m[2][1])
+         - m[0][1] * (m[1][0] * r[2]    - r[1]    * m[2][0])
+         + r[0]    * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / det;
+
+    for ( unsigned long i = start; i < start + len; ++i ) {
+        double  fit = a * sin( w * i) + c * cos( w * i);
+        double  e   = out[i] - fit - d;
+
+        *signal += fit * fit;
+        *noise  += e * e;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Measure the total harmonic distortion and noise of a converter on the
+ *  tone, in dB. The output is fitted a block at a time, so that a ratio
+ *  a tiny bit off, as that of aflibConverter, is not taken for noise
+ *----------------------------------------------------------------------------*/
+static double
+measureDistortion ( Converter     * converter,
+                    Buffers       * b,
+                    unsigned int    inRate,
+                    unsigned int    outRate )
+{
+    unsigned long   maxOut = (unsigned long) (toneTime * outRate) + b->outSize;
+    unsigned long   skip   = (unsigned long) (settleTime * outRate);
+    unsigned long   block  = (unsigned long) (fitTime * outRate);
+    float         * out    = new float[maxOut];
+    unsigned long   numOut = 0;
+    double          w      = 2.0 * M_PI * toneFreq / outRate;
+    double          signal = 0.0;
+    double          noise  = 0.0;
+
+    for ( unsigned long in = 0; in < toneTime * inRate; in += b->samples ) {
+        unsigned int    count;
+
+        fillBuffers( b, in, inRate);
+        count = converter->convert( b);
+        for ( unsigned int i = 0; i < count && numOut < maxOut; ++i ) {
+            out[numOut++] = converter->output( b, count, i);
+        }
+    }
+
+    for ( unsigned long i = skip; i + block <= numOut; i += block ) {
+        fitBlock( out, i, block, w, &signal, &noise);
+    }
+    delete[] out;
+
+    return 10.0 * log10( noise / signal);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Compare the speed and the distortion of the converters, at some
+ *  common conversions
+ *----------------------------------------------------------------------------*/
+int
+main (  int         argc,
+        char      * argv[] )
+{
+    unsigned int    numNames  = sizeof(names) / sizeof(names[0]);
+    unsigned int    numRates  = sizeof(rates) / sizeof(rates[0]);
+    unsigned int    numCounts = sizeof(channelCounts)
+                              / sizeof(channelCounts[0]);
+
+    std::cout << std::fixed << std::setprecision( 0)
+              << "nanoseconds per input sample, and THD+N of a "
+              << toneFreq << " Hz tone at " << 20.0 * log10( toneLevel)
+              << " dBFS in brackets, frames of " << frameSamples
+              << " samples" << std::endl << std::endl;
+
+    std::cout << std::left << std::setw( 14) << "conversion"
+              << std::right << std::setw( 4) << "ch";
+    for ( unsigned int n = 0; n < numNames; ++n ) {
+        std::cout << std::setw( 22) << names[n];
+    }
+    std::cout << std::endl;
+
+    try {
+        for ( unsigned int r = 0; r < numRates; ++r ) {
+            unsigned int    inRate  = rates[r][0];
+            unsigned int    outRate = rates[r][1];
+
+            if ( !PolyphaseConverter::isSupported( inRate, outRate) ) {
+                continue;
+            }
+
+            for ( unsigned int k = 0; k < numCounts; ++k ) {
+                Buffers     b;
+
+                createBuffers( &b, channelCounts[k], (double) outRate / inRate);
+                std::cout << std::setw( 6) << inRate << " > "
+                          << std::left << std::setw( 5) << outRate
+                          << std::right << std::setw( 4) << channelCounts[k];
+
+                for ( unsigned int n = 0; n < numNames; ++n ) {
+                    Converter     * converter;
+                    double          ns;
+                    double          thdn;
+
+                    converter = createConverter( n, inRate, outRate,
+                                                 channelCounts[k]);
+                    thdn = measureDistortion( converter, &b, inRate, outRate);
+                    fillBuffers( &b, 0, inRate);
+                    ns   = measureSpeed( converter, &b);
+                    delete converter;
+
+                    std::cout << std::setw( 10) << std::setprecision( 2) << ns
+                              << " (" << std::setw( 7) << std::setprecision( 1)
+                              << thdn << " dB)";
+                }
+                std::cout << std::endl;
+
+                deleteBuffers( &b);
+            }
+        }
+    } catch ( Exception   & e ) {
+        std::cerr << "polyphase benchmark failed: " << e << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,343 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : PolyphaseConverter.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+
+#include "Exception.h"
+#include "SampleConv.h"
+#include "PolyphaseConverter.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The length of the filter in input samples, when not downsampling.
+ *  When downsampling, the filter is longer by the ratio of the rates.
+ *----------------------------------------------------------------------------*/
+static const unsigned int   baseTaps    = 64;
+
+/*------------------------------------------------------------------------------
+ *  The shape of the Kaiser window, for about 85 dB of stopband attenuation
+ *----------------------------------------------------------------------------*/
+static const double         kaiserBeta  = 8.6;
+
+/*------------------------------------------------------------------------------
+ *  The cutoff of the filter, relative to the lower of the Nyquist
+ *  frequencies, so that the transition band of baseTaps long filters
+ *  ends at the Nyquist frequency
+ *----------------------------------------------------------------------------*/
+static const double         cutoff      = 0.915;
+
+
+/* ===============================================  local function prototypes */
+
+/*------------------------------------------------------------------------------
+ *  The greatest common divisor of two numbers
+ *----------------------------------------------------------------------------*/
+static unsigned int
+gcd (   unsigned int    a,
+        unsigned int    b )                                 throw ();
+
+/*------------------------------------------------------------------------------
+ *  The zeroth order modified Bessel function of the first kind
+ *----------------------------------------------------------------------------*/
+static double
+besselI0 (  double      x )                                 throw ();
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  The greatest common divisor of two numbers
+ *----------------------------------------------------------------------------*/
+static unsigned int
+gcd (   unsigned int    a,
+        unsigned int    b )                                 throw ()
+{
+    while ( b ) {
+        unsigned int    r = a % b;
+
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The zeroth order modified Bessel function of the first kind
+ *----------------------------------------------------------------------------*/
+static double
+besselI0 (  double      x )                                 throw ()
+{
+    double          sum  = 1.0;
+    double          term = 1.0;
+    unsigned int    k;
+
+    for ( k = 1; k < 64 && term > sum * 1e-12; ++k ) {
+        double  t = x / (2.0 * k);
+
+        term *= t * t;
+        sum  += term;
+    }
+    return sum;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Tell if a ratio of sample rates can be converted
+ *----------------------------------------------------------------------------*/
+bool
+PolyphaseConverter :: isSupported ( unsigned int    inSampleRate,
+                                    unsigned int    outSampleRate ) throw ()
+{
+    if ( !inSampleRate || !outSampleRate ) {
+        return false;
+    }
+    return outSampleRate / gcd( inSampleRate, outSampleRate) <= maxPhases;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+PolyphaseConverter :: init (    unsigned int        inSampleRate,
+                                unsigned int        outSampleRate,
+                                unsigned int        channels )
+{
+    unsigned int    divisor;
+    double          stretch;
+
+    if ( !isSupported( inSampleRate, outSampleRate) ) {
+        throw Exception( __FILE__, __LINE__,
+                         "unsupported ratio of sample rates", outSampleRate);
+    }
+    if ( !channels ) {
+        throw Exception( __FILE__, __LINE__, "no channels to convert");
+    }
+
+    divisor          = gcd( inSampleRate, outSampleRate);
+    this->channels   = channels;
+    this->upFactor   = outSampleRate / divisor;
+    this->downFactor = inSampleRate / divisor;
+
+    // a longer filter for downsampling, for the same steepness at the
+    // lower cutoff, in whole SIMD vectors
+    stretch = downFactor > upFactor ? (double) downFactor / upFactor : 1.0;
+    taps    = (unsigned int) ceil( baseTaps * stretch / 8.0) * 8;
+
+    coeffs      = new float[upFactor * taps];
+    history     = 0;
+    historySize = 0;
+    historyLen  = 0;
+    phase       = 0;
+    position    = 0;
+
+    createFilter();
+
+    // start with silence, so that the first output is centered on the
+    // first input, with the filter half filled
+    reserveHistory( taps / 2 - 1);
+    historyLen = taps / 2 - 1;
+    memset( history, 0, channels * historySize * sizeof(float));
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+PolyphaseConverter :: strip ( void )
+{
+    delete[] coeffs;
+    delete[] history;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Compute the coefficients of the filter
+ *----------------------------------------------------------------------------*/
+void
+PolyphaseConverter :: createFilter ( void )
+{
+    double          fc    = 0.5 * cutoff * (upFactor < downFactor
+                                            ? (double) upFactor / downFactor
+                                            : 1.0);
+    double          half  = taps / 2;
+    double          norm  = besselI0( kaiserBeta);
+    unsigned int    p;
+    unsigned int    k;
+
+    for ( p = 0; p < upFactor; ++p ) {
+        float     * c   = coeffs + p * taps;
+        double      sum = 0.0;
+
+        // c[k] weighs the input k - half + 1 samples from the one
+        // preceding the output, which is p / upFactor samples before it
+        for ( k = 0; k < taps; ++k ) {
+            double  t = (double) p / upFactor + half - 1.0 - k;
+            double  x = t / half;
+            double  v;
+
+            if ( x <= -1.0 || x >= 1.0 ) {
+                v = 0.0;
+            } else {
+                v = t == 0.0 ? 2.0 * fc
+                             : sin( 2.0 * M_PI * fc * t) / (M_PI * t);
+                v *= besselI0( kaiserBeta * sqrt( 1.0 - x * x)) / norm;
+            }
+            c[k] = (float) v;
+            sum += v;
+        }
+
+        // unity gain for each phase, so that DC passes unchanged
+        for ( k = 0; k < taps; ++k ) {
+            c[k] = (float) (c[k] / sum);
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Make room in the history for more input
+ *----------------------------------------------------------------------------*/
+void
+PolyphaseConverter :: reserveHistory ( unsigned int     count )
+{
+    unsigned int    size = historyLen + count;
+    float         * buf;
+    unsigned int    c;
+
+    if ( size <= historySize ) {
+        return;
+    }
+
+    buf = new float[channels * size];
+    for ( c = 0; c < channels && historyLen; ++c ) {
+        memcpy( buf + c * size,
+                history + c * historySize,
+                historyLen * sizeof(float));
+    }
+    delete[] history;
+    history     = buf;
+    historySize = size;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert samples
+ *----------------------------------------------------------------------------*/
+int
+PolyphaseConverter :: resample (    int               & inCount,
+                                    int                 outCount,
+                                    short               inArray[],
+                                    short               outArray[] )
+{
+    float         * out;
+    unsigned int    produced = 0;
+    unsigned int    c;
+
+    if ( inCount < 0 || outCount < 0 ) {
+        throw Exception( __FILE__, __LINE__, "negative sample count");
+    }
+
+    reserveHistory( inCount);
+    for ( c = 0; c < channels; ++c ) {
+        SampleConv::shortToFloat( inArray + c * inCount,
+                                  inCount,
+                                  history + c * historySize + historyLen);
+    }
+    historyLen += inCount;
+
+    out = outBuffer.reserve( outCount ? outCount : 1);
+    for ( c = 0; c < channels; ++c ) {
+        const float   * hist = history + c * historySize;
+        unsigned int    ph   = phase;
+        unsigned int    pos  = position;
+        unsigned int    n;
+
+        // as many outputs as the input allows, up to outCount
+        for ( n = 0; n < (unsigned int) outCount
+                  && pos + taps <= historyLen; ++n ) {
+            out[n] = SampleConv::dotProduct( hist + pos,
+                                             coeffs + ph * taps,
+                                             taps);
+            ph  += downFactor;
+            pos += ph / upFactor;
+            ph  %= upFactor;
+        }
+        SampleConv::floatToShort( out, n, outArray + c * outCount);
+
+        // all the channels are in the same state
+        if ( c == channels - 1 ) {
+            produced = n;
+            phase    = ph;
+            position = pos;
+        }
+    }
+
+    // let go of the input no output needs any more
+    for ( c = 0; c < channels; ++c ) {
+        float     * hist = history + c * historySize;
+
+        memmove( hist, hist + position,
+                 (historyLen - position) * sizeof(float));
+    }
+    historyLen -= position;
+    position    = 0;
+
+    return produced;
+}
+
@@ -0,0 +1,285 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : PolyphaseConverter.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef POLYPHASE_CONVERTER_H
+#define POLYPHASE_CONVERTER_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "Referable.h"
+#include "Exception.h"
+#include "ScratchBuffer.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A sample rate converter for rational ratios, like 44.1 kHz to 48 kHz
+ *  or 48 kHz to 22.05 kHz, with a polyphase FIR filter.
+ *
+ *  The ratio outSampleRate / inSampleRate is reduced to upFactor /
+ *  downFactor. The filter, a Kaiser windowed sinc, is computed once for
+ *  each of the upFactor phases, thus each output sample is a single
+ *  inner product of the input with the coefficients of its phase, done
+ *  by the SIMD kernels of SampleConv. Only ratios with a limited number
+ *  of phases are supported, see isSupported().
+ *
+ *  The interface is that of aflibConverter, so that it can take its
+ *  place: the input and the output are 16 bit samples, one channel
+ *  after the other. All the input is always taken, and kept for as long
+ *  as the filter needs it, thus the converter should be fed a continuous
+ *  stream of audio.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class PolyphaseConverter : public virtual Referable
+{
+    private:
+
+        /**
+         *  The most phases of a filter, that is, the largest upFactor.
+         */
+        static const unsigned int   maxPhases = 512;
+
+        /**
+         *  Number of channels converted.
+         */
+        unsigned int        channels;
+
+        /**
+         *  The number of phases, the output sample rate divided by the
+         *  greatest common divisor of the sample rates.
+         */
+        unsigned int        upFactor;
+
+        /**
+         *  The input sample rate divided by the greatest common divisor
+         *  of the sample rates.
+         */
+        unsigned int        downFactor;
+
+        /**
+         *  The number of coefficients in each phase of the filter.
+         */
+        unsigned int        taps;
+
+        /**
+         *  The coefficients of the filter, taps for each phase.
+         */
+        float             * coeffs;
+
+        /**
+         *  The input not yet used up, for each channel, historySize
+         *  long each.
+         */
+        float             * history;
+
+        /**
+         *  The number of samples the history of each channel can hold.
+         */
+        unsigned int        historySize;
+
+        /**
+         *  The number of samples in the history of each channel.
+         */
+        unsigned int        historyLen;
+
+        /**
+         *  The phase of the next output sample.
+         */
+        unsigned int        phase;
+
+        /**
+         *  Where the input of the next output sample starts in the
+         *  history.
+         */
+        unsigned int        position;
+
+        /**
+         *  The output of a channel, before the conversion to 16 bits.
+         */
+        ScratchBuffer<float>    outBuffer;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param inSampleRate sample rate of the input.
+         *  @param outSampleRate sample rate of the output.
+         *  @param channels number of channels to convert.
+         *  @exception Exception if the ratio is not supported.
+         */
+        void
+        init (  unsigned int        inSampleRate,
+                unsigned int        outSampleRate,
+                unsigned int        channels )          ;
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void )                                  ;
+
+        /**
+         *  Compute the coefficients of the filter.
+         */
+        void
+        createFilter ( void )                           ;
+
+        /**
+         *  Make room in the history for more input.
+         *
+         *  @param count the number of samples to add to each channel.
+         */
+        void
+        reserveHistory ( unsigned int   count )         ;
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        PolyphaseConverter ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception, as the state of
+         *  the converter is not to be copied.
+         *
+         *  @param converter the object to copy.
+         *  @exception Exception
+         */
+        inline
+        PolyphaseConverter ( const PolyphaseConverter     & converter )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param inSampleRate sample rate of the input.
+         *  @param outSampleRate sample rate of the output.
+         *  @param channels number of channels to convert.
+         *  @exception Exception if the ratio is not supported.
+         */
+        inline
+        PolyphaseConverter (    unsigned int        inSampleRate,
+                                unsigned int        outSampleRate,
+                                unsigned int        channels )
+        {
+            init( inSampleRate, outSampleRate, channels);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~PolyphaseConverter ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Tell if a ratio of sample rates can be converted, that is,
+         *  if its filter does not have too many phases.
+         *
+         *  @param inSampleRate sample rate of the input.
+         *  @param outSampleRate sample rate of the output.
+         *  @return true if the ratio is supported.
+         */
+        static bool
+        isSupported (   unsigned int        inSampleRate,
+                        unsigned int        outSampleRate )     throw ();
+
+        /**
+         *  Convert samples.
+         *
+         *  @param inCount the number of input samples per channel, all
+         *                 of which are always taken.
+         *  @param outCount the most output samples per channel to
+         *                  compute.
+         *  @param inArray the input, one channel after the other,
+         *                 inCount long each.
+         *  @param outArray put the output here, one channel after the
+         *                  other, outCount long each.
+         *  @return the number of output samples per channel computed.
+         */
+        int
+        resample (  int               & inCount,
+                    int                 outCount,
+                    short               inArray[],
+                    short               outArray[] )    ;
+
+        /**
+         *  Get the number of coefficients in each phase of the filter.
+         *
+         *  @return the length of the filter, in input samples.
+         */
+        inline unsigned int
+        getTaps ( void ) const                          throw ()
+        {
+            return taps;
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* POLYPHASE_CONVERTER_H */
+
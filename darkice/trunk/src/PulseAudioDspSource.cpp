@@ -93,7 +93,11 @@ PulseAudioDspSource :: init (  const char      * paSourceName )
     running = 0;
     
     //Supported for some bits per sample, both Big and Little endian
-    if (isBigEndian())
+    if (isFloat())
+    {
+       ss.format = PA_SAMPLE_FLOAT32NE;
+    }
+    else if (isBigEndian())
     {
        switch (getBitsPerSample())
        {
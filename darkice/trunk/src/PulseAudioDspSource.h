@@ -131,15 +131,20 @@ class PulseAudioDspSource : public AudioSource, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channel number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param floatSamples true to read 32 bit float samples.
          *  @exception Exception
          */
         inline
         PulseAudioDspSource (  const char    * paSourceName,
                          int             sampleRate    = 44100,
                          int             bitsPerSample = 16,
-                         int             channel       = 2 )
+                         int             channel       = 2,
+                         bool            floatSamples  = false )
                                                         
-                    : AudioSource( sampleRate, bitsPerSample, channel)
+                    : AudioSource( sampleRate,
+                                   bitsPerSample,
+                                   channel,
+                                   floatSamples )
         {
             init( paSourceName);
         }
@@ -378,15 +383,20 @@ class PulseAudioDspSource : public AudioSource, public virtual Reporter
          *  @param bitsPerSample bits per sample (e.g. 16 bits).
          *  @param channel number of channels of the audio source
          *                 (e.g. 1 for mono, 2 for stereo, etc.).
+         *  @param floatSamples true to read 32 bit float samples.
          *  @exception Exception
          */
         inline
         PulseAudioDspSource (  const char    * paSourceName,
                          int             sampleRate    = 44100,
                          int             bitsPerSample = 16,
-                         int             channel       = 2 )
+                         int             channel       = 2,
+                         bool            floatSamples  = false )
                                                         
-                    : AudioSource( sampleRate, bitsPerSample, channel)
+                    : AudioSource( sampleRate,
+                                   bitsPerSample,
+                                   channel,
+                                   floatSamples )
         {
             init( paSourceName);
         }
@@ -0,0 +1,286 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Reconnector.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#else
+#error need errno.h
+#endif
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#error need sys/time.h
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#else
+#error need signal.h
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#else
+#error need sched.h
+#endif
+
+
+#include "Exception.h"
+#include "Reconnector.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Reconnector :: init (   Sink          * sink,
+                        unsigned int    maxAttempts )
+{
+    if ( !sink ) {
+        throw Exception( __FILE__, __LINE__, "no sink");
+    }
+
+    this->sink        = sink;
+    this->maxAttempts = maxAttempts;
+    this->attempts    = 0;
+    this->thread      = 0;
+    this->started     = false;
+    this->opened      = false;
+    this->cancelled   = false;
+    this->finished.store( false);
+
+    pthread_mutex_init( &mutex, 0);
+    pthread_cond_init( &cond, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Reconnector :: strip ( void )
+{
+    cancel();
+
+    pthread_cond_destroy( &cond);
+    pthread_mutex_destroy( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Start reopening the sink
+ *----------------------------------------------------------------------------*/
+void
+Reconnector :: start ( void )
+{
+    pthread_attr_t      attr;
+    struct sched_param  param;
+
+    if ( started ) {
+        return;
+    }
+
+    attempts  = 0;
+    opened    = false;
+    cancelled = false;
+    finished.store( false);
+
+    // waiting for the network is no job for a real-time thread
+    pthread_attr_init( &attr);
+    pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam( &attr, &param);
+
+    if ( pthread_create( &thread, &attr, threadFunction, this) ) {
+        pthread_attr_destroy( &attr);
+        throw Exception( __FILE__, __LINE__, "can't create reconnect thread");
+    }
+    pthread_attr_destroy( &attr);
+
+    started = true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Collect the result of reopening
+ *----------------------------------------------------------------------------*/
+bool
+Reconnector :: finish ( void )
+{
+    if ( !started ) {
+        return true;
+    }
+
+    pthread_join( thread, 0);
+    started = false;
+
+    return opened;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Give up reopening
+ *----------------------------------------------------------------------------*/
+void
+Reconnector :: cancel ( void )
+{
+    if ( !started ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex);
+    cancelled = true;
+    pthread_cond_signal( &cond);
+    pthread_mutex_unlock( &mutex);
+
+    pthread_join( thread, 0);
+    started = false;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wait for some time, or until cancelled
+ *----------------------------------------------------------------------------*/
+bool
+Reconnector :: wait ( double    seconds )
+{
+    struct timeval      now;
+    struct timespec     timeout;
+    long                usec;
+    bool                ret;
+
+    gettimeofday( &now, 0);
+    usec            = now.tv_usec + (long) ((seconds - (long) seconds) * 1e6);
+    timeout.tv_sec  = now.tv_sec + (long) seconds + usec / 1000000;
+    timeout.tv_nsec = (usec % 1000000) * 1000;
+
+    pthread_mutex_lock( &mutex);
+    while ( !cancelled ) {
+        if ( pthread_cond_timedwait( &cond, &mutex, &timeout) == ETIMEDOUT ) {
+            break;
+        }
+    }
+    ret = cancelled;
+    pthread_mutex_unlock( &mutex);
+
+    return ret;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Try to open the sink
+ *----------------------------------------------------------------------------*/
+void
+Reconnector :: reopen ( void )
+{
+    // a sink handed over after failing may still think it is open
+    if ( sink->isOpen() ) {
+        try {
+            sink->close();
+        } catch ( Exception   & e ) {
+            reportEvent( 4, "Reconnector :: reopen,", e.getDescription());
+        }
+    }
+
+    while ( !maxAttempts || attempts < maxAttempts ) {
+        ++attempts;
+
+        try {
+            sink->open();
+        } catch ( Exception   & e ) {
+            reportEvent( 4, "Reconnector :: reopen,", e.getDescription());
+        }
+
+        if ( sink->isOpen() ) {
+            opened = true;
+            backoff.reset();
+            reportEvent( 3, "reconnected after attempts:", attempts);
+            break;
+        }
+
+        if ( maxAttempts ) {
+            reportEvent( 3, "couldn't reconnect, attempt", attempts,
+                         "/", maxAttempts);
+        } else {
+            reportEvent( 3, "couldn't reconnect, attempt", attempts);
+        }
+
+        if ( (!maxAttempts || attempts < maxAttempts)
+          && wait( backoff.next()) ) {
+            break;
+        }
+    }
+
+    finished.store( true);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The thread function
+ *----------------------------------------------------------------------------*/
+void *
+Reconnector :: threadFunction ( void      * param )
+{
+    Reconnector   * reconnector = (Reconnector *) param;
+    sigset_t        sigset;
+
+    // SIGUSR1 is for the main thread, to cut the recordings
+    sigemptyset( &sigset);
+    sigaddset( &sigset, SIGUSR1);
+    pthread_sigmask( SIG_BLOCK, &sigset, 0);
+
+    reconnector->reopen();
+
+    return 0;
+}
+
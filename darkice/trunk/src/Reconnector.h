@@ -0,0 +1,299 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Reconnector.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef RECONNECTOR_H
+#define RECONNECTOR_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+#include <atomic>
+
+#include "Referable.h"
+#include "Reporter.h"
+#include "Exception.h"
+#include "Sink.h"
+#include "Backoff.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  Reopens a Sink in the background, retrying with exponential backoff,
+ *  so that the thread writing to the sink can go on meanwhile.
+ *
+ *  The states are: idle, opening (a thread of its own is trying to open
+ *  the sink, and waiting between the attempts), and finished (the sink
+ *  is open, or all attempts failed). While opening, the sink belongs to
+ *  the reconnector, and must not be touched by anyone else. A sink that
+ *  is still open when handed over is closed first, in the background
+ *  as well.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class Reconnector : public virtual Referable, public virtual Reporter
+{
+    private:
+
+        /**
+         *  The sink to reopen.
+         */
+        Sink                  * sink;
+
+        /**
+         *  The number of attempts to make before giving up, 0 for
+         *  no limit.
+         */
+        unsigned int            maxAttempts;
+
+        /**
+         *  The number of attempts made so far.
+         */
+        unsigned int            attempts;
+
+        /**
+         *  The delays between the attempts.
+         */
+        Backoff                 backoff;
+
+        /**
+         *  The thread trying to open the sink.
+         */
+        pthread_t               thread;
+
+        /**
+         *  Tells if the thread is running, and has not been joined yet.
+         */
+        bool                    started;
+
+        /**
+         *  Tells if the thread has finished.
+         */
+        std::atomic<bool>       finished;
+
+        /**
+         *  Tells if the thread managed to open the sink.
+         */
+        bool                    opened;
+
+        /**
+         *  Tells if the thread is to give up.
+         */
+        bool                    cancelled;
+
+        /**
+         *  The mutex protecting cancelled.
+         */
+        pthread_mutex_t         mutex;
+
+        /**
+         *  Signalled when cancelled.
+         */
+        pthread_cond_t          cond;
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param sink the sink to reopen.
+         *  @param maxAttempts the number of attempts before giving up,
+         *                     0 for no limit.
+         *  @exception Exception
+         */
+        void
+        init (  Sink          * sink,
+                unsigned int    maxAttempts );
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void );
+
+        /**
+         *  Try to open the sink until it succeeds, all attempts fail,
+         *  or cancelled.
+         */
+        void
+        reopen ( void );
+
+        /**
+         *  Wait for some time, or until cancelled.
+         *
+         *  @param seconds the time to wait.
+         *  @return true if cancelled, false otherwise.
+         */
+        bool
+        wait ( double   seconds );
+
+        /**
+         *  The thread function.
+         *
+         *  @param param the Reconnector to run.
+         *  @return nothing.
+         */
+        static void *
+        threadFunction ( void     * param );
+
+
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        Reconnector ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception.
+         *
+         *  @param reconnector the object to copy.
+         *  @exception Exception
+         */
+        inline
+        Reconnector ( const Reconnector   & reconnector )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param reconnector the object to assign to this one.
+         *  @return a reference to this object.
+         *  @exception Exception
+         */
+        inline Reconnector &
+        operator= ( const Reconnector & reconnector )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param sink the sink to reopen, when asked to.
+         *  @param maxAttempts the number of attempts to make before
+         *                     giving up, 0 to try until cancelled.
+         *  @exception Exception
+         */
+        inline
+        Reconnector (   Sink          * sink,
+                        unsigned int    maxAttempts )
+        {
+            init( sink, maxAttempts);
+        }
+
+        /**
+         *  Destructor. Cancels reopening, if in progress.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~Reconnector ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Start reopening the sink in the background, unless already
+         *  doing so.
+         *
+         *  @exception Exception
+         */
+        void
+        start ( void );
+
+        /**
+         *  Tell if the sink is being reopened. While so, the sink must
+         *  not be used.
+         *
+         *  @return true if the sink is being reopened, false otherwise.
+         */
+        inline bool
+        isBusy ( void ) const                       throw ()
+        {
+            return started && !finished.load();
+        }
+
+        /**
+         *  Collect the result of reopening, once not busy any more.
+         *
+         *  @return true if the sink was reopened, or there was no
+         *          attempt to reopen it, false if all attempts failed.
+         */
+        bool
+        finish ( void );
+
+        /**
+         *  Give up reopening, waiting for the current attempt to end.
+         */
+        void
+        cancel ( void );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* RECONNECTOR_H */
+
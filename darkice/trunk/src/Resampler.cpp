@@ -0,0 +1,225 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Resampler.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+
+#include "Exception.h"
+#include "Resampler.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Resampler :: init ( unsigned int        inSampleRate,
+                    unsigned int        outSampleRate,
+                    unsigned int        channel )
+{
+    if ( inSampleRate == 0 || outSampleRate == 0 ) {
+        throw Exception( __FILE__, __LINE__, "invalid sample rate");
+    }
+    if ( channel == 0 ) {
+        throw Exception( __FILE__, __LINE__, "no channels to resample");
+    }
+
+    this->inSampleRate  = inSampleRate;
+    this->outSampleRate = outSampleRate;
+    this->channel       = channel;
+    this->ratio         = (double) outSampleRate / (double) inSampleRate;
+    this->outBufferSize = 0;
+    this->outBuffer     = 0;
+
+    // Determine if we can use linear interpolation.
+    // The inverse of the ratio must be a power of two for linear mode to
+    // be of sufficient quality.
+
+    double  inverse = 1 / ratio;
+    int     integer = (int) inverse;
+
+    linear = true;
+
+    // Check that the inverse of the ratio is an integer
+    if( integer == inverse ) {
+        while( linear && integer ) { // Loop through the bits
+            // If the lowest order bit is not the only one set
+            if( integer & 1 && integer != 1 ) {
+                // Not a power of two; cannot use linear
+                linear = false;
+            } else {
+                // Shift all the bits over and try again
+                integer >>= 1;
+            }
+        }
+    } else {
+       linear = false;
+    }
+
+    // If we get here and linear is still true, then we have
+    // a power of two.
+
+    // open the aflibConverter in
+    // - high quality
+    // - linear or quadratic (non-linear) based on algorithm
+    // - not filter interpolation
+#ifdef HAVE_SRC_LIB
+    int srcError = 0;
+    converter = src_new( linear ? SRC_LINEAR : SRC_SINC_FASTEST,
+                         channel, &srcError);
+    if ( srcError ) {
+        throw Exception( __FILE__, __LINE__, "libsamplerate error: ",
+                         src_strerror( srcError));
+    }
+
+    converterData.src_ratio    = ratio;
+    converterData.end_of_input = 0;
+#else
+    if ( !linear && PolyphaseConverter::isSupported( inSampleRate,
+                                                     outSampleRate) ) {
+        converter = 0;
+        polyphase = new PolyphaseConverter( inSampleRate,
+                                            outSampleRate,
+                                            channel);
+    } else {
+        polyphase = 0;
+        converter = new aflibConverter( true, linear, false);
+        converter->initialize( ratio, channel);
+    }
+    inTotal   = 0;
+    outTotal  = 0;
+#endif
+}
+
+
+/*------------------------------------------------------------------------------
+ *  De-initialize the object
+ *----------------------------------------------------------------------------*/
+void
+Resampler :: strip ( void )
+{
+#ifdef HAVE_SRC_LIB
+    src_delete( converter);
+#else
+    delete converter;
+    delete polyphase;
+#endif
+    delete[] outBuffer;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Resample a frame
+ *----------------------------------------------------------------------------*/
+void
+Resampler :: resample ( const AudioFrame  * in,
+                        AudioFrame        * out )
+{
+    if ( in->getChannel() != channel || out->getChannel() != channel ) {
+        throw Exception( __FILE__, __LINE__,
+                         "number of channels does not match the resampler",
+                         in->getChannel());
+    }
+
+    unsigned int    inCount  = in->getSamples();
+#ifdef HAVE_SRC_LIB
+    unsigned int    outCount = (unsigned int) (inCount * ratio) + 1;
+#else
+    unsigned int    outCount;
+
+    if ( polyphase ) {
+        // the polyphase converter produces what its input allows,
+        // give it room for that
+        outCount = (unsigned int) (inCount * ratio) + 2;
+    } else {
+        // aflibConverter produces exactly as many samples as asked for,
+        // so ask for what keeps the output in step with the input overall
+        inTotal += inCount;
+        outCount = (unsigned int) (inTotal * outSampleRate / inSampleRate
+                                 - outTotal);
+        outTotal += outCount;
+    }
+#endif
+
+    if ( outCount > outBufferSize ) {
+        delete[] outBuffer;
+        outBufferSize = outCount;
+#ifdef HAVE_SRC_LIB
+        outBuffer     = new float[outBufferSize * channel];
+#else
+        outBuffer     = new short int[outBufferSize * channel];
+#endif
+    }
+
+#ifdef HAVE_SRC_LIB
+    converterData.data_in       = (float *) in->getFloat();
+    converterData.input_frames  = inCount;
+    converterData.data_out      = outBuffer;
+    converterData.output_frames = outBufferSize;
+
+    int srcError = src_process( converter, &converterData);
+    if ( srcError ) {
+        throw Exception( __FILE__, __LINE__, "libsamplerate error: ",
+                         src_strerror( srcError));
+    }
+
+    out->setFloat( outBuffer, converterData.output_frames_gen);
+#else
+    // aflibConverter works on the channels one after the other
+    int     count     = inCount;
+    short * inArray   = (short int *) in->getShort( 0);
+    int     converted = polyphase
+                      ? polyphase->resample( count, outCount, inArray,
+                                             outBuffer)
+                      : converter->resample( count, outCount, inArray,
+                                             outBuffer);
+
+    out->setPlanarShort( outBuffer, outCount, converted);
+#endif
+}
+
@@ -0,0 +1,302 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : Resampler.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SRC_LIB
+#include <samplerate.h>
+#else
+#include "aflibConverter.h"
+#include "PolyphaseConverter.h"
+#endif
+
+#include "Referable.h"
+#include "Exception.h"
+#include "AudioFrame.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A sample rate converter, turning AudioFrames at one sample rate into
+ *  AudioFrames at another one.
+ *
+ *  Uses libsamplerate if available. Otherwise PolyphaseConverter is used
+ *  for the ratios it supports, which covers the usual sample rates, and
+ *  aflibConverter for the rest. Linear interpolation is used when the
+ *  input sample rate is a power of two multiple of the output sample
+ *  rate, as that is of sufficient quality in that case.
+ *
+ *  A resampler keeps state between the frames it processes, thus it
+ *  should be fed a continuous stream of audio. The output of a single
+ *  resampler can be shared by any number of encoders though, see
+ *  AudioFrame::attach().
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class Resampler : public virtual Referable
+{
+    private:
+
+        /**
+         *  Sample rate of the input.
+         */
+        unsigned int        inSampleRate;
+
+        /**
+         *  Sample rate of the output.
+         */
+        unsigned int        outSampleRate;
+
+        /**
+         *  Number of channels resampled.
+         */
+        unsigned int        channel;
+
+        /**
+         *  The resample ratio, output sample rate / input sample rate.
+         */
+        double              ratio;
+
+        /**
+         *  Flag to show if linear interpolation is used.
+         */
+        bool                linear;
+
+        /**
+         *  The number of samples per channel the output buffer can hold.
+         */
+        unsigned int        outBufferSize;
+
+#ifdef HAVE_SRC_LIB
+        /**
+         *  The libsamplerate converter.
+         */
+        SRC_STATE         * converter;
+
+        /**
+         *  The parameters of a libsamplerate conversion.
+         */
+        SRC_DATA            converterData;
+
+        /**
+         *  The output of the converter, channels interleaved.
+         */
+        float             * outBuffer;
+#else
+        /**
+         *  The aflib converter, if the polyphase converter is not used.
+         */
+        aflibConverter    * converter;
+
+        /**
+         *  The polyphase converter, for the ratios it supports.
+         */
+        PolyphaseConverter  * polyphase;
+
+        /**
+         *  The number of samples per channel fed to the converter so far.
+         */
+        unsigned long long  inTotal;
+
+        /**
+         *  The number of samples per channel produced by the converter
+         *  so far.
+         */
+        unsigned long long  outTotal;
+
+        /**
+         *  The output of the converter, one channel after the other,
+         *  each outBufferSize long.
+         */
+        short int         * outBuffer;
+#endif
+
+        /**
+         *  Initialize the object.
+         *
+         *  @param inSampleRate sample rate of the input.
+         *  @param outSampleRate sample rate of the output.
+         *  @param channel number of channels to resample.
+         *  @exception Exception
+         */
+        void
+        init (  unsigned int        inSampleRate,
+                unsigned int        outSampleRate,
+                unsigned int        channel )           ;
+
+        /**
+         *  De-initialize the object.
+         *
+         *  @exception Exception
+         */
+        void
+        strip ( void )                                  ;
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        Resampler ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception, as the state of
+         *  the converter can't be copied.
+         *
+         *  @param resampler the object to copy.
+         *  @exception Exception
+         */
+        inline
+        Resampler ( const Resampler     & resampler )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Constructor.
+         *
+         *  @param inSampleRate sample rate of the input.
+         *  @param outSampleRate sample rate of the output.
+         *  @param channel number of channels to resample.
+         *  @exception Exception
+         */
+        inline
+        Resampler ( unsigned int        inSampleRate,
+                    unsigned int        outSampleRate,
+                    unsigned int        channel )
+        {
+            init( inSampleRate, outSampleRate, channel);
+        }
+
+        /**
+         *  Destructor.
+         *
+         *  @exception Exception
+         */
+        inline virtual
+        ~Resampler ( void )
+        {
+            strip();
+        }
+
+        /**
+         *  Resample a frame.
+         *
+         *  @param in the frame to resample, at the input sample rate,
+         *            with the number of channels of the resampler.
+         *  @param out the frame to put the resampled audio into, a 16 bit
+         *             frame with the number of channels of the resampler.
+         *  @exception Exception
+         */
+        void
+        resample (  const AudioFrame  * in,
+                    AudioFrame        * out )           ;
+
+        /**
+         *  Get the sample rate of the input.
+         *
+         *  @return the input sample rate.
+         */
+        inline unsigned int
+        getInSampleRate ( void ) const                  throw ()
+        {
+            return inSampleRate;
+        }
+
+        /**
+         *  Get the sample rate of the output.
+         *
+         *  @return the output sample rate.
+         */
+        inline unsigned int
+        getOutSampleRate ( void ) const                 throw ()
+        {
+            return outSampleRate;
+        }
+
+        /**
+         *  Get the number of channels resampled.
+         *
+         *  @return the number of channels.
+         */
+        inline unsigned int
+        getChannel ( void ) const                       throw ()
+        {
+            return channel;
+        }
+
+        /**
+         *  Tell if linear interpolation is used.
+         *
+         *  @return true if linear interpolation is used, false if
+         *          a higher quality, more expensive method is used.
+         */
+        inline bool
+        isLinear ( void ) const                         throw ()
+        {
+            return linear;
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* RESAMPLER_H */
+
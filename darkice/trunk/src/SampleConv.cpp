@@ -0,0 +1,1196 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : SampleConv.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+// the SIMD versions are compiled with per function target attributes,
+// so that the binary still runs on CPUs without the instructions
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define SAMPLE_CONV_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define SAMPLE_CONV_NEON
+#include <arm_neon.h>
+#endif
+
+#include "SampleConv.h"
+
+
+/* ===================================================  local data structures */
+
+/*------------------------------------------------------------------------------
+ *  One version of all the kernels
+ *----------------------------------------------------------------------------*/
+struct Kernels {
+    const char    * name;
+    void         (* swapShort)         ( const int16_t *, size_t, int16_t *);
+    void         (* shortToFloat)      ( const int16_t *, size_t, float *);
+    void         (* floatToShort)      ( const float *, size_t, int16_t *);
+    void         (* intToFloat)        ( const int32_t *, size_t, float *);
+    void         (* floatToInt)        ( const float *, size_t, int32_t *);
+    void         (* int24ToFloat)      ( const unsigned char *, size_t,
+                                         float *, bool);
+    void         (* floatToInt24)      ( const float *, size_t,
+                                         unsigned char *, bool);
+    void         (* deinterleaveShort) ( const int16_t *, size_t,
+                                         int16_t **, unsigned int);
+    void         (* deinterleaveFloat) ( const float *, size_t,
+                                         float **, unsigned int);
+    void         (* interleaveFloat)   ( const float * const *, size_t,
+                                         float *, unsigned int);
+    float        (* dotProduct)        ( const float *, const float *,
+                                         size_t);
+};
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  Scale factors and clipping limits of the integer sample formats.
+ *  The upper limit of 32 bit samples is the largest float below 2^31.
+ *----------------------------------------------------------------------------*/
+static const float shortScale   = 32768.f;
+static const float shortMax     = 32767.f;
+static const float shortMin     = -32768.f;
+static const float int24Scale   = 8388608.f;
+static const float int24Max     = 8388607.f;
+static const float int24Min     = -8388608.f;
+static const float intScale     = 2147483648.f;
+static const float intMax       = 2147483520.f;
+static const float intMin       = -2147483648.f;
+
+#ifdef SAMPLE_CONV_X86
+#define SSE2_TARGET     __attribute__ ((target ("sse2")))
+#define AVX2_TARGET     __attribute__ ((target ("avx2")))
+#endif
+
+
+/* ===============================================  local function prototypes */
+
+/*------------------------------------------------------------------------------
+ *  Select the fastest kernels the CPU supports
+ *----------------------------------------------------------------------------*/
+static const Kernels *
+selectKernels ( void );
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Plain C++ kernels, also used for the leftovers of the SIMD versions
+ *----------------------------------------------------------------------------*/
+static void
+swapShortScalar (   const int16_t     * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        uint16_t    v = (uint16_t) in[i];
+
+        out[i] = (int16_t) ((v << 8) | (v >> 8));
+    }
+}
+
+static void
+shortToFloatScalar (    const int16_t     * in,
+                        size_t              count,
+                        float             * out )
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        out[i] = ((float) in[i]) / shortScale;
+    }
+}
+
+static void
+floatToShortScalar (    const float       * in,
+                        size_t              count,
+                        int16_t           * out )
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        float   f = in[i] * shortScale;
+
+        if ( f > shortMax ) {
+            f = shortMax;
+        } else if ( f < shortMin ) {
+            f = shortMin;
+        } else if ( f != f ) {
+            f = 0.0f;
+        }
+        out[i] = (int16_t) lrintf( f);
+    }
+}
+
+static void
+intToFloatScalar (  const int32_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        out[i] = ((float) in[i]) / intScale;
+    }
+}
+
+static void
+floatToIntScalar (  const float       * in,
+                    size_t              count,
+                    int32_t           * out )
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        float   f = in[i] * intScale;
+
+        if ( f > intMax ) {
+            f = intMax;
+        } else if ( f < intMin ) {
+            f = intMin;
+        } else if ( f != f ) {
+            f = 0.0f;
+        }
+        out[i] = (int32_t) lrintf( f);
+    }
+}
+
+static void
+int24ToFloatScalar (    const unsigned char * in,
+                        size_t                count,
+                        float               * out,
+                        bool                  bigEndian )
+{
+    for ( size_t i = 0; i < count; ++i, in += 3 ) {
+        uint32_t    v;
+
+        // put the sample into the top 24 bits, for the sign
+        if ( bigEndian ) {
+            v = ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16)
+              | ((uint32_t) in[2] << 8);
+        } else {
+            v = ((uint32_t) in[2] << 24) | ((uint32_t) in[1] << 16)
+              | ((uint32_t) in[0] << 8);
+        }
+        out[i] = ((float) (int32_t) v) / intScale;
+    }
+}
+
+static void
+floatToInt24Scalar (    const float         * in,
+                        size_t                count,
+                        unsigned char       * out,
+                        bool                  bigEndian )
+{
+    for ( size_t i = 0; i < count; ++i, out += 3 ) {
+        float       f = in[i] * int24Scale;
+        uint32_t    v;
+
+        if ( f > int24Max ) {
+            f = int24Max;
+        } else if ( f < int24Min ) {
+            f = int24Min;
+        } else if ( f != f ) {
+            f = 0.0f;
+        }
+        v = (uint32_t) lrintf( f);
+
+        if ( bigEndian ) {
+            out[0] = (unsigned char) (v >> 16);
+            out[1] = (unsigned char) (v >> 8);
+            out[2] = (unsigned char) v;
+        } else {
+            out[0] = (unsigned char) v;
+            out[1] = (unsigned char) (v >> 8);
+            out[2] = (unsigned char) (v >> 16);
+        }
+    }
+}
+
+static void
+deinterleaveShortScalar (   const int16_t     * in,
+                            size_t              samples,
+                            int16_t          ** out,
+                            unsigned int        channels )
+{
+    for ( size_t i = 0; i < samples; ++i ) {
+        for ( unsigned int c = 0; c < channels; ++c ) {
+            out[c][i] = *in++;
+        }
+    }
+}
+
+static void
+deinterleaveFloatScalar (   const float       * in,
+                            size_t              samples,
+                            float            ** out,
+                            unsigned int        channels )
+{
+    for ( size_t i = 0; i < samples; ++i ) {
+        for ( unsigned int c = 0; c < channels; ++c ) {
+            out[c][i] = *in++;
+        }
+    }
+}
+
+static void
+interleaveFloatScalar ( const float * const * in,
+                        size_t                samples,
+                        float               * out,
+                        unsigned int          channels )
+{
+    for ( size_t i = 0; i < samples; ++i ) {
+        for ( unsigned int c = 0; c < channels; ++c ) {
+            *out++ = in[c][i];
+        }
+    }
+}
+
+static float
+dotProductScalar (  const float       * a,
+                    const float       * b,
+                    size_t              count )
+{
+    float       sum = 0.f;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static const Kernels scalarKernels = {
+    "scalar",
+    swapShortScalar,
+    shortToFloatScalar,
+    floatToShortScalar,
+    intToFloatScalar,
+    floatToIntScalar,
+    int24ToFloatScalar,
+    floatToInt24Scalar,
+    deinterleaveShortScalar,
+    deinterleaveFloatScalar,
+    interleaveFloatScalar,
+    dotProductScalar
+};
+
+
+#ifdef SAMPLE_CONV_X86
+
+/*------------------------------------------------------------------------------
+ *  SSE2 kernels
+ *----------------------------------------------------------------------------*/
+SSE2_TARGET static void
+swapShortSse2 (     const int16_t     * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    size_t      i = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *) (in + i));
+
+        v = _mm_or_si128( _mm_slli_epi16( v, 8), _mm_srli_epi16( v, 8));
+        _mm_storeu_si128( (__m128i *) (out + i), v);
+    }
+    swapShortScalar( in + i, count - i, out + i);
+}
+
+SSE2_TARGET static void
+shortToFloatSse2 (  const int16_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const __m128    scale = _mm_set1_ps( 1.f / shortScale);
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128i v  = _mm_loadu_si128( (const __m128i *) (in + i));
+        // sign extend by putting the samples into the top halves
+        __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( v, v), 16);
+        __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( v, v), 16);
+
+        _mm_storeu_ps( out + i,     _mm_mul_ps( _mm_cvtepi32_ps( lo), scale));
+        _mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi), scale));
+    }
+    shortToFloatScalar( in + i, count - i, out + i);
+}
+
+SSE2_TARGET static void
+floatToShortSse2 (  const float       * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    const __m128    scale = _mm_set1_ps( shortScale);
+    const __m128    max   = _mm_set1_ps( shortMax);
+    const __m128    min   = _mm_set1_ps( shortMin);
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128  a = _mm_mul_ps( _mm_loadu_ps( in + i), scale);
+        __m128  b = _mm_mul_ps( _mm_loadu_ps( in + i + 4), scale);
+
+        // NaN to 0, as min and max would take it for the limit
+        a = _mm_and_ps( a, _mm_cmpord_ps( a, a));
+        b = _mm_and_ps( b, _mm_cmpord_ps( b, b));
+        a = _mm_max_ps( _mm_min_ps( a, max), min);
+        b = _mm_max_ps( _mm_min_ps( b, max), min);
+        _mm_storeu_si128( (__m128i *) (out + i),
+                          _mm_packs_epi32( _mm_cvtps_epi32( a),
+                                           _mm_cvtps_epi32( b)));
+    }
+    floatToShortScalar( in + i, count - i, out + i);
+}
+
+SSE2_TARGET static void
+intToFloatSse2 (    const int32_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const __m128    scale = _mm_set1_ps( 1.f / intScale);
+    size_t          i     = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *) (in + i));
+
+        _mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( v), scale));
+    }
+    intToFloatScalar( in + i, count - i, out + i);
+}
+
+SSE2_TARGET static void
+floatToIntSse2 (    const float       * in,
+                    size_t              count,
+                    int32_t           * out )
+{
+    const __m128    scale = _mm_set1_ps( intScale);
+    const __m128    max   = _mm_set1_ps( intMax);
+    const __m128    min   = _mm_set1_ps( intMin);
+    size_t          i     = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        __m128  f = _mm_mul_ps( _mm_loadu_ps( in + i), scale);
+
+        f = _mm_and_ps( f, _mm_cmpord_ps( f, f));
+        f = _mm_max_ps( _mm_min_ps( f, max), min);
+        _mm_storeu_si128( (__m128i *) (out + i), _mm_cvtps_epi32( f));
+    }
+    floatToIntScalar( in + i, count - i, out + i);
+}
+
+SSE2_TARGET static void
+deinterleaveShortSse2 ( const int16_t     * in,
+                        size_t              samples,
+                        int16_t          ** out,
+                        unsigned int        channels )
+{
+    if ( channels != 2 ) {
+        deinterleaveShortScalar( in, samples, out, channels);
+        return;
+    }
+
+    int16_t   * left  = out[0];
+    int16_t   * right = out[1];
+    size_t      i     = 0;
+
+    for ( ; i + 8 <= samples; i += 8 ) {
+        __m128i a = _mm_loadu_si128( (const __m128i *) (in + 2 * i));
+        __m128i b = _mm_loadu_si128( (const __m128i *) (in + 2 * i + 8));
+        // the left samples are in the lower, the right ones in the upper
+        // halves of the 32 bit words
+        __m128i la = _mm_srai_epi32( _mm_slli_epi32( a, 16), 16);
+        __m128i lb = _mm_srai_epi32( _mm_slli_epi32( b, 16), 16);
+        __m128i ra = _mm_srai_epi32( a, 16);
+        __m128i rb = _mm_srai_epi32( b, 16);
+
+        _mm_storeu_si128( (__m128i *) (left + i),  _mm_packs_epi32( la, lb));
+        _mm_storeu_si128( (__m128i *) (right + i), _mm_packs_epi32( ra, rb));
+    }
+    for ( ; i < samples; ++i ) {
+        left[i]  = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+SSE2_TARGET static void
+deinterleaveFloatSse2 ( const float       * in,
+                        size_t              samples,
+                        float            ** out,
+                        unsigned int        channels )
+{
+    if ( channels != 2 ) {
+        deinterleaveFloatScalar( in, samples, out, channels);
+        return;
+    }
+
+    float     * left  = out[0];
+    float     * right = out[1];
+    size_t      i     = 0;
+
+    for ( ; i + 4 <= samples; i += 4 ) {
+        __m128  a = _mm_loadu_ps( in + 2 * i);
+        __m128  b = _mm_loadu_ps( in + 2 * i + 4);
+
+        _mm_storeu_ps( left + i,  _mm_shuffle_ps( a, b, _MM_SHUFFLE(2,0,2,0)));
+        _mm_storeu_ps( right + i, _mm_shuffle_ps( a, b, _MM_SHUFFLE(3,1,3,1)));
+    }
+    for ( ; i < samples; ++i ) {
+        left[i]  = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+SSE2_TARGET static void
+interleaveFloatSse2 (   const float * const * in,
+                        size_t                samples,
+                        float               * out,
+                        unsigned int          channels )
+{
+    if ( channels != 2 ) {
+        interleaveFloatScalar( in, samples, out, channels);
+        return;
+    }
+
+    const float   * left  = in[0];
+    const float   * right = in[1];
+    size_t          i     = 0;
+
+    for ( ; i + 4 <= samples; i += 4 ) {
+        __m128  l = _mm_loadu_ps( left + i);
+        __m128  r = _mm_loadu_ps( right + i);
+
+        _mm_storeu_ps( out + 2 * i,     _mm_unpacklo_ps( l, r));
+        _mm_storeu_ps( out + 2 * i + 4, _mm_unpackhi_ps( l, r));
+    }
+    for ( ; i < samples; ++i ) {
+        out[2 * i]     = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+SSE2_TARGET static float
+dotProductSse2 (    const float       * a,
+                    const float       * b,
+                    size_t              count )
+{
+    __m128      sum0 = _mm_setzero_ps();
+    __m128      sum1 = _mm_setzero_ps();
+    float       sums[4];
+    size_t      i    = 0;
+
+    // two sums, so that the additions don't wait for each other
+    for ( ; i + 8 <= count; i += 8 ) {
+        sum0 = _mm_add_ps( sum0, _mm_mul_ps( _mm_loadu_ps( a + i),
+                                             _mm_loadu_ps( b + i)));
+        sum1 = _mm_add_ps( sum1, _mm_mul_ps( _mm_loadu_ps( a + i + 4),
+                                             _mm_loadu_ps( b + i + 4)));
+    }
+    _mm_storeu_ps( sums, _mm_add_ps( sum0, sum1));
+
+    return sums[0] + sums[1] + sums[2] + sums[3]
+         + dotProductScalar( a + i, b + i, count - i);
+}
+
+static const Kernels sse2Kernels = {
+    "sse2",
+    swapShortSse2,
+    shortToFloatSse2,
+    floatToShortSse2,
+    intToFloatSse2,
+    floatToIntSse2,
+    int24ToFloatScalar,
+    floatToInt24Scalar,
+    deinterleaveShortSse2,
+    deinterleaveFloatSse2,
+    interleaveFloatSse2,
+    dotProductSse2
+};
+
+
+/*------------------------------------------------------------------------------
+ *  AVX2 kernels, the interleaving ones are the SSE2 versions, as the
+ *  256 bit shuffles only work within 128 bit lanes
+ *----------------------------------------------------------------------------*/
+AVX2_TARGET static void
+swapShortAvx2 (     const int16_t     * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    size_t      i = 0;
+
+    for ( ; i + 16 <= count; i += 16 ) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *) (in + i));
+
+        v = _mm256_or_si256( _mm256_slli_epi16( v, 8),
+                             _mm256_srli_epi16( v, 8));
+        _mm256_storeu_si256( (__m256i *) (out + i), v);
+    }
+    swapShortScalar( in + i, count - i, out + i);
+}
+
+AVX2_TARGET static void
+shortToFloatAvx2 (  const int16_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const __m256    scale = _mm256_set1_ps( 1.f / shortScale);
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *) (in + i));
+        __m256  f = _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( v));
+
+        _mm256_storeu_ps( out + i, _mm256_mul_ps( f, scale));
+    }
+    shortToFloatScalar( in + i, count - i, out + i);
+}
+
+AVX2_TARGET static void
+floatToShortAvx2 (  const float       * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    const __m256    scale = _mm256_set1_ps( shortScale);
+    const __m256    max   = _mm256_set1_ps( shortMax);
+    const __m256    min   = _mm256_set1_ps( shortMin);
+    size_t          i     = 0;
+
+    for ( ; i + 16 <= count; i += 16 ) {
+        __m256  a = _mm256_mul_ps( _mm256_loadu_ps( in + i), scale);
+        __m256  b = _mm256_mul_ps( _mm256_loadu_ps( in + i + 8), scale);
+        __m256i v;
+
+        // NaN to 0, as min and max would take it for the limit
+        a = _mm256_and_ps( a, _mm256_cmp_ps( a, a, _CMP_ORD_Q));
+        b = _mm256_and_ps( b, _mm256_cmp_ps( b, b, _CMP_ORD_Q));
+        a = _mm256_max_ps( _mm256_min_ps( a, max), min);
+        b = _mm256_max_ps( _mm256_min_ps( b, max), min);
+        v = _mm256_packs_epi32( _mm256_cvtps_epi32( a),
+                                _mm256_cvtps_epi32( b));
+        // packing works within the 128 bit lanes, put the halves in order
+        v = _mm256_permute4x64_epi64( v, _MM_SHUFFLE(3,1,2,0));
+        _mm256_storeu_si256( (__m256i *) (out + i), v);
+    }
+    floatToShortScalar( in + i, count - i, out + i);
+}
+
+AVX2_TARGET static void
+intToFloatAvx2 (    const int32_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const __m256    scale = _mm256_set1_ps( 1.f / intScale);
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *) (in + i));
+
+        _mm256_storeu_ps( out + i,
+                          _mm256_mul_ps( _mm256_cvtepi32_ps( v), scale));
+    }
+    intToFloatScalar( in + i, count - i, out + i);
+}
+
+AVX2_TARGET static void
+floatToIntAvx2 (    const float       * in,
+                    size_t              count,
+                    int32_t           * out )
+{
+    const __m256    scale = _mm256_set1_ps( intScale);
+    const __m256    max   = _mm256_set1_ps( intMax);
+    const __m256    min   = _mm256_set1_ps( intMin);
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m256  f = _mm256_mul_ps( _mm256_loadu_ps( in + i), scale);
+
+        f = _mm256_and_ps( f, _mm256_cmp_ps( f, f, _CMP_ORD_Q));
+        f = _mm256_max_ps( _mm256_min_ps( f, max), min);
+        _mm256_storeu_si256( (__m256i *) (out + i), _mm256_cvtps_epi32( f));
+    }
+    floatToIntScalar( in + i, count - i, out + i);
+}
+
+AVX2_TARGET static void
+int24ToFloatAvx2 (  const unsigned char * in,
+                    size_t                count,
+                    float               * out,
+                    bool                  bigEndian )
+{
+    // move the 3 bytes of each sample into the top of a 32 bit word
+    const __m128i   le    = _mm_setr_epi8( -1,  0,  1,  2, -1,  3,  4,  5,
+                                           -1,  6,  7,  8, -1,  9, 10, 11);
+    const __m128i   be    = _mm_setr_epi8( -1,  2,  1,  0, -1,  5,  4,  3,
+                                           -1,  8,  7,  6, -1, 11, 10,  9);
+    const __m128i   mask  = bigEndian ? be : le;
+    const __m128    scale = _mm_set1_ps( 1.f / intScale);
+    size_t          i     = 0;
+
+    // 4 samples at a time, but a full 16 bytes are read
+    for ( ; i + 6 <= count; i += 4 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *) (in + 3 * i));
+
+        v = _mm_shuffle_epi8( v, mask);
+        _mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( v), scale));
+    }
+    int24ToFloatScalar( in + 3 * i, count - i, out + i, bigEndian);
+}
+
+AVX2_TARGET static void
+floatToInt24Avx2 (  const float         * in,
+                    size_t                count,
+                    unsigned char       * out,
+                    bool                  bigEndian )
+{
+    // take the lower 3 bytes of each 32 bit word
+    const __m128i   le    = _mm_setr_epi8(  0,  1,  2,  4,  5,  6,  8,  9,
+                                           10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i   be    = _mm_setr_epi8(  2,  1,  0,  6,  5,  4, 10,  9,
+                                            8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i   mask  = bigEndian ? be : le;
+    const __m128    scale = _mm_set1_ps( int24Scale);
+    const __m128    max   = _mm_set1_ps( int24Max);
+    const __m128    min   = _mm_set1_ps( int24Min);
+    size_t          i     = 0;
+
+    // 4 samples at a time, but a full 16 bytes are written,
+    // the extra 4 are overwritten by the next round
+    for ( ; i + 6 <= count; i += 4 ) {
+        __m128  f = _mm_mul_ps( _mm_loadu_ps( in + i), scale);
+        __m128i v;
+
+        f = _mm_and_ps( f, _mm_cmpord_ps( f, f));
+        f = _mm_max_ps( _mm_min_ps( f, max), min);
+        v = _mm_shuffle_epi8( _mm_cvtps_epi32( f), mask);
+        _mm_storeu_si128( (__m128i *) (out + 3 * i), v);
+    }
+    floatToInt24Scalar( in + i, count - i, out + 3 * i, bigEndian);
+}
+
+AVX2_TARGET static float
+dotProductAvx2 (    const float       * a,
+                    const float       * b,
+                    size_t              count )
+{
+    __m256      sum0 = _mm256_setzero_ps();
+    __m256      sum1 = _mm256_setzero_ps();
+    __m128      sum;
+    float       sums[4];
+    size_t      i    = 0;
+
+    // two sums, so that the additions don't wait for each other
+    for ( ; i + 16 <= count; i += 16 ) {
+        sum0 = _mm256_add_ps( sum0,
+                              _mm256_mul_ps( _mm256_loadu_ps( a + i),
+                                             _mm256_loadu_ps( b + i)));
+        sum1 = _mm256_add_ps( sum1,
+                              _mm256_mul_ps( _mm256_loadu_ps( a + i + 8),
+                                             _mm256_loadu_ps( b + i + 8)));
+    }
+    for ( ; i + 8 <= count; i += 8 ) {
+        sum0 = _mm256_add_ps( sum0,
+                              _mm256_mul_ps( _mm256_loadu_ps( a + i),
+                                             _mm256_loadu_ps( b + i)));
+    }
+    sum0 = _mm256_add_ps( sum0, sum1);
+    sum  = _mm_add_ps( _mm256_castps256_ps128( sum0),
+                       _mm256_extractf128_ps( sum0, 1));
+    _mm_storeu_ps( sums, sum);
+
+    return sums[0] + sums[1] + sums[2] + sums[3]
+         + dotProductScalar( a + i, b + i, count - i);
+}
+
+static const Kernels avx2Kernels = {
+    "avx2",
+    swapShortAvx2,
+    shortToFloatAvx2,
+    floatToShortAvx2,
+    intToFloatAvx2,
+    floatToIntAvx2,
+    int24ToFloatAvx2,
+    floatToInt24Avx2,
+    deinterleaveShortSse2,
+    deinterleaveFloatSse2,
+    interleaveFloatSse2,
+    dotProductAvx2
+};
+
+#endif // SAMPLE_CONV_X86
+
+
+#ifdef SAMPLE_CONV_NEON
+
+/*------------------------------------------------------------------------------
+ *  NEON kernels, for 64 bit ARM, where NEON is always present
+ *----------------------------------------------------------------------------*/
+static void
+swapShortNeon (     const int16_t     * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    size_t      i = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        uint8x16_t  v = vld1q_u8( (const uint8_t *) (in + i));
+
+        vst1q_u8( (uint8_t *) (out + i), vrev16q_u8( v));
+    }
+    swapShortScalar( in + i, count - i, out + i);
+}
+
+static void
+shortToFloatNeon (  const int16_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const float     scale = 1.f / shortScale;
+    size_t          i     = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        int16x8_t   v  = vld1q_s16( in + i);
+        int32x4_t   lo = vmovl_s16( vget_low_s16( v));
+        int32x4_t   hi = vmovl_s16( vget_high_s16( v));
+
+        vst1q_f32( out + i,     vmulq_n_f32( vcvtq_f32_s32( lo), scale));
+        vst1q_f32( out + i + 4, vmulq_n_f32( vcvtq_f32_s32( hi), scale));
+    }
+    shortToFloatScalar( in + i, count - i, out + i);
+}
+
+static void
+floatToShortNeon (  const float       * in,
+                    size_t              count,
+                    int16_t           * out )
+{
+    const float32x4_t   max = vdupq_n_f32( shortMax);
+    const float32x4_t   min = vdupq_n_f32( shortMin);
+    size_t              i   = 0;
+
+    for ( ; i + 8 <= count; i += 8 ) {
+        float32x4_t a = vmulq_n_f32( vld1q_f32( in + i), shortScale);
+        float32x4_t b = vmulq_n_f32( vld1q_f32( in + i + 4), shortScale);
+
+        // NaN passes min and max, and converts to 0
+        a = vmaxq_f32( vminq_f32( a, max), min);
+        b = vmaxq_f32( vminq_f32( b, max), min);
+        vst1q_s16( out + i, vcombine_s16( vqmovn_s32( vcvtnq_s32_f32( a)),
+                                          vqmovn_s32( vcvtnq_s32_f32( b))));
+    }
+    floatToShortScalar( in + i, count - i, out + i);
+}
+
+static void
+intToFloatNeon (    const int32_t     * in,
+                    size_t              count,
+                    float             * out )
+{
+    const float     scale = 1.f / intScale;
+    size_t          i     = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        float32x4_t f = vcvtq_f32_s32( vld1q_s32( in + i));
+
+        vst1q_f32( out + i, vmulq_n_f32( f, scale));
+    }
+    intToFloatScalar( in + i, count - i, out + i);
+}
+
+static void
+floatToIntNeon (    const float       * in,
+                    size_t              count,
+                    int32_t           * out )
+{
+    const float32x4_t   max = vdupq_n_f32( intMax);
+    const float32x4_t   min = vdupq_n_f32( intMin);
+    size_t              i   = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        float32x4_t f = vmulq_n_f32( vld1q_f32( in + i), intScale);
+
+        f = vmaxq_f32( vminq_f32( f, max), min);
+        vst1q_s32( out + i, vcvtnq_s32_f32( f));
+    }
+    floatToIntScalar( in + i, count - i, out + i);
+}
+
+static void
+deinterleaveShortNeon ( const int16_t     * in,
+                        size_t              samples,
+                        int16_t          ** out,
+                        unsigned int        channels )
+{
+    if ( channels != 2 ) {
+        deinterleaveShortScalar( in, samples, out, channels);
+        return;
+    }
+
+    int16_t   * left  = out[0];
+    int16_t   * right = out[1];
+    size_t      i     = 0;
+
+    for ( ; i + 8 <= samples; i += 8 ) {
+        int16x8x2_t v = vld2q_s16( in + 2 * i);
+
+        vst1q_s16( left + i,  v.val[0]);
+        vst1q_s16( right + i, v.val[1]);
+    }
+    for ( ; i < samples; ++i ) {
+        left[i]  = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+static void
+deinterleaveFloatNeon ( const float       * in,
+                        size_t              samples,
+                        float            ** out,
+                        unsigned int        channels )
+{
+    if ( channels != 2 ) {
+        deinterleaveFloatScalar( in, samples, out, channels);
+        return;
+    }
+
+    float     * left  = out[0];
+    float     * right = out[1];
+    size_t      i     = 0;
+
+    for ( ; i + 4 <= samples; i += 4 ) {
+        float32x4x2_t   v = vld2q_f32( in + 2 * i);
+
+        vst1q_f32( left + i,  v.val[0]);
+        vst1q_f32( right + i, v.val[1]);
+    }
+    for ( ; i < samples; ++i ) {
+        left[i]  = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+static void
+interleaveFloatNeon (   const float * const * in,
+                        size_t                samples,
+                        float               * out,
+                        unsigned int          channels )
+{
+    if ( channels != 2 ) {
+        interleaveFloatScalar( in, samples, out, channels);
+        return;
+    }
+
+    const float   * left  = in[0];
+    const float   * right = in[1];
+    size_t          i     = 0;
+
+    for ( ; i + 4 <= samples; i += 4 ) {
+        float32x4x2_t   v;
+
+        v.val[0] = vld1q_f32( left + i);
+        v.val[1] = vld1q_f32( right + i);
+        vst2q_f32( out + 2 * i, v);
+    }
+    for ( ; i < samples; ++i ) {
+        out[2 * i]     = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static float
+dotProductNeon (    const float       * a,
+                    const float       * b,
+                    size_t              count )
+{
+    float32x4_t sum0 = vdupq_n_f32( 0.f);
+    float32x4_t sum1 = vdupq_n_f32( 0.f);
+    size_t      i    = 0;
+
+    // two sums, so that the additions don't wait for each other
+    for ( ; i + 8 <= count; i += 8 ) {
+        sum0 = vmlaq_f32( sum0, vld1q_f32( a + i), vld1q_f32( b + i));
+        sum1 = vmlaq_f32( sum1, vld1q_f32( a + i + 4), vld1q_f32( b + i + 4));
+    }
+
+    return vaddvq_f32( vaddq_f32( sum0, sum1))
+         + dotProductScalar( a + i, b + i, count - i);
+}
+
+static const Kernels neonKernels = {
+    "neon",
+    swapShortNeon,
+    shortToFloatNeon,
+    floatToShortNeon,
+    intToFloatNeon,
+    floatToIntNeon,
+    int24ToFloatScalar,
+    floatToInt24Scalar,
+    deinterleaveShortNeon,
+    deinterleaveFloatNeon,
+    interleaveFloatNeon,
+    dotProductNeon
+};
+
+#endif // SAMPLE_CONV_NEON
+
+
+/*------------------------------------------------------------------------------
+ *  Select the fastest kernels the CPU supports
+ *----------------------------------------------------------------------------*/
+static const Kernels *
+selectKernels ( void )
+{
+#if defined(SAMPLE_CONV_X86)
+    // this runs before main(), so the CPU model has to be set up first
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2") ) {
+        return &avx2Kernels;
+    }
+    if ( __builtin_cpu_supports( "sse2") ) {
+        return &sse2Kernels;
+    }
+#elif defined(SAMPLE_CONV_NEON)
+    return &neonKernels;
+#endif
+    return &scalarKernels;
+}
+
+/*------------------------------------------------------------------------------
+ *  The kernels in use
+ *----------------------------------------------------------------------------*/
+static const Kernels * kernels = selectKernels();
+
+
+/*------------------------------------------------------------------------------
+ *  Get the name of the kernel versions in use
+ *----------------------------------------------------------------------------*/
+const char *
+SampleConv :: getKernelName ( void )                    throw ()
+{
+    return kernels->name;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Use another version of the kernels
+ *----------------------------------------------------------------------------*/
+bool
+SampleConv :: useKernels ( const char     * name )          throw ()
+{
+    const Kernels     * k = 0;
+
+    if ( !strcmp( name, scalarKernels.name) ) {
+        k = &scalarKernels;
+#if defined(SAMPLE_CONV_X86)
+    } else if ( !strcmp( name, sse2Kernels.name) ) {
+        k = __builtin_cpu_supports( "sse2") ? &sse2Kernels : 0;
+    } else if ( !strcmp( name, avx2Kernels.name) ) {
+        k = __builtin_cpu_supports( "avx2") ? &avx2Kernels : 0;
+#elif defined(SAMPLE_CONV_NEON)
+    } else if ( !strcmp( name, neonKernels.name) ) {
+        k = &neonKernels;
+#endif
+    }
+
+    if ( !k ) {
+        return false;
+    }
+    kernels = k;
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Swap the bytes of 16 bit samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: swapShort (   const int16_t     * in,
+                            size_t              count,
+                            int16_t           * out )   throw ()
+{
+    kernels->swapShort( in, count, out);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert 16 bit samples to float samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: shortToFloat (    const int16_t     * in,
+                                size_t              count,
+                                float             * out )   throw ()
+{
+    kernels->shortToFloat( in, count, out);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert float samples to 16 bit samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: floatToShort (    const float       * in,
+                                size_t              count,
+                                int16_t           * out )   throw ()
+{
+    kernels->floatToShort( in, count, out);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert 32 bit samples to float samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: intToFloat (  const int32_t     * in,
+                            size_t              count,
+                            float             * out )   throw ()
+{
+    kernels->intToFloat( in, count, out);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert float samples to 32 bit samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: floatToInt (  const float       * in,
+                            size_t              count,
+                            int32_t           * out )   throw ()
+{
+    kernels->floatToInt( in, count, out);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert packed 24 bit samples to float samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: int24ToFloat (    const unsigned char * in,
+                                size_t                count,
+                                float               * out,
+                                bool                  bigEndian )   throw ()
+{
+    kernels->int24ToFloat( in, count, out, bigEndian);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Convert float samples to packed 24 bit samples
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: floatToInt24 (    const float         * in,
+                                size_t                count,
+                                unsigned char       * out,
+                                bool                  bigEndian )   throw ()
+{
+    kernels->floatToInt24( in, count, out, bigEndian);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Separate interleaved 16 bit samples into one buffer per channel
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: deinterleaveShort (   const int16_t     * in,
+                                    size_t              samples,
+                                    int16_t          ** out,
+                                    unsigned int        channels )  throw ()
+{
+    if ( channels == 1 ) {
+        if ( out[0] != in ) {
+            memmove( out[0], in, samples * sizeof(int16_t));
+        }
+        return;
+    }
+    kernels->deinterleaveShort( in, samples, out, channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Separate interleaved float samples into one buffer per channel
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: deinterleaveFloat (   const float       * in,
+                                    size_t              samples,
+                                    float            ** out,
+                                    unsigned int        channels )  throw ()
+{
+    if ( channels == 1 ) {
+        if ( out[0] != in ) {
+            memmove( out[0], in, samples * sizeof(float));
+        }
+        return;
+    }
+    kernels->deinterleaveFloat( in, samples, out, channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Interleave float samples held in one buffer per channel
+ *----------------------------------------------------------------------------*/
+void
+SampleConv :: interleaveFloat ( const float * const * in,
+                                size_t                samples,
+                                float               * out,
+                                unsigned int          channels )    throw ()
+{
+    if ( channels == 1 ) {
+        if ( out != in[0] ) {
+            memmove( out, in[0], samples * sizeof(float));
+        }
+        return;
+    }
+    kernels->interleaveFloat( in, samples, out, channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Multiply two arrays of float samples element by element, and sum them
+ *----------------------------------------------------------------------------*/
+float
+SampleConv :: dotProduct (  const float       * a,
+                            const float       * b,
+                            size_t              count )     throw ()
+{
+    return kernels->dotProduct( a, b, count);
+}
+
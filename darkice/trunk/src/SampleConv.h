@@ -0,0 +1,315 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : SampleConv.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef SAMPLE_CONV_H
+#define SAMPLE_CONV_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#else
+#error need inttypes.h
+#endif
+
+#include <cstddef>
+
+#include "Exception.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  Sample format conversion kernels, used on every chunk of audio
+ *  read. Each kernel has a plain C++ version, and SSE2, AVX2 or NEON
+ *  versions where the platform has them. The fastest version the CPU
+ *  supports is selected once, at program start.
+ *
+ *  Float samples are in the range [-1.0, 1.0). Converting floats to
+ *  integers rounds to the nearest value, and clips to the range of the
+ *  integer type. The kernels that work element by element may be called
+ *  with the same buffer for input and output.
+ *
+ *  This class can not be instantiated, but contains static functions
+ *  only.
+ *
+ *  Typical usage:
+ *
+ *  <pre>
+ *  #include "SampleConv.h"
+ *
+ *  SampleConv::floatToShort( floatBuffer, samples * channels, shortBuffer);
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class SampleConv
+{
+    protected:
+
+        /**
+         *  Default constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        SampleConv ( void )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Copy constructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        SampleConv ( const SampleConv &   s )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+        /**
+         *  Destructor. Always throws an Exception.
+         *
+         *  @exception Exception
+         */
+        inline
+        ~SampleConv ( void )
+        {
+        }
+
+        /**
+         *  Assignment operator. Always throws an Exception.
+         *
+         *  @param s the object to assign to this one.
+         *  @exception Exception
+         */
+        inline SampleConv &
+        operator= ( const SampleConv &   s )
+        {
+            throw Exception( __FILE__, __LINE__);
+        }
+
+
+    public:
+
+        /**
+         *  Get the name of the kernel versions in use.
+         *
+         *  @return "avx2", "sse2", "neon" or "scalar".
+         */
+        static const char *
+        getKernelName ( void )                              throw ();
+
+        /**
+         *  Use another version of the kernels than the fastest one,
+         *  to compare them. Not to be called while converting.
+         *
+         *  @param name "avx2", "sse2", "neon" or "scalar".
+         *  @return true if the version is used from now on, false if
+         *          it is not built in, or the CPU doesn't support it.
+         */
+        static bool
+        useKernels ( const char       * name )              throw ();
+
+        /**
+         *  Swap the bytes of 16 bit samples.
+         *
+         *  @param in the samples to swap.
+         *  @param count the number of samples in in.
+         *  @param out put the swapped samples here.
+         */
+        static void
+        swapShort (     const int16_t     * in,
+                        size_t              count,
+                        int16_t           * out )           throw ();
+
+        /**
+         *  Convert 16 bit samples to float samples.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the float samples here.
+         */
+        static void
+        shortToFloat (  const int16_t     * in,
+                        size_t              count,
+                        float             * out )           throw ();
+
+        /**
+         *  Convert float samples to 16 bit samples, clipping them.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the 16 bit samples here.
+         */
+        static void
+        floatToShort (  const float       * in,
+                        size_t              count,
+                        int16_t           * out )           throw ();
+
+        /**
+         *  Convert 32 bit samples to float samples.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the float samples here.
+         */
+        static void
+        intToFloat (    const int32_t     * in,
+                        size_t              count,
+                        float             * out )           throw ();
+
+        /**
+         *  Convert float samples to 32 bit samples, clipping them.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the 32 bit samples here.
+         */
+        static void
+        floatToInt (    const float       * in,
+                        size_t              count,
+                        int32_t           * out )           throw ();
+
+        /**
+         *  Convert packed 24 bit samples, 3 bytes each, to float samples.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the float samples here.
+         *  @param bigEndian true if the samples are big endian.
+         */
+        static void
+        int24ToFloat (  const unsigned char * in,
+                        size_t                count,
+                        float               * out,
+                        bool                  bigEndian )   throw ();
+
+        /**
+         *  Convert float samples to packed 24 bit samples, clipping them.
+         *
+         *  @param in the samples to convert.
+         *  @param count the number of samples in in.
+         *  @param out put the 24 bit samples here, 3 bytes each.
+         *  @param bigEndian true if the samples are to be big endian.
+         */
+        static void
+        floatToInt24 (  const float         * in,
+                        size_t                count,
+                        unsigned char       * out,
+                        bool                  bigEndian )   throw ();
+
+        /**
+         *  Separate interleaved 16 bit samples into one buffer
+         *  per channel.
+         *
+         *  @param in the interleaved samples.
+         *  @param samples the number of samples per channel in in.
+         *  @param out the buffers for the channels,
+         *             each samples long.
+         *  @param channels the number of channels.
+         */
+        static void
+        deinterleaveShort ( const int16_t     * in,
+                            size_t              samples,
+                            int16_t          ** out,
+                            unsigned int        channels )  throw ();
+
+        /**
+         *  Separate interleaved float samples into one buffer
+         *  per channel.
+         *
+         *  @param in the interleaved samples.
+         *  @param samples the number of samples per channel in in.
+         *  @param out the buffers for the channels,
+         *             each samples long.
+         *  @param channels the number of channels.
+         */
+        static void
+        deinterleaveFloat ( const float       * in,
+                            size_t              samples,
+                            float            ** out,
+                            unsigned int        channels )  throw ();
+
+        /**
+         *  Interleave float samples held in one buffer per channel.
+         *
+         *  @param in the buffers of the channels, each samples long.
+         *  @param samples the number of samples per channel.
+         *  @param out put the interleaved samples here.
+         *  @param channels the number of channels.
+         */
+        static void
+        interleaveFloat (   const float * const * in,
+                            size_t                samples,
+                            float               * out,
+                            unsigned int          channels )  throw ();
+
+        /**
+         *  Multiply two arrays of float samples element by element,
+         *  and sum the products, as for a step of an FIR filter.
+         *
+         *  @param a the first array.
+         *  @param b the second array.
+         *  @param count the number of elements in each array.
+         *  @return the sum of the products.
+         */
+        static float
+        dotProduct (    const float       * a,
+                        const float       * b,
+                        size_t              count )     throw ();
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* SAMPLE_CONV_H */
+
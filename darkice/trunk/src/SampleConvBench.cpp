@@ -0,0 +1,527 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : SampleConvBench.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error need stdlib.h
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#else
+#error need math.h
+#endif
+
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#else
+#error need limits.h
+#endif
+
+#include <iostream>
+#include <iomanip>
+
+#include "SampleConv.h"
+#include "TimeSummary.h"
+
+
+/* ===================================================  local data structures */
+
+/*------------------------------------------------------------------------------
+ *  The buffers of a frame, as AudioFrame keeps them
+ *----------------------------------------------------------------------------*/
+struct Buffers {
+    unsigned int        channels;
+    size_t              samples;
+    unsigned char     * pcm;
+    int16_t           * shortBuffer;
+    float             * floatBuffer;
+    int16_t          ** shortChannels;
+    float            ** floatChannels;
+};
+
+/*------------------------------------------------------------------------------
+ *  A conversion to measure, the way it was done before the kernels,
+ *  and the way it is done by them
+ *----------------------------------------------------------------------------*/
+struct Bench {
+    const char    * name;
+    void         (* old)       ( Buffers * b);
+    void         (* kernels)   ( Buffers * b);
+};
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+/*------------------------------------------------------------------------------
+ *  The samples per channel in each frame converted, as in a 4096 byte
+ *  chunk of 16 bit stereo
+ *----------------------------------------------------------------------------*/
+static const size_t         frameSamples = 1024;
+
+/*------------------------------------------------------------------------------
+ *  The seconds to spend on measuring each conversion
+ *----------------------------------------------------------------------------*/
+static const double         measureTime  = 0.2;
+
+/*------------------------------------------------------------------------------
+ *  The versions of the kernels to compare
+ *----------------------------------------------------------------------------*/
+static const char         * versions[]   = { "scalar", "sse2", "avx2", "neon" };
+
+/*------------------------------------------------------------------------------
+ *  The numbers of channels to compare at
+ *----------------------------------------------------------------------------*/
+static const unsigned int   channelCounts[] = { 1, 2, 8 };
+
+
+/* ===============================================  local function prototypes */
+
+static void
+from16Old ( Buffers   * b );
+
+static void
+from16Kernels ( Buffers   * b );
+
+static void
+fromFloatOld ( Buffers   * b );
+
+static void
+fromFloatKernels ( Buffers   * b );
+
+static void
+jackOld ( Buffers   * b );
+
+static void
+jackKernels ( Buffers   * b );
+
+static void
+from24Old ( Buffers   * b );
+
+static void
+from24Kernels ( Buffers   * b );
+
+static void
+from32Old ( Buffers   * b );
+
+static void
+from32Kernels ( Buffers   * b );
+
+/*------------------------------------------------------------------------------
+ *  The conversions measured
+ *----------------------------------------------------------------------------*/
+static const Bench          benches[] = {
+    { "16 bit to frame",      from16Old,      from16Kernels },
+    { "float to frame",       fromFloatOld,   fromFloatKernels },
+    { "jack clip and pack",   jackOld,        jackKernels },
+    { "24 bit to float",      from24Old,      from24Kernels },
+    { "32 bit to float",      from32Old,      from32Kernels }
+};
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Big endian 16 bit samples to a frame, the old way: Util::conv()
+ *  assembling the bytes, then one loop filling all the buffers
+ *----------------------------------------------------------------------------*/
+static void
+from16Old ( Buffers   * b )
+{
+    size_t      n = b->samples * b->channels;
+
+    for ( size_t i = 0, j = 0; j < n; ++j ) {
+        int16_t     value;
+
+        value            = b->pcm[i++] << 8;
+        value           |= b->pcm[i++];
+        b->shortBuffer[j] = value;
+    }
+    for ( size_t i = 0, j = 0; i < b->samples; ++i ) {
+        for ( unsigned int c = 0; c < b->channels; ++c, ++j ) {
+            b->shortChannels[c][i] = b->shortBuffer[j];
+            b->floatBuffer[j]      = ((float) b->shortBuffer[j]) / 32768.f;
+            b->floatChannels[c][i] = b->floatBuffer[j];
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Big endian 16 bit samples to a frame, as AudioFrame::convert() does
+ *----------------------------------------------------------------------------*/
+static void
+from16Kernels ( Buffers   * b )
+{
+    size_t      n = b->samples * b->channels;
+
+    SampleConv::swapShort( (const int16_t *) b->pcm, n, b->shortBuffer);
+    SampleConv::shortToFloat( b->shortBuffer, n, b->floatBuffer);
+    SampleConv::deinterleaveShort( b->shortBuffer,
+                                   b->samples,
+                                   b->shortChannels,
+                                   b->channels);
+    SampleConv::deinterleaveFloat( b->floatBuffer,
+                                   b->samples,
+                                   b->floatChannels,
+                                   b->channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Float samples to a frame, the old way: clipping to 16 bits and
+ *  filling all the buffers in one loop
+ *----------------------------------------------------------------------------*/
+static void
+fromFloatOld ( Buffers   * b )
+{
+    const float   * in = (const float *) b->pcm;
+
+    for ( size_t i = 0, j = 0; i < b->samples; ++i ) {
+        for ( unsigned int c = 0; c < b->channels; ++c, ++j ) {
+            int     s = (int) (in[j] * 32768.f);
+
+            if ( s > 32767 ) {
+                s = 32767;
+            } else if ( s < -32768 ) {
+                s = -32768;
+            }
+            b->shortBuffer[j]      = (int16_t) s;
+            b->shortChannels[c][i] = (int16_t) s;
+            b->floatBuffer[j]      = in[j];
+            b->floatChannels[c][i] = in[j];
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Float samples to a frame, as AudioFrame::convert() does
+ *----------------------------------------------------------------------------*/
+static void
+fromFloatKernels ( Buffers   * b )
+{
+    size_t      n = b->samples * b->channels;
+
+    memcpy( b->floatBuffer, b->pcm, n * sizeof(float));
+    SampleConv::floatToShort( b->floatBuffer, n, b->shortBuffer);
+    SampleConv::deinterleaveShort( b->shortBuffer,
+                                   b->samples,
+                                   b->shortChannels,
+                                   b->channels);
+    SampleConv::deinterleaveFloat( b->floatBuffer,
+                                   b->samples,
+                                   b->floatChannels,
+                                   b->channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The JACK ports' float samples to interleaved 16 bit samples, the old
+ *  way of JackDspSource::read()
+ *----------------------------------------------------------------------------*/
+static void
+jackOld ( Buffers   * b )
+{
+    for ( unsigned int c = 0; c < b->channels; ++c ) {
+        const float   * port = b->floatChannels[c];
+
+        for ( size_t n = 0; n < b->samples; ++n ) {
+            int tmp = lrintf( port[n] * 32768.0f);
+            if ( tmp > SHRT_MAX ) {
+                b->shortBuffer[n * b->channels + c] = SHRT_MAX;
+            } else if ( tmp < SHRT_MIN ) {
+                b->shortBuffer[n * b->channels + c] = SHRT_MIN;
+            } else {
+                b->shortBuffer[n * b->channels + c] = (short) tmp;
+            }
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  The JACK ports' float samples to interleaved 16 bit samples, as
+ *  JackDspSource::read() does
+ *----------------------------------------------------------------------------*/
+static void
+jackKernels ( Buffers   * b )
+{
+    SampleConv::interleaveFloat( b->floatChannels,
+                                 b->samples,
+                                 b->floatBuffer,
+                                 b->channels);
+    SampleConv::floatToShort( b->floatBuffer,
+                              b->samples * b->channels,
+                              b->shortBuffer);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Little endian packed 24 bit samples to float, one sample at a time
+ *----------------------------------------------------------------------------*/
+static void
+from24Old ( Buffers   * b )
+{
+    size_t      n = b->samples * b->channels;
+
+    for ( size_t i = 0, j = 0; j < n; ++j, i += 3 ) {
+        int32_t     value = (int32_t) (((uint32_t) b->pcm[i] << 8)
+                                     | ((uint32_t) b->pcm[i + 1] << 16)
+                                     | ((uint32_t) b->pcm[i + 2] << 24));
+
+        b->floatBuffer[j] = (float) (value >> 8) / 8388608.f;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Little endian packed 24 bit samples to float, by the kernels
+ *----------------------------------------------------------------------------*/
+static void
+from24Kernels ( Buffers   * b )
+{
+    SampleConv::int24ToFloat( b->pcm,
+                              b->samples * b->channels,
+                              b->floatBuffer,
+                              false);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  32 bit samples to float, one sample at a time
+ *----------------------------------------------------------------------------*/
+static void
+from32Old ( Buffers   * b )
+{
+    const int32_t     * in = (const int32_t *) b->pcm;
+    size_t              n  = b->samples * b->channels;
+
+    for ( size_t j = 0; j < n; ++j ) {
+        b->floatBuffer[j] = (float) in[j] / 2147483648.f;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  32 bit samples to float, by the kernels
+ *----------------------------------------------------------------------------*/
+static void
+from32Kernels ( Buffers   * b )
+{
+    SampleConv::intToFloat( (const int32_t *) b->pcm,
+                            b->samples * b->channels,
+                            b->floatBuffer);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Allocate the buffers of a frame, with noise in the input
+ *----------------------------------------------------------------------------*/
+static void
+createBuffers ( Buffers         * b,
+                unsigned int      channels )
+{
+    size_t      n = frameSamples * channels;
+
+    b->channels      = channels;
+    b->samples       = frameSamples;
+    b->pcm           = new unsigned char[n * sizeof(float)];
+    b->shortBuffer   = new int16_t[n];
+    b->floatBuffer   = new float[n];
+    b->shortChannels = new int16_t*[channels];
+    b->floatChannels = new float*[channels];
+    for ( unsigned int c = 0; c < channels; ++c ) {
+        b->shortChannels[c] = new int16_t[frameSamples];
+        b->floatChannels[c] = new float[frameSamples];
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Fill the input of a conversion with noise of the right kind: floats
+ *  somewhat beyond [-1.0, 1.0), so that some are clipped
+ *----------------------------------------------------------------------------*/
+static void
+fillBuffers (   Buffers       * b,
+                bool            floats )
+{
+    size_t      n = b->samples * b->channels;
+
+    srand( 1);
+    if ( floats ) {
+        float     * f = (float *) b->pcm;
+
+        for ( size_t j = 0; j < n; ++j ) {
+            f[j] = (float) rand() / RAND_MAX * 2.2f - 1.1f;
+        }
+        for ( unsigned int c = 0; c < b->channels; ++c ) {
+            for ( size_t i = 0; i < b->samples; ++i ) {
+                b->floatChannels[c][i] = (float) rand() / RAND_MAX
+                                       * 2.2f - 1.1f;
+            }
+        }
+    } else {
+        for ( size_t i = 0; i < n * sizeof(float); ++i ) {
+            b->pcm[i] = (unsigned char) rand();
+        }
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Free the buffers of a frame
+ *----------------------------------------------------------------------------*/
+static void
+deleteBuffers ( Buffers   * b )
+{
+    for ( unsigned int c = 0; c < b->channels; ++c ) {
+        delete[] b->shortChannels[c];
+        delete[] b->floatChannels[c];
+    }
+    delete[] b->shortChannels;
+    delete[] b->floatChannels;
+    delete[] b->floatBuffer;
+    delete[] b->shortBuffer;
+    delete[] b->pcm;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Measure a conversion, in nanoseconds per sample
+ *----------------------------------------------------------------------------*/
+static double
+measure (   void           (* convert) ( Buffers * b),
+            Buffers         * b )
+{
+    unsigned long   rounds = 0;
+    double          start;
+    double          elapsed;
+
+    // once to warm up the caches
+    convert( b);
+
+    start = TimeSummary::now();
+    do {
+        for ( unsigned int i = 0; i < 64; ++i ) {
+            convert( b);
+        }
+        rounds  += 64;
+        elapsed  = TimeSummary::now() - start;
+    } while ( elapsed < measureTime );
+
+    return elapsed * 1e9 / rounds / (b->samples * b->channels);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Compare the old conversions with each version of the kernels
+ *  available, at 1, 2 and 8 channels
+ *----------------------------------------------------------------------------*/
+int
+main (  int         argc,
+        char      * argv[] )
+{
+    const char    * selected = SampleConv::getKernelName();
+    unsigned int    numVersions = sizeof(versions) / sizeof(versions[0]);
+    unsigned int    numBenches  = sizeof(benches) / sizeof(benches[0]);
+    unsigned int    numCounts   = sizeof(channelCounts)
+                                / sizeof(channelCounts[0]);
+
+    std::cout << "nanoseconds per sample, speedup over the old code in "
+                 "brackets, frames of " << frameSamples << " samples"
+              << std::endl << std::endl;
+
+    std::cout << std::left << std::setw( 20) << "conversion"
+              << std::right << std::setw( 4) << "ch"
+              << std::setw( 10) << "old";
+    for ( unsigned int v = 0; v < numVersions; ++v ) {
+        if ( SampleConv::useKernels( versions[v]) ) {
+            std::cout << std::setw( 18) << versions[v];
+        }
+    }
+    std::cout << std::endl;
+
+    std::cout << std::fixed << std::setprecision( 2);
+    for ( unsigned int t = 0; t < numBenches; ++t ) {
+        for ( unsigned int k = 0; k < numCounts; ++k ) {
+            Buffers     b;
+            double      old;
+
+            createBuffers( &b, channelCounts[k]);
+            fillBuffers( &b, benches[t].old == fromFloatOld
+                          || benches[t].old == jackOld);
+
+            old = measure( benches[t].old, &b);
+            std::cout << std::left << std::setw( 20) << benches[t].name
+                      << std::right << std::setw( 4) << channelCounts[k]
+                      << std::setw( 10) << old;
+
+            for ( unsigned int v = 0; v < numVersions; ++v ) {
+                double  ns;
+
+                if ( !SampleConv::useKernels( versions[v]) ) {
+                    continue;
+                }
+                ns = measure( benches[t].kernels, &b);
+                std::cout << std::setw( 10) << ns
+                          << " (" << std::setw( 4) << std::setprecision( 1)
+                          << old / ns << "x)" << std::setprecision( 2);
+            }
+            std::cout << std::endl;
+
+            deleteBuffers( &b);
+        }
+    }
+
+    SampleConv::useKernels( selected);
+    std::cout << std::endl << "kernels selected at start: " << selected
+              << std::endl;
+
+    return 0;
+}
+
@@ -0,0 +1,235 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : ScratchBuffer.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef SCRATCH_BUFFER_H
+#define SCRATCH_BUFFER_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#include <cstddef>
+
+#include "Exception.h"
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  A work buffer that is kept between calls, and is only reallocated
+ *  when it has to grow. Encoders use these instead of allocating
+ *  temporary buffers on each write, so that once the buffers have
+ *  reached the size needed, encoding does no more heap allocations.
+ *  The allocationcheck program, run by make check, counts the heap calls
+ *  of the encoders once warmed up, and fails if there are any.
+ *
+ *  The contents are not kept when the buffer grows with reserve(), only
+ *  with grow(), and are not copied when the buffer itself is copied.
+ *
+ *  sample usage:
+ *
+ *  <pre>
+ *  #include "ScratchBuffer.h"
+ *
+ *  ScratchBuffer<unsigned char>    outBuffer;
+ *
+ *  ...
+ *
+ *  unsigned char * buf = outBuffer.reserve( size);
+ *  </pre>
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+template <class T>
+class ScratchBuffer
+{
+    private:
+
+        /**
+         *  The buffer itself.
+         */
+        T         * buffer;
+
+        /**
+         *  The number of elements the buffer can hold.
+         */
+        size_t      size;
+
+
+    public:
+
+        /**
+         *  Default constructor, creates an empty buffer.
+         */
+        inline
+        ScratchBuffer ( void )                          throw ()
+        {
+            buffer = 0;
+            size   = 0;
+        }
+
+        /**
+         *  Copy constructor, creates an empty buffer.
+         *
+         *  @param other the buffer to copy, its contents are not copied.
+         */
+        inline
+        ScratchBuffer ( const ScratchBuffer<T> &    other )     throw ()
+        {
+            buffer = 0;
+            size   = 0;
+        }
+
+        /**
+         *  Destructor.
+         */
+        inline
+        ~ScratchBuffer ( void )                         throw ()
+        {
+            delete[] buffer;
+        }
+
+        /**
+         *  Assignment operator. Keeps the buffer of this object.
+         *
+         *  @param other the buffer to assign, its contents are not copied.
+         *  @return a reference to this object.
+         */
+        inline ScratchBuffer<T> &
+        operator= ( const ScratchBuffer<T> &    other )     throw ()
+        {
+            return *this;
+        }
+
+        /**
+         *  Make sure the buffer can hold a number of elements.
+         *
+         *  @param size the number of elements needed.
+         *  @return the buffer, at least size elements long.
+         *  @exception Exception
+         */
+        inline T *
+        reserve ( size_t    size )
+        {
+            if ( size > this->size ) {
+                delete[] buffer;
+                buffer     = 0;
+                this->size = 0;
+                buffer     = new T[size];
+                this->size = size;
+            }
+
+            return buffer;
+        }
+
+        /**
+         *  Make sure the buffer can hold a number of elements, keeping
+         *  the ones already in it. The buffer at least doubles when it
+         *  grows, so that appending to it costs little.
+         *
+         *  @param size the number of elements needed.
+         *  @param used the number of elements in the buffer to keep.
+         *  @return the buffer, at least size elements long.
+         *  @exception Exception
+         */
+        inline T *
+        grow (  size_t    size,
+                size_t    used )
+        {
+            if ( size > this->size ) {
+                T         * buf;
+
+                if ( size < 2 * this->size ) {
+                    size = 2 * this->size;
+                }
+                buf = new T[size];
+                for ( size_t i = 0; i < used && i < this->size; ++i ) {
+                    buf[i] = buffer[i];
+                }
+                delete[] buffer;
+                buffer     = buf;
+                this->size = size;
+            }
+
+            return buffer;
+        }
+
+        /**
+         *  Get the buffer.
+         *
+         *  @return the buffer, or 0 if nothing was reserved yet.
+         */
+        inline T *
+        get ( void ) const                              throw ()
+        {
+            return buffer;
+        }
+
+        /**
+         *  Get the number of elements the buffer can hold.
+         *
+         *  @return the number of elements the buffer can hold.
+         */
+        inline size_t
+        getSize ( void ) const                          throw ()
+        {
+            return size;
+        }
+
+        /**
+         *  Free the buffer.
+         */
+        inline void
+        release ( void )                                throw ()
+        {
+            delete[] buffer;
+            buffer = 0;
+            size   = 0;
+        }
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* SCRATCH_BUFFER_H */
+
@@ -179,6 +179,9 @@ ShoutCast :: sendLogin ( void )
     sink->flush();
 
     /* read the anticipated response: "OK" */
+    if ( !source->canRead( loginTimeout, 0) ) {
+        return false;
+    }
     len = source->read( resp, STRBUF_SIZE);
     reportEvent(8, "server response length: ", len);
     reportEvent(8, "server response: ", resp);
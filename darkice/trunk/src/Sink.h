@@ -38,6 +38,7 @@
 
 #include "Referable.h"
 #include "Exception.h"
+#include "Packet.h"
 
 
 /* ================================================================ constants */
@@ -147,6 +148,68 @@ class Sink : public virtual Referable
         write (                 const void    * buf,
                                 unsigned int    len )    = 0;
 
+        /**
+         *  Write a packet of encoded data to the Sink. Sinks that keep
+         *  data for later keep a reference to the packet, instead of
+         *  copying the data. By default, the data of the packet is
+         *  simply written.
+         *
+         *  @param packet the packet to write.
+         *  @return the number of bytes written from the packet
+         *          (may be less than the size of the packet).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writePacket (           Packet        * packet )
+        {
+            return write( packet->getData(), packet->getSize());
+        }
+
+        /**
+         *  Write data again that the Sink has been given before, but
+         *  did not take all of, or is to send again on a reopened
+         *  connection. Sinks keeping all the data they are given, such
+         *  as a stream dump, keep it only once. By default, the data is
+         *  simply written.
+         *  @param buf the data to write.
+         *  @param len number of bytes to write from buf.
+         *  @return the number of bytes written (may be less than len).
+         *  @exception Exception
+         */
+        inline virtual unsigned int
+        writeAgain (            const void    * buf,
+                                unsigned int    len )
+        {
+            return write( buf, len);
+        }
+
+        /**
+         *  Tell the Sink the data the stream starts with, such as the
+         *  header pages of an Ogg stream, written to it just as any
+         *  other data. Sinks that start the stream over, on a reopened
+         *  connection or a new file after a cut, send it again first.
+         *  By default, it is not kept.
+         *  @param header the data the stream starts with,
+         *                or NULL if none.
+         */
+        inline virtual void
+        setHeader (             Packet        * header )
+        {
+        }
+
+        /**
+         *  Check if the Sink writes to a file only, with nobody listening
+         *  to the stream written to it, so that the stream may start
+         *  anew on a cut, just as the file. By default, false.
+         *  @return true if the Sink writes to a file only,
+         *          false otherwise.
+         */
+        inline virtual bool
+        isFile ( void ) const                           throw ()
+        {
+            return false;
+        }
+
         /**
          *  Flush all data that was written to the Sink to the underlying
          *  construct.
@@ -164,6 +227,34 @@ class Sink : public virtual Referable
         virtual void
         cut ( void )                                    throw () = 0;
 
+        /**
+         *  Cut at a known time, such as the rotation of a file. Sinks
+         *  saving to a file name the next one after that time.
+         *  By default, the same as cut().
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch,
+         *                  or 0 for a cut at no particular time, as cut().
+         */
+        inline virtual void
+        cutAt (                 double          boundary )  throw ()
+        {
+            cut();
+        }
+
+        /**
+         *  Get ready for a cut coming at a known time, such as the
+         *  rotation of a file, so that the cut itself costs little.
+         *  Sinks saving to a file may create the next one here, named
+         *  after the time of the cut. By default, nothing is done.
+         *
+         *  @param boundary the time of the cut to come,
+         *                  in seconds since the epoch.
+         */
+        inline virtual void
+        prepareCut (            double          boundary )  throw ()
+        {
+        }
+
         /**
          *  Close the Sink.
          *
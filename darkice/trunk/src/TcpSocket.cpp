@@ -75,6 +75,12 @@
 #error need unistd.h
 #endif
 
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#error need fcntl.h
+#endif
+
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #else
@@ -103,6 +109,11 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The number of seconds to wait for a server to accept a connection
+ *----------------------------------------------------------------------------*/
+static const unsigned int connectTimeout = 10;
+
 
 /* ===============================================  local function prototypes */
 
@@ -116,9 +127,11 @@ void
 TcpSocket :: init (   const char    * host,
                       unsigned short  port )          
 {
-    this->host   = Util::strDup( host);
-    this->port   = port;
-    this->sockfd = 0;
+    this->host      = Util::strDup( host);
+    this->port      = port;
+    this->sockfd    = 0;
+    this->bytesSent = 0;
+    this->conn      = 0;
 }
 
 
@@ -152,6 +165,7 @@ TcpSocket :: TcpSocket (  const TcpSocket &    ss )
     }
 
     sockfd = fd;
+    loop   = ss.loop;
 }
 
 
@@ -180,24 +194,104 @@ TcpSocket :: operator= (  const TcpSocket &    ss )
         }
 
         sockfd = fd;
+        loop   = ss.loop;
     }
 
     return *this;
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Create the socket and connect it, without blocking for long
+ *----------------------------------------------------------------------------*/
+int
+TcpSocket :: connectTo (    int                     family,
+                            const struct sockaddr * addr,
+                            socklen_t               addrlen )
+{
+    int                     optval;
+    socklen_t               optlen;
+    int                     flags;
+    int                     error;
+    fd_set                  fdset;
+    struct timespec         timespec;
+    sigset_t                sigset;
+
+    if ( (sockfd = socket( family, SOCK_STREAM,  IPPROTO_TCP)) == -1 ) {
+        error  = errno;
+        sockfd = 0;
+        return error;
+    }
+
+    // set TCP keep-alive
+    optval = 1;
+    optlen = sizeof(optval);
+    if (setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, &optval, optlen) == -1) {
+        reportEvent(5, "can't set TCP socket keep-alive mode", errno);
+    }
+
+    // a blocking connect to a server that drops our packets would only
+    // give up after minutes, so connect non-blocking, and wait for a while
+    flags = fcntl( sockfd, F_GETFL);
+    fcntl( sockfd, F_SETFL, flags | O_NONBLOCK);
+
+    error = 0;
+    if ( connect( sockfd, addr, addrlen) == -1 ) {
+        error = errno;
+    }
+
+    if ( error == EINPROGRESS ) {
+        FD_ZERO( &fdset);
+        FD_SET( sockfd, &fdset);
+
+        timespec.tv_sec  = connectTimeout;
+        timespec.tv_nsec = 0;
+
+        // mask out SIGUSR1, as we're expecting that signal for other reasons
+        sigemptyset(&sigset);
+        sigaddset(&sigset, SIGUSR1);
+
+        switch ( pselect( sockfd + 1, NULL, &fdset, NULL, &timespec, &sigset) ) {
+            case -1:
+                error = errno;
+                break;
+
+            case 0:
+                error = ETIMEDOUT;
+                break;
+
+            default:
+                optlen = sizeof(error);
+                if ( getsockopt( sockfd, SOL_SOCKET, SO_ERROR,
+                                 &error, &optlen) == -1 ) {
+                    error = errno;
+                }
+        }
+    }
+
+    if ( error ) {
+        ::close( sockfd);
+        sockfd = 0;
+        return error;
+    }
+
+    fcntl( sockfd, F_SETFL, flags);
+
+    return 0;
+}
+
+
 /*------------------------------------------------------------------------------
  *  Open the file
  *----------------------------------------------------------------------------*/
 bool
 TcpSocket :: open ( void )                       
 {
-    int                     optval;
-    socklen_t               optlen;
+    int                     error;
 #ifdef HAVE_GETADDRINFO
     struct addrinfo         hints;
+    struct addrinfo       * result;
     struct addrinfo       * ptr;
-    struct sockaddr_storage addr;
     char                    portstr[6];
 #else
     struct sockaddr_in      addr;
@@ -214,12 +308,25 @@ TcpSocket :: open ( void )
     hints.ai_family = AF_UNSPEC;
     snprintf(portstr, sizeof(portstr), "%d", port);
 
-    if (getaddrinfo(host , portstr, &hints, &ptr)) {
+    if ( (error = getaddrinfo(host , portstr, &hints, &result)) ) {
         sockfd = 0;
-        throw Exception( __FILE__, __LINE__, "getaddrinfo error", errno);
+        throw Exception( __FILE__, __LINE__, "getaddrinfo error",
+                         gai_strerror( error), 0);
     }
-    memcpy ( &addr, ptr->ai_addr, ptr->ai_addrlen);
-    freeaddrinfo(ptr);
+
+    // try all the addresses of the host, until one accepts
+    error = EAFNOSUPPORT;
+    for ( ptr = result; ptr; ptr = ptr->ai_next ) {
+        if ( ptr->ai_family != AF_INET && ptr->ai_family != AF_INET6 ) {
+            continue;
+        }
+        if ( !(error = connectTo( ptr->ai_family,
+                                  ptr->ai_addr,
+                                  ptr->ai_addrlen)) ) {
+            break;
+        }
+    }
+    freeaddrinfo(result);
 #else
     if ( !(pHostEntry = gethostbyname( host)) ) {
         sockfd = 0;
@@ -230,38 +337,12 @@ TcpSocket :: open ( void )
     addr.sin_family      = AF_INET;
     addr.sin_port        = htons(port);
     addr.sin_addr.s_addr = *((long*) pHostEntry->h_addr_list[0]);
-#endif
-
-    if ( (sockfd = socket( addr.ss_family, SOCK_STREAM,  IPPROTO_TCP)) == -1 ) {
-        sockfd = 0;
-        throw Exception( __FILE__, __LINE__, "socket error", errno);
-    }
-
-    // set TCP keep-alive
-    optval = 1;
-    optlen = sizeof(optval);
-    if (setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, &optval, optlen) == -1) {
-        reportEvent(5, "can't set TCP socket keep-alive mode", errno);
-    }
-
-    // connect
-    socklen_t addrlen;
-    switch (addr.ss_family) {
-        case AF_INET:
-            addrlen = sizeof(struct sockaddr_in);
-            break;
-        case AF_INET6:
-            addrlen = sizeof(struct sockaddr_in6);
-            break;
-        default:
-            throw Exception( __FILE__, __LINE__, "invalid address family", errno);
-    }
 
+    error = connectTo( AF_INET, (struct sockaddr *) &addr, sizeof(addr));
+#endif
 
-    if ( connect( sockfd, (struct sockaddr*)&addr, addrlen) == -1 ) {
-        ::close( sockfd);
-        sockfd = 0;
-        throw Exception( __FILE__, __LINE__, "connect error", errno);
+    if ( error ) {
+        throw Exception( __FILE__, __LINE__, "connect error", error);
     }
 
     return true;
@@ -297,6 +378,7 @@ TcpSocket :: canRead (      unsigned int    sec,
     ret = pselect( sockfd + 1, &fdset, NULL, NULL, &timespec, &sigset);
 
     if ( ret == -1 ) {
+        leaveLoop();
         ::close( sockfd);
         sockfd = 0;
         throw Exception( __FILE__, __LINE__, "select error");
@@ -323,14 +405,19 @@ TcpSocket :: read (     void          * buf,
 
     if ( ret == -1 ) {
         switch (errno) {
+            case EAGAIN:
+                // the socket is non-blocking when in a NetworkLoop
+                ret = 0;
+                break;
+
             case ECONNRESET:
-                // re-open the socket if it has been reset by the peer
+                // reset by the peer, whoever uses the socket reopens it
                 close();
-                Util::sleep(1L, 0L);
-                open();
+                ret = 0;
                 break;
 
             default:
+                leaveLoop();
                 ::close( sockfd);
                 sockfd = 0;
                 throw Exception( __FILE__, __LINE__, "recv error", errno);
@@ -357,6 +444,11 @@ TcpSocket :: canWrite (    unsigned int    sec,
         return false;
     }
 
+    if ( conn ) {
+        // no need to ask the socket, the loop takes care of that
+        return loop->canSend( conn, sec, usec);
+    }
+
     FD_ZERO( &fdset);
     FD_SET( sockfd, &fdset);
 
@@ -370,6 +462,7 @@ TcpSocket :: canWrite (    unsigned int    sec,
     ret = pselect( sockfd + 1, NULL, &fdset, NULL, &timespec, &sigset);
     
     if ( ret == -1 ) {
+        leaveLoop();
         ::close( sockfd);
         sockfd = 0;
         reportEvent(4,"TcpSocket :: canWrite, connection lost", errno);
@@ -392,6 +485,21 @@ TcpSocket :: write (    const void    * buf,
         return 0;
     }
 
+    if ( conn ) {
+        try {
+            ret = loop->send( conn, buf, len);
+        } catch ( Exception   & e ) {
+            leaveLoop();
+            ::close( sockfd);
+            sockfd = 0;
+            reportEvent(4,"TcpSocket :: write, send error", e.getCode());
+            throw;
+        }
+
+        // counted by the loop, as it is sent
+        return ret;
+    }
+
 #ifdef HAVE_MSG_NOSIGNAL
     ret = send( sockfd, buf, len, MSG_NOSIGNAL);
 #else
@@ -408,6 +516,7 @@ TcpSocket :: write (    const void    * buf,
             throw Exception( __FILE__, __LINE__, "send error", errno);
         }
     }
+    bytesSent += ret;
 
     return ret;
 }
@@ -424,8 +533,49 @@ TcpSocket :: close ( void )
     }
 
     flush();
+    leaveLoop();
     ::close( sockfd);
     sockfd = 0;
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Hand the connection over to the network loop
+ *----------------------------------------------------------------------------*/
+void
+TcpSocket :: enterLoop ( void )
+{
+    if ( !isOpen() || conn || !loop.get() ) {
+        return;
+    }
+
+    conn = loop->add( sockfd);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Take the connection back from the network loop
+ *----------------------------------------------------------------------------*/
+void
+TcpSocket :: leaveLoop ( void )
+{
+    if ( conn ) {
+        bytesSent += loop->remove( conn);
+        conn = 0;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Wait a while for the data queued to be sent
+ *----------------------------------------------------------------------------*/
+void
+TcpSocket :: flush ( void )
+{
+    if ( conn && !loop->drain( conn, 1) ) {
+        reportEvent( 4, "TcpSocket :: flush, data left unsent",
+                     conn->getQueued());
+    }
+}
+
+
@@ -36,9 +36,21 @@
 
 /* ============================================================ include files */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#else
+#error need sys/socket.h
+#endif
+
 #include "Source.h"
 #include "Sink.h"
 #include "Reporter.h"
+#include "Ref.h"
+#include "NetworkLoop.h"
 
 
 /* ================================================================ constants */
@@ -52,6 +64,9 @@
 /**
  *  A TCP network socket
  *
+ *  If a NetworkLoop is set, the socket can be handed over to it once
+ *  connected, after which writes are queued and sent by the loop.
+ *
  *  @author  $Author$
  *  @version $Revision$
  */
@@ -73,6 +88,42 @@ class TcpSocket : public Source, public Sink, public virtual Reporter
          *  Low-level socket descriptor.
          */
         int                 sockfd;
+
+        /**
+         *  The number of bytes sent through this socket so far, not
+         *  counting those of the connection in the loop, if any.
+         */
+        unsigned long       bytesSent;
+
+        /**
+         *  The loop to hand the connection over to, if any.
+         */
+        Ref<NetworkLoop>    loop;
+
+        /**
+         *  The connection in the loop, or 0 if not handed over.
+         */
+        NetworkLoop::Connection   * conn;
+
+        /**
+         *  Take the connection back from the loop, if handed over.
+         */
+        void
+        leaveLoop ( void );
+
+        /**
+         *  Create the socket and connect it to an address, giving up
+         *  after a while if the server does not answer.
+         *
+         *  @param family the address family of addr.
+         *  @param addr the address to connect to.
+         *  @param addrlen the length of addr.
+         *  @return 0 if connected, the error code otherwise.
+         */
+        int
+        connectTo ( int                     family,
+                    const struct sockaddr * addr,
+                    socklen_t               addrlen );
         
         /**
          *  Initialize the object.
@@ -175,6 +226,54 @@ class TcpSocket : public Source, public Sink, public virtual Reporter
             return port;
         }
 
+        /**
+         *  Get the number of bytes sent through this socket so far,
+         *  over all the connections made.
+         *
+         *  @return the number of bytes sent.
+         */
+        inline unsigned long
+        getBytesSent ( void ) const                 throw ()
+        {
+            return bytesSent + (conn ? conn->getSent() : 0);
+        }
+
+        /**
+         *  Set the loop to send the data with, once the connection
+         *  is handed over.
+         *
+         *  @param loop the loop, or 0 to always send directly.
+         */
+        inline void
+        setNetworkLoop ( NetworkLoop  * loop )
+        {
+            this->loop = loop;
+        }
+
+        /**
+         *  Hand the open connection over to the NetworkLoop, if one is
+         *  set. From then on the socket is non-blocking, writes are
+         *  queued and are sent by the loop. Call this when the
+         *  connection is established, and nothing needs to be read
+         *  from it any more.
+         *
+         *  @exception Exception
+         */
+        void
+        enterLoop ( void );
+
+        /**
+         *  Get the number of bytes waiting in the queue of the
+         *  NetworkLoop to be sent.
+         *
+         *  @return the number of bytes queued.
+         */
+        inline unsigned int
+        getQueued ( void ) const                    throw ()
+        {
+            return conn ? conn->getQueued() : 0;
+        }
+
         /**
          *  Open the TcpSocket.
          *
@@ -250,14 +349,13 @@ class TcpSocket : public Source, public Sink, public virtual Reporter
 
         /**
          *  Flush all data that was written to the TcpSocket to the underlying
-         *  connection.
+         *  connection. When handed over to a NetworkLoop, waits a while
+         *  for the queue to be sent.
          *
          *  @exception Exception
          */
-        inline virtual void
-        flush ( void )                              
-        {
-        }
+        virtual void
+        flush ( void )                              ;
 
         /**
          *  Cut what the sink has been doing so far, and start anew.
@@ -0,0 +1,227 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : TimeSummary.cpp
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
+#ifdef HAVE_TIME_H
+#include <time.h>
+#else
+#error need time.h
+#endif
+
+#include <algorithm>
+
+#include "TimeSummary.h"
+
+
+/* ===================================================  local data structures */
+
+
+/* ================================================  local constants & macros */
+
+/*------------------------------------------------------------------------------
+ *  File identity
+ *----------------------------------------------------------------------------*/
+static const char fileid[] = "$Id$";
+
+
+/* ===============================================  local function prototypes */
+
+
+/* =============================================================  module code */
+
+/*------------------------------------------------------------------------------
+ *  Constructor
+ *----------------------------------------------------------------------------*/
+TimeSummary :: TimeSummary ( void )
+{
+    pthread_mutex_init( &mutex, 0);
+    count = 0;
+    sum   = 0.0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Copy constructor
+ *----------------------------------------------------------------------------*/
+TimeSummary :: TimeSummary ( const TimeSummary    & summary )
+{
+    pthread_mutex_init( &mutex, 0);
+    copy( summary);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Destructor
+ *----------------------------------------------------------------------------*/
+TimeSummary :: ~TimeSummary ( void )
+{
+    pthread_mutex_destroy( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Assignment operator
+ *----------------------------------------------------------------------------*/
+TimeSummary &
+TimeSummary :: operator= ( const TimeSummary  & summary )
+{
+    if ( this != &summary ) {
+        copy( summary);
+    }
+
+    return *this;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Copy the statistics of another object
+ *----------------------------------------------------------------------------*/
+void
+TimeSummary :: copy ( const TimeSummary   & summary )
+{
+    float           w[windowSize];
+    unsigned long   c;
+    double          s;
+
+    pthread_mutex_lock( &summary.mutex);
+    memcpy( w, summary.window, sizeof(w));
+    c = summary.count;
+    s = summary.sum;
+    pthread_mutex_unlock( &summary.mutex);
+
+    pthread_mutex_lock( &mutex);
+    memcpy( window, w, sizeof(w));
+    count = c;
+    sum   = s;
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Add a measurement
+ *----------------------------------------------------------------------------*/
+void
+TimeSummary :: add ( double     seconds )
+{
+    pthread_mutex_lock( &mutex);
+    window[count % windowSize] = (float) seconds;
+    ++count;
+    sum += seconds;
+    pthread_mutex_unlock( &mutex);
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the number of all measurements
+ *----------------------------------------------------------------------------*/
+unsigned long
+TimeSummary :: getCount ( void ) const
+{
+    unsigned long   c;
+
+    pthread_mutex_lock( &mutex);
+    c = count;
+    pthread_mutex_unlock( &mutex);
+
+    return c;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the sum of all measurements
+ *----------------------------------------------------------------------------*/
+double
+TimeSummary :: getSum ( void ) const
+{
+    double          s;
+
+    pthread_mutex_lock( &mutex);
+    s = sum;
+    pthread_mutex_unlock( &mutex);
+
+    return s;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get quantiles of the recent measurements
+ *----------------------------------------------------------------------------*/
+void
+TimeSummary :: getQuantiles (   const double      * quantiles,
+                                double            * values,
+                                unsigned int        n ) const
+{
+    float           w[windowSize];
+    unsigned int    size;
+
+    // sort a copy, so that the measuring thread is not held up
+    pthread_mutex_lock( &mutex);
+    size = count < windowSize ? (unsigned int) count : windowSize;
+    memcpy( w, window, size * sizeof(float));
+    pthread_mutex_unlock( &mutex);
+
+    std::sort( w, w + size);
+
+    for ( unsigned int i = 0; i < n; ++i ) {
+        unsigned int    ix;
+
+        if ( size == 0 ) {
+            values[i] = 0.0;
+            continue;
+        }
+        ix = (unsigned int) (quantiles[i] * (size - 1) + 0.5);
+        values[i] = w[ix < size ? ix : size - 1];
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Get the time of a monotonic clock
+ *----------------------------------------------------------------------------*/
+double
+TimeSummary :: now ( void )
+{
+    struct timespec     ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
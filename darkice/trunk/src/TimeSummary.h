@@ -0,0 +1,190 @@
+/*------------------------------------------------------------------------------
+
+   Copyright (c) 2000-2007 Tyrell Corporation. All rights reserved.
+
+   Tyrell DarkIce
+
+   File     : TimeSummary.h
+   Version  : $Revision$
+   Author   : $Author$
+   Location : $HeadURL$
+
+   Copyright notice:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+------------------------------------------------------------------------------*/
+#ifndef TIME_SUMMARY_H
+#define TIME_SUMMARY_H
+
+#ifndef __cplusplus
+#error This is a C++ include file
+#endif
+
+
+/* ============================================================ include files */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#else
+#error need pthread.h
+#endif
+
+
+/* ================================================================ constants */
+
+
+/* =================================================================== macros */
+
+
+/* =============================================================== data types */
+
+/**
+ *  Statistics of a repeatedly measured duration: the number and the sum
+ *  of all the measurements, and quantiles over the most recent ones.
+ *
+ *  One thread adds the measurements, while any other thread may read
+ *  the statistics.
+ *
+ *  @author  $Author$
+ *  @version $Revision$
+ */
+class TimeSummary
+{
+    private:
+
+        /**
+         *  The number of recent measurements the quantiles are
+         *  calculated from.
+         */
+        static const unsigned int   windowSize = 1024;
+
+        /**
+         *  The recent measurements, in seconds.
+         */
+        float                       window[windowSize];
+
+        /**
+         *  The number of all measurements.
+         */
+        unsigned long               count;
+
+        /**
+         *  The sum of all measurements, in seconds.
+         */
+        double                      sum;
+
+        /**
+         *  Mutex guarding the statistics.
+         */
+        mutable pthread_mutex_t     mutex;
+
+        /**
+         *  Copy the statistics of another object.
+         *
+         *  @param summary the object to copy from.
+         */
+        void
+        copy ( const TimeSummary  & summary );
+
+
+    public:
+
+        /**
+         *  Default constructor.
+         */
+        TimeSummary ( void );
+
+        /**
+         *  Copy constructor.
+         *
+         *  @param summary the object to copy.
+         */
+        TimeSummary ( const TimeSummary   & summary );
+
+        /**
+         *  Destructor.
+         */
+        ~TimeSummary ( void );
+
+        /**
+         *  Assignment operator.
+         *
+         *  @param summary the object to assign to this one.
+         *  @return a reference to this object.
+         */
+        TimeSummary &
+        operator= ( const TimeSummary & summary );
+
+        /**
+         *  Add a measurement.
+         *
+         *  @param seconds the measured duration.
+         */
+        void
+        add ( double    seconds );
+
+        /**
+         *  Get the number of all measurements.
+         *
+         *  @return the number of all measurements.
+         */
+        unsigned long
+        getCount ( void ) const;
+
+        /**
+         *  Get the sum of all measurements.
+         *
+         *  @return the sum of all measurements, in seconds.
+         */
+        double
+        getSum ( void ) const;
+
+        /**
+         *  Get quantiles of the recent measurements.
+         *
+         *  @param quantiles the quantiles to get, each between 0 and 1.
+         *  @param values put the quantiles here, in seconds,
+         *                0 if there are no measurements yet.
+         *  @param n the number of quantiles.
+         */
+        void
+        getQuantiles (  const double      * quantiles,
+                        double            * values,
+                        unsigned int        n ) const;
+
+        /**
+         *  Get the time of a monotonic clock, to measure durations with.
+         *
+         *  @return the time in seconds, from an unspecified starting point.
+         */
+        static double
+        now ( void );
+};
+
+
+/* ================================================= external data structures */
+
+
+/* ====================================================== function prototypes */
+
+
+
+#endif  /* TIME_SUMMARY_H */
+
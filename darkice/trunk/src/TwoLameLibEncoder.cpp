@@ -69,7 +69,8 @@ TwoLameLibEncoder :: init ( void )
 {
 	this->twolame_opts    = NULL;
 
-	if ( getInBitsPerSample() != 16 ) {
+	if ( !isInFloat() && getInBitsPerSample() != 16
+	  && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
 		throw Exception( __FILE__, __LINE__,
 						 "specified bits per sample not supported",
 						 getInBitsPerSample() );
@@ -172,7 +173,10 @@ TwoLameLibEncoder :: open ( void )
 	if (getReportVerbosity() >= 3) {
     	twolame_print_config( twolame_opts);
 	}
-	
+
+    // enough for flushing, grows on the first write
+    mp2Buffer.reserve( 7200);
+
     return true;
 }
 
@@ -188,58 +192,43 @@ TwoLameLibEncoder :: write (   const void    * buf,
         return 0;
     }
 
-    unsigned int    bitsPerSample = getInBitsPerSample();
-    unsigned int    inChannels    = getInChannel();
-
-    unsigned int    sampleSize = (bitsPerSample / 8) * inChannels;
-    unsigned char * b = (unsigned char*) buf;
-    unsigned int    processed = len - (len % sampleSize);
-    unsigned int    nSamples = processed / sampleSize;
-    short int     * leftBuffer  = new short int[nSamples];
-    short int     * rightBuffer = new short int[nSamples];
-
-    if ( bitsPerSample == 8 ) {
-        Util::conv8( b, processed, leftBuffer, rightBuffer, inChannels);
-    } else if ( bitsPerSample == 16 ) {
-        Util::conv16( b,
-                      processed,
-                      leftBuffer,
-                      rightBuffer,
-                      inChannels,
-                      isInBigEndian());
-    } else {
-        delete[] leftBuffer;
-        delete[] rightBuffer;
-        throw Exception( __FILE__, __LINE__,
-                        "unsupported number of bits per sample for the encoder",
-                         bitsPerSample );
+    return writeFrame( toFrame( buf, len));
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+TwoLameLibEncoder :: writeFrame (  const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
     }
 
+    unsigned int    inChannels = getInChannel();
+    unsigned int    nSamples   = frame->getSamples();
+
     // data chunk size estimate according to TwoLAME documentation
     // NOTE: mp2Size is calculated based on the number of input channels
     //       which may be bigger than need, as output channels can be less
     unsigned int    mp2Size = (unsigned int) (1.25 * nSamples + 7200);
-    unsigned char * mp2Buf  = new unsigned char[mp2Size];
+    unsigned char * mp2Buf  = mp2Buffer.reserve( mp2Size);
     int             ret;
 
     ret = twolame_encode_buffer( twolame_opts,
-                              leftBuffer,
-                              inChannels == 2 ? rightBuffer : leftBuffer,
+                              frame->getShort( 0),
+                              frame->getShort( inChannels == 2 ? 1 : 0),
                               nSamples,
                               mp2Buf,
                               mp2Size );
 
-    delete[] leftBuffer;
-    delete[] rightBuffer;
-
     if ( ret < 0 ) {
         reportEvent( 3, "TwoLAME encoding error", ret);
-        delete[] mp2Buf;
         return 0;
     }
 
     unsigned int    written = getSink()->write( mp2Buf, ret);
-    delete[] mp2Buf;
     // just let go data that could not be written
     if ( written < (unsigned int) ret ) {
         reportEvent( 2,
@@ -247,7 +236,7 @@ TwoLameLibEncoder :: write (   const void    * buf,
                      ret - written);
     }
 
-    return processed;
+    return frame->getSize();
 }
 
 
@@ -264,13 +253,12 @@ TwoLameLibEncoder :: flush ( void )
 
     // data chunk size estimate according to TwoLAME documentation
     unsigned int    mp2Size = 7200;
-    unsigned char * mp2Buf  = new unsigned char[mp2Size];
+    unsigned char * mp2Buf  = mp2Buffer.reserve( mp2Size);
     int             ret;
 
     ret = twolame_encode_flush( twolame_opts, mp2Buf, mp2Size );
 
     unsigned int    written = getSink()->write( mp2Buf, ret);
-    delete[] mp2Buf;
 
     // just let go data that could not be written
     if ( written < (unsigned int) ret ) {
@@ -51,6 +51,7 @@
 #include "Exception.h"
 #include "Reporter.h"
 #include "AudioEncoder.h"
+#include "ScratchBuffer.h"
 #include "Sink.h"
 
 
@@ -78,6 +79,11 @@ class TwoLameLibEncoder : public AudioEncoder, public virtual Reporter
          */
         twolame_options             * twolame_opts;
 
+        /**
+         *  Buffer for the encoded mp2 data, kept between writes.
+         */
+        ScratchBuffer<unsigned char>  mp2Buffer;
+
         /**
          *  Initialize the object.
          *
@@ -168,6 +174,8 @@ class TwoLameLibEncoder : public AudioEncoder, public virtual Reporter
          *                       If 0, input sample rate is used.
          *  @param outChannel number of channels of the output.
          *                    If 0, input channel is used.
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them.
          *  @exception Exception
          */
         inline
@@ -176,7 +184,8 @@ class TwoLameLibEncoder : public AudioEncoder, public virtual Reporter
                             BitrateMode             outBitrateMode,
                             unsigned int            outBitrate,
                             unsigned int            outSampleRate = 0,
-                            unsigned int            outChannel    = 0 )
+                            unsigned int            outChannel    = 0,
+                            ChannelMap            * channelMap    = 0 )
                                                             
             
                     : AudioEncoder ( sink,
@@ -185,7 +194,8 @@ class TwoLameLibEncoder : public AudioEncoder, public virtual Reporter
                                      outBitrate,
                                      0.0f,  // outQuality
                                      outSampleRate,
-                                     outChannel )
+                                     outChannel,
+                                     channelMap )
         {
             init();
         }
@@ -338,6 +348,17 @@ class TwoLameLibEncoder : public AudioEncoder, public virtual Reporter
         write (        const void    * buf,
                        unsigned int    len )        ;
 
+        /**
+         *  Write a frame of audio to the encoder, using the already
+         *  converted samples of the frame.
+         *
+         *  @param frame the audio to encode.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        virtual unsigned int
+        writeFrame (   const AudioFrame    * frame )        ;
+
         /**
          *  Flush all data that was written to the encoder to the underlying
          *  connection.
@@ -91,6 +91,7 @@
 #include <errno.h>
 #endif
 
+#include "SampleConv.h"
 #include "Util.h"
 
 
@@ -302,21 +303,28 @@ Util :: strToD( const char    * str )
  *----------------------------------------------------------------------------*/
 char *
 Util :: fileAddDate ( const char * str,
-                      const char * format )             
+                      const char * format,
+                      time_t       when )
 {
     unsigned int    size;
     const char          * last; 
     char          * s;
     char          * strdate;
-    time_t          now;
+    struct tm       tm;
 
     if ( !str ) {
         throw Exception( __FILE__, __LINE__, "no str");
     }
 
     strdate = new char[128];
-    now     = time(NULL);    
-    strftime( strdate, 128, format, localtime (&now));
+    if ( !format ) {
+        format = "[%m-%d-%Y-%H-%M-%S]";
+    }
+    if ( !when ) {
+        when = time(NULL);
+    }
+    localtime_r( &when, &tm);
+    strftime( strdate, 128, format, &tm);
 
     // search for the part before the extension of the file name
     if ( !(last = strrchr( str, '.')) ) {
@@ -355,6 +363,19 @@ Util :: conv (  unsigned int        bitsPerSample,
             outBuffer[j] = pcmBuffer[i++];
             ++j;
         }
+    } else if ( bitsPerSample == 16 && sizeof(T) == sizeof(int16_t) ) {
+        size_t          samples = lenPcmBuffer / 2;
+        int16_t       * out     = (int16_t *) outBuffer;
+
+#ifdef WORDS_BIGENDIAN
+        if ( !isBigEndian ) {
+#else
+        if ( isBigEndian ) {
+#endif
+            SampleConv::swapShort( (int16_t *) pcmBuffer, samples, out);
+        } else {
+            memcpy( out, pcmBuffer, samples * sizeof(int16_t));
+        }
     } else if ( bitsPerSample == 16 ) {
 
         if ( isBigEndian ) {
@@ -456,59 +477,25 @@ Util :: conv16 (    unsigned char     * pcmBuffer,
                     unsigned int        channels,
                     bool                isBigEndian )
 {
-    if ( isBigEndian ) {
-        if ( channels == 1 ) {
-            unsigned int    i, j;
+    int16_t       * buffers[2] = { leftBuffer, rightBuffer };
 
-            for ( i = 0, j = 0; i < lenPcmBuffer; ) {
-                int16_t           value;
+    // anything but mono is taken as stereo
+    channels = channels == 1 ? 1 : 2;
 
-                value           = pcmBuffer[i++] << 8;
-                value          |= pcmBuffer[i++];
-                leftBuffer[j]  =  value;
-                ++j;
-            }
-        } else {
-            unsigned int    i, j;
+    size_t          samples    = lenPcmBuffer / 2 / channels;
 
-            for ( i = 0, j = 0; i < lenPcmBuffer; ) {
-                int16_t           value;
-
-                value           = pcmBuffer[i++] << 8;
-                value          |= pcmBuffer[i++];
-                leftBuffer[j]   = value;
-                value           = pcmBuffer[i++] << 8;
-                value          |= pcmBuffer[i++];
-                rightBuffer[j]  = value;
-                ++j;
-            }
-        }
-    } else {
-        if ( channels == 1 ) {
-            unsigned int    i, j;
-
-            for ( i = 0, j = 0; i < lenPcmBuffer; ) {
-                int16_t          value;
+    SampleConv::deinterleaveShort( (int16_t *) pcmBuffer,
+                                   samples,
+                                   buffers,
+                                   channels);
 
-                value          = pcmBuffer[i++];
-                value         |= pcmBuffer[i++] << 8;
-                leftBuffer[j]  = value;
-                ++j;
-            }
-        } else {
-            unsigned int    i, j;
-
-            for ( i = 0, j = 0; i < lenPcmBuffer; ) {
-                int16_t           value;
-
-                value           = pcmBuffer[i++];
-                value          |= pcmBuffer[i++] << 8;
-                leftBuffer[j]   = value;
-                value           = pcmBuffer[i++];
-                value          |= pcmBuffer[i++] << 8;
-                rightBuffer[j]  = value;
-                ++j;
-            }
+#ifdef WORDS_BIGENDIAN
+    if ( !isBigEndian ) {
+#else
+    if ( isBigEndian ) {
+#endif
+        for ( unsigned int c = 0; c < channels; ++c ) {
+            SampleConv::swapShort( buffers[c], samples, buffers[c]);
         }
     }
 }
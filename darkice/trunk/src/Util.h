@@ -36,6 +36,16 @@
 
 /* ============================================================ include files */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#else
+#error need sys/types.h
+#endif
+
 #include "Exception.h"
 
 
@@ -206,6 +216,10 @@ class Util
          *  Add current date to a file name, before the file extension (if any)
          *
          *  @param str the string to convert (file name).
+         *  @param format the strftime() format of the date, or NULL for
+         *                "[%m-%d-%Y-%H-%M-%S]".
+         *  @param when the date to add, in seconds since the epoch,
+         *              or 0 for the current date.
          *  @return the new string with the date appended before 
          *          extension of the file name. the string has to be
          *          deleted with delete[] after it is not needed
@@ -213,7 +227,8 @@ class Util
          */
         static char *
         fileAddDate ( const char * str,
-                      const char * format = "[%m-%d-%Y-%H-%M-%S]" )
+                      const char * format = 0,
+                      time_t       when   = 0 )
                                                         ;
 
         /**
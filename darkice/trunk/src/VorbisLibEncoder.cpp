@@ -36,6 +36,12 @@
 // compile only if configured for Ogg Vorbis
 #ifdef HAVE_VORBIS_LIB
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error need string.h
+#endif
+
 
 #include "Exception.h"
 #include "Util.h"
@@ -52,6 +58,19 @@
  *----------------------------------------------------------------------------*/
 static const char fileid[] = "$Id$";
 
+/*------------------------------------------------------------------------------
+ *  The most page body to ask libogg for when the page duration is set,
+ *  which is as much as a page can hold, so that the duration decides
+ *  alone
+ *----------------------------------------------------------------------------*/
+static const int    maxPageFill = 255 * 255;
+
+/*------------------------------------------------------------------------------
+ *  The number of packets the pages are sent in, beyond which packets
+ *  are allocated
+ *----------------------------------------------------------------------------*/
+static const unsigned int maxPooledPackets = 256;
+
 
 /* ===============================================  local function prototypes */
 
@@ -62,12 +81,21 @@ static const char fileid[] = "$Id$";
  *  Initialize the encoder
  *----------------------------------------------------------------------------*/
 void
-VorbisLibEncoder :: init ( unsigned int     outMaxBitrate )
+VorbisLibEncoder :: init ( unsigned int     outMaxBitrate,
+                           unsigned int     pipelineDepth,
+                           unsigned int     pageDuration )
                                                             
 {
     this->outMaxBitrate = outMaxBitrate;
-
-    if ( getInBitsPerSample() != 16 && getInBitsPerSample() != 8 ) {
+    this->pipelineDepth = pipelineDepth;
+    this->pageDuration  = pageDuration;
+    this->pageSamples   = 0;
+    this->pageGranule   = 0;
+    this->pageBufferLen = 0;
+
+    if ( !isInFloat()
+      && getInBitsPerSample() != 16 && getInBitsPerSample() != 8
+      && getInBitsPerSample() != 24 && getInBitsPerSample() != 32 ) {
         throw Exception( __FILE__, __LINE__,
                          "specified bits per sample not supported",
                          getInBitsPerSample() );
@@ -88,56 +116,12 @@ VorbisLibEncoder :: init ( unsigned int     outMaxBitrate )
         
     }
 
-    if ( getOutSampleRate() == getInSampleRate() ) {
-        resampleRatio = 1;
-        converter     = 0;
-    } else {
-        resampleRatio = ( (double) getOutSampleRate() /
-                          (double) getInSampleRate() );
-
-        // Determine if we can use linear interpolation.
-        // The inverse of the ratio must be a power of two for linear mode to
-        // be of sufficient quality.
-        
-        bool    useLinear = true;
-        double  inverse   = 1 / resampleRatio;
-        int     integer   = (int) inverse;
-
-        // Check that the inverse of the ratio is an integer
-        if( integer == inverse ) {
-            while( useLinear && integer ) { // Loop through the bits
-                // If the lowest order bit is not the only one set
-                if( integer & 1 && integer != 1 ) {
-                    // Not a power of two; cannot use linear
-                    useLinear = false;
-                } else {
-                    // Shift all the bits over and try again
-                    integer >>= 1;
-                }
-            }
-        } else {
-           useLinear = false;
-        }
-
-        // If we get here and useLinear is still true, then we have
-        // a power of two.
-           
-        // open the aflibConverter in
-        // - high quality
-        // - linear or quadratic (non-linear) based on algorithm
-        // - not filter interpolation
-#ifdef HAVE_SRC_LIB
-        int srcError = 0;
-        converter = src_new(useLinear == true ? SRC_LINEAR : SRC_SINC_FASTEST,
-                            getInChannel(), &srcError);
-        if(srcError)
-            throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-#else
-        converter = new aflibConverter( true, useLinear, false);
-#endif
-    }
-
     encoderOpen = false;
+    codecLink   = 0;
+    muxLink     = 0;
+    spareLink   = 0;
+    restarting  = false;
+    pool        = new PacketPool( maxPooledPackets);
 }
 
 
@@ -148,8 +132,6 @@ bool
 VorbisLibEncoder :: open ( void )
                                                             
 {
-    int     ret;
-
     if ( isOpen() ) {
         close();
     }
@@ -160,7 +142,40 @@ VorbisLibEncoder :: open ( void )
                          "vorbis lib opening underlying sink error");
     }
 
-    vorbis_info_init( &vorbisInfo);
+    // the first logical stream is started just as the ones after a cut
+    streamSerial  = 0;
+    pageBufferLen = 0;
+    codecNext();
+    muxNext();
+    pagesWrite( true);
+
+    pageSamples = (ogg_int64_t) pageDuration * getOutSampleRate() / 1000;
+
+    // from now on the codec state belongs to the codec thread, if any
+    if ( pipelineDepth ) {
+        pipeline = new EncoderPipeline( this, pipelineDepth);
+        pipeline->start();
+    }
+
+    encoderOpen = true;
+
+    return true;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Make a logical stream
+ *----------------------------------------------------------------------------*/
+VorbisLibEncoder :: Link *
+VorbisLibEncoder :: linkCreate ( void )
+{
+    Link          * link = new Link;
+    vorbis_info   * info = &link->vorbisInfo;
+    int             ret  = 0;
+
+    // all cleared, so that it can be let go of when half made
+    memset( link, 0, sizeof(Link));
+    vorbis_info_init( info);
 
     switch ( getOutBitrateMode() ) {
 
@@ -169,57 +184,56 @@ VorbisLibEncoder :: open ( void )
                 if ( !maxBitrate ) {
                     maxBitrate = -1;
                 }
-                if ( (ret = vorbis_encode_init( &vorbisInfo,
-                                                getOutChannel(),
-                                                getOutSampleRate(),
-                                                maxBitrate,
-                                                getOutBitrate() * 1000,
-                                                -1)) ) {
-                    throw Exception( __FILE__, __LINE__,
-                                     "vorbis encode init error", ret);
-                }
+                ret = vorbis_encode_init( info,
+                                          getOutChannel(),
+                                          getOutSampleRate(),
+                                          maxBitrate,
+                                          getOutBitrate() * 1000,
+                                          -1);
             } break;
 
         case abr:
             /* set non-managed VBR around the average bitrate */
-            ret = vorbis_encode_setup_managed( &vorbisInfo,
+            ret = vorbis_encode_setup_managed( info,
                                                getOutChannel(),
                                                getOutSampleRate(),
                                                -1,
                                                getOutBitrate() * 1000,
                                                -1 )
-               || vorbis_encode_ctl( &vorbisInfo, OV_ECTL_RATEMANAGE_SET, NULL)
-               || vorbis_encode_setup_init( &vorbisInfo);
-            if ( ret ) {
-                throw Exception( __FILE__, __LINE__,
-                                 "vorbis encode init error", ret);
-            }
+               || vorbis_encode_ctl( info, OV_ECTL_RATEMANAGE_SET, NULL)
+               || vorbis_encode_setup_init( info);
             break;
 
         case vbr:
-            if ( (ret = vorbis_encode_init_vbr( &vorbisInfo,
-                                                getOutChannel(),
-                                                getOutSampleRate(),
-                                                getOutQuality() )) ) {
-                throw Exception( __FILE__, __LINE__,
-                                 "vorbis encode init error", ret);
-            }
+            ret = vorbis_encode_init_vbr( info,
+                                          getOutChannel(),
+                                          getOutSampleRate(),
+                                          getOutQuality() );
             break;
     }
+    if ( ret ) {
+        linkDelete( link);
+        throw Exception( __FILE__, __LINE__, "vorbis encode init error", ret);
+    }
 
-    if ( (ret = vorbis_analysis_init( &vorbisDspState, &vorbisInfo)) ) {
+    if ( (ret = vorbis_analysis_init( &link->vorbisDspState, info)) ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "vorbis analysis init error", ret);
     }
 
-    if ( (ret = vorbis_block_init( &vorbisDspState, &vorbisBlock)) ) {
+    if ( (ret = vorbis_block_init( &link->vorbisDspState,
+                                   &link->vorbisBlock)) ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "vorbis block init error", ret);
     }
 
-    if ( (ret = ogg_stream_init( &oggStreamState, 0)) ) {
+    if ( (ret = ogg_stream_init( &link->oggStreamState, streamSerial++)) ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "ogg stream init error", ret);
     }
 
     // create an empty vorbis_comment structure
+    vorbis_comment  vorbisComment;
     vorbis_comment_init( &vorbisComment);
     /* FIXME: removed title metadata when the sink type was changed from
      *        CastSink to the more generic Sink.
@@ -233,48 +247,75 @@ VorbisLibEncoder :: open ( void )
     }
     */
 
-    // create the vorbis stream headers and send them to the underlying sink
+    // create the vorbis stream headers, to be sent when the stream starts
     ogg_packet      header;
     ogg_packet      commentHeader;
     ogg_packet      codeHeader;
 
-    if ( (ret = vorbis_analysis_headerout( &vorbisDspState,
-                                           &vorbisComment,
-                                           &header,
-                                           &commentHeader,
-                                           &codeHeader )) ) {
+    ret = vorbis_analysis_headerout( &link->vorbisDspState,
+                                     &vorbisComment,
+                                     &header,
+                                     &commentHeader,
+                                     &codeHeader );
+    vorbis_comment_clear( &vorbisComment);
+    if ( ret ) {
+        linkDelete( link);
         throw Exception( __FILE__, __LINE__, "vorbis header init error", ret);
     }
 
-    ogg_stream_packetin( &oggStreamState, &header);
-    ogg_stream_packetin( &oggStreamState, &commentHeader);
-    ogg_stream_packetin( &oggStreamState, &codeHeader);
+    ogg_stream_packetin( &link->oggStreamState, &header);
+    ogg_stream_packetin( &link->oggStreamState, &commentHeader);
+    ogg_stream_packetin( &link->oggStreamState, &codeHeader);
 
-    ogg_page        oggPage;
-    while ( ogg_stream_flush( &oggStreamState, &oggPage) ) {
-        getSink()->write( oggPage.header, oggPage.header_len);
-        getSink()->write( oggPage.body, oggPage.body_len);
-    }
-
-    vorbis_comment_clear( &vorbisComment );
-
-    // initialize the resampling coverter if needed
-    if ( converter ) {
-#ifdef HAVE_SRC_LIB
-        converterData.input_frames   = 4096/((getInBitsPerSample() / 8) * getInChannel());
-        converterData.data_in        = new float[converterData.input_frames*getInChannel()];
-        converterData.output_frames  = (int) (converterData.input_frames * resampleRatio + 1);
-        converterData.data_out       = new float[getInChannel() * converterData.output_frames];
-        converterData.src_ratio      = resampleRatio;
-        converterData.end_of_input   = 0;
-#else
-        converter->initialize( resampleRatio, getInChannel());
-#endif
+    return link;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Let go of a logical stream
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: linkDelete (    Link      * link )
+{
+    if ( !link ) {
+        return;
     }
 
-    encoderOpen = true;
+    ogg_stream_clear( &link->oggStreamState);
+    vorbis_block_clear( &link->vorbisBlock);
+    vorbis_dsp_clear( &link->vorbisDspState);
+    vorbis_info_clear( &link->vorbisInfo);
+    delete link;
+}
 
-    return true;
+
+/*------------------------------------------------------------------------------
+ *  Have the codec encode into the next logical stream
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: codecNext ( void )
+{
+    // the previous logical stream is let go by the muxer, see muxNext()
+    codecLink = spareLink ? spareLink : linkCreate();
+    spareLink = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Mux into the logical stream of the codec
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: muxNext ( void )
+{
+    ogg_page        oggPage;
+
+    linkDelete( muxLink);
+    muxLink     = codecLink;
+    pageGranule = 0;
+
+    while ( ogg_stream_flush( &muxLink->oggStreamState, &oggPage) ) {
+        pageCollect( &oggPage);
+    }
 }
 
 
@@ -289,91 +330,129 @@ VorbisLibEncoder :: write ( const void    * buf,
         return 0;
     }
 
-    unsigned int    channels      = getInChannel();
-    unsigned int    bitsPerSample = getInBitsPerSample();
-    unsigned int    sampleSize = (bitsPerSample / 8) * channels;
+    return writeFrame( toFrame( buf, len));
+}
 
-    unsigned int i;
 
-    if ( getInChannel() == 2 && getOutChannel() == 1 ) {
-        for ( i = 0; i < len/sampleSize; i++) {
-            if ( bitsPerSample == 8 ) {
-                char          * buf8 = (char *) buf;
-                unsigned int    ix   = sampleSize * i;
-                unsigned int    iix  = ix;
-                buf8[i] = (buf8[ix] + buf8[++iix]) / 2;
-            }
-            if ( bitsPerSample == 16 ) {
-                short         * buf16 = (short *) buf;
-                unsigned int    ix    = (bitsPerSample >> 3) * i;
-                unsigned int    iix   = ix;
-                buf16[i] = (buf16[ix] + buf16[++iix]) / 2;
-            }
-        }
-        len      >>= 1;
-        channels   = 1;
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+VorbisLibEncoder :: writeFrame (    const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
     }
 
-    sampleSize = (bitsPerSample / 8) * channels;
-    unsigned char * b = (unsigned char*) buf;
-    unsigned int    processed = len - (len % sampleSize);
-    unsigned int    nSamples = processed / sampleSize;
-    float        ** vorbisBuffer;
+    // resample if needed, the frame may already hold the resampled audio
+    const AudioFrame  * in       = resample( frame);
+    unsigned int        channels = getInChannel();
+    unsigned int        nSamples = in->getSamples();
 
+    if ( pipeline.get() ) {
+        Ref<Packet>     samples;
 
-    // convert the byte-based raw input into a short buffer
-    // with channels still interleaved
-    unsigned int    totalSamples = nSamples * channels;
-    short int     * shortBuffer  = new short int[totalSamples];
+        // the channels one after the other
+        if ( channels == 2 ) {
+            samples = pipeline->newSamples( in->getFloat( 0),
+                                            nSamples * sizeof(float),
+                                            in->getFloat( 1),
+                                            nSamples * sizeof(float));
+        } else {
+            samples = pipeline->newSamples( in->getFloat( 0),
+                                            nSamples * sizeof(float));
+        }
 
+        // mux what the codec thread has encoded meanwhile
+        while ( !pipeline->push( samples.get()) ) {
+            pipelineOut( false);
+        }
+        pipelineOut( false);
+    } else {
+        const float   * planes[2];
 
-    Util::conv( bitsPerSample, b, processed, shortBuffer, isInBigEndian());
+        planes[0] = in->getFloat( 0);
+        planes[1] = channels == 2 ? in->getFloat( 1) : 0;
+        encodeSamples( planes, nSamples);
+    }
+    pagesWrite();
 
-    if ( converter ) {
-        // resample if needed
-        int         inCount  = nSamples;
-        int         outCount = (int) (inCount * resampleRatio);
-        short int * resampledBuffer = new short int[(outCount+1)* channels];
-        int         converted;
-#ifdef HAVE_SRC_LIB
-        converterData.input_frames   = nSamples;
-        src_short_to_float_array (shortBuffer, (float *) converterData.data_in, totalSamples);
-        int srcError = src_process (converter, &converterData);
-        if (srcError)
-             throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-        converted = converterData.output_frames_gen;
+    return frame->getSize();
+}
 
-        src_float_to_short_array(converterData.data_out, resampledBuffer, converted*channels);
 
-#else
-        converted = converter->resample( inCount,
-                                         outCount,
-                                         shortBuffer,
-                                         resampledBuffer );
-#endif
-
-        vorbisBuffer = vorbis_analysis_buffer( &vorbisDspState,
-                                               converted);
-        Util::conv( resampledBuffer,
-                    converted * channels,
-                    vorbisBuffer,
-                    channels);
-        delete[] resampledBuffer;
+/*------------------------------------------------------------------------------
+ *  Encode samples
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: encodeSamples ( const float * const   * planes,
+                                    unsigned int            nSamples )
+{
+    unsigned int        channels = getInChannel();
+    bool                downmix  = channels == 2 && getOutChannel() == 1;
+    float            ** vorbisBuffer;
+
+    // make the next logical stream ready ahead of a cut, here on the
+    // codec thread if pipelined, so that the cut itself doesn't wait
+    // for the codec to be set up. only a stream to a file starts anew
+    if ( !spareLink && getSink()->isFile() ) {
+        spareLink = linkCreate();
+    }
 
-        vorbis_analysis_wrote( &vorbisDspState, converted);
+    vorbisBuffer = vorbis_analysis_buffer( &codecLink->vorbisDspState,
+                                           nSamples);
+    if ( downmix ) {
+        const float   * left  = planes[0];
+        const float   * right = planes[1];
 
+        for ( unsigned int i = 0; i < nSamples; ++i ) {
+            vorbisBuffer[0][i] = (left[i] + right[i]) / 2;
+        }
     } else {
-
-        vorbisBuffer = vorbis_analysis_buffer( &vorbisDspState, nSamples);
-        Util::conv( shortBuffer, totalSamples, vorbisBuffer, channels);
-        vorbis_analysis_wrote( &vorbisDspState, nSamples);
+        for ( unsigned int c = 0; c < channels; ++c ) {
+            memcpy( vorbisBuffer[c],
+                    planes[c],
+                    nSamples * sizeof(float));
+        }
     }
+    vorbis_analysis_wrote( &codecLink->vorbisDspState, nSamples);
 
-    delete[] shortBuffer;
-    
     vorbisBlocksOut();
+}
+
 
-    return processed;
+/*------------------------------------------------------------------------------
+ *  Tell the codec that the stream has ended
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: encodeEnd ( void )
+{
+    vorbis_analysis_wrote( &codecLink->vorbisDspState, 0);
+    vorbisBlocksOut();
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Encode a block of samples on the codec thread
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: encodeBlock (   const Packet      * samples )
+{
+    const float       * planes[2];
+    unsigned int        nSamples;
+
+    if ( !samples ) {
+        encodeEnd();
+        if ( restarting ) {
+            codecNext();
+        }
+        return;
+    }
+
+    nSamples  = samples->getSize() / (getInChannel() * sizeof(float));
+    planes[0] = (const float *) samples->getData();
+    planes[1] = planes[0] + nSamples;
+    encodeSamples( planes, nSamples);
 }
 
 
@@ -388,43 +467,220 @@ VorbisLibEncoder :: flush ( void )
         return;
     }
 
-    vorbis_analysis_wrote( &vorbisDspState, 0);
-    vorbisBlocksOut();
+    if ( pipeline.get() ) {
+        // wait for the codec thread to encode all of the stream
+        while ( !pipeline->push( 0) ) {
+            pipelineOut( false);
+        }
+        pipelineOut( true);
+    } else {
+        encodeEnd();
+    }
+    pagesWrite();
     getSink()->flush();
 }
 
 
+/*------------------------------------------------------------------------------
+ *  Cut the stream at a time, and go on in a new logical stream
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: cutAt ( double          boundary )       throw ()
+{
+    if ( !isOpen()
+      || !getSink()->isFile() ) {
+        // the listeners keep their stream, sinks with a file to cut
+        // start the new one with the header of the stream
+        getSink()->cutAt( boundary);
+        return;
+    }
+
+    try {
+        // end the logical stream, so that all of it goes before the cut
+        if ( pipeline.get() ) {
+            restarting = true;
+            while ( !pipeline->push( 0) ) {
+                pipelineOut( false);
+            }
+            pipelineOut( true);
+            restarting = false;
+        } else {
+            encodeEnd();
+            codecNext();
+        }
+        pagesWrite();
+    } catch ( Exception     & e ) {
+        restarting = false;
+        reportEvent( 2, "couldn't end vorbis stream for cut", e);
+    }
+
+    // the new file starts with the header of the next logical stream,
+    // not with the one of the stream ended
+    getSink()->setHeader( 0);
+    getSink()->cutAt( boundary);
+
+    // the next logical stream, ready by now, starts after the cut
+    if ( codecLink != muxLink ) {
+        muxNext();
+        try {
+            pagesWrite( true);
+        } catch ( Exception     & e ) {
+            reportEvent( 2, "couldn't start vorbis stream after cut", e);
+        }
+    }
+}
+
+
 /*------------------------------------------------------------------------------
  *  Send pending Vorbis blocks to the underlying stream
  *----------------------------------------------------------------------------*/
 void
 VorbisLibEncoder :: vorbisBlocksOut ( void )                
 {
-    while ( 1 == vorbis_analysis_blockout( &vorbisDspState, &vorbisBlock) ) {
+    vorbis_dsp_state  * dspState = &codecLink->vorbisDspState;
+    vorbis_block      * block    = &codecLink->vorbisBlock;
+
+    while ( 1 == vorbis_analysis_blockout( dspState, block) ) {
         ogg_packet      oggPacket;
-        ogg_page        oggPage;
 
-        vorbis_analysis( &vorbisBlock, &oggPacket);
-        vorbis_bitrate_addblock( &vorbisBlock);
+        vorbis_analysis( block, &oggPacket);
+        vorbis_bitrate_addblock( block);
 
-        while ( vorbis_bitrate_flushpacket( &vorbisDspState, &oggPacket) ) {
+        while ( vorbis_bitrate_flushpacket( dspState, &oggPacket) ) {
+            packetOut( &oggPacket);
+        }
+    }
+}
 
-            ogg_stream_packetin( &oggStreamState, &oggPacket);
 
-            while ( ogg_stream_pageout( &oggStreamState, &oggPage) ) {
-                int    written = 0;
-                
-                written  = getSink()->write(oggPage.header, oggPage.header_len);
-                written += getSink()->write( oggPage.body, oggPage.body_len);
+/*------------------------------------------------------------------------------
+ *  Pass on an encoded packet
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: packetOut ( ogg_packet    * oggPacket )
+{
+    if ( pipeline.get() ) {
+        // on the codec thread, the Ogg stream is muxed by the writer
+        Ref<Packet>     packet = pipeline->newPacket( oggPacket->packet,
+                                                      oggPacket->bytes);
+
+        pipeline->emit( packet.get(),
+                        oggPacket->granulepos,
+                        oggPacket->packetno,
+                        oggPacket->e_o_s);
+    } else {
+        pagesOut( oggPacket);
+    }
+}
 
-                if ( written < oggPage.header_len + oggPage.body_len ) {
-                    // just let go data that could not be written
-                    reportEvent( 2,
-                           "couldn't write full vorbis data to underlying sink",
-                           oggPage.header_len + oggPage.body_len - written);
-                }
-            }
+
+/*------------------------------------------------------------------------------
+ *  Send an encoded packet to the Ogg stream
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: pagesOut (  ogg_packet    * oggPacket )
+{
+    ogg_stream_state  * streamState = &muxLink->oggStreamState;
+    ogg_page            oggPage;
+
+    ogg_stream_packetin( streamState, oggPacket);
+
+    for (;;) {
+        int     ret;
+
+        if ( !pageSamples ) {
+            ret = ogg_stream_pageout( streamState, &oggPage);
+        } else if ( oggPacket->granulepos - pageGranule >= pageSamples ) {
+            // the page is long enough, end it with this packet
+            ret = ogg_stream_flush_fill( streamState, &oggPage, maxPageFill);
+        } else {
+            // only full pages until then
+            ret = ogg_stream_pageout_fill( streamState,
+                                           &oggPage,
+                                           maxPageFill);
+        }
+        if ( !ret ) {
+            break;
+        }
+
+        if ( ogg_page_granulepos( &oggPage) != -1 ) {
+            pageGranule = ogg_page_granulepos( &oggPage);
         }
+        pageCollect( &oggPage);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Collect an Ogg page
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: pageCollect (   const ogg_page    * oggPage )
+{
+    unsigned int        len = oggPage->header_len + oggPage->body_len;
+    unsigned char     * buf;
+
+    buf = pageBuffer.grow( pageBufferLen + len, pageBufferLen);
+    memcpy( buf + pageBufferLen, oggPage->header, oggPage->header_len);
+    memcpy( buf + pageBufferLen + oggPage->header_len,
+            oggPage->body,
+            oggPage->body_len);
+    pageBufferLen += len;
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Send the collected pages to the underlying sink
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: pagesWrite ( bool       header )
+{
+    Ref<Packet>     packet;
+    unsigned int    written;
+
+    if ( !pageBufferLen ) {
+        return;
+    }
+
+    // the pages are written as a whole, so that they are never cut
+    if ( header ) {
+        // kept for as long as the stream goes on, not to be re-used
+        packet    = new Packet( pageBuffer.get(), pageBufferLen);
+        getSink()->setHeader( packet.get());
+    } else {
+        packet    = pool->get( pageBuffer.get(), pageBufferLen);
+    }
+    written       = getSink()->writePacket( packet.get());
+    pageBufferLen = 0;
+
+    if ( written < packet->getSize() ) {
+        // just let go data that could not be written
+        reportEvent( 2,
+                     "couldn't write full vorbis data to underlying sink",
+                     packet->getSize() - written);
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Send the packets encoded by the codec thread to the Ogg stream
+ *----------------------------------------------------------------------------*/
+void
+VorbisLibEncoder :: pipelineOut (   bool    wait )
+{
+    EncoderPipeline::Block      block;
+
+    while ( pipeline->pop( block, wait) && block.packet.get() ) {
+        ogg_packet      oggPacket;
+
+        oggPacket.packet     = (unsigned char *) block.packet->getData();
+        oggPacket.bytes      = block.packet->getSize();
+        oggPacket.b_o_s      = 0;
+        oggPacket.e_o_s      = block.endOfStream;
+        oggPacket.granulepos = block.granulePosition;
+        oggPacket.packetno   = block.packetNumber;
+
+        pagesOut( &oggPacket);
     }
 }
 
@@ -438,11 +694,19 @@ VorbisLibEncoder :: close ( void )
     if ( isOpen() ) {
         flush();
 
-        ogg_stream_clear( &oggStreamState);
-        vorbis_block_clear( &vorbisBlock);
-        vorbis_dsp_clear( &vorbisDspState);
-        vorbis_comment_clear( &vorbisComment);
-        vorbis_info_clear( &vorbisInfo);
+        if ( pipeline.get() ) {
+            pipeline->stop();
+            pipeline = 0;
+        }
+
+        if ( codecLink != muxLink ) {
+            linkDelete( codecLink);
+        }
+        linkDelete( muxLink);
+        linkDelete( spareLink);
+        codecLink = 0;
+        muxLink   = 0;
+        spareLink = 0;
 
         encoderOpen = false;
 
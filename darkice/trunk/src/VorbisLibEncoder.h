@@ -52,11 +52,9 @@
 #include "Reporter.h"
 #include "AudioEncoder.h"
 #include "Sink.h"
-#ifdef HAVE_SRC_LIB
-#include <samplerate.h>
-#else
-#include "aflibConverter.h"
-#endif
+#include "EncoderPipeline.h"
+#include "PacketPool.h"
+#include "ScratchBuffer.h"
 
 
 /* ================================================================ constants */
@@ -74,39 +72,71 @@
  *  @author  $Author$
  *  @version $Revision$
  */
-class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
+class VorbisLibEncoder : public AudioEncoder,
+                         public PipelinedEncoder,
+                         public virtual Reporter
 {
     private:
 
+        /**
+         *  A logical stream: the state of the codec, and of the Ogg
+         *  stream it is muxed into. Kept apart from the encoder, so that
+         *  the next logical stream can be made ready before a cut.
+         */
+        struct Link {
+            /**
+             *  Ogg Vorbis library global info
+             */
+            vorbis_info                 vorbisInfo;
+
+            /**
+             *  Ogg Vorbis library global DSP state
+             */
+            vorbis_dsp_state            vorbisDspState;
+
+            /**
+             *  Ogg Vorbis library global block
+             */
+            vorbis_block                vorbisBlock;
+
+            /**
+             *  Ogg library stream state, with the headers already in it
+             */
+            ogg_stream_state            oggStreamState;
+        };
+
         /**
          *  Value indicating if the encoding process is going on
          */
         bool                            encoderOpen;
 
         /**
-         *  Ogg Vorbis library global info
+         *  The logical stream the codec encodes into.
          */
-        vorbis_info                     vorbisInfo;
+        Link                          * codecLink;
 
         /**
-         *  Ogg Vorbis library global DSP state
+         *  The logical stream the encoded packets are muxed into. The
+         *  same as codecLink, except while a cut drains the codec
+         *  thread.
          */
-        vorbis_dsp_state                vorbisDspState;
+        Link                          * muxLink;
 
         /**
-         *  Ogg Vorbis library global block
+         *  The next logical stream, made ready ahead of a cut, or NULL.
          */
-        vorbis_block                    vorbisBlock;
+        Link                          * spareLink;
 
         /**
-         *  Ogg Vorbis library global comment
+         *  The serial number of the next logical stream made.
          */
-        vorbis_comment                  vorbisComment;
+        int                             streamSerial;
 
         /**
-         *  Ogg library global stream state
+         *  Tells the codec thread to take the next logical stream
+         *  when the current one ends, as the stream is being cut.
          */
-        ogg_stream_state                oggStreamState;
+        bool                            restarting;
 
         /**
          *  Maximum bitrate of the output in kbits/sec. If 0, don't care.
@@ -114,28 +144,61 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
         unsigned int                    outMaxBitrate;
 
         /**
-         *  Resample ratio
+         *  The number of blocks of samples queued for the codec thread,
+         *  or 0 to encode on the thread writing to the encoder.
          */
-        double                          resampleRatio;
+        unsigned int                    pipelineDepth;
 
         /**
-         *  sample rate converter object for possible resampling
+         *  The codec thread, while open with a pipeline depth.
          */
-#ifdef HAVE_SRC_LIB
-        SRC_STATE                     * converter;
-        SRC_DATA                      converterData;
-#else
-        aflibConverter                * converter;
-#endif
+        Ref<EncoderPipeline>            pipeline;
+
+        /**
+         *  The duration of the Ogg pages to aim for, in milliseconds,
+         *  or 0 to leave it to libogg.
+         */
+        unsigned int                    pageDuration;
+
+        /**
+         *  The pageDuration in samples of the output.
+         */
+        ogg_int64_t                     pageSamples;
+
+        /**
+         *  The granule position of the last page sent.
+         */
+        ogg_int64_t                     pageGranule;
+
+        /**
+         *  The pages not yet sent to the underlying sink.
+         */
+        ScratchBuffer<unsigned char>    pageBuffer;
+
+        /**
+         *  The number of bytes in pageBuffer.
+         */
+        unsigned int                    pageBufferLen;
+
+        /**
+         *  The packets the pages are sent in.
+         */
+        PacketPool                    * pool;
 
         /**
          *  Initialize the object.
          *
          *  @param the maximum bit rate
+         *  @param pipelineDepth the number of blocks of samples to queue
+         *                       for the codec thread, 0 for none.
+         *  @param pageDuration the duration of the Ogg pages in
+         *                      milliseconds, 0 to leave it to libogg.
          *  @exception Exception
          */
         void
-        init ( unsigned int     outMaxBitrate )         ;
+        init ( unsigned int     outMaxBitrate,
+               unsigned int     pipelineDepth,
+               unsigned int     pageDuration )          ;
 
         /**
          *  De-initialize the object.
@@ -145,23 +208,124 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
         inline void
         strip ( void )                                  
         {
-            if ( converter ) {
-#ifdef HAVE_SRC_LIB
-                delete [] converterData.data_in;
-                delete [] converterData.data_out;
-                src_delete (converter);
-#else
-                delete converter;
-#endif
-            }
+            delete pool;
         }
 
+        /**
+         *  Make a logical stream: set up the codec, and put its headers
+         *  into a new Ogg stream.
+         *
+         *  @return the new logical stream.
+         *  @exception Exception
+         */
+        Link *
+        linkCreate ( void )                                 ;
+
+        /**
+         *  Let go of a logical stream.
+         *
+         *  @param link the logical stream, may be NULL.
+         */
+        void
+        linkDelete (    Link      * link )                  ;
+
+        /**
+         *  Have the codec encode into the next logical stream, on the
+         *  codec thread if pipelined, after the current one has ended.
+         *
+         *  @exception Exception
+         */
+        void
+        codecNext ( void )                                  ;
+
+        /**
+         *  Mux into the logical stream of the codec, once the packets
+         *  of the previous one have all been muxed, and collect its
+         *  header pages.
+         */
+        void
+        muxNext ( void )                                    ;
+
         /**
          *  Send pending Vorbis blocks to the underlying stream
          */
         void
         vorbisBlocksOut( void )                         ;
 
+        /**
+         *  Encode samples.
+         *
+         *  @param planes the samples of each channel.
+         *  @param nSamples the number of samples for each channel.
+         *  @exception Exception
+         */
+        void
+        encodeSamples ( const float * const   * planes,
+                        unsigned int            nSamples )  ;
+
+        /**
+         *  Tell the codec that the stream has ended.
+         *
+         *  @exception Exception
+         */
+        void
+        encodeEnd ( void )                                  ;
+
+        /**
+         *  Pass on an encoded packet: to the Ogg stream, or back from
+         *  the codec thread, when pipelined.
+         *
+         *  @param oggPacket the encoded packet.
+         *  @exception Exception
+         */
+        void
+        packetOut ( ogg_packet    * oggPacket )             ;
+
+        /**
+         *  Send an encoded packet to the Ogg stream, and collect the
+         *  pages completed by it, see pagesWrite().
+         *
+         *  @param oggPacket the encoded packet.
+         */
+        void
+        pagesOut (  ogg_packet    * oggPacket )             ;
+
+        /**
+         *  Collect an Ogg page, to be sent by pagesWrite().
+         *
+         *  @param oggPage the page.
+         */
+        void
+        pageCollect (   const ogg_page    * oggPage )       ;
+
+        /**
+         *  Send the collected pages to the underlying sink, in a
+         *  single write.
+         *
+         *  @param header tells if the pages are the headers of the
+         *                stream, for the sinks to start over with.
+         */
+        void
+        pagesWrite ( bool       header = false )            ;
+
+        /**
+         *  Send the packets encoded by the codec thread to the Ogg stream.
+         *
+         *  @param wait wait for the end of the stream.
+         *  @exception Exception
+         */
+        void
+        pipelineOut (   bool    wait )                      ;
+
+        /**
+         *  Encode a block of samples on the codec thread.
+         *
+         *  @param samples the samples, or NULL to end the stream.
+         *  @exception Exception
+         */
+        virtual void
+        encodeBlock (   const Packet      * samples )       ;
+
 
     protected:
 
@@ -196,6 +360,13 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
          *                       0 if not used.
          *  @param outChannel number of channels of the output.
          *                    If 0, inChannel is used.
+         *  @param pipelineDepth the number of blocks of samples to queue
+         *                       for a codec thread of its own, or 0 to
+         *                       encode on the thread writing the samples.
+         *  @param pageDuration the duration of the Ogg pages to aim for,
+         *                      in milliseconds, or 0 to leave it to
+         *                      libogg. Longer pages mean less overhead,
+         *                      shorter ones less delay for listeners.
          *  @exception Exception
          */
         inline
@@ -209,7 +380,9 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
                             double          outQuality,
                             unsigned int    outSampleRate = 0,
                             unsigned int    outChannel    = 0,
-                            unsigned int    outMaxBitrate = 0 )
+                            unsigned int    outMaxBitrate = 0,
+                            unsigned int    pipelineDepth = 0,
+                            unsigned int    pageDuration  = 0 )
                                                         
 
                     : AudioEncoder ( sink,
@@ -223,7 +396,7 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
                                      outSampleRate,
                                      outChannel )
         {
-            init( outMaxBitrate);
+            init( outMaxBitrate, pipelineDepth, pageDuration);
         }
 
         /**
@@ -241,6 +414,14 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
          *                       0 if not used.
          *  @param outChannel number of channels of the output.
          *                    If 0, input channel is used.
+         *  @param pipelineDepth the number of blocks of samples to queue
+         *                       for a codec thread of its own, or 0 to
+         *                       encode on the thread writing the samples.
+         *  @param pageDuration the duration of the Ogg pages to aim for,
+         *                      in milliseconds, or 0 to leave it to
+         *                      libogg.
+         *  @param channelMap the channels of the AudioSource to encode,
+         *                    or NULL to encode all of them.
          *  @exception Exception
          */
         inline
@@ -251,7 +432,10 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
                             double                  outQuality,
                             unsigned int            outSampleRate = 0,
                             unsigned int            outChannel    = 0,
-                            unsigned int            outMaxBitrate = 0 )
+                            unsigned int            outMaxBitrate = 0,
+                            unsigned int            pipelineDepth = 0,
+                            unsigned int            pageDuration  = 0,
+                            ChannelMap            * channelMap    = 0 )
                                                             
 
                     : AudioEncoder ( sink,
@@ -260,9 +444,10 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
                                      outBitrate,
                                      outQuality,
                                      outSampleRate,
-                                     outChannel )
+                                     outChannel,
+                                     channelMap )
         {
-            init( outMaxBitrate);
+            init( outMaxBitrate, pipelineDepth, pageDuration);
         }
 
         /**
@@ -278,7 +463,9 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
             if( encoder.isOpen() ) {
                 throw Exception(__FILE__, __LINE__, "don't copy open encoders");
             }
-            init( encoder.getOutMaxBitrate() );
+            init( encoder.getOutMaxBitrate(),
+                  encoder.getPipelineDepth(),
+                  encoder.getPageDuration() );
         }
 
         /**
@@ -312,7 +499,9 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
             if ( this != &encoder ) {
                 strip();
                 AudioEncoder::operator=( encoder);
-                init( encoder.getOutMaxBitrate() );
+                init( encoder.getOutMaxBitrate(),
+                  encoder.getPipelineDepth(),
+                  encoder.getPageDuration() );
             }
 
             return *this;
@@ -330,6 +519,29 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
             return outMaxBitrate;
         }
 
+        /**
+         *  Get the number of blocks of samples queued for the codec thread.
+         *
+         *  @return the depth of the encoder pipeline, 0 if not pipelined.
+         */
+        inline unsigned int
+        getPipelineDepth ( void ) const        throw ()
+        {
+            return pipelineDepth;
+        }
+
+        /**
+         *  Get the duration of the Ogg pages aimed for.
+         *
+         *  @return the duration of the pages in milliseconds,
+         *          0 if left to libogg.
+         */
+        inline unsigned int
+        getPageDuration ( void ) const         throw ()
+        {
+            return pageDuration;
+        }
+
         /**
          *  Check whether encoding is in progress.
          *
@@ -402,7 +614,8 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
                 return false;
             }
 
-            if ( 1 == vorbis_analysis_blockout( &vorbisDspState, &vorbisBlock) ) {
+            if ( 1 == vorbis_analysis_blockout( &codecLink->vorbisDspState,
+                                                &codecLink->vorbisBlock) ) {
               return getSink()->canWrite(sec, usec);
             } else {
               return true;
@@ -424,6 +637,28 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
         write (        const void    * buf,
                        unsigned int    len )        ;
 
+        /**
+         *  Write a frame of audio to the encoder, using the already
+         *  converted samples of the frame.
+         *
+         *  @param frame the audio to encode.
+         *  @return the number of bytes of raw audio processed.
+         *  @exception Exception
+         */
+        virtual unsigned int
+        writeFrame (   const AudioFrame    * frame )        ;
+
+        /**
+         *  Tell if the encoder resamples its input through a Resampler.
+         *
+         *  @return true if the input and output sample rates differ.
+         */
+        inline virtual bool
+        usesResampler ( void ) const                    throw ()
+        {
+            return getInSampleRate() != getOutSampleRate();
+        }
+
         /**
          *  Flush all data that was written to the encoder to the underlying
          *  connection.
@@ -433,6 +668,29 @@ class VorbisLibEncoder : public AudioEncoder, public virtual Reporter
         virtual void
         flush ( void )                              ;
 
+        /**
+         *  Cut the stream: end the logical stream, cut the underlying
+         *  sink, and go on in a new logical stream, which starts with
+         *  its own headers. The new logical stream is made ready well
+         *  before, so that the cut costs no more than the end of the
+         *  current one.
+         */
+        inline virtual void
+        cut ( void )                                    throw ()
+        {
+            cutAt( 0.0);
+        }
+
+        /**
+         *  Cut the stream at a known time, as cut(), the underlying sink
+         *  being cut at that time.
+         *
+         *  @param boundary the time of the cut, in seconds since the epoch,
+         *                  or 0 for a cut at no particular time.
+         */
+        virtual void
+        cutAt ( double          boundary )              throw ();
+
         /**
          *  Close the encoding session.
          *
@@ -203,29 +203,8 @@ aacPlusEncoder :: open ( void )
 	}
 
     inputSamples = info.frameLength * OutChannels;
-    // initialize the resampling coverter if needed
-    if ( converter ) {
-#ifdef HAVE_SRC_LIB
-        converterData.input_frames   = 4096/((getInBitsPerSample() / 8) * getInChannel());
-        converterData.data_in        = new float[converterData.input_frames*getInChannel()];
-        converterData.output_frames  = (int) (converterData.input_frames * resampleRatio + 1);
-        if ((int) inputSamples >  getInChannel() * converterData.output_frames) {
-            resampledOffset       = new float[2 * inputSamples];
-        } else {
-            resampledOffset       = new float[2 * getInChannel() * converterData.input_frames];
-        }
-        converterData.src_ratio      = resampleRatio;
-        converterData.end_of_input   = 0;
-#else
-        converter->initialize( resampleRatio, getInChannel());
-        //needed 2x(converted input samples) to handle offsets
-        int outCount                 = 2 * getInChannel() * (inputSamples + 1);
-        if (resampleRatio > 1)
-        outCount = (int) (outCount * resampleRatio);
-        resampledOffset = new short int[outCount];
-#endif
-        resampledOffsetSize = 0;
-    }
+    resampledOffsetSize = 0;
+    outputBuffer.reserve( maxOutputBytes);
 
     aacplusOpen = true;
     reportEvent(10, "nChannelsAAC", OutChannels);
@@ -246,13 +225,27 @@ aacPlusEncoder :: write (  const void    * buf,
         return 0;
     }
 
+    return writeFrame( toFrame( buf, len));
+}
+
+
+/*------------------------------------------------------------------------------
+ *  Write a frame of audio to the encoder
+ *----------------------------------------------------------------------------*/
+unsigned int
+aacPlusEncoder :: writeFrame (  const AudioFrame    * frame )
+{
+    if ( !isOpen() || frame->getSize() == 0 ) {
+        return 0;
+    }
+
+    // resample if needed, the frame may already hold the resampled audio
+    const AudioFrame  * in           = resample( frame);
     unsigned int    channels         = getInChannel();
-    unsigned int    bitsPerSample    = getInBitsPerSample();
-    unsigned int    sampleSize       = (bitsPerSample / 8) * channels;
-    unsigned char * b                = (unsigned char*) buf;
-    unsigned int    processed        = len - (len % sampleSize);
-    unsigned int    nSamples         = processed / sampleSize;
-    unsigned char * aacplusBuf          = (unsigned char *) malloc(maxOutputBytes);
+    unsigned int    bitsPerSample    = 16;
+    unsigned int    nSamples         = in->getSamples();
+    short int     * b                = (short int *) in->getShort();
+    unsigned char * aacplusBuf       = outputBuffer.get();
     int             samples          = (int) nSamples * channels;
     int             processedSamples = 0;
 
@@ -268,7 +261,7 @@ aacPlusEncoder :: write (  const void    * buf,
     int out_size, out_elem_size;
     int input_size;
 
-    in_elem_size = (getInBitsPerSample() / 8);
+    in_elem_size = (bitsPerSample / 8);
     in_buf.bufElSizes = &in_elem_size;
     in_buf.numBufs = 1;
     in_buf.bufferIdentifiers = &in_identifier;
@@ -281,51 +274,31 @@ aacPlusEncoder :: write (  const void    * buf,
     out_buf.bufSizes = &out_size;
     out_buf.bufElSizes = &out_elem_size;
 
-    if ( converter ) {
-        unsigned int         converted;
-#ifdef HAVE_SRC_LIB
-        src_short_to_float_array ((short *) b, (float *) converterData.data_in, samples);
-        converterData.input_frames   = nSamples;
-        converterData.data_out = resampledOffset + (resampledOffsetSize * channels);
-        int srcError = src_process (converter, &converterData);
-        if (srcError)
-             throw Exception (__FILE__, __LINE__, "libsamplerate error: ", src_strerror (srcError));
-        converted = converterData.output_frames_gen;
-#else
-        int         inCount  = nSamples;
-        short int     * shortBuffer  = new short int[samples];
-        int         outCount = (int) (inCount * resampleRatio);
-        Util::conv( bitsPerSample, b, processed, shortBuffer, isInBigEndian());
-        converted = converter->resample( inCount,
-                                         outCount+1,
-                                         shortBuffer,
-                                         &resampledOffset[resampledOffsetSize*channels]);
-        delete[] shortBuffer;
-#endif
-        resampledOffsetSize += converted;
+    if ( usesResampler() ) {
+        // the resampled chunks don't match the encoder input size,
+        // so collect them until there is enough to encode
+        if ( resampledOffsetSize + nSamples > resampledOffsetCapacity ) {
+            short int * buf = new short int[(resampledOffsetSize + nSamples)
+                                          * channels];
+
+            if ( resampledOffsetSize ) {
+                memcpy( buf,
+                        resampledOffset,
+                        resampledOffsetSize * channels * sizeof(short int));
+            }
+            delete[] resampledOffset;
+            resampledOffset         = buf;
+            resampledOffsetCapacity = resampledOffsetSize + nSamples;
+        }
+        memcpy( resampledOffset + resampledOffsetSize * channels,
+                b,
+                samples * sizeof(short int));
+        resampledOffsetSize += nSamples;
 
         // encode samples (if enough)
         while(resampledOffsetSize - processedSamples >= inputSamples / channels) {
-#ifdef HAVE_SRC_LIB
-            input_size = inputSamples * (bitsPerSample / 8);
-            short *shortData = (int16_t*) malloc(input_size);
-
-            src_float_to_short_array(resampledOffset + (processedSamples * channels),
-                                     shortData, inputSamples) ;
-
-            in_buf.bufs = (void **) &shortData;
-
-            in_args.numInSamples = inputSamples;
-            in_buf.bufSizes = &input_size;
-
-            if ((err = aacEncEncode(encoderHandle, &in_buf, &out_buf, &in_args, &out_args)) != AACENC_OK)
-                throw Exception( __FILE__, __LINE__, "fdk-aac aacEncEncode error");
-
-            outputBytes = out_args.numOutBytes;
-
-            free(shortData);
-#else
-            in_buf.bufs = &(resampledOffset + (processedSamples * channels));
+            void *tmp = &(resampledOffset[processedSamples * channels]);
+            in_buf.bufs = &tmp;
             input_size = inputSamples * (bitsPerSample / 8);
             in_args.numInSamples = inputSamples;
             in_buf.bufSizes = &input_size;
@@ -335,7 +308,6 @@ aacPlusEncoder :: write (  const void    * buf,
 
             outputBytes = out_args.numOutBytes;
 
-#endif
             unsigned int wrote = getSink()->write(aacplusBuf, outputBytes);
             
             if (wrote < outputBytes) {
@@ -349,13 +321,8 @@ aacPlusEncoder :: write (  const void    * buf,
             resampledOffsetSize -= processedSamples;
             //move least part of resampled data to beginning
             if(resampledOffsetSize)
-#ifdef HAVE_SRC_LIB
-                resampledOffset = (float *) memmove(resampledOffset, &resampledOffset[processedSamples*channels],
-                                                    resampledOffsetSize*channels*sizeof(float));
-#else
-                resampledOffset = (short *) memmove(resampledOffset, &resampledOffset[processedSamples*channels],
-                                                    resampledOffsetSize*sampleSize);
-#endif
+                memmove(resampledOffset, &resampledOffset[processedSamples*channels],
+                        resampledOffsetSize*channels*sizeof(short int));
         }
     } else {
         while (processedSamples < samples) {
@@ -363,7 +330,7 @@ aacPlusEncoder :: write (  const void    * buf,
                               ? samples - processedSamples
                               : inputSamples;
 
-            void *tmp = &(b[processedSamples / sampleSize]);
+            void *tmp = &(b[processedSamples]);
             in_buf.bufs = &tmp;
             input_size = inputSamples * (bitsPerSample / 8);
             in_args.numInSamples = inSamples;
@@ -384,10 +351,8 @@ aacPlusEncoder :: write (  const void    * buf,
         }
     }
 
-    free(aacplusBuf);
-
 //    return processedSamples;
-    return samples * sampleSize;
+    return frame->getSize();
 }
 
 /*------------------------------------------------------------------------------